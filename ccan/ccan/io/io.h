@@ -814,6 +814,29 @@ struct timemono (*io_time_override(struct timemono (*now)(void)))(void);
  */
 int (*io_poll_override(int (*poll)(struct pollfd *fds, nfds_t nfds, int timeout)))(struct pollfd *, nfds_t, int);
 
+/**
+ * io_use_epoll - use epoll(7) to find ready fds, rather than poll(2).
+ * @enable: true to use epoll, false for poll.
+ *
+ * poll() costs time proportional to the number of fds on every loop,
+ * which adds up with thousands of connections; epoll only costs for
+ * the fds which are ready.  The poll override (see io_poll_override)
+ * is still called to do the sleeping, but on the single epoll fd: an
+ * override which fakes results rather than calling poll() will only
+ * work with poll().  It's off by default.
+ *
+ * This can only be changed while there are no fds: returns false if
+ * there are, or if epoll isn't available (and poll() will be used).
+ * If epoll fails later (eg. for fds it can't handle, like regular
+ * files) io falls back to poll() by itself, as does a child after
+ * fork(), since it shares the epoll fd with its parent.
+ *
+ * Example:
+ *	// Doesn't matter if it fails: poll() works too.
+ *	io_use_epoll(true);
+ */
+bool io_use_epoll(bool enable);
+
 /**
  * io_have_fd - do we own this file descriptor?
  * @fd: the file descriptor.
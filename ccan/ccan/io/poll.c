@@ -4,12 +4,18 @@
 #include <assert.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <limits.h>
 #include <errno.h>
 #include <ccan/time/time.h>
 #include <ccan/timer/timer.h>
+#if HAVE_SYS_EPOLL_H
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 static size_t num_fds = 0, max_fds = 0, num_waiting = 0, num_always = 0, max_always = 0, num_exclusive = 0;
 static struct pollfd *pollfds = NULL;
@@ -18,6 +24,117 @@ static struct io_plan **always = NULL;
 static struct timemono (*nowfn)(void) = time_mono;
 static int (*pollfn)(struct pollfd *fds, nfds_t nfds, int timeout) = poll;
 
+#if HAVE_SYS_EPOLL_H
+/* We keep pollfds up-to-date even when using epoll: it's how we know
+ * what we registered, and what we fall back to. */
+static bool use_epoll = false;
+static int epfd = -1;
+/* A child after fork() shares the epoll instance with its parent:
+ * it must not touch it, so it drops back to poll(). */
+static pid_t epoll_pid;
+
+/* Indexed by fd number.  Events carry the generation too: an event for
+ * an fd which was closed (and the number reused) while we were
+ * handling earlier events is stale. */
+struct epoll_slot {
+	struct fd *fd;
+	uint32_t gen;
+};
+static struct epoll_slot *epoll_slots = NULL;
+static uint32_t epoll_gen = 0;
+
+static void epoll_stop(void)
+{
+	close(epfd);
+	epfd = -1;
+	epoll_slots = tal_free(epoll_slots);
+}
+
+static uint32_t to_epoll_events(short events)
+{
+	uint32_t ev = 0;
+
+	if (events & POLLIN)
+		ev |= EPOLLIN;
+	if (events & POLLOUT)
+		ev |= EPOLLOUT;
+	return ev;
+}
+
+static short from_epoll_events(uint32_t ev)
+{
+	short events = 0;
+
+	if (ev & EPOLLIN)
+		events |= POLLIN;
+	if (ev & EPOLLOUT)
+		events |= POLLOUT;
+	if (ev & EPOLLERR)
+		events |= POLLERR;
+	if (ev & EPOLLHUP)
+		events |= POLLHUP;
+	return events;
+}
+
+static bool epoll_add_slot(struct fd *fd)
+{
+	size_t n = tal_count(epoll_slots);
+
+	if (fd->fd >= n) {
+		size_t num = n;
+
+		while (num <= fd->fd)
+			num *= 2;
+		if (!tal_resize(&epoll_slots, num))
+			return false;
+		memset(epoll_slots + n, 0, (num - n) * sizeof(*epoll_slots));
+	}
+	epoll_slots[fd->fd].fd = fd;
+	epoll_slots[fd->fd].gen = ++epoll_gen;
+	return true;
+}
+
+/* Idle fds are not registered at all: poll() ignores even errors on
+ * them, and a level-triggered hangup would otherwise wake us forever. */
+static void epoll_update(const struct fd *fd, short old, short new)
+{
+	struct epoll_event ev;
+	int op;
+
+	if (epfd < 0 || old == new)
+		return;
+
+	if (getpid() != epoll_pid) {
+		epoll_stop();
+		return;
+	}
+
+	if (!new) {
+		/* If it's already been closed, this fails harmlessly */
+		epoll_ctl(epfd, EPOLL_CTL_DEL, fd->fd, NULL);
+		return;
+	}
+
+	op = old ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	ev.events = to_epoll_events(new);
+	ev.data.u64 = ((uint64_t)epoll_slots[fd->fd].gen << 32) | fd->fd;
+	if (epoll_ctl(epfd, op, fd->fd, &ev) != 0)
+		epoll_stop();
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+bool io_use_epoll(bool enable)
+{
+#if HAVE_SYS_EPOLL_H
+	if (num_fds)
+		return false;
+	use_epoll = enable;
+	return true;
+#else
+	return !enable;
+#endif
+}
+
 struct timemono (*io_time_override(struct timemono (*now)(void)))(void)
 {
 	struct timemono (*old)(void) = nowfn;
@@ -43,8 +160,24 @@ static bool add_fd(struct fd *fd, short events)
 		if (!fds)
 			return false;
 		max_fds = 8;
+#if HAVE_SYS_EPOLL_H
+		if (use_epoll && epfd < 0) {
+			epoll_slots = tal_arrz(NULL, struct epoll_slot, 8);
+			if (epoll_slots) {
+				epfd = epoll_create1(EPOLL_CLOEXEC);
+				epoll_pid = getpid();
+			}
+			if (epfd < 0)
+				epoll_slots = tal_free(epoll_slots);
+		}
+#endif
 	}
 
+#if HAVE_SYS_EPOLL_H
+	if (epfd >= 0 && !epoll_add_slot(fd))
+		return false;
+#endif
+
 	if (num_fds + 1 > max_fds) {
 		size_t num = max_fds * 2;
 
@@ -68,6 +201,9 @@ static bool add_fd(struct fd *fd, short events)
 	num_fds++;
 	if (events)
 		num_waiting++;
+#if HAVE_SYS_EPOLL_H
+	epoll_update(fd, 0, events);
+#endif
 
 	return true;
 }
@@ -80,6 +216,11 @@ static void del_fd(struct fd *fd)
 	assert(n < num_fds);
 	if (pollfds[n].events)
 		num_waiting--;
+#if HAVE_SYS_EPOLL_H
+	epoll_update(fd, pollfds[n].events, 0);
+	if (epfd >= 0)
+		epoll_slots[fd->fd].fd = NULL;
+#endif
 	if (n != num_fds - 1) {
 		/* Move last one over us. */
 		pollfds[n] = pollfds[num_fds-1];
@@ -91,6 +232,10 @@ static void del_fd(struct fd *fd)
 		pollfds = tal_free(pollfds);
 		fds = NULL;
 		max_fds = 0;
+#if HAVE_SYS_EPOLL_H
+		if (epfd >= 0)
+			epoll_stop();
+#endif
 		if (num_always == 0) {
 			always = tal_free(always);
 			max_always = 0;
@@ -107,8 +252,8 @@ static void del_fd(struct fd *fd)
 
 static void destroy_listener(struct io_listener *l)
 {
-	close(l->fd.fd);
 	del_fd(&l->fd);
+	close(l->fd.fd);
 }
 
 bool add_listener(struct io_listener *l)
@@ -197,6 +342,7 @@ static void setup_pfd(struct io_conn *conn, struct pollfd *pfd)
 void backend_new_plan(struct io_conn *conn)
 {
 	struct pollfd *pfd = &pollfds[conn->fd.backend_info];
+	short old_events = pfd->events;
 
 	if (pfd->events)
 		num_waiting--;
@@ -205,6 +351,11 @@ void backend_new_plan(struct io_conn *conn)
 
 	if (pfd->events)
 		num_waiting++;
+#if HAVE_SYS_EPOLL_H
+	epoll_update(&conn->fd, old_events, pfd->events);
+#else
+	(void)old_events;
+#endif
 }
 
 void backend_wake(const void *wait)
@@ -233,9 +384,9 @@ static void destroy_conn(struct io_conn *conn, bool close_fd)
 {
 	int saved_errno = errno;
 
+	del_fd(&conn->fd);
 	if (close_fd)
 		close(conn->fd.fd);
-	del_fd(&conn->fd);
 
 	remove_from_always(&conn->plan[IO_IN]);
 	remove_from_always(&conn->plan[IO_OUT]);
@@ -367,6 +518,98 @@ static void restore_pollfds(void)
 	}
 }
 
+/* Returns true if it did something with these events. */
+static bool handle_fd_events(struct fd *fd, short events)
+{
+	if (fd->listener) {
+		struct io_listener *l = (void *)fd;
+		if (events & POLLIN) {
+			accept_conn(l);
+			return true;
+		} else if (events & (POLLHUP|POLLNVAL|POLLERR)) {
+			errno = EBADF;
+			io_close_listener(l);
+			return true;
+		}
+	} else if (events & (POLLIN|POLLOUT)) {
+		io_ready((struct io_conn *)fd, events);
+		return true;
+	} else if (events & (POLLHUP|POLLNVAL|POLLERR)) {
+		errno = EBADF;
+		io_close((struct io_conn *)fd);
+		return true;
+	}
+	return false;
+}
+
+#if HAVE_SYS_EPOLL_H
+/* Where poll() would have put this event: stale ones go last. */
+static size_t epoll_event_index(const struct epoll_event *ev)
+{
+	int fdnum = ev->data.u64 & 0xFFFFFFFF;
+	uint32_t gen = ev->data.u64 >> 32;
+
+	if (!epoll_slots[fdnum].fd || epoll_slots[fdnum].gen != gen)
+		return SIZE_MAX;
+	return epoll_slots[fdnum].fd->backend_info;
+}
+
+static int epoll_event_cmp(const void *a, const void *b)
+{
+	size_t ia = epoll_event_index(a), ib = epoll_event_index(b);
+
+	return ia < ib ? -1 : ia > ib;
+}
+
+/* Returns false on (non-EINTR) error. */
+static bool epoll_iterate(int ms_timeout)
+{
+	struct epoll_event events[128];
+	struct pollfd pfd;
+	int r;
+
+	/* pollfn does the sleeping (it may be overridden to do other
+	 * things first), but on the epoll fd rather than every fd. */
+	pfd.fd = epfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	r = pollfn(&pfd, 1, ms_timeout);
+	if (r <= 0)
+		return r == 0 || errno == EINTR;
+
+	/* Level-triggered, so anything beyond this turns up next time. */
+	r = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), 0);
+	if (r < 0)
+		return errno == EINTR;
+
+	/* Handle them in the order poll() would have: callers can
+	 * (if they shouldn't!) depend on it. */
+	qsort(events, r, sizeof(events[0]), epoll_event_cmp);
+
+	for (int i = 0; i < r && !io_loop_return; i++) {
+		int fdnum = events[i].data.u64 & 0xFFFFFFFF;
+		uint32_t gen = events[i].data.u64 >> 32;
+		struct fd *fd;
+
+		/* epoll_stop() may have been called by a previous event */
+		if (epfd < 0)
+			break;
+
+		/* Closed (and maybe reused) by a previous event? */
+		fd = epoll_slots[fdnum].fd;
+		if (!fd || epoll_slots[fdnum].gen != gen)
+			continue;
+
+		/* Only what it still wants: a previous event may have
+		 * changed its plans. */
+		handle_fd_events(fd, from_epoll_events(events[i].events)
+				 & (pollfds[fd->backend_info].events
+				    | POLLHUP|POLLERR));
+	}
+	return true;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
 /* This is the main loop. */
 void *io_loop(struct timers *timers, struct timer **expired)
 {
@@ -415,6 +658,15 @@ void *io_loop(struct timers *timers, struct timer **expired)
 			}
 		}
 
+#if HAVE_SYS_EPOLL_H
+		/* Exclusive is unusual: just use poll() for it. */
+		if (epfd >= 0 && !num_exclusive) {
+			if (!epoll_iterate(ms_timeout))
+				break;
+			continue;
+		}
+#endif
+
 		/* We do this temporarily, assuming exclusive is unusual */
 		exclude_pollfds();
 		r = pollfn(pollfds, num_fds, ms_timeout);
@@ -429,7 +681,6 @@ void *io_loop(struct timers *timers, struct timer **expired)
 		}
 
 		for (i = 0; i < num_fds && !io_loop_return; i++) {
-			struct io_conn *c = (void *)fds[i];
 			int events = pollfds[i].revents;
 
 			/* Clear so we don't get confused if exclusive next time */
@@ -438,24 +689,8 @@ void *io_loop(struct timers *timers, struct timer **expired)
 			if (r == 0)
 				break;
 
-			if (fds[i]->listener) {
-				struct io_listener *l = (void *)fds[i];
-				if (events & POLLIN) {
-					accept_conn(l);
-					r--;
-				} else if (events & (POLLHUP|POLLNVAL|POLLERR)) {
-					r--;
-					errno = EBADF;
-					io_close_listener(l);
-				}
-			} else if (events & (POLLIN|POLLOUT)) {
+			if (handle_fd_events(fds[i], events))
 				r--;
-				io_ready(c, events);
-			} else if (events & (POLLHUP|POLLNVAL|POLLERR)) {
-				r--;
-				errno = EBADF;
-				io_close(c);
-			}
 		}
 	}
 
@@ -0,0 +1,167 @@
+#include <ccan/io/io.h>
+/* Include the C files directly. */
+#include <ccan/io/poll.c>
+#include <ccan/io/io.c>
+#include <ccan/tap/tap.h>
+#include <sys/wait.h>
+#include <stdio.h>
+
+#define NUM 100
+
+struct ring {
+	int fds[NUM][2];
+	struct io_conn *conns[NUM];
+	char buf[NUM];
+	int done;
+};
+
+static struct io_plan *passed_on(struct io_conn *conn, struct ring *r)
+{
+	int i;
+
+	for (i = 0; i < NUM; i++)
+		if (r->conns[i] == conn)
+			break;
+
+	r->done++;
+	/* Pass the token along the ring, to a different fd. */
+	if (i + 1 < NUM) {
+		if (write(r->fds[i+1][1], &r->buf[i], 1) != 1)
+			abort();
+	} else
+		io_break(r);
+
+	return io_close(conn);
+}
+
+static struct io_plan *init_conn(struct io_conn *conn, struct ring *r)
+{
+	int i;
+
+	for (i = 0; i < NUM; i++)
+		if (r->fds[i][0] == io_conn_fd(conn))
+			break;
+	r->conns[i] = conn;
+	return io_read(conn, &r->buf[i], 1, passed_on, r);
+}
+
+/* What the poll override was last asked to wait on. */
+static nfds_t last_nfds;
+static int last_fd;
+static size_t num_polls;
+
+static int mypoll(struct pollfd *pfds, nfds_t nfds, int timeout)
+{
+	last_nfds = nfds;
+	last_fd = pfds[0].fd;
+	num_polls++;
+	return poll(pfds, nfds, timeout);
+}
+
+/* Pass a token around NUM conns, checking what the override sees. */
+static void run_ring(bool epoll)
+{
+	struct ring *r = malloc(sizeof(*r));
+#if HAVE_SYS_EPOLL_H
+	int pollfd;
+#endif
+
+	ok1(io_use_epoll(epoll));
+	r->done = 0;
+	for (size_t i = 0; i < NUM; i++) {
+		if (pipe(r->fds[i]) != 0)
+			abort();
+		io_new_conn(NULL, r->fds[i][0], init_conn, r);
+	}
+#if HAVE_SYS_EPOLL_H
+	ok1((epfd >= 0) == epoll);
+	pollfd = epfd;
+#endif
+	/* Can't change it now. */
+	ok1(!io_use_epoll(!epoll));
+
+	num_polls = 0;
+	if (write(r->fds[0][1], "x", 1) != 1)
+		abort();
+	ok1(io_loop(NULL, NULL) == r);
+	ok1(r->done == NUM);
+	ok1(r->buf[NUM-1] == 'x');
+	ok1(num_polls >= NUM);
+
+	/* poll() gets every fd still waiting, epoll() just the one. */
+#if HAVE_SYS_EPOLL_H
+	if (epoll) {
+		ok1(last_nfds == 1);
+		ok1(last_fd == pollfd);
+	} else
+#endif
+		ok1(last_nfds == 1 && last_fd == r->fds[NUM-1][0]);
+
+	/* Everything closed, so it's all freed. */
+	ok1(num_fds == 0);
+#if HAVE_SYS_EPOLL_H
+	ok1(epfd == -1);
+#endif
+
+	for (size_t i = 0; i < NUM; i++)
+		close(r->fds[i][1]);
+	free(r);
+}
+
+int main(void)
+{
+	/* This is how many tests you plan to run */
+#if HAVE_SYS_EPOLL_H
+	struct ring *r = malloc(sizeof(*r));
+	int status;
+
+	plan_tests(31);
+#else
+	plan_tests(10);
+#endif
+
+	ok1(io_poll_override(mypoll) == poll);
+	run_ring(false);
+
+#if HAVE_SYS_EPOLL_H
+	run_ring(true);
+
+	/* A child shares the epoll fd: closing conns there must not
+	 * unregister them in the parent. */
+	ok1(io_use_epoll(true));
+	r->done = 0;
+	for (size_t i = 0; i < NUM; i++) {
+		if (pipe(r->fds[i]) != 0)
+			abort();
+		io_new_conn(NULL, r->fds[i][0], init_conn, r);
+	}
+	ok1(epfd >= 0);
+
+	fflush(stdout);
+	if (!fork()) {
+		for (size_t i = 0; i < NUM; i++)
+			io_close(r->conns[i]);
+		exit(epfd == -1 ? 0 : 1);
+	}
+	ok1(wait(&status) != -1);
+	ok1(WIFEXITED(status));
+	ok1(WEXITSTATUS(status) == 0);
+	ok1(epfd >= 0);
+
+	if (write(r->fds[0][1], "x", 1) != 1)
+		abort();
+	ok1(io_loop(NULL, NULL) == r);
+	ok1(r->done == NUM);
+	ok1(epfd == -1);
+
+	for (size_t i = 0; i < NUM; i++)
+		close(r->fds[i][1]);
+	free(r);
+#else
+	/* We fall back to poll. */
+	ok1(!io_use_epoll(true));
+#endif
+
+	/* This exits depending on whether all tests passed */
+	return exit_status();
+}
@@ -842,6 +842,48 @@ struct bolt11 *bolt11_decode_nosig(const tal_t *ctx, const char *str,
 	return b11;
 }
 
+/* Checking the signature is most of the cost of decoding, and pay,
+ * decodepay and the offers plugin see the same invoices over and over:
+ * remember who signed the last few. */
+#define BOLT11_SIG_CACHE_SIZE 64
+
+struct bolt11_sig_cache_entry {
+	/* This was signed... */
+	struct sha256 hash;
+	u8 sig_and_recid[65];
+	/* ... by this. */
+	struct node_id signer;
+};
+static struct bolt11_sig_cache_entry sig_cache[BOLT11_SIG_CACHE_SIZE];
+
+static struct bolt11_sig_cache_entry *sig_cache_entry(const struct sha256 *hash)
+{
+	return &sig_cache[hash->u.u32[0] % BOLT11_SIG_CACHE_SIZE];
+}
+
+static const struct node_id *sig_cache_find(const struct sha256 *hash,
+					    const u8 sig_and_recid[65])
+{
+	const struct bolt11_sig_cache_entry *e = sig_cache_entry(hash);
+
+	/* An empty entry has an all-zero signature, which never parses. */
+	if (!sha256_eq(&e->hash, hash)
+	    || memcmp(e->sig_and_recid, sig_and_recid, 65) != 0)
+		return NULL;
+	return &e->signer;
+}
+
+static void sig_cache_add(const struct sha256 *hash,
+			  const u8 sig_and_recid[65],
+			  const struct node_id *signer)
+{
+	struct bolt11_sig_cache_entry *e = sig_cache_entry(hash);
+
+	e->hash = *hash;
+	memcpy(e->sig_and_recid, sig_and_recid, 65);
+	e->signer = *signer;
+}
+
 /* Decodes and checks signature; returns NULL on error. */
 struct bolt11 *bolt11_decode(const tal_t *ctx, const char *str,
 			     const struct feature_set *our_features,
@@ -856,6 +898,7 @@ struct bolt11 *bolt11_decode(const tal_t *ctx, const char *str,
 	struct bolt11 *b11;
 	struct sha256 hash;
 	bool have_n;
+	const struct node_id *signer;
 
 	b11 = bolt11_decode_nosig(ctx, str, our_features, description,
 				  must_be_chain, &hash, &sigdata, &have_n,
@@ -886,6 +929,15 @@ struct bolt11 *bolt11_decode(const tal_t *ctx, const char *str,
 	secp256k1_ecdsa_recoverable_signature_convert(secp256k1_ctx,
 						      &b11->sig, &sig);
 
+	/* The hash covers the `n` field too, so if we've seen this exact
+	 * signature over it, we know what we decided last time. */
+	signer = sig_cache_find(&hash, sig_and_recid);
+	if (signer) {
+		if (!have_n)
+			b11->receiver_id = *signer;
+		return b11;
+	}
+
 	/* BOLT #11:
 	 *
 	 * A reader...  MUST check that the `signature` is valid (see
@@ -913,6 +965,7 @@ struct bolt11 *bolt11_decode(const tal_t *ctx, const char *str,
 			return decode_fail(b11, fail, "invalid signature");
 	}
 
+	sig_cache_add(&hash, sig_and_recid, &b11->receiver_id);
 	return b11;
 }
 
@@ -0,0 +1,242 @@
+#include "config.h"
+#include <ccan/asort/asort.h>
+#include <common/coinselect.h>
+#include <common/pseudorand.h>
+#include <common/utils.h>
+
+/* Same limit as Bitcoin Core: it's usually found well before this. */
+#define BNB_MAX_TRIES 100000
+
+/* The knapsack tries this many random subsets... */
+#define KNAPSACK_ROUNDS 1000
+/* ... but no more than this many coin visits in total, for huge wallets. */
+#define KNAPSACK_MAX_WORK 10000000
+
+struct candidate {
+	/* Index into the caller's array */
+	size_t idx;
+	u64 value;
+};
+
+static int cmp_value_desc(const struct candidate *a,
+			  const struct candidate *b,
+			  void *unused)
+{
+	if (a->value > b->value)
+		return -1;
+	if (a->value < b->value)
+		return 1;
+	/* So the result doesn't depend on the sort */
+	if (a->idx < b->idx)
+		return -1;
+	return a->idx > b->idx;
+}
+
+/* Depth-first search, largest first, for the set closest above @target
+ * without going over @target + @cost_of_change.  Returns positions in
+ * @c, or NULL. */
+static size_t *bnb(const tal_t *ctx,
+		   const struct candidate *c, size_t n,
+		   u64 target, u64 cost_of_change)
+{
+	/* We can take each one at most once */
+	size_t *taken = tal_arr(tmpctx, size_t, n), num_taken = 0;
+	size_t *best = NULL;
+	u64 best_excess = UINT64_MAX, value = 0, available = 0;
+	size_t i = 0;
+
+	for (size_t j = 0; j < n; j++)
+		available += c[j].value;
+
+	for (size_t tries = 0; tries < BNB_MAX_TRIES; tries++, i++) {
+		bool backtrack = false;
+
+		if (value + available < target
+		    || value > target + cost_of_change)
+			backtrack = true;
+		else if (value >= target) {
+			u64 excess = value - target;
+			if (!best
+			    || excess < best_excess
+			    || (excess == best_excess
+				&& num_taken < tal_count(best))) {
+				tal_free(best);
+				best = tal_dup_arr(ctx, size_t, taken, num_taken, 0);
+				best_excess = excess;
+			}
+			backtrack = true;
+		}
+
+		if (backtrack) {
+			size_t last;
+
+			if (num_taken == 0)
+				break;
+			last = taken[--num_taken];
+			/* Everything after the last one we took is back in
+			 * play, then try again without it. */
+			for (i--; i > last; i--)
+				available += c[i].value;
+			value -= c[last].value;
+		} else {
+			available -= c[i].value;
+			/* Taking an equal value to the one we just left out
+			 * would only repeat the search we already did. */
+			if (num_taken == 0
+			    || taken[num_taken - 1] == i - 1
+			    || c[i].value != c[i - 1].value) {
+				taken[num_taken++] = i;
+				value += c[i].value;
+			}
+		}
+	}
+
+	return best;
+}
+
+/* Random subsets (followed by filling up in order) of @c, which adds up to
+ * @total >= @target: keep whichever overshoots the least. */
+static bool *approximate_best_subset(const tal_t *ctx,
+				     const struct candidate *c, size_t n,
+				     u64 total, u64 target, u64 *best_value)
+{
+	bool *best = tal_arr(ctx, bool, n), *included = tal_arr(tmpctx, bool, n);
+	size_t rounds = KNAPSACK_MAX_WORK / n;
+
+	if (rounds > KNAPSACK_ROUNDS)
+		rounds = KNAPSACK_ROUNDS;
+	if (rounds == 0)
+		rounds = 1;
+
+	for (size_t i = 0; i < n; i++)
+		best[i] = true;
+	*best_value = total;
+
+	for (size_t r = 0; r < rounds && *best_value != target; r++) {
+		bool reached = false;
+		u64 value = 0, coinflips = 0;
+
+		memset(included, 0, n * sizeof(*included));
+		for (int pass = 0; pass < 2 && !reached; pass++) {
+			for (size_t i = 0; i < n; i++) {
+				bool take;
+
+				if (pass == 0) {
+					/* 64 coin flips at a time */
+					if (i % 64 == 0)
+						coinflips = pseudorand_u64();
+					take = coinflips & 1;
+					coinflips >>= 1;
+				} else
+					take = !included[i];
+
+				if (take) {
+					value += c[i].value;
+					included[i] = true;
+					if (value < target)
+						continue;
+					reached = true;
+					if (value < *best_value) {
+						*best_value = value;
+						memcpy(best, included,
+						       n * sizeof(*best));
+					}
+					/* Try doing without this one */
+					value -= c[i].value;
+					included[i] = false;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+/* What Bitcoin Core did before branch-and-bound: exact match, else
+ * smaller coins, else the smallest larger one. */
+static size_t *knapsack(const tal_t *ctx,
+			const struct candidate *c, size_t n,
+			u64 target)
+{
+	struct candidate *smaller = tal_arr(tmpctx, struct candidate, 0);
+	size_t *ret, lowest_larger = n;
+	u64 total_smaller = 0, best_value;
+	bool *best;
+
+	for (size_t i = 0; i < n; i++) {
+		if (c[i].value == target) {
+			ret = tal_arr(ctx, size_t, 1);
+			ret[0] = i;
+			return ret;
+		}
+		if (c[i].value < target) {
+			/* Remember where it came from */
+			struct candidate s = { i, c[i].value };
+			tal_arr_expand(&smaller, s);
+			total_smaller += c[i].value;
+		} else if (lowest_larger == n
+			   || c[i].value < c[lowest_larger].value)
+			lowest_larger = i;
+	}
+
+	if (total_smaller < target) {
+		if (lowest_larger == n)
+			return NULL;
+		ret = tal_arr(ctx, size_t, 1);
+		ret[0] = lowest_larger;
+		return ret;
+	}
+
+	best = approximate_best_subset(tmpctx, smaller, tal_count(smaller),
+				       total_smaller, target, &best_value);
+
+	/* One larger coin may beat many small ones. */
+	if (lowest_larger != n
+	    && best_value != target
+	    && c[lowest_larger].value <= best_value) {
+		ret = tal_arr(ctx, size_t, 1);
+		ret[0] = lowest_larger;
+		return ret;
+	}
+
+	ret = tal_arr(ctx, size_t, 0);
+	for (size_t i = 0; i < tal_count(smaller); i++) {
+		if (best[i])
+			tal_arr_expand(&ret, smaller[i].idx);
+	}
+	return ret;
+}
+
+size_t *coinselect(const tal_t *ctx,
+		   const struct amount_sat *effective,
+		   struct amount_sat target,
+		   struct amount_sat cost_of_change)
+{
+	struct candidate *c = tal_arr(tmpctx, struct candidate, 0);
+	size_t *sel;
+
+	/* Worthless inputs never help. */
+	for (size_t i = 0; i < tal_count(effective); i++) {
+		struct candidate cand;
+
+		if (amount_sat_zero(effective[i]))
+			continue;
+		cand.idx = i;
+		cand.value = effective[i].satoshis; /* Raw: coin selection */
+		tal_arr_expand(&c, cand);
+	}
+	asort(c, tal_count(c), cmp_value_desc, NULL);
+
+	sel = bnb(ctx, c, tal_count(c),
+		  target.satoshis, /* Raw: coin selection */
+		  cost_of_change.satoshis); /* Raw: coin selection */
+	if (!sel)
+		sel = knapsack(ctx, c, tal_count(c),
+			       target.satoshis); /* Raw: coin selection */
+	if (!sel)
+		return NULL;
+
+	/* Positions in c, to indices into effective. */
+	for (size_t i = 0; i < tal_count(sel); i++)
+		sel[i] = c[sel[i]].idx;
+	return sel;
+}
@@ -0,0 +1,24 @@
+#ifndef LIGHTNING_COMMON_COINSELECT_H
+#define LIGHTNING_COMMON_COINSELECT_H
+#include "config.h"
+#include <common/amount.h>
+
+/* Choose which of the @effective values to spend to reach @target.
+ *
+ * Each effective value is what an input is worth once it's paid the fee
+ * for its own weight, and @target includes the fee for the rest of the
+ * transaction, so any set which adds up to @target pays for itself.
+ *
+ * We first try branch-and-bound for a set which lands within
+ * @cost_of_change above @target (so it isn't worth making change), with
+ * the least excess.  Otherwise we fall back to a knapsack search for the
+ * set which overshoots @target the least.
+ *
+ * Returns a tal_arr of indices into @effective, or NULL if they can't
+ * reach @target at all. */
+size_t *coinselect(const tal_t *ctx,
+		   const struct amount_sat *effective,
+		   struct amount_sat target,
+		   struct amount_sat cost_of_change);
+
+#endif /* LIGHTNING_COMMON_COINSELECT_H */
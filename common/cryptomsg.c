@@ -83,17 +83,15 @@ static void le64_nonce(unsigned char *npub, u64 nonce)
 	memcpy(npub + zerolen, &le_nonce, sizeof(le_nonce));
 }
 
-u8 *cryptomsg_decrypt_body(const tal_t *ctx,
-			   struct crypto_state *cs, const u8 *in)
+bool cryptomsg_decrypt_body_inplace(struct crypto_state *cs,
+				    u8 *in, size_t inlen)
 {
 	unsigned char npub[crypto_aead_chacha20poly1305_ietf_NPUBBYTES];
-	unsigned long long mlen;
-	size_t inlen = tal_count(in);
-	u8 *decrypted;
+	size_t mlen;
 
-	if (inlen < 16)
-		return NULL;
-	decrypted = tal_arr(ctx, u8, inlen - 16);
+	if (inlen < CRYPTOMSG_BODY_OVERHEAD)
+		return false;
+	mlen = inlen - CRYPTOMSG_BODY_OVERHEAD;
 
 	le64_nonce(npub, cs->rn++);
 
@@ -103,18 +101,34 @@ u8 *cryptomsg_decrypt_body(const tal_t *ctx,
 	 *    obtain decrypted plaintext packet `p`.
 	 *    * The nonce `rn` MUST be incremented after this step.
 	 */
-	if (crypto_aead_chacha20poly1305_ietf_decrypt(decrypted,
-						      &mlen, NULL,
-						      memcheck(in, inlen),
-						      inlen,
-						      NULL, 0,
-						      npub, cs->rk.data) != 0) {
+	if (crypto_aead_chacha20poly1305_ietf_decrypt_detached(in, NULL,
+							       memcheck(in, mlen),
+							       mlen,
+							       in + mlen,
+							       NULL, 0,
+							       npub,
+							       cs->rk.data) != 0)
+		return false;
+
+	maybe_rotate_key(&cs->rn, &cs->rk, &cs->r_ck);
+	return true;
+}
+
+u8 *cryptomsg_decrypt_body(const tal_t *ctx,
+			   struct crypto_state *cs, const u8 *in)
+{
+	size_t inlen = tal_count(in);
+	u8 *decrypted;
+
+	if (inlen < CRYPTOMSG_BODY_OVERHEAD)
+		return NULL;
+
+	decrypted = tal_dup_arr(ctx, u8, in, inlen, 0);
+	if (!cryptomsg_decrypt_body_inplace(cs, decrypted, inlen)) {
 		/* FIXME: Report error! */
 		return tal_free(decrypted);
 	}
-	assert(mlen == tal_count(decrypted));
-
-	maybe_rotate_key(&cs->rn, &cs->rk, &cs->r_ck);
+	tal_resize(&decrypted, inlen - CRYPTOMSG_BODY_OVERHEAD);
 	return decrypted;
 }
 
@@ -148,17 +162,14 @@ bool cryptomsg_decrypt_header(struct crypto_state *cs, u8 hdr[18], u16 *lenp)
 	return true;
 }
 
-u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
-			  struct crypto_state *cs,
-			  const u8 *msg TAKES)
+void cryptomsg_encrypt_inplace(struct crypto_state *cs, u8 *buf, size_t mlen)
 {
 	unsigned char npub[crypto_aead_chacha20poly1305_ietf_NPUBBYTES];
-	unsigned long long clen, mlen = tal_count(msg);
+	u8 *body = buf + CRYPTOMSG_HDR_SIZE;
 	be16 l;
 	int ret;
-	u8 *out;
 
-	out = tal_arr(ctx, u8, sizeof(l) + 16 + mlen + 16);
+	assert(mlen <= 0xFFFF);
 
 	/* BOLT #8:
 	 *
@@ -173,6 +184,7 @@ u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
 	 *   2. Serialize `l` into 2 bytes encoded as a big-endian integer.
 	 */
 	l = cpu_to_be16(mlen);
+	memcpy(buf, &l, sizeof(l));
 
 	/* BOLT #8:
 	 *
@@ -186,21 +198,20 @@ u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
                 data).
 	 */
 	le64_nonce(npub, cs->sn++);
-	ret = crypto_aead_chacha20poly1305_ietf_encrypt(out, &clen,
-							(unsigned char *)
-							memcheck(&l, sizeof(l)),
-							sizeof(l),
-							NULL, 0,
-							NULL, npub,
-							cs->sk.data);
+	ret = crypto_aead_chacha20poly1305_ietf_encrypt_detached(buf,
+								 buf + sizeof(l),
+								 NULL,
+								 buf, sizeof(l),
+								 NULL, 0,
+								 NULL, npub,
+								 cs->sk.data);
 	assert(ret == 0);
-	assert(clen == sizeof(l) + 16);
 #ifdef SUPERVERBOSE
 	status_debug("# encrypt l: cleartext=0x%s, AD=NULL, sn=0x%s, sk=0x%s => 0x%s",
 		     tal_hexstr(trc, &l, sizeof(l)),
 		     tal_hexstr(trc, npub, sizeof(npub)),
 		     tal_hexstr(trc, &cs->sk, sizeof(cs->sk)),
-		     tal_hexstr(trc, out, clen));
+		     tal_hexstr(trc, buf, CRYPTOMSG_HDR_SIZE));
 #endif
 
 	/* BOLT #8:
@@ -212,23 +223,36 @@ u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
 	 *     * The nonce `sn` MUST be incremented after this step.
 	 */
 	le64_nonce(npub, cs->sn++);
-	ret = crypto_aead_chacha20poly1305_ietf_encrypt(out + clen, &clen,
-							memcheck(msg, mlen),
-							mlen,
-							NULL, 0,
-							NULL, npub,
-							cs->sk.data);
+	ret = crypto_aead_chacha20poly1305_ietf_encrypt_detached(body,
+								 body + mlen,
+								 NULL,
+								 memcheck(body, mlen),
+								 mlen,
+								 NULL, 0,
+								 NULL, npub,
+								 cs->sk.data);
 	assert(ret == 0);
-	assert(clen == mlen + 16);
 #ifdef SUPERVERBOSE
-	status_debug("# encrypt m: cleartext=0x%s, AD=NULL, sn=0x%s, sk=0x%s => 0x%s",
-		     tal_hexstr(trc, msg, mlen),
+	status_debug("# encrypt m: AD=NULL, sn=0x%s, sk=0x%s => 0x%s",
 		     tal_hexstr(trc, npub, sizeof(npub)),
 		     tal_hexstr(trc, &cs->sk, sizeof(cs->sk)),
-		     tal_hexstr(trc, out + CRYPTOMSG_HDR_SIZE, clen));
+		     tal_hexstr(trc, body, mlen + CRYPTOMSG_BODY_OVERHEAD));
 #endif
 
 	maybe_rotate_key(&cs->sn, &cs->sk, &cs->s_ck);
+}
+
+u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
+			  struct crypto_state *cs,
+			  const u8 *msg TAKES)
+{
+	size_t mlen = tal_count(msg);
+	u8 *out;
+
+	out = tal_arr(ctx, u8,
+		      CRYPTOMSG_HDR_SIZE + mlen + CRYPTOMSG_BODY_OVERHEAD);
+	memcpy(out + CRYPTOMSG_HDR_SIZE, msg, mlen);
+	cryptomsg_encrypt_inplace(cs, out, mlen);
 
 	if (taken(msg))
 		tal_free(msg);
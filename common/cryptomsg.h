@@ -28,4 +28,14 @@ u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
 bool cryptomsg_decrypt_header(struct crypto_state *cs, u8 hdr[18], u16 *lenp);
 u8 *cryptomsg_decrypt_body(const tal_t *ctx,
 			   struct crypto_state *cs, const u8 *in);
+
+/* In-place versions, so callers can reuse buffers.  @buf has
+ * CRYPTOMSG_HDR_SIZE bytes of space, then the @mlen byte message, then
+ * CRYPTOMSG_BODY_OVERHEAD bytes of space: all of it is overwritten with
+ * the encrypted header and body. */
+void cryptomsg_encrypt_inplace(struct crypto_state *cs, u8 *buf, size_t mlen);
+/* Decrypts @in (of @inlen bytes, as read after the header): on success, the
+ * first @inlen - CRYPTOMSG_BODY_OVERHEAD bytes are the message. */
+bool cryptomsg_decrypt_body_inplace(struct crypto_state *cs,
+				    u8 *in, size_t inlen);
 #endif /* LIGHTNING_COMMON_CRYPTOMSG_H */
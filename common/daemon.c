@@ -151,6 +151,10 @@ void daemon_setup(const char *argv0,
 	signal(SIGPIPE, SIG_IGN);
 
 	io_poll_override(daemon_poll);
+	/* Where available, this makes wakeups cost the same however
+	 * many fds we have (connectd with many peers, lightningd with
+	 * many plugins).  daemon_poll() is then called on the epoll fd. */
+	io_use_epoll(true);
 }
 
 void daemon_shutdown(void)
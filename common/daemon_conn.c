@@ -64,28 +64,32 @@ struct io_plan *daemon_conn_read_with_fd_(struct io_conn *conn,
 	return io_recv_fd(conn, &dc->fd_in, handle_recv_fd, dc);
 }
 
+/* Enough to amortize syscalls, without hiding our queue length from
+ * callers who use it for flow control. */
+#define DAEMON_CONN_WRITE_BATCH 64
+
 static struct io_plan *daemon_conn_write_next(struct io_conn *conn,
 					      struct daemon_conn *dc)
 {
-	const u8 *msg;
-
-	msg = msg_dequeue(dc->out);
+	const u8 **msgs, *msg;
 
 	/* If nothing in queue, give empty callback a chance to queue somthing */
-	if (!msg && dc->outq_empty) {
+	if (!msg_queue_length(dc->out) && dc->outq_empty)
 		dc->outq_empty(dc->arg);
-		msg = msg_dequeue(dc->out);
-	}
 
+	/* Write as many as we can in one go... */
+	msgs = msg_dequeue_many(NULL, dc->out, DAEMON_CONN_WRITE_BATCH);
+	if (msgs)
+		return io_write_wires(conn, take(msgs),
+				      daemon_conn_write_next, dc);
+
+	/* ... otherwise it's an fd, or nothing. */
+	msg = msg_dequeue(dc->out);
 	if (msg) {
 		int fd = msg_extract_fd(dc->out, msg);
-		if (fd >= 0) {
-			tal_free(msg);
-			return io_send_fd(conn, fd, true,
-					  daemon_conn_write_next, dc);
-		}
-		return io_write_wire(conn, take(msg), daemon_conn_write_next,
-				     dc);
+		assert(fd >= 0);
+		tal_free(msg);
+		return io_send_fd(conn, fd, true, daemon_conn_write_next, dc);
 	}
 	return msg_queue_wait(conn, dc->out, daemon_conn_write_next, dc);
 }
@@ -5,6 +5,10 @@
 #include <common/dijkstra.h>
 #include <common/gossmap.h>
 #include <gheap.h>
+#include <unistd.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 /* Each node has this side-info. */
 struct dijkstra {
@@ -13,10 +17,11 @@ struct dijkstra {
 	u32 total_delay;
 	/* Total cost from here to destination */
 	struct amount_msat cost;
-	/* I want to use an index here, except that gheap moves things onto
-	 * a temporary on the stack and that makes things complex. */
+	/* The heap holds pointers to these, so gheap's callbacks don't need
+	 * any context (which item_mover can't have). */
 	/* NULL means it's been visited already. */
-	const struct gossmap_node **heapptr;
+	struct dijkstra **heapptr;
+	const struct gossmap_node *node;
 
 	/* How we decide "best", lower is better */
 	u64 score;
@@ -25,10 +30,6 @@ struct dijkstra {
 	struct gossmap_chan *best_chan;
 };
 
-/* Because item_mover doesn't provide a ctx ptr, we need a global anyway. */
-static struct dijkstra *global_dijkstra;
-static const struct gossmap *global_map;
-
 /* Returns UINT_MAX if unreachable. */
 u32 dijkstra_distance(const struct dijkstra *dij, u32 node_idx)
 {
@@ -53,37 +54,35 @@ static int less_comparer(const void *const ctx,
 			 const void *const a,
 			 const void *const b)
 {
-	return get_dijkstra(global_dijkstra, global_map,
-			    *(struct gossmap_node **)a)->score
-		> get_dijkstra(global_dijkstra, global_map,
-			       *(struct gossmap_node **)b)->score;
+	return (*(struct dijkstra **)a)->score
+		> (*(struct dijkstra **)b)->score;
 }
 
 static void item_mover(void *const dst, const void *const src)
 {
-	struct gossmap_node *n = *((struct gossmap_node **)src);
-	get_dijkstra(global_dijkstra, global_map, n)->heapptr = dst;
-	*((struct gossmap_node **)dst) = n;
+	struct dijkstra *d = *((struct dijkstra **)src);
+	d->heapptr = dst;
+	*((struct dijkstra **)dst) = d;
 }
 
-static const struct gossmap_node **mkheap(const tal_t *ctx,
-					  struct dijkstra *dij,
-					  const struct gossmap *map,
-					  const struct gossmap_node *start,
-					  struct amount_msat sent)
+/* Heap must have gossmap_num_nodes() entries. */
+static void init_heap(struct dijkstra **heap,
+		      struct dijkstra *dij,
+		      const struct gossmap *map,
+		      const struct gossmap_node *start,
+		      struct amount_msat sent)
 {
-	const struct gossmap_node *n, **heap;
+	const struct gossmap_node *n;
 	size_t i;
 
-	heap = tal_arr(tmpctx, const struct gossmap_node *,
-		       gossmap_num_nodes(map));
 	for (i = 1, n = gossmap_first_node(map);
 	     n;
 	     n = gossmap_next_node(map, n), i++) {
 		struct dijkstra *d = get_dijkstra(dij, map, n);
+		d->node = n;
 		if (n == start) {
 			/* First entry in heap is start, distance 0 */
-			heap[0] = start;
+			heap[0] = d;
 			d->heapptr = &heap[0];
 			d->distance = 0;
 			d->total_delay = 0;
@@ -91,7 +90,7 @@ static const struct gossmap_node **mkheap(const tal_t *ctx,
 			d->score = 0;
 			i--;
 		} else {
-			heap[i] = n;
+			heap[i] = d;
 			d->heapptr = &heap[i];
 			d->distance = UINT_MAX;
 			d->cost = AMOUNT_MSAT(-1ULL);
@@ -99,8 +98,7 @@ static const struct gossmap_node **mkheap(const tal_t *ctx,
 			d->score = -1ULL;
 		}
 	}
-	assert(i == tal_count(heap));
-	return heap;
+	assert(i == gossmap_num_nodes(map));
 }
 
 /* 365.25 * 24 * 60 / 10 */
@@ -119,27 +117,26 @@ static struct amount_msat risk_price(struct amount_msat amount,
 	return riskfee;
 }
 
-/* Do Dijkstra: start in this case is the dst node. */
-const struct dijkstra *
-dijkstra_(const tal_t *ctx,
-	  const struct gossmap *map,
-	  const struct gossmap_node *start,
-	  struct amount_msat amount,
-	  double riskfactor,
-	  bool (*channel_ok)(const struct gossmap *map,
-			     const struct gossmap_chan *c,
-			     int dir,
-			     struct amount_msat amount,
-			     void *arg),
-	  u64 (*path_score)(u32 distance,
-			    struct amount_msat cost,
-			    struct amount_msat risk,
-			    int dir,
-			    const struct gossmap_chan *c),
-	  void *arg)
+/* This does no allocation, and touches no globals, so it can be run in
+ * multiple threads at once (on the same, unchanging gossmap). */
+static void dijkstra_run(struct dijkstra *dij,
+			 struct dijkstra **heap,
+			 const struct gossmap *map,
+			 const struct gossmap_node *start,
+			 struct amount_msat amount,
+			 double riskfactor,
+			 bool (*channel_ok)(const struct gossmap *map,
+					    const struct gossmap_chan *c,
+					    int dir,
+					    struct amount_msat amount,
+					    void *arg),
+			 u64 (*path_score)(u32 distance,
+					   struct amount_msat cost,
+					   struct amount_msat risk,
+					   int dir,
+					   const struct gossmap_chan *c),
+			 void *arg)
 {
-	struct dijkstra *dij;
-	const struct gossmap_node **heap;
 	size_t heapsize;
 	struct gheap_ctx gheap_ctx;
 
@@ -152,12 +149,6 @@ dijkstra_(const tal_t *ctx,
 	gheap_ctx.less_comparer_ctx = NULL;
 	gheap_ctx.item_mover = item_mover;
 
-	dij = tal_arr(ctx, struct dijkstra, gossmap_max_node_idx(map));
-
-	/* Pay no attention to the man behind the curtain! */
-	global_map = map;
-	global_dijkstra = dij;
-
 	/* Wikipedia's article on Dijkstra is excellent:
 	 *    https://en.wikipedia.org/wiki/Dijkstra's_algorithm
 	 * (License https://creativecommons.org/licenses/by-sa/3.0/)
@@ -171,8 +162,8 @@ dijkstra_(const tal_t *ctx,
 	 * for our initial node and to infinity for all other nodes. Set the
 	 * initial node as current.[14]
 	 */
-	heap = mkheap(NULL, dij, map, start, amount);
-	heapsize = tal_count(heap);
+	init_heap(heap, dij, map, start, amount);
+	heapsize = gossmap_num_nodes(map);
 
 	/*
 	 * 3. For the current node, consider all of its unvisited neighbouds
@@ -201,10 +192,9 @@ dijkstra_(const tal_t *ctx,
 	 * go back to step 3.
 	 */
 	while (heapsize != 0) {
-		struct dijkstra *cur_d;
-		const struct gossmap_node *cur = heap[0];
+		struct dijkstra *cur_d = heap[0];
+		const struct gossmap_node *cur = cur_d->node;
 
-		cur_d = get_dijkstra(dij, map, cur);
 		assert(cur_d->heapptr == heap);
 
 		/* Finished all reachable nodes */
@@ -259,6 +249,143 @@ dijkstra_(const tal_t *ctx,
 		gheap_pop_heap(&gheap_ctx, heap, heapsize--);
 		cur_d->heapptr = NULL;
 	}
+}
+
+/* Do Dijkstra: start in this case is the dst node. */
+const struct dijkstra *
+dijkstra_(const tal_t *ctx,
+	  const struct gossmap *map,
+	  const struct gossmap_node *start,
+	  struct amount_msat amount,
+	  double riskfactor,
+	  bool (*channel_ok)(const struct gossmap *map,
+			     const struct gossmap_chan *c,
+			     int dir,
+			     struct amount_msat amount,
+			     void *arg),
+	  u64 (*path_score)(u32 distance,
+			    struct amount_msat cost,
+			    struct amount_msat risk,
+			    int dir,
+			    const struct gossmap_chan *c),
+	  void *arg)
+{
+	struct dijkstra *dij, **heap;
+
+	dij = tal_arr(ctx, struct dijkstra, gossmap_max_node_idx(map));
+	heap = tal_arr(dij, struct dijkstra *, gossmap_num_nodes(map));
+	dijkstra_run(dij, heap, map, start, amount, riskfactor,
+		     channel_ok, path_score, arg);
 	tal_free(heap);
 	return dij;
 }
+
+
+struct dijkstra_job {
+	const struct gossmap *map;
+	const struct dijkstra_query *q;
+	bool (*channel_ok)(const struct gossmap *map,
+			   const struct gossmap_chan *c,
+			   int dir,
+			   struct amount_msat amount,
+			   void *arg);
+	u64 (*path_score)(u32 distance,
+			  struct amount_msat cost,
+			  struct amount_msat risk,
+			  int dir,
+			  const struct gossmap_chan *c);
+	struct dijkstra *dij;
+	struct dijkstra **heap;
+#if HAVE_PTHREAD
+	pthread_t thread;
+#endif
+};
+
+static void *dijkstra_job_run(void *arg)
+{
+	struct dijkstra_job *job = arg;
+
+	dijkstra_run(job->dij, job->heap, job->map, job->q->start,
+		     job->q->amount, job->q->riskfactor,
+		     job->channel_ok, job->path_score, job->q->arg);
+	return NULL;
+}
+
+void dijkstra_batch(const struct gossmap *map,
+		    const struct dijkstra_query *queries,
+		    size_t num_queries,
+		    size_t max_threads,
+		    bool (*channel_ok)(const struct gossmap *map,
+				       const struct gossmap_chan *c,
+				       int dir,
+				       struct amount_msat amount,
+				       void *arg),
+		    u64 (*path_score)(u32 distance,
+				      struct amount_msat cost,
+				      struct amount_msat risk,
+				      int dir,
+				      const struct gossmap_chan *c),
+		    void (*done)(const struct dijkstra *dij, void *arg))
+{
+	struct dijkstra_job *jobs;
+	size_t num_jobs;
+
+#if HAVE_PTHREAD
+	if (max_threads == 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		max_threads = ncpus > 0 ? ncpus : 1;
+	}
+#else
+	/* No threads: we do them one at a time. */
+	max_threads = 1;
+#endif
+	num_jobs = num_queries < max_threads ? num_queries : max_threads;
+
+	/* tal isn't thread-safe, so all the allocation is done here: the
+	 * threads only ever touch their own job. */
+	jobs = tal_arr(tmpctx, struct dijkstra_job, num_jobs);
+	for (size_t i = 0; i < num_jobs; i++) {
+		jobs[i].map = map;
+		jobs[i].channel_ok = channel_ok;
+		jobs[i].path_score = path_score;
+		jobs[i].dij = tal_arr(jobs, struct dijkstra,
+				      gossmap_max_node_idx(map));
+		jobs[i].heap = tal_arr(jobs, struct dijkstra *,
+				       gossmap_num_nodes(map));
+	}
+
+	/* We run one query per job at a time, so we only ever need num_jobs
+	 * dijkstra arrays, however many queries there are. */
+	for (size_t off = 0; off < num_queries; off += num_jobs) {
+		size_t n = num_queries - off;
+		size_t started;
+
+		if (n > num_jobs)
+			n = num_jobs;
+
+		for (size_t i = 0; i < n; i++)
+			jobs[i].q = &queries[off + i];
+
+		/* First one we do ourselves. */
+		started = 1;
+#if HAVE_PTHREAD
+		for (; started < n; started++) {
+			if (pthread_create(&jobs[started].thread, NULL,
+					   dijkstra_job_run, &jobs[started]) != 0)
+				break;
+		}
+#endif
+		dijkstra_job_run(&jobs[0]);
+#if HAVE_PTHREAD
+		for (size_t i = 1; i < started; i++)
+			pthread_join(jobs[i].thread, NULL);
+#endif
+		/* If we couldn't create threads, do the rest here. */
+		for (size_t i = started; i < n; i++)
+			dijkstra_job_run(&jobs[i]);
+
+		for (size_t i = 0; i < n; i++)
+			done(jobs[i].dij, jobs[i].q->arg);
+	}
+	tal_free(jobs);
+}
@@ -36,6 +36,40 @@ dijkstra_(const tal_t *ctx,
 		  (path_score),						\
 		  (arg))
 
+/* One of many independent queries for dijkstra_batch. */
+struct dijkstra_query {
+	/* As for dijkstra(): this is the dst node. */
+	const struct gossmap_node *start;
+	struct amount_msat amount;
+	double riskfactor;
+	/* Handed to channel_ok and done. */
+	void *arg;
+};
+
+/* Do Dijkstra for each of @queries, running up to @max_threads at once
+ * (0 means one per CPU; without pthreads, it's always one).  @done is
+ * called for each (in this thread, in order): the dijkstra is only valid
+ * until it returns, since we reuse it.
+ *
+ * Since @channel_ok and @path_score are called from multiple threads at
+ * once, they must not allocate or change anything; nor can @map change
+ * until this returns. */
+void dijkstra_batch(const struct gossmap *map,
+		    const struct dijkstra_query *queries,
+		    size_t num_queries,
+		    size_t max_threads,
+		    bool (*channel_ok)(const struct gossmap *map,
+				       const struct gossmap_chan *c,
+				       int dir,
+				       struct amount_msat amount,
+				       void *arg),
+		    u64 (*path_score)(u32 distance,
+				      struct amount_msat cost,
+				      struct amount_msat risk,
+				      int dir,
+				      const struct gossmap_chan *c),
+		    void (*done)(const struct dijkstra *dij, void *arg));
+
 /* Returns UINT_MAX if unreachable. */
 u32 dijkstra_distance(const struct dijkstra *dij, u32 node_idx);
 
@@ -82,6 +82,10 @@
 #define GOSSIP_TOKEN_TIME(dev_fast_gossip_flag) \
 	DEV_FAST_GOSSIP(dev_fast_gossip_flag, 1, 3600)
 
+/* How often gossipd rewrites the gossmap index for plugins. */
+#define GOSSMAP_INDEX_INTERVAL(dev_fast_gossip_flag) \
+	DEV_FAST_GOSSIP(dev_fast_gossip_flag, 1, 300)
+
 /* This is where we keep our gossip */
 #define GOSSIP_STORE_FILENAME "gossip_store"
 
@@ -13,6 +13,19 @@ struct gossip_rcvd_filter;
  */
 #define GOSSIP_STORE_VERSION 10
 
+/**
+ * gossipd writes an index of the gossip_store to this file (appended to the
+ * store filename), which gossmap_load() uses if it's valid, to avoid
+ * parsing the whole store.
+ */
+#define GOSSMAP_INDEX_SUFFIX ".gossmap"
+
+/**
+ * gossipd keeps a u64 counter in this file (appended to the store filename),
+ * incremented after every append, so readers can cheaply check for changes.
+ */
+#define GOSSIP_STORE_SEQ_SUFFIX ".seq"
+
 /**
  * Bit of length we use to mark a deleted record.
  */
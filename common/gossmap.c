@@ -4,6 +4,7 @@
 #include <ccan/err/err.h>
 #include <ccan/htable/htable_type.h>
 #include <ccan/ptrint/ptrint.h>
+#include <ccan/read_write_all/read_write_all.h>
 #include <ccan/tal/str/str.h>
 #include <common/features.h>
 #include <common/gossip_store.h>
@@ -13,7 +14,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <gossipd/gossip_store_wiregen.h>
+#include <stdio.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wire/peer_wire.h>
 
@@ -48,6 +51,9 @@ static size_t nodeid_hash(const struct node_id id)
 HTABLE_DEFINE_TYPE(ptrint_t, nodeidx_id, nodeid_hash, nodeidx_eq_id,
 		   nodeidx_htable);
 
+/* Address space we reserve past the end of the store, for it to grow into */
+#define GOSSMAP_MMAP_SLACK (64 * 1024 * 1024)
+
 struct gossmap {
 	/* The file descriptor and filename to monitor */
 	int fd;
@@ -57,6 +63,13 @@ struct gossmap {
 	u8 *mmap;
 	/* map_end is where we read to so far, map_size is total size */
 	size_t map_end, map_size;
+	/* We map more than map_size, so we rarely need to remap as it grows */
+	size_t mmap_len;
+
+	/* gossipd increments this every time it appends to the store (if
+	 * we could map it), so we can tell nothing changed without a syscall */
+	const u64 *seq;
+	u64 last_seq;
 
 	/* Map of node id -> node */
 	struct nodeidx_htable nodes;
@@ -66,9 +79,19 @@ struct gossmap {
 
 	/* Array of nodes, so we can use simple index. */
 	struct gossmap_node *node_arr;
+	u32 num_node_arr;
 
 	/* Array of chans, so we can use simple index */
 	struct gossmap_chan *chan_arr;
+	u32 num_chan_arr;
+
+	/* If we loaded from an index, it's mapped here (privately, so
+	 * unmodified pages are shared with other processes). */
+	u8 *idx_mmap;
+	size_t idx_size;
+
+	/* Total updates rejected so far (for the index) */
+	size_t num_rejected;
 
 	/* Linked list of freed ones, if any. */
 	u32 freed_nodes, freed_chans;
@@ -155,27 +178,35 @@ static int map_feature_test(const struct gossmap *map,
 /* These values can change across calls to gossmap_check. */
 u32 gossmap_max_node_idx(const struct gossmap *map)
 {
-	return tal_count(map->node_arr);
+	return map->num_node_arr;
 }
 
 u32 gossmap_max_chan_idx(const struct gossmap *map)
 {
-	return tal_count(map->chan_arr);
+	return map->num_chan_arr;
 }
 
 /* Each channel has a unique (low) index. */
 u32 gossmap_node_idx(const struct gossmap *map, const struct gossmap_node *node)
 {
-	assert(node - map->node_arr < tal_count(map->node_arr));
+	assert(node - map->node_arr < map->num_node_arr);
 	return node - map->node_arr;
 }
 
 u32 gossmap_chan_idx(const struct gossmap *map, const struct gossmap_chan *chan)
 {
-	assert(chan - map->chan_arr < tal_count(map->chan_arr));
+	assert(chan - map->chan_arr < map->num_chan_arr);
 	return chan - map->chan_arr;
 }
 
+/* Is this pointer inside the (privately-mapped) index file? */
+static bool in_index(const struct gossmap *map, const void *p)
+{
+	return map->idx_mmap
+		&& (const u8 *)p >= map->idx_mmap
+		&& (const u8 *)p < map->idx_mmap + map->idx_size;
+}
+
 /* htable can't handle NULL or 1 values, so we add 2 */
 static struct gossmap_chan *ptrint2chan(const ptrint_t *pidx)
 {
@@ -227,10 +258,11 @@ struct gossmap_chan *gossmap_find_chan(const struct gossmap *map,
 	return NULL;
 }
 
-static u32 init_node_arr(struct gossmap_node *node_arr, size_t start)
+static u32 init_node_arr(struct gossmap_node *node_arr, size_t start,
+			 size_t num)
 {
 	size_t i;
-	for (i = start; i < tal_count(node_arr) - 1; i++) {
+	for (i = start; i < num - 1; i++) {
 		node_arr[i].nann_off = i + 1;
 		node_arr[i].chan_idxs = NULL;
 	}
@@ -247,9 +279,16 @@ static struct gossmap_node *next_free_node(struct gossmap *map)
 
 	if (map->freed_nodes == UINT_MAX) {
 		/* Double in size, add second half to free list */
-		size_t n = tal_count(map->node_arr);
-		tal_resize(&map->node_arr, n * 2);
-		map->freed_nodes = init_node_arr(map->node_arr, n);
+		size_t n = map->num_node_arr;
+		if (in_index(map, map->node_arr)) {
+			struct gossmap_node *arr;
+			arr = tal_arr(map, struct gossmap_node, n * 2);
+			memcpy(arr, map->node_arr, n * sizeof(*arr));
+			map->node_arr = arr;
+		} else
+			tal_resize(&map->node_arr, n * 2);
+		map->num_node_arr = n * 2;
+		map->freed_nodes = init_node_arr(map->node_arr, n, n * 2);
 	}
 
 	f = map->freed_nodes;
@@ -274,24 +313,36 @@ static void remove_node(struct gossmap *map, struct gossmap_node *node)
 	if (!nodeidx_htable_del(&map->nodes, node2ptrint(node)))
 		abort();
 	node->nann_off = map->freed_nodes;
-	free(node->chan_idxs);
+	if (!in_index(map, node->chan_idxs))
+		free(node->chan_idxs);
 	node->chan_idxs = NULL;
 	node->num_chans = 0;
 	map->freed_nodes = nodeidx;
 }
 
-static void node_add_channel(struct gossmap_node *node, u32 chanidx)
+static void node_add_channel(struct gossmap *map,
+			     struct gossmap_node *node, u32 chanidx)
 {
 	node->num_chans++;
-	node->chan_idxs = realloc(node->chan_idxs,
-				  node->num_chans * sizeof(*node->chan_idxs));
+	/* Can't realloc inside the index: copy out. */
+	if (in_index(map, node->chan_idxs)) {
+		u32 *chan_idxs = malloc(node->num_chans
+					* sizeof(*node->chan_idxs));
+		memcpy(chan_idxs, node->chan_idxs,
+		       (node->num_chans - 1) * sizeof(*node->chan_idxs));
+		node->chan_idxs = chan_idxs;
+	} else
+		node->chan_idxs = realloc(node->chan_idxs,
+					  node->num_chans
+					  * sizeof(*node->chan_idxs));
 	node->chan_idxs[node->num_chans-1] = chanidx;
 }
 
-static u32 init_chan_arr(struct gossmap_chan *chan_arr, size_t start)
+static u32 init_chan_arr(struct gossmap_chan *chan_arr, size_t start,
+			 size_t num)
 {
 	size_t i;
-	for (i = start; i < tal_count(chan_arr) - 1; i++) {
+	for (i = start; i < num - 1; i++) {
 		chan_arr[i].cann_off = i + 1;
 		chan_arr[i].plus_scid_off = 0;
 	}
@@ -307,9 +358,16 @@ static struct gossmap_chan *next_free_chan(struct gossmap *map)
 
 	if (map->freed_chans == UINT_MAX) {
 		/* Double in size, add second half to free list */
-		size_t n = tal_count(map->chan_arr);
-		tal_resize(&map->chan_arr, n * 2);
-		map->freed_chans = init_chan_arr(map->chan_arr, n);
+		size_t n = map->num_chan_arr;
+		if (in_index(map, map->chan_arr)) {
+			struct gossmap_chan *arr;
+			arr = tal_arr(map, struct gossmap_chan, n * 2);
+			memcpy(arr, map->chan_arr, n * sizeof(*arr));
+			map->chan_arr = arr;
+		} else
+			tal_resize(&map->chan_arr, n * 2);
+		map->num_chan_arr = n * 2;
+		map->freed_chans = init_chan_arr(map->chan_arr, n, n * 2);
 	}
 
 	f = map->freed_chans;
@@ -332,8 +390,10 @@ static struct gossmap_chan *new_channel(struct gossmap *map,
 	memset(chan->half, 0, sizeof(chan->half));
 	chan->half[0].nodeidx = n1idx;
 	chan->half[1].nodeidx = n2idx;
-	node_add_channel(map->node_arr + n1idx, gossmap_chan_idx(map, chan));
-	node_add_channel(map->node_arr + n2idx, gossmap_chan_idx(map, chan));
+	node_add_channel(map, map->node_arr + n1idx,
+			 gossmap_chan_idx(map, chan));
+	node_add_channel(map, map->node_arr + n2idx,
+			 gossmap_chan_idx(map, chan));
 	chanidx_htable_add(&map->channels, chan2ptrint(chan));
 
 	return chan;
@@ -572,6 +632,34 @@ static void node_announcement(struct gossmap *map, size_t nann_off)
 	n->nann_off = nann_off;
 }
 
+/* Make sure the mmap covers up to map_size. */
+static void map_store(struct gossmap *map)
+{
+	if (map->mmap) {
+		if (map->map_size <= map->mmap_len)
+			return;
+		munmap(map->mmap, map->mmap_len);
+	}
+
+	/* We can map past the end of the file (as long as we don't access
+	 * it!), and as the file grows, it appears in the mapping.  So reserve
+	 * plenty of address space, so we don't remap on every refresh. */
+	map->mmap_len = map->map_size * 2 + GOSSMAP_MMAP_SLACK;
+	map->mmap = mmap(NULL, map->mmap_len, PROT_READ, MAP_SHARED, map->fd, 0);
+	/* If this fails, we fall back to read */
+	if (map->mmap == MAP_FAILED)
+		map->mmap = NULL;
+}
+
+static void unmap_store(struct gossmap *map)
+{
+	if (map->mmap)
+		munmap(map->mmap, map->mmap_len);
+	map->mmap = NULL;
+}
+
+static bool refresh_store(struct gossmap *map, size_t *num_rejected);
+
 static void reopen_store(struct gossmap *map, size_t ended_off)
 {
 	int fd = open(map->fname, O_RDONLY);
@@ -584,7 +672,11 @@ static void reopen_store(struct gossmap *map, size_t ended_off)
 
 	close(map->fd);
 	map->fd = fd;
-	gossmap_refresh(map, NULL);
+
+	/* Completely new file, so we need a new map. */
+	unmap_store(map);
+	map->map_size = 0;
+	refresh_store(map, NULL);
 }
 
 static bool map_catchup(struct gossmap *map, size_t *num_rejected)
@@ -632,59 +724,331 @@ static bool map_catchup(struct gossmap *map, size_t *num_rejected)
 		changed = true;
 	}
 
+	map->num_rejected += num_bad;
 	if (num_rejected)
 		*num_rejected = num_bad;
 	return changed;
 }
 
+/* The index file is a snapshot of our arrays, so other processes can
+ * map it rather than parsing the whole store.  It's only ever read by
+ * the same build which wrote it (we check sizes, but that's a sanity
+ * check, not a compatibility guarantee), so we write structs raw:
+ *
+ *   hdr
+ *   chan_arr[num_chans]
+ *   node_arr[num_nodes] (chan_idxs is 1 + offset into chan_idxs[], or 0)
+ *   scids[num_chans] (unused entries are 0)
+ *   node_ids[num_nodes] (unused entries are 0)
+ *   chan_idxs[num_chan_idxs]
+ *
+ * Each section is 8-byte aligned.  We can't store the hash tables
+ * (they're seeded per-process), but with the keys beside the arrays we
+ * can rebuild them without touching the store.
+ */
+#define GOSSMAP_INDEX_MAGIC "GOSSMAPI"
+#define GOSSMAP_INDEX_VERSION 1
+
+struct gossmap_index_hdr {
+	char magic[8];
+	u32 version;
+	/* Sanity check that we're the same build. */
+	u16 chan_size, node_size;
+	/* Which store this indexes, and how far. */
+	u64 store_dev, store_ino;
+	u64 store_end;
+	/* The bytes of the store just before store_end (or fewer,
+	 * if it's shorter), in case the inode got reused. */
+	u8 store_tail[32];
+	u32 num_chans, num_nodes;
+	u32 freed_chans, freed_nodes;
+	u32 num_chan_idxs;
+	u32 num_rejected;
+};
+
+struct index_layout {
+	u64 chan_off, node_off, scid_off, nodeid_off, chan_idxs_off, total;
+};
+
+static u64 idx_align(u64 off)
+{
+	return (off + 7) & ~(u64)7;
+}
+
+static void index_layout(const struct gossmap_index_hdr *hdr,
+			 struct index_layout *l)
+{
+	l->chan_off = idx_align(sizeof(*hdr));
+	l->node_off = idx_align(l->chan_off
+				+ (u64)hdr->num_chans * sizeof(struct gossmap_chan));
+	l->scid_off = idx_align(l->node_off
+				+ (u64)hdr->num_nodes * sizeof(struct gossmap_node));
+	l->nodeid_off = idx_align(l->scid_off
+				  + (u64)hdr->num_chans * sizeof(struct short_channel_id));
+	l->chan_idxs_off = idx_align(l->nodeid_off
+				     + (u64)hdr->num_nodes * sizeof(struct node_id));
+	l->total = l->chan_idxs_off + (u64)hdr->num_chan_idxs * sizeof(u32);
+}
+
+static size_t store_tail_len(u64 store_end)
+{
+	return store_end < 32 ? store_end : 32;
+}
+
+/* Don't trust the index too much: we'd crash later on bad offsets. */
+static bool index_sane(const struct gossmap *map,
+		       const struct gossmap_index_hdr *hdr,
+		       const u32 *chan_idxs)
+{
+	if (hdr->freed_chans != UINT_MAX && hdr->freed_chans >= hdr->num_chans)
+		return false;
+	if (hdr->freed_nodes != UINT_MAX && hdr->freed_nodes >= hdr->num_nodes)
+		return false;
+
+	for (size_t i = 0; i < hdr->num_chans; i++) {
+		const struct gossmap_chan *c = &map->chan_arr[i];
+		/* Free ones link through cann_off */
+		if (c->plus_scid_off == 0) {
+			if (c->cann_off != UINT_MAX
+			    && c->cann_off >= hdr->num_chans)
+				return false;
+			continue;
+		}
+		if ((u64)c->cann_off + c->plus_scid_off + 8 + 2 * PUBKEY_CMPR_LEN
+		    > hdr->store_end)
+			return false;
+		for (size_t h = 0; h < 2; h++) {
+			if (c->half[h].nodeidx >= hdr->num_nodes)
+				return false;
+			if (c->cupdate_off[h] >= hdr->store_end)
+				return false;
+		}
+	}
+	for (size_t i = 0; i < hdr->num_nodes; i++) {
+		const struct gossmap_node *n = &map->node_arr[i];
+		/* Free ones link through nann_off */
+		if (!n->chan_idxs) {
+			if (n->nann_off != UINT_MAX
+			    && n->nann_off >= hdr->num_nodes)
+				return false;
+			continue;
+		}
+		if (n->nann_off >= hdr->store_end)
+			return false;
+		if (n->chan_idxs - chan_idxs + (u64)n->num_chans
+		    > hdr->num_chan_idxs)
+			return false;
+		for (size_t j = 0; j < n->num_chans; j++) {
+			if (n->chan_idxs[j] >= hdr->num_chans)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool load_index(struct gossmap *map)
+{
+	char *fname = tal_fmt(map, "%s"GOSSMAP_INDEX_SUFFIX, map->fname);
+	struct gossmap_index_hdr hdr;
+	struct index_layout l;
+	struct stat st, store_st;
+	u8 tail[32];
+	int fd;
+	const struct short_channel_id *scids;
+	const struct node_id *node_ids;
+	u32 *chan_idxs;
+
+	fd = open(fname, O_RDONLY);
+	tal_free(fname);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) != 0
+	    || fstat(map->fd, &store_st) != 0
+	    || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		goto fail;
+
+	if (memcmp(hdr.magic, GOSSMAP_INDEX_MAGIC, sizeof(hdr.magic)) != 0
+	    || hdr.version != GOSSMAP_INDEX_VERSION
+	    || hdr.chan_size != sizeof(struct gossmap_chan)
+	    || hdr.node_size != sizeof(struct gossmap_node)
+	    || hdr.num_chans == 0
+	    || hdr.num_nodes == 0)
+		goto fail;
+
+	/* Is it for this store? */
+	if (hdr.store_dev != store_st.st_dev
+	    || hdr.store_ino != store_st.st_ino
+	    || hdr.store_end < 1
+	    || hdr.store_end > map->map_size)
+		goto fail;
+	map_copy(map, hdr.store_end - store_tail_len(hdr.store_end),
+		 tail, store_tail_len(hdr.store_end));
+	if (memcmp(tail, hdr.store_tail, store_tail_len(hdr.store_end)) != 0)
+		goto fail;
+
+	index_layout(&hdr, &l);
+	if (l.total > st.st_size)
+		goto fail;
+
+	/* Private and writable: pages are shared until we change them. */
+	map->idx_size = l.total;
+	map->idx_mmap = mmap(NULL, map->idx_size, PROT_READ|PROT_WRITE,
+			     MAP_PRIVATE, fd, 0);
+	if (map->idx_mmap == MAP_FAILED) {
+		map->idx_mmap = NULL;
+		goto fail;
+	}
+	close(fd);
+
+	map->chan_arr = (struct gossmap_chan *)(map->idx_mmap + l.chan_off);
+	map->num_chan_arr = hdr.num_chans;
+	map->node_arr = (struct gossmap_node *)(map->idx_mmap + l.node_off);
+	map->num_node_arr = hdr.num_nodes;
+	scids = (const struct short_channel_id *)(map->idx_mmap + l.scid_off);
+	node_ids = (const struct node_id *)(map->idx_mmap + l.nodeid_off);
+	chan_idxs = (u32 *)(map->idx_mmap + l.chan_idxs_off);
+
+	/* Turn offsets back into pointers. */
+	for (size_t i = 0; i < hdr.num_nodes; i++) {
+		uintptr_t off = (uintptr_t)map->node_arr[i].chan_idxs;
+		if (off == 0)
+			continue;
+		if (off - 1 > hdr.num_chan_idxs)
+			goto fail_unmap;
+		map->node_arr[i].chan_idxs = chan_idxs + off - 1;
+	}
+
+	if (!index_sane(map, &hdr, chan_idxs))
+		goto fail_unmap;
+
+	map->freed_chans = hdr.freed_chans;
+	map->freed_nodes = hdr.freed_nodes;
+	map->num_rejected = hdr.num_rejected;
+	map->map_end = hdr.store_end;
+
+	chanidx_htable_init_sized(&map->channels, hdr.num_chans);
+	nodeidx_htable_init_sized(&map->nodes, hdr.num_nodes);
+	for (size_t i = 0; i < hdr.num_chans; i++) {
+		if (map->chan_arr[i].plus_scid_off == 0)
+			continue;
+		htable_add(&map->channels.raw, scid_hash(scids[i]),
+			   chan2ptrint(&map->chan_arr[i]));
+	}
+	for (size_t i = 0; i < hdr.num_nodes; i++) {
+		if (!map->node_arr[i].chan_idxs)
+			continue;
+		htable_add(&map->nodes.raw, nodeid_hash(node_ids[i]),
+			   node2ptrint(&map->node_arr[i]));
+	}
+	return true;
+
+fail_unmap:
+	munmap(map->idx_mmap, map->idx_size);
+	map->idx_mmap = NULL;
+	return false;
+
+fail:
+	close(fd);
+	return false;
+}
+
+static void map_seq(struct gossmap *map)
+{
+	char *fname = tal_fmt(map, "%s"GOSSIP_STORE_SEQ_SUFFIX, map->fname);
+	int fd = open(fname, O_RDONLY);
+	void *p;
+
+	tal_free(fname);
+
+	map->seq = NULL;
+	if (fd < 0)
+		return;
+
+	/* gossipd creates it with this size, before it's opened by anyone */
+	p = mmap(NULL, sizeof(*map->seq), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return;
+
+	map->seq = p;
+	map->last_seq = *map->seq;
+}
+
+static void unmap_seq(struct gossmap *map)
+{
+	if (map->seq)
+		munmap((void *)map->seq, sizeof(*map->seq));
+}
+
 static bool load_gossip_store(struct gossmap *map, size_t *num_rejected)
 {
 	map->fd = open(map->fname, O_RDONLY);
 	if (map->fd < 0)
 		return false;
 
+	/* Do this first, so we can't miss an append. */
+	map_seq(map);
+
 	map->map_size = lseek(map->fd, 0, SEEK_END);
 	map->local = NULL;
-	/* If this fails, we fall back to read */
-	map->mmap = mmap(NULL, map->map_size, PROT_READ, MAP_SHARED, map->fd, 0);
-	if (map->mmap == MAP_FAILED)
-		map->mmap = NULL;
+	map->mmap = NULL;
+	map_store(map);
 
 	if (map_u8(map, 0) != GOSSIP_STORE_VERSION) {
 		close(map->fd);
-		if (map->mmap)
-			munmap(map->mmap, map->map_size);
+		unmap_store(map);
+		unmap_seq(map);
 		errno = EINVAL;
 		return false;
 	}
 
-	/* Since channel_announcement is ~430 bytes, and channel_update is 136,
-	 * node_announcement is 144, and current topology has 35000 channels
-	 * and 10000 nodes, let's assume each channel gets about 750 bytes.
-	 *
-	 * We halve this, since often some records are deleted. */
-	chanidx_htable_init_sized(&map->channels, map->map_size / 750 / 2);
-	nodeidx_htable_init_sized(&map->nodes, map->map_size / 2500 / 2);
-
-	map->chan_arr = tal_arr(map, struct gossmap_chan, map->map_size / 750 / 2 + 1);
-	map->freed_chans = init_chan_arr(map->chan_arr, 0);
-	map->node_arr = tal_arr(map, struct gossmap_node, map->map_size / 2500 / 2 + 1);
-	map->freed_nodes = init_node_arr(map->node_arr, 0);
-
-	map->map_end = 1;
-	map_catchup(map, num_rejected);
+	map->num_rejected = 0;
+	map->idx_mmap = NULL;
+
+	/* If gossipd has written an index, we only need to catch up
+	 * from where it left off. */
+	if (!load_index(map)) {
+		/* Since channel_announcement is ~430 bytes, and
+		 * channel_update is 136, node_announcement is 144, and
+		 * current topology has 35000 channels and 10000 nodes,
+		 * let's assume each channel gets about 750 bytes.
+		 *
+		 * We halve this, since often some records are deleted. */
+		chanidx_htable_init_sized(&map->channels, map->map_size / 750 / 2);
+		nodeidx_htable_init_sized(&map->nodes, map->map_size / 2500 / 2);
+
+		map->num_chan_arr = map->map_size / 750 / 2 + 1;
+		map->chan_arr = tal_arr(map, struct gossmap_chan, map->num_chan_arr);
+		map->freed_chans = init_chan_arr(map->chan_arr, 0,
+						 map->num_chan_arr);
+		map->num_node_arr = map->map_size / 2500 / 2 + 1;
+		map->node_arr = tal_arr(map, struct gossmap_node, map->num_node_arr);
+		map->freed_nodes = init_node_arr(map->node_arr, 0,
+						 map->num_node_arr);
+
+		map->map_end = 1;
+	}
+
+	map_catchup(map, NULL);
+	if (num_rejected)
+		*num_rejected = map->num_rejected;
 	return true;
 }
 
 static void destroy_map(struct gossmap *map)
 {
-	if (map->mmap)
-		munmap(map->mmap, map->map_size);
+	unmap_store(map);
+	unmap_seq(map);
 	chanidx_htable_clear(&map->channels);
 	nodeidx_htable_clear(&map->nodes);
 
-	for (size_t i = 0; i < tal_count(map->node_arr); i++)
-		free(map->node_arr[i].chan_idxs);
+	for (size_t i = 0; i < map->num_node_arr; i++) {
+		if (!in_index(map, map->node_arr[i].chan_idxs))
+			free(map->node_arr[i].chan_idxs);
+	}
+	if (map->idx_mmap)
+		munmap(map->idx_mmap, map->idx_size);
 }
 
 /* Local modifications.  We only expect a few, so we use a simple
@@ -917,27 +1281,38 @@ void gossmap_remove_localmods(struct gossmap *map,
 	map->local = NULL;
 }
 
-bool gossmap_refresh(struct gossmap *map, size_t *num_rejected)
+static bool refresh_store(struct gossmap *map, size_t *num_rejected)
 {
 	off_t len;
 
-	/* You must remove local updates before this. */
-	assert(!map->local);
-
 	/* If file has gotten larger, try rereading */
 	len = lseek(map->fd, 0, SEEK_END);
 	if (len == map->map_size)
 		return false;
 
-	if (map->mmap)
-		munmap(map->mmap, map->map_size);
 	map->map_size = len;
-	map->mmap = mmap(NULL, map->map_size, PROT_READ, MAP_SHARED, map->fd, 0);
-	if (map->mmap == MAP_FAILED)
-		map->mmap = NULL;
+	map_store(map);
 	return map_catchup(map, num_rejected);
 }
 
+bool gossmap_refresh(struct gossmap *map, size_t *num_rejected)
+{
+	/* You must remove local updates before this. */
+	assert(!map->local);
+
+	/* gossipd increments this *after* appending, so if it's unchanged
+	 * there's nothing new.  If it changes while we're reading, we'll
+	 * simply notice next time. */
+	if (map->seq) {
+		u64 seq = *(const volatile u64 *)map->seq;
+		if (seq == map->last_seq)
+			return false;
+		map->last_seq = seq;
+	}
+
+	return refresh_store(map, num_rejected);
+}
+
 struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
 			     size_t *num_channel_updates_rejected)
 {
@@ -950,6 +1325,97 @@ struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
 	return map;
 }
 
+bool gossmap_write_index(const struct gossmap *map)
+{
+	struct gossmap_index_hdr hdr;
+	struct index_layout l;
+	struct stat st;
+	u8 *buf;
+	struct gossmap_node *nodes;
+	struct short_channel_id *scids;
+	struct node_id *node_ids;
+	u32 *chan_idxs;
+	size_t n;
+	char *fname, *tmpname;
+	int fd;
+	bool ok;
+
+	/* We'd be writing local channels into the index! */
+	assert(!map->local);
+
+	if (fstat(map->fd, &st) != 0)
+		return false;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, GOSSMAP_INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.version = GOSSMAP_INDEX_VERSION;
+	hdr.chan_size = sizeof(struct gossmap_chan);
+	hdr.node_size = sizeof(struct gossmap_node);
+	hdr.store_dev = st.st_dev;
+	hdr.store_ino = st.st_ino;
+	hdr.store_end = map->map_end;
+	map_copy(map, hdr.store_end - store_tail_len(hdr.store_end),
+		 hdr.store_tail, store_tail_len(hdr.store_end));
+	hdr.num_chans = map->num_chan_arr;
+	hdr.num_nodes = map->num_node_arr;
+	hdr.freed_chans = map->freed_chans;
+	hdr.freed_nodes = map->freed_nodes;
+	hdr.num_rejected = map->num_rejected;
+	for (size_t i = 0; i < map->num_node_arr; i++) {
+		if (map->node_arr[i].chan_idxs)
+			hdr.num_chan_idxs += map->node_arr[i].num_chans;
+	}
+
+	index_layout(&hdr, &l);
+	buf = tal_arrz(NULL, u8, l.total);
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + l.chan_off, map->chan_arr,
+	       hdr.num_chans * sizeof(struct gossmap_chan));
+	nodes = (struct gossmap_node *)(buf + l.node_off);
+	scids = (struct short_channel_id *)(buf + l.scid_off);
+	node_ids = (struct node_id *)(buf + l.nodeid_off);
+	chan_idxs = (u32 *)(buf + l.chan_idxs_off);
+
+	for (size_t i = 0; i < hdr.num_chans; i++) {
+		if (map->chan_arr[i].plus_scid_off == 0)
+			continue;
+		scids[i] = gossmap_chan_scid(map, &map->chan_arr[i]);
+	}
+
+	n = 0;
+	for (size_t i = 0; i < hdr.num_nodes; i++) {
+		const struct gossmap_node *node = &map->node_arr[i];
+
+		nodes[i] = *node;
+		if (!node->chan_idxs)
+			continue;
+		gossmap_node_get_id(map, node, &node_ids[i]);
+		memcpy(chan_idxs + n, node->chan_idxs,
+		       node->num_chans * sizeof(*chan_idxs));
+		nodes[i].chan_idxs = (u32 *)(uintptr_t)(n + 1);
+		n += node->num_chans;
+	}
+	assert(n == hdr.num_chan_idxs);
+
+	/* Write it out atomically, so readers never see a partial one. */
+	fname = tal_fmt(buf, "%s"GOSSMAP_INDEX_SUFFIX, map->fname);
+	tmpname = tal_fmt(buf, "%s.tmp", fname);
+	fd = open(tmpname, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if (fd < 0) {
+		tal_free(buf);
+		return false;
+	}
+	ok = write_all(fd, buf, l.total);
+	if (close(fd) != 0)
+		ok = false;
+	if (ok)
+		ok = (rename(tmpname, fname) == 0);
+	if (!ok)
+		unlink(tmpname);
+	tal_free(buf);
+	return ok;
+}
+
 void gossmap_node_get_id(const struct gossmap *map,
 			 const struct gossmap_node *node,
 			 struct node_id *id)
@@ -1003,7 +1469,7 @@ struct gossmap_chan *gossmap_nth_chan(const struct gossmap *map,
 	struct gossmap_chan *chan;
 
 	assert(n < node->num_chans);
-	assert(node->chan_idxs[n] < tal_count(map->chan_arr));
+	assert(node->chan_idxs[n] < map->num_chan_arr);
 	chan = map->chan_arr + node->chan_idxs[n];
 
 	if (which_half) {
@@ -1033,7 +1499,7 @@ size_t gossmap_num_nodes(const struct gossmap *map)
 
 static struct gossmap_node *node_iter(const struct gossmap *map, size_t start)
 {
-	for (size_t i = start; i < tal_count(map->node_arr); i++) {
+	for (size_t i = start; i < map->num_node_arr; i++) {
 		if (map->node_arr[i].chan_idxs != NULL)
 			return &map->node_arr[i];
 	}
@@ -1058,7 +1524,7 @@ size_t gossmap_num_chans(const struct gossmap *map)
 
 static struct gossmap_chan *chan_iter(const struct gossmap *map, size_t start)
 {
-	for (size_t i = start; i < tal_count(map->chan_arr); i++) {
+	for (size_t i = start; i < map->num_chan_arr; i++) {
 		if (map->chan_arr[i].plus_scid_off != 0)
 			return &map->chan_arr[i];
 	}
@@ -46,6 +46,10 @@ struct gossmap_chan {
 struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
 			     size_t *num_channel_updates_rejected);
 
+/* Write out an index of this gossmap, for gossmap_load() to use.  Returns
+ * false (with errno set) on failure.  Must not have localmods applied. */
+bool gossmap_write_index(const struct gossmap *map);
+
 /* Call this before using to ensure it's up-to-date.  Returns true if something
  * was updated. Note: this can scramble node and chan indexes! */
 bool gossmap_refresh(struct gossmap *map, size_t *num_channel_updates_rejected);
@@ -0,0 +1,65 @@
+#include "config.h"
+#include <common/fp16.h>
+#include <common/gossmap.h>
+#include <common/gossmap_incoming.h>
+
+/* What can the peer on the other side of ourchan bring in? */
+static struct amount_msat peer_capacity(const struct gossmap *gossmap,
+				       const struct gossmap_node *peer,
+				       const struct gossmap_chan *ourchan)
+{
+	struct amount_msat capacity = AMOUNT_MSAT(0);
+
+	for (size_t i = 0; i < peer->num_chans; i++) {
+		int dir;
+		struct gossmap_chan *c;
+		c = gossmap_nth_chan(gossmap, peer, i, &dir);
+		if (c == ourchan)
+			continue;
+		if (!c->half[!dir].enabled)
+			continue;
+		if (!amount_msat_add(
+			&capacity, capacity,
+			amount_msat(fp16_to_u64(c->half[!dir].htlc_max))))
+			continue;
+	}
+	return capacity;
+}
+
+struct gossmap_incoming *gossmap_incoming_chans(const tal_t *ctx,
+						const struct gossmap *gossmap,
+						const struct node_id *local_id)
+{
+	struct gossmap_incoming *incoming;
+	struct gossmap_node *me;
+
+	incoming = tal_arr(ctx, struct gossmap_incoming, 0);
+	me = gossmap_find_node(gossmap, local_id);
+	if (!me)
+		return incoming;
+
+	for (size_t i = 0; i < me->num_chans; i++) {
+		struct gossmap_incoming in;
+		struct gossmap_chan *ourchan;
+		struct gossmap_node *peer;
+		int dir;
+
+		ourchan = gossmap_nth_chan(gossmap, me, i, &dir);
+		/* If its half is disabled, ignore. */
+		if (!ourchan->half[!dir].enabled)
+			continue;
+
+		peer = gossmap_nth_node(gossmap, ourchan, !dir);
+		gossmap_node_get_id(gossmap, peer, &in.peer_id);
+		in.scid = gossmap_chan_scid(gossmap, ourchan);
+		in.fee_base = amount_msat(ourchan->half[!dir].base_fee);
+		in.fee_proportional_millionths
+			= ourchan->half[!dir].proportional_fee;
+		in.cltv_expiry_delta = ourchan->half[!dir].delay;
+		in.htlc_max = amount_msat(fp16_to_u64(ourchan->half[!dir]
+						      .htlc_max));
+		in.incoming_capacity = peer_capacity(gossmap, peer, ourchan);
+		tal_arr_expand(&incoming, in);
+	}
+	return incoming;
+}
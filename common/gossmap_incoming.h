@@ -0,0 +1,37 @@
+#ifndef LIGHTNING_COMMON_GOSSMAP_INCOMING_H
+#define LIGHTNING_COMMON_GOSSMAP_INCOMING_H
+#include "config.h"
+#include <bitcoin/short_channel_id.h>
+#include <ccan/short_types/short_types.h>
+#include <ccan/tal/tal.h>
+#include <common/amount.h>
+#include <common/node_id.h>
+
+struct gossmap;
+
+/* One of our channels, as the peer advertizes it in gossip. */
+struct gossmap_incoming {
+	struct node_id peer_id;
+	struct short_channel_id scid;
+	struct amount_msat fee_base;
+	u32 fee_proportional_millionths;
+	u16 cltv_expiry_delta;
+	struct amount_msat htlc_max;
+	/* What the peer's other channels can bring in (0 == deadend) */
+	struct amount_msat incoming_capacity;
+};
+
+/**
+ * gossmap_incoming_chans - the channels payments can reach us over.
+ * @ctx: tal context to allocate return off
+ * @gossmap: the gossmap
+ * @local_id: our node id
+ *
+ * This is what the topology plugin's listincoming returns: every channel
+ * of ours whose peer's side is enabled.  Empty if we're not in @gossmap.
+ */
+struct gossmap_incoming *gossmap_incoming_chans(const tal_t *ctx,
+						const struct gossmap *gossmap,
+						const struct node_id *local_id);
+
+#endif /* LIGHTNING_COMMON_GOSSMAP_INCOMING_H */
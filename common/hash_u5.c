@@ -1,5 +1,4 @@
 #include "config.h"
-#include <ccan/endian/endian.h>
 #include <common/hash_u5.h>
 #include <string.h>
 
@@ -13,36 +12,33 @@ void hash_u5_init(struct hash_u5 *hu5, const char *hrp)
 
 void hash_u5(struct hash_u5 *hu5, const u8 *u5, size_t len)
 {
-	size_t bits = len * 5;
-
-	while (bits) {
-		size_t n = 5;
-
-		if (bits < n)
-			n = bits;
-
-		hu5->buf <<= n;
-		hu5->buf |= (*u5 >> (5-n));
-		bits -= n;
-		hu5->num_bits += n;
-
-		if (n == 5)
-			u5++;
-
-		if (hu5->num_bits >= 32) {
-			be32 be32 = cpu_to_be32(hu5->buf >> (hu5->num_bits-32));
-			sha256_update(&hu5->hash, &be32, sizeof(be32));
-			hu5->num_bits -= 32;
+	/* Hand sha256 whole runs of bytes, not one word at a time. */
+	u8 bytes[64];
+	size_t n = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		hu5->buf <<= 5;
+		hu5->buf |= u5[i];
+		hu5->num_bits += 5;
+
+		if (hu5->num_bits >= 8) {
+			hu5->num_bits -= 8;
+			bytes[n++] = hu5->buf >> hu5->num_bits;
+			if (n == sizeof(bytes)) {
+				sha256_update(&hu5->hash, bytes, n);
+				n = 0;
+			}
 		}
 	}
+	sha256_update(&hu5->hash, bytes, n);
 }
 
 void hash_u5_done(struct hash_u5 *hu5, struct sha256 *res)
 {
 	if (hu5->num_bits) {
-		be32 be32 = cpu_to_be32(hu5->buf << (32 - hu5->num_bits));
+		u8 byte = hu5->buf << (8 - hu5->num_bits);
 
-		sha256_update(&hu5->hash, &be32, (hu5->num_bits + 7) / 8);
+		sha256_update(&hu5->hash, &byte, sizeof(byte));
 	}
 	sha256_done(&hu5->hash, res);
 }
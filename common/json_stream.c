@@ -46,6 +46,8 @@ struct json_stream *new_json_stream(const tal_t *ctx,
 	js->writer = writer;
 	js->reader = NULL;
 	js->log = log;
+	js->drained_cb = NULL;
+	js->bytes_written = 0;
 	return js;
 }
 
@@ -216,6 +218,7 @@ static struct io_plan *json_stream_output_write(struct io_conn *conn,
 
 	/* For when we've just done some output */
 	json_out_consume(js->jout, js->len_read);
+	js->bytes_written += js->len_read;
 
 	/* Get how much we can write out from js */
 	p = json_out_contents(js->jout, &js->len_read);
@@ -226,6 +229,15 @@ static struct io_plan *json_stream_output_write(struct io_conn *conn,
 		js->reader = NULL;
 		if (!json_stream_still_writing(js))
 			return js->reader_cb(conn, js, js->reader_arg);
+		/* Writer may want to give us more now. */
+		if (js->drained_cb) {
+			js->drained_cb(js, js->drained_arg);
+			if (json_out_contents(js->jout, &js->len_read)
+			    || !json_stream_still_writing(js)) {
+				js->len_read = 0;
+				return json_stream_output_write(conn, js);
+			}
+		}
 		return io_out_wait(conn, js, json_stream_output_write, js);
 	}
 
@@ -235,6 +247,14 @@ static struct io_plan *json_stream_output_write(struct io_conn *conn,
 			json_stream_output_write, js);
 }
 
+void json_stream_on_drained_(struct json_stream *js,
+			     void (*cb)(struct json_stream *js, void *arg),
+			     void *arg)
+{
+	js->drained_cb = cb;
+	js->drained_arg = arg;
+}
+
 struct io_plan *json_stream_output_(struct json_stream *js,
 				    struct io_conn *conn,
 				    struct io_plan *(*cb)(struct io_conn *conn,
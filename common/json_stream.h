@@ -48,6 +48,12 @@ struct json_stream {
 				     void *arg);
 	void *reader_arg;
 	size_t len_read;
+	/* Total written out so far */
+	size_t bytes_written;
+
+	/* If non-NULL, the writer wants to know when it's all been read. */
+	void (*drained_cb)(struct json_stream *js, void *arg);
+	void *drained_arg;
 
 	/* Where to log I/O */
 	struct log *log;
@@ -188,6 +194,26 @@ struct io_plan *json_stream_output_(struct json_stream *js,
 							  void *arg),
 				    void *arg);
 
+/**
+ * json_stream_on_drained - produce output as the reader consumes it.
+ * @js: the json_stream
+ * @cb: called when everything written so far has been read.
+ * @arg: the argument to @cb
+ *
+ * This lets a writer add a piece at a time, rather than buffering a huge
+ * response: @cb should add some more, or close the stream.
+ */
+#define json_stream_on_drained(js, cb, arg)				\
+	json_stream_on_drained_((js),					\
+				typesafe_cb_preargs(void, void *,	\
+						    (cb), (arg),	\
+						    struct json_stream *), \
+				(arg))
+
+void json_stream_on_drained_(struct json_stream *js,
+			     void (*cb)(struct json_stream *js, void *arg),
+			     void *arg);
+
 /* Ensure there's a double \n after a JSON response. */
 void json_stream_double_cr(struct json_stream *js);
 void json_stream_flush(struct json_stream *js);
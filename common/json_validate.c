@@ -0,0 +1,257 @@
+#include "config.h"
+#include <ccan/str/str.h>
+#include <common/json_validate.h>
+#include <errno.h>
+#include <stdlib.h>
+
+void json_validator_init(struct json_validator *v)
+{
+	v->state = JV_VALUE;
+	v->depth = 0;
+}
+
+static bool is_ws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void value_done(struct json_validator *v)
+{
+	v->state = v->depth == 0 ? JV_DONE : JV_AFTER_VALUE;
+}
+
+static bool open_container(struct json_validator *v, char c)
+{
+	if (v->depth == JSON_VALIDATE_MAX_DEPTH)
+		return false;
+	v->stack[v->depth++] = c;
+	v->state = c == '{' ? JV_KEY_OR_END : JV_VALUE_OR_END;
+	return true;
+}
+
+static bool close_container(struct json_validator *v, char open)
+{
+	if (v->depth == 0 || v->stack[v->depth - 1] != open)
+		return false;
+	v->depth--;
+	value_done(v);
+	return true;
+}
+
+static void start_string(struct json_validator *v, bool is_key)
+{
+	v->is_key = is_key;
+	utf8_state_init(&v->utf8);
+	v->state = JV_STRING;
+}
+
+static bool start_value(struct json_validator *v, char c)
+{
+	switch (c) {
+	case '{':
+	case '[':
+		return open_container(v, c);
+	case '"':
+		start_string(v, false);
+		return true;
+	case '-':
+		v->num = JV_NUM_MINUS;
+		break;
+	case '0':
+		v->num = JV_NUM_ZERO;
+		break;
+	case 't':
+		v->literal = "rue";
+		v->state = JV_LITERAL;
+		return true;
+	case 'f':
+		v->literal = "alse";
+		v->state = JV_LITERAL;
+		return true;
+	case 'n':
+		v->literal = "ull";
+		v->state = JV_LITERAL;
+		return true;
+	default:
+		if (!cisdigit(c))
+			return false;
+		v->num = JV_NUM_INT;
+	}
+	v->state = JV_NUMBER;
+	return true;
+}
+
+/* Is this the next char of the number? */
+static bool number_char(struct json_validator *v, char c)
+{
+	switch (v->num) {
+	case JV_NUM_MINUS:
+		if (c == '0')
+			v->num = JV_NUM_ZERO;
+		else if (cisdigit(c))
+			v->num = JV_NUM_INT;
+		else
+			return false;
+		return true;
+	case JV_NUM_INT:
+		if (cisdigit(c))
+			return true;
+		/* Fall thru */
+	case JV_NUM_ZERO:
+		if (c == '.')
+			v->num = JV_NUM_DOT;
+		else if (c == 'e' || c == 'E')
+			v->num = JV_NUM_E;
+		else
+			return false;
+		return true;
+	case JV_NUM_DOT:
+		if (!cisdigit(c))
+			return false;
+		v->num = JV_NUM_FRAC;
+		return true;
+	case JV_NUM_FRAC:
+		if (cisdigit(c))
+			return true;
+		if (c != 'e' && c != 'E')
+			return false;
+		v->num = JV_NUM_E;
+		return true;
+	case JV_NUM_E:
+		if (c == '+' || c == '-') {
+			v->num = JV_NUM_ESIGN;
+			return true;
+		}
+		/* Fall thru */
+	case JV_NUM_ESIGN:
+		if (!cisdigit(c))
+			return false;
+		v->num = JV_NUM_EXP;
+		return true;
+	case JV_NUM_EXP:
+		return cisdigit(c);
+	}
+	abort();
+}
+
+static bool number_complete(const struct json_validator *v)
+{
+	return v->num == JV_NUM_ZERO || v->num == JV_NUM_INT
+		|| v->num == JV_NUM_FRAC || v->num == JV_NUM_EXP;
+}
+
+static bool validate_char(struct json_validator *v, char c)
+{
+again:
+	switch (v->state) {
+	case JV_VALUE_OR_END:
+		if (c == ']')
+			return close_container(v, '[');
+		/* Fall thru */
+	case JV_VALUE:
+		if (is_ws(c))
+			return true;
+		return start_value(v, c);
+	case JV_KEY_OR_END:
+		if (c == '}')
+			return close_container(v, '{');
+		/* Fall thru */
+	case JV_KEY:
+		if (is_ws(c))
+			return true;
+		if (c != '"')
+			return false;
+		start_string(v, true);
+		return true;
+	case JV_COLON:
+		if (is_ws(c))
+			return true;
+		if (c != ':')
+			return false;
+		v->state = JV_VALUE;
+		return true;
+	case JV_AFTER_VALUE:
+		if (is_ws(c))
+			return true;
+		if (c == ',') {
+			v->state = v->stack[v->depth - 1] == '{'
+				? JV_KEY : JV_VALUE;
+			return true;
+		}
+		if (c == '}')
+			return close_container(v, '{');
+		if (c == ']')
+			return close_container(v, '[');
+		return false;
+	case JV_STRING:
+		/* Part way through a multi-byte character? */
+		if (!utf8_decode(&v->utf8, c))
+			return true;
+		if (errno != 0)
+			return false;
+		if (v->utf8.c == '"') {
+			if (v->is_key)
+				v->state = JV_COLON;
+			else
+				value_done(v);
+		} else if (v->utf8.c == '\\')
+			v->state = JV_STRING_ESCAPE;
+		else if (v->utf8.c < 0x20)
+			return false;
+		return true;
+	case JV_STRING_ESCAPE:
+		if (c == 'u') {
+			v->hex_left = 4;
+			v->state = JV_STRING_UNICODE;
+			return true;
+		}
+		if (!strchr("\"\\/bfnrt", c) || c == '\0')
+			return false;
+		v->state = JV_STRING;
+		return true;
+	case JV_STRING_UNICODE:
+		if (!cisxdigit(c))
+			return false;
+		if (--v->hex_left == 0)
+			v->state = JV_STRING;
+		return true;
+	case JV_NUMBER:
+		if (number_char(v, c))
+			return true;
+		if (!number_complete(v))
+			return false;
+		/* That char is the start of whatever comes next. */
+		value_done(v);
+		goto again;
+	case JV_LITERAL:
+		if (c != *v->literal)
+			return false;
+		if (*++v->literal == '\0')
+			value_done(v);
+		return true;
+	case JV_DONE:
+		return is_ws(c);
+	case JV_INVALID:
+		return false;
+	}
+	abort();
+}
+
+bool json_validate(struct json_validator *v, const char *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (!validate_char(v, buf[i])) {
+			v->state = JV_INVALID;
+			return false;
+		}
+	}
+	return v->state != JV_INVALID;
+}
+
+bool json_validate_done(const struct json_validator *v)
+{
+	if (v->state == JV_DONE)
+		return true;
+	/* A bare number only ends when the input does. */
+	return v->state == JV_NUMBER && v->depth == 0 && number_complete(v);
+}
@@ -0,0 +1,78 @@
+/* Check JSON syntax a piece at a time, without keeping it all. */
+#ifndef LIGHTNING_COMMON_JSON_VALIDATE_H
+#define LIGHTNING_COMMON_JSON_VALIDATE_H
+#include "config.h"
+#include <ccan/utf8/utf8.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Our JSON is never nested more than a dozen deep. */
+#define JSON_VALIDATE_MAX_DEPTH 64
+
+enum json_validate_state {
+	JV_VALUE,
+	/* Just after '[' */
+	JV_VALUE_OR_END,
+	JV_KEY,
+	/* Just after '{' */
+	JV_KEY_OR_END,
+	JV_COLON,
+	/* Expecting ',' or the end of this object or array */
+	JV_AFTER_VALUE,
+	JV_STRING,
+	JV_STRING_ESCAPE,
+	JV_STRING_UNICODE,
+	JV_NUMBER,
+	JV_LITERAL,
+	/* We've had a whole value */
+	JV_DONE,
+	JV_INVALID,
+};
+
+/* Where we are in -1.5e+10 */
+enum json_validate_number {
+	JV_NUM_MINUS,
+	JV_NUM_ZERO,
+	JV_NUM_INT,
+	JV_NUM_DOT,
+	JV_NUM_FRAC,
+	JV_NUM_E,
+	JV_NUM_ESIGN,
+	JV_NUM_EXP,
+};
+
+struct json_validator {
+	enum json_validate_state state;
+	/* '{' or '[' for each object or array we're inside */
+	char stack[JSON_VALIDATE_MAX_DEPTH];
+	size_t depth;
+	/* JV_STRING*: is this an object key? */
+	bool is_key;
+	/* JV_STRING: for multi-byte characters */
+	struct utf8_state utf8;
+	/* JV_STRING_UNICODE: hex digits left in \uXXXX */
+	int hex_left;
+	/* JV_NUMBER */
+	enum json_validate_number num;
+	/* JV_LITERAL: the rest of "true", "false" or "null" */
+	const char *literal;
+};
+
+/* Start checking for a single JSON value. */
+void json_validator_init(struct json_validator *v);
+
+/**
+ * json_validate - check the next part of the JSON.
+ * @v: the validator.
+ * @buf: the next @len bytes.
+ * @len: the length of @buf.
+ *
+ * Returns false if it's not valid JSON (and will keep returning false).
+ * Like json_parse_simple(), strings must be valid UTF-8.
+ */
+bool json_validate(struct json_validator *v, const char *buf, size_t len);
+
+/* Have we seen exactly one complete value (and perhaps whitespace)? */
+bool json_validate_done(const struct json_validator *v);
+
+#endif /* LIGHTNING_COMMON_JSON_VALIDATE_H */
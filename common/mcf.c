@@ -0,0 +1,432 @@
+#include "config.h"
+#include <ccan/asort/asort.h>
+#include <common/gossmap.h>
+#include <common/mcf.h>
+#include <math.h>
+
+/* We solve in units of amount / MCF_UNITS (rounded up): more units are more
+ * accurate, but can need more augmenting paths. */
+#define MCF_UNITS 1000
+
+/* How many linear pieces we approximate each channel direction's cost with */
+#define MCF_PIECES 4
+
+#define NO_ARC UINT32_MAX
+#define INFINITE_COST INT64_MAX
+
+/* Arcs come in pairs: arcs[2n] is the forward arc, arcs[2n+1] the reverse
+ * (residual) one, so the latter's residual is the flow along the former. */
+struct mcf_arc {
+	/* Node index this arc goes to */
+	u32 head;
+	/* Next arc out of the same node */
+	u32 next;
+	s64 cost;
+	s64 residual;
+};
+
+struct mcf_graph {
+	struct mcf_arc *arcs;
+	/* First arc out of each node */
+	u32 *first;
+	/* For each pair of arcs, the channel direction it's a piece of. */
+	struct gossmap_chan **chans;
+	int *dirs;
+	/* Units each channel direction can carry, by gossmap_chan_idx * 2
+	 * + dir. */
+	s64 *cap_units;
+};
+
+/* Part of the flow, before we turn it into a struct mcf_path */
+struct flow_part {
+	/* Arc pairs from source to target */
+	u32 *pairs;
+	s64 units;
+};
+
+struct heap_entry {
+	s64 dist;
+	u32 node;
+};
+
+static void heap_push(struct heap_entry **heap, s64 dist, u32 node)
+{
+	size_t i = tal_count(*heap);
+	struct heap_entry e = { dist, node };
+
+	tal_resize(heap, i + 1);
+	while (i > 0 && (*heap)[(i - 1) / 2].dist > dist) {
+		(*heap)[i] = (*heap)[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	(*heap)[i] = e;
+}
+
+static struct heap_entry heap_pop(struct heap_entry **heap)
+{
+	struct heap_entry top = (*heap)[0], last;
+	size_t n = tal_count(*heap) - 1, i = 0;
+
+	last = (*heap)[n];
+	tal_resize(heap, n);
+	while (2 * i + 1 < n) {
+		size_t child = 2 * i + 1;
+		if (child + 1 < n && (*heap)[child + 1].dist < (*heap)[child].dist)
+			child++;
+		if ((*heap)[child].dist >= last.dist)
+			break;
+		(*heap)[i] = (*heap)[child];
+		i = child;
+	}
+	if (n)
+		(*heap)[i] = last;
+	return top;
+}
+
+static void add_arc_pair(struct mcf_graph *g, u32 tail, u32 head,
+			 s64 units, s64 cost,
+			 struct gossmap_chan *c, int dir)
+{
+	size_t n = tal_count(g->arcs);
+
+	tal_resize(&g->arcs, n + 2);
+	g->arcs[n].head = head;
+	g->arcs[n].cost = cost;
+	g->arcs[n].residual = units;
+	g->arcs[n].next = g->first[tail];
+	g->first[tail] = n;
+
+	g->arcs[n + 1].head = tail;
+	g->arcs[n + 1].cost = -cost;
+	g->arcs[n + 1].residual = 0;
+	g->arcs[n + 1].next = g->first[head];
+	g->first[head] = n + 1;
+
+	tal_arr_expand(&g->chans, c);
+	tal_arr_expand(&g->dirs, dir);
+}
+
+/* Bits of uncertainty in sending x over capacity c */
+static double uncertainty(double c, double x)
+{
+	return -log2((c + 1 - x) / (c + 1));
+}
+
+static void add_channel(struct mcf_graph *g,
+			struct gossmap_chan *c, int dir,
+			u64 cap_units, u64 total_units, u64 unit, u64 mu)
+{
+	const struct half_chan *h = &c->half[dir];
+	/* We never send more than the total, so only model that range. */
+	u64 range = cap_units < total_units ? cap_units : total_units;
+	u64 pieces = range < MCF_PIECES ? range : MCF_PIECES;
+	/* We charge the base fee on every unit: that overstates it for
+	 * larger flows, but biases us against high base fees as we should
+	 * be. */
+	double fee = h->base_fee + (double)h->proportional_fee * unit / 1000000;
+
+	for (u64 k = 0; k < pieces; k++) {
+		u64 lo = range * k / pieces, hi = range * (k + 1) / pieces;
+		double slope = (uncertainty(cap_units, hi)
+				- uncertainty(cap_units, lo)) / (hi - lo);
+		double cost = ceil(fee + slope * mu);
+
+		/* Strictly positive costs mean the optimal flow has no
+		 * cycles, so it decomposes into simple paths. */
+		if (cost < 1)
+			cost = 1;
+		if (cost > 1e15)
+			cost = 1e15;
+		add_arc_pair(g, h->nodeidx, c->half[!dir].nodeidx,
+			     hi - lo, cost, c, dir);
+	}
+}
+
+/* Dijkstra over residual arcs using reduced costs (which the potentials
+ * keep non-negative), stopping once we reach target.  Then update the
+ * potentials so the next call's reduced costs are non-negative too. */
+static bool shortest_path(const struct mcf_graph *g, u32 source, u32 target,
+			  s64 *potential, s64 *dist, u32 *pred, bool *done,
+			  struct heap_entry **heap)
+{
+	size_t num_nodes = tal_count(g->first);
+
+	for (size_t i = 0; i < num_nodes; i++) {
+		dist[i] = INFINITE_COST;
+		pred[i] = NO_ARC;
+		done[i] = false;
+	}
+	tal_resize(heap, 0);
+
+	dist[source] = 0;
+	heap_push(heap, 0, source);
+	while (tal_count(*heap)) {
+		u32 u = heap_pop(heap).node;
+
+		if (done[u])
+			continue;
+		done[u] = true;
+		if (u == target)
+			break;
+
+		for (u32 a = g->first[u]; a != NO_ARC; a = g->arcs[a].next) {
+			const struct mcf_arc *arc = &g->arcs[a];
+			s64 d;
+
+			if (arc->residual == 0 || done[arc->head])
+				continue;
+			d = dist[u] + arc->cost
+				+ potential[u] - potential[arc->head];
+			if (d < dist[arc->head]) {
+				dist[arc->head] = d;
+				pred[arc->head] = a;
+				heap_push(heap, d, arc->head);
+			}
+		}
+	}
+
+	if (!done[target])
+		return false;
+
+	for (size_t i = 0; i < num_nodes; i++)
+		potential[i] += done[i] ? dist[i] : dist[target];
+	return true;
+}
+
+/* Successive shortest paths: returns false if we can't send it all. */
+static bool solve(struct mcf_graph *g, u32 source, u32 target, s64 units)
+{
+	size_t num_nodes = tal_count(g->first);
+	s64 *potential = tal_arrz(tmpctx, s64, num_nodes);
+	s64 *dist = tal_arr(tmpctx, s64, num_nodes);
+	u32 *pred = tal_arr(tmpctx, u32, num_nodes);
+	bool *done = tal_arr(tmpctx, bool, num_nodes);
+	struct heap_entry *heap = tal_arr(tmpctx, struct heap_entry, 0);
+
+	while (units > 0) {
+		s64 flow = units;
+
+		if (!shortest_path(g, source, target, potential, dist, pred,
+				   done, &heap))
+			return false;
+
+		for (u32 v = target; v != source; v = g->arcs[pred[v] ^ 1].head) {
+			if (g->arcs[pred[v]].residual < flow)
+				flow = g->arcs[pred[v]].residual;
+		}
+		for (u32 v = target; v != source; v = g->arcs[pred[v] ^ 1].head) {
+			g->arcs[pred[v]].residual -= flow;
+			g->arcs[pred[v] ^ 1].residual += flow;
+		}
+		units -= flow;
+	}
+	return true;
+}
+
+/* Take a path off the flow, following the largest flow out of each node */
+static bool next_part(const tal_t *ctx, struct mcf_graph *g,
+		      u32 source, u32 target, struct flow_part *part)
+{
+	size_t num_nodes = tal_count(g->first);
+	u32 u = source;
+
+	part->pairs = tal_arr(ctx, u32, 0);
+	part->units = INFINITE_COST;
+	while (u != target) {
+		u32 best = NO_ARC;
+
+		for (u32 a = g->first[u]; a != NO_ARC; a = g->arcs[a].next) {
+			/* Flow is residual on the reverse arc */
+			if (a & 1)
+				continue;
+			if (g->arcs[a ^ 1].residual == 0)
+				continue;
+			if (best == NO_ARC
+			    || g->arcs[a ^ 1].residual > g->arcs[best ^ 1].residual)
+				best = a;
+		}
+		/* No flow left (or, can't happen, a cycle) */
+		if (best == NO_ARC || tal_count(part->pairs) == num_nodes) {
+			part->pairs = tal_free(part->pairs);
+			return false;
+		}
+		tal_arr_expand(&part->pairs, best / 2);
+		if (g->arcs[best ^ 1].residual < part->units)
+			part->units = g->arcs[best ^ 1].residual;
+		u = g->arcs[best].head;
+	}
+
+	for (size_t i = 0; i < tal_count(part->pairs); i++)
+		g->arcs[part->pairs[i] * 2 + 1].residual -= part->units;
+	return true;
+}
+
+/* Different pieces of the same channels give the same path. */
+static bool same_path(const struct mcf_graph *g,
+		      const struct flow_part *a, const struct flow_part *b)
+{
+	if (tal_count(a->pairs) != tal_count(b->pairs))
+		return false;
+	for (size_t i = 0; i < tal_count(a->pairs); i++) {
+		if (g->chans[a->pairs[i]] != g->chans[b->pairs[i]]
+		    || g->dirs[a->pairs[i]] != g->dirs[b->pairs[i]])
+			return false;
+	}
+	return true;
+}
+
+/* Give the units of the paths we dropped to those we kept, as far as their
+ * channels' capacities allow: returns false if they don't. */
+static bool spread_units(const struct gossmap *map,
+			 const struct mcf_graph *g,
+			 struct flow_part *parts, s64 dropped)
+{
+	s64 *room = tal_dup_talarr(tmpctx, s64, g->cap_units);
+
+	for (size_t i = 0; i < tal_count(parts); i++) {
+		for (size_t j = 0; j < tal_count(parts[i].pairs); j++) {
+			u32 pair = parts[i].pairs[j];
+			room[gossmap_chan_idx(map, g->chans[pair]) * 2
+			     + g->dirs[pair]] -= parts[i].units;
+		}
+	}
+
+	/* Biggest first, since they're probably the best paths. */
+	for (size_t i = 0; i < tal_count(parts) && dropped; i++) {
+		s64 add = dropped;
+
+		for (size_t j = 0; j < tal_count(parts[i].pairs); j++) {
+			u32 pair = parts[i].pairs[j];
+			s64 r = room[gossmap_chan_idx(map, g->chans[pair]) * 2
+				     + g->dirs[pair]];
+			if (r < add)
+				add = r;
+		}
+		if (add <= 0)
+			continue;
+
+		for (size_t j = 0; j < tal_count(parts[i].pairs); j++) {
+			u32 pair = parts[i].pairs[j];
+			room[gossmap_chan_idx(map, g->chans[pair]) * 2
+			     + g->dirs[pair]] -= add;
+		}
+		parts[i].units += add;
+		dropped -= add;
+	}
+	return dropped == 0;
+}
+
+static int cmp_units(const struct flow_part *a, const struct flow_part *b,
+		     void *unused)
+{
+	if (a->units > b->units)
+		return -1;
+	return a->units < b->units;
+}
+
+struct mcf_path *min_cost_flow_(const tal_t *ctx,
+				const struct gossmap *map,
+				const struct gossmap_node *source,
+				const struct gossmap_node *target,
+				struct amount_msat amount,
+				u64 mu,
+				size_t max_paths,
+				struct amount_msat (*capacity)(const struct gossmap *map,
+							       const struct gossmap_chan *c,
+							       int dir,
+							       void *arg),
+				void *arg)
+{
+	u64 msat = amount.millisatoshis; /* Raw: lengthy math */
+	u64 unit = (msat + MCF_UNITS - 1) / MCF_UNITS, total_units;
+	u32 src = gossmap_node_idx(map, source);
+	u32 dst = gossmap_node_idx(map, target);
+	struct mcf_graph *g = tal(tmpctx, struct mcf_graph);
+	struct flow_part *parts = tal_arr(tmpctx, struct flow_part, 0);
+	struct flow_part part;
+	struct mcf_path *paths;
+	s64 dropped = 0;
+
+	if (msat == 0 || max_paths == 0)
+		return tal_arr(ctx, struct mcf_path, 0);
+	if (unit == 0)
+		unit = 1;
+	total_units = (msat + unit - 1) / unit;
+
+	g->arcs = tal_arr(g, struct mcf_arc, 0);
+	g->chans = tal_arr(g, struct gossmap_chan *, 0);
+	g->dirs = tal_arr(g, int, 0);
+	g->cap_units = tal_arrz(g, s64, gossmap_max_chan_idx(map) * 2);
+	g->first = tal_arr(g, u32, gossmap_max_node_idx(map));
+	for (size_t i = 0; i < tal_count(g->first); i++)
+		g->first[i] = NO_ARC;
+
+	for (struct gossmap_chan *c = gossmap_first_chan(map);
+	     c;
+	     c = gossmap_next_chan(map, c)) {
+		for (int dir = 0; dir < 2; dir++) {
+			struct amount_msat cap = capacity(map, c, dir, arg);
+			u64 cap_units = cap.millisatoshis / unit; /* Raw: units */
+
+			if (!cap_units)
+				continue;
+			add_channel(g, c, dir, cap_units, total_units,
+				    unit, mu);
+			/* We never send more than the total anyway. */
+			g->cap_units[gossmap_chan_idx(map, c) * 2 + dir]
+				= cap_units < total_units
+				? cap_units : total_units;
+		}
+	}
+
+	if (!solve(g, src, dst, total_units)) {
+		tal_free(g);
+		return NULL;
+	}
+
+	while (next_part(parts, g, src, dst, &part)) {
+		size_t i;
+		for (i = 0; i < tal_count(parts); i++) {
+			if (same_path(g, &parts[i], &part)) {
+				parts[i].units += part.units;
+				break;
+			}
+		}
+		if (i == tal_count(parts))
+			tal_arr_expand(&parts, part);
+	}
+
+	/* Too many?  Drop the smallest, and give their units to the rest if
+	 * they can carry them.  If not, we fail: the caller can ask again
+	 * with more paths, or as smaller amounts. */
+	asort(parts, tal_count(parts), cmp_units, NULL);
+	for (size_t i = max_paths; i < tal_count(parts); i++)
+		dropped += parts[i].units;
+	if (tal_count(parts) > max_paths) {
+		tal_resize(&parts, max_paths);
+		if (!spread_units(map, g, parts, dropped)) {
+			tal_free(g);
+			return NULL;
+		}
+	}
+
+	paths = tal_arr(ctx, struct mcf_path, tal_count(parts));
+	for (size_t i = 0; i < tal_count(parts); i++) {
+		u64 pmsat = parts[i].units * unit;
+
+		/* Rounding comes off the largest (first) part: we rounded
+		 * the total up, by less than a unit. */
+		if (i == 0)
+			pmsat -= total_units * unit - msat;
+		paths[i].amount = amount_msat(pmsat);
+		paths[i].chans = tal_arr(paths, struct gossmap_chan *,
+					 tal_count(parts[i].pairs));
+		paths[i].dirs = tal_arr(paths, int, tal_count(parts[i].pairs));
+		for (size_t j = 0; j < tal_count(parts[i].pairs); j++) {
+			paths[i].chans[j] = g->chans[parts[i].pairs[j]];
+			paths[i].dirs[j] = g->dirs[parts[i].pairs[j]];
+		}
+	}
+	tal_free(g);
+	return paths;
+}
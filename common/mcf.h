@@ -0,0 +1,62 @@
+#ifndef LIGHTNING_COMMON_MCF_H
+#define LIGHTNING_COMMON_MCF_H
+#include "config.h"
+#include <ccan/typesafe_cb/typesafe_cb.h>
+#include <common/amount.h>
+
+struct gossmap;
+struct gossmap_chan;
+struct gossmap_node;
+
+/* One part of a flow found by min_cost_flow. */
+struct mcf_path {
+	/* tal_arr of channels from source to target, and which half of
+	 * each we use (i.e. the sending node is chans[i]->half[dirs[i]]). */
+	struct gossmap_chan **chans;
+	int *dirs;
+	/* What to deliver to the target along this path (not including
+	 * fees). */
+	struct amount_msat amount;
+};
+
+/* Split @amount from @source to @target into at most @max_paths paths.
+ *
+ * We treat the liquidity of each channel direction as uniformly
+ * distributed between 0 and whatever @capacity says it could carry (0
+ * means don't use it), so sending x costs -log2((C+1-x)/(C+1)) (the
+ * uncertainty cost: one bit for each halving of the success probability).
+ * Each bit is weighed as @mu msat of fees, so larger @mu prefers reliable
+ * over cheap.  That's convex, so we piecewise-linearize it and solve the
+ * min cost flow exactly.
+ *
+ * If the flow takes more than @max_paths paths, the smallest are dropped
+ * and their amounts added to the others, as far as their channels can
+ * carry it.
+ *
+ * Returns a tal_arr of paths whose amounts add up to @amount, or NULL if
+ * the channels can't carry @amount, or can't in @max_paths paths. */
+struct mcf_path *min_cost_flow_(const tal_t *ctx,
+				const struct gossmap *map,
+				const struct gossmap_node *source,
+				const struct gossmap_node *target,
+				struct amount_msat amount,
+				u64 mu,
+				size_t max_paths,
+				struct amount_msat (*capacity)(const struct gossmap *map,
+							       const struct gossmap_chan *c,
+							       int dir,
+							       void *arg),
+				void *arg);
+
+#define min_cost_flow(ctx, map, source, target, amount, mu, max_paths,	\
+		      capacity, arg)					\
+	min_cost_flow_((ctx), (map), (source), (target), (amount), (mu), \
+		       (max_paths),					\
+		       typesafe_cb_preargs(struct amount_msat, void *,	\
+					   (capacity), (arg),		\
+					   const struct gossmap *,	\
+					   const struct gossmap_chan *,	\
+					   int),			\
+		       (arg))
+
+#endif /* LIGHTNING_COMMON_MCF_H */
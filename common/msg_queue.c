@@ -4,22 +4,48 @@
 #include <common/utils.h>
 #include <wire/wire.h>
 
+/* Once empty, we shrink back to this. */
+#define MSG_QUEUE_MIN_SIZE 8
+
 struct msg_queue {
 	bool fd_passing;
+	/* Ring buffer: tal_count(q) is a power of 2. */
 	const u8 **q;
+	size_t head, count;
 };
 
 struct msg_queue *msg_queue_new(const tal_t *ctx, bool fd_passing)
 {
 	struct msg_queue *q = tal(ctx, struct msg_queue);
 	q->fd_passing = fd_passing;
-	q->q = tal_arr(q, const u8 *, 0);
+	q->q = tal_arr(q, const u8 *, MSG_QUEUE_MIN_SIZE);
+	q->head = q->count = 0;
 	return q;
 }
 
+static size_t ring_mask(const struct msg_queue *q)
+{
+	return tal_count(q->q) - 1;
+}
+
 static void do_enqueue(struct msg_queue *q, const u8 *add TAKES)
 {
-	tal_arr_expand(&q->q, tal_dup_talarr(q, u8, add));
+	size_t max = tal_count(q->q);
+
+	if (q->count == max) {
+		/* Unwrap into a new array twice the size. */
+		const u8 **newq = tal_arr(q, const u8 *, max * 2);
+		for (size_t i = 0; i < q->count; i++)
+			newq[i] = q->q[(q->head + i) & ring_mask(q)];
+		tal_free(q->q);
+		q->q = newq;
+		q->head = 0;
+	}
+
+	/* If it's taken, this just steals it. */
+	q->q[(q->head + q->count) & ring_mask(q)]
+		= tal_dup_talarr(q, u8, add);
+	q->count++;
 
 	/* In case someone is waiting */
 	io_wake(q);
@@ -27,7 +53,7 @@ static void do_enqueue(struct msg_queue *q, const u8 *add TAKES)
 
 size_t msg_queue_length(const struct msg_queue *q)
 {
-	return tal_count(q->q);
+	return q->count;
 }
 
 void msg_enqueue(struct msg_queue *q, const u8 *add)
@@ -48,18 +74,47 @@ void msg_enqueue_fd(struct msg_queue *q, int fd)
 
 const u8 *msg_dequeue(struct msg_queue *q)
 {
-	size_t n = tal_count(q->q);
 	const u8 *msg;
 
-	if (!n)
+	if (!q->count)
 		return NULL;
 
-	msg = q->q[0];
-	memmove(q->q, q->q + 1, sizeof(*q->q) * (n-1));
-	tal_resize(&q->q, n-1);
+	msg = q->q[q->head];
+	q->head = (q->head + 1) & ring_mask(q);
+	q->count--;
+
+	/* Don't hang onto a huge array after a burst. */
+	if (!q->count) {
+		q->head = 0;
+		if (tal_count(q->q) > MSG_QUEUE_MIN_SIZE)
+			tal_resize(&q->q, MSG_QUEUE_MIN_SIZE);
+	}
 	return msg;
 }
 
+static bool is_fd_msg(const struct msg_queue *q, const u8 *msg)
+{
+	return q->fd_passing && fromwire_peektype(msg) == MSG_PASS_FD;
+}
+
+const u8 **msg_dequeue_many(const tal_t *ctx, struct msg_queue *q, size_t max)
+{
+	const u8 **msgs;
+	size_t n;
+
+	for (n = 0; n < q->count && n < max; n++) {
+		if (is_fd_msg(q, q->q[(q->head + n) & ring_mask(q)]))
+			break;
+	}
+	if (!n)
+		return NULL;
+
+	msgs = tal_arr(ctx, const u8 *, n);
+	for (size_t i = 0; i < n; i++)
+		msgs[i] = tal_steal(msgs, msg_dequeue(q));
+	return msgs;
+}
+
 int msg_extract_fd(const struct msg_queue *q, const u8 *msg)
 {
 	const u8 *p = msg + sizeof(u16);
@@ -12,7 +12,8 @@
  * we can pass fds.  Otherwise, set @fd_passing to false. */
 struct msg_queue *msg_queue_new(const tal_t *ctx, bool fd_passing);
 
-/* If add is taken(), freed after sending.  msg_wake() implied. */
+/* If add is taken(), it's not copied, and freed after sending.
+ * msg_wake() implied. */
 void msg_enqueue(struct msg_queue *q, const u8 *add TAKES);
 
 /* Get current queue length */
@@ -27,6 +28,10 @@ void msg_wake(const struct msg_queue *q);
 /* Returns NULL if nothing to do. */
 const u8 *msg_dequeue(struct msg_queue *q);
 
+/* Up to @max msgs (stopping before any fd), allocated off the returned
+ * array, which is allocated off @ctx.  Returns NULL if none. */
+const u8 **msg_dequeue_many(const tal_t *ctx, struct msg_queue *q, size_t max);
+
 /* Returns -1 if not an fd: close after sending. */
 int msg_extract_fd(const struct msg_queue *q, const u8 *msg);
 
@@ -135,3 +135,41 @@ struct route_hop *route_from_dijkstra(const tal_t *ctx,
 
 	return hops;
 }
+
+struct route_hop *route_from_chans(const tal_t *ctx,
+				   const struct gossmap *map,
+				   struct gossmap_chan **chans,
+				   const int *dirs,
+				   struct amount_msat final_amount,
+				   u32 final_cltv)
+{
+	struct route_hop *hops = tal_arr(ctx, struct route_hop,
+					 tal_count(chans));
+
+	/* Work backwards, adding fees and delays as we go. */
+	for (size_t i = tal_count(chans); i > 0; i--) {
+		struct route_hop *hop = &hops[i - 1];
+		const struct gossmap_chan *c = chans[i - 1];
+		const struct half_chan *h;
+
+		if (!gossmap_chan_set(c, dirs[i - 1]))
+			return tal_free(hops);
+
+		hop->direction = dirs[i - 1];
+		hop->scid = gossmap_chan_scid(map, c);
+		gossmap_node_get_id(map,
+				    gossmap_nth_node(map, c, !hop->direction),
+				    &hop->node_id);
+		hop->blinding = NULL;
+		hop->enctlv = NULL;
+		hop->amount = final_amount;
+		hop->delay = final_cltv;
+
+		h = &c->half[hop->direction];
+		if (!amount_msat_add_fee(&final_amount,
+					 h->base_fee, h->proportional_fee))
+			return tal_free(hops);
+		final_cltv += h->delay;
+	}
+	return hops;
+}
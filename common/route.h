@@ -68,6 +68,15 @@ struct route_hop *route_from_dijkstra(const tal_t *ctx,
 				      struct amount_msat final_amount,
 				      u32 final_cltv);
 
+/* Route tal_arr along @chans (from the source), using half @dirs[i] of
+ * each: NULL if one has no channel_update. */
+struct route_hop *route_from_chans(const tal_t *ctx,
+				   const struct gossmap *map,
+				   struct gossmap_chan **chans,
+				   const int *dirs,
+				   struct amount_msat final_amount,
+				   u32 final_cltv);
+
 /*
  * Manually exlude nodes or channels from a route.
  * Used with `getroute` and `pay` commands
@@ -706,6 +706,22 @@ int main(int argc, char *argv[])
 	assert(!bolt11_decode(tmpctx, "lnbc1pvjluezpp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqdqcgfskggz423rz6wp6yrc2pgpqcqpjmyveg8ccprmlssyae9l33an2m0qz3qcfcavt7wdzrdqyx5q7hqmp7ne08uvwlwaaqwt4lxgmjh5gce3hv0m8tzwkzfshpdv9d5p9pcsp5v86r0", NULL, NULL, NULL, &fail));
 	assert(streq(fail, "d: invalid utf8"));
 
+	/* Decoding it again uses the signature cache... */
+	badstr = "lnbc1pvjluezsp5zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zygspp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqdpl2pkx2ctnv5sxxmmwwd5kgetjypeh2ursdae8g6twvus8g6rfwvs8qun0dfjkxaq9qrsgq357wnc5r2ueh7ck6q93dj32dlqnls087fxdwk8qakdyafkq3yap9us6v52vjjsrvywa6rt52cm9r9zqt8r2t7mlcwspyetp5h2tztugp9lfyql";
+	b11 = bolt11_decode(tmpctx, badstr, NULL, NULL, NULL, &fail);
+	assert(node_id_eq(&b11->receiver_id, &node));
+	for (size_t i = 0; i < ARRAY_SIZE(sig_cache); i++) {
+		if (node_id_eq(&sig_cache[i].signer, &node))
+			sig_cache[i].signer.k[1] ^= 1;
+	}
+	b11 = bolt11_decode(tmpctx, badstr, NULL, NULL, NULL, &fail);
+	assert(!node_id_eq(&b11->receiver_id, &node));
+
+	/* Once forgotten, we recover the real signer again. */
+	memset(sig_cache, 0, sizeof(sig_cache));
+	b11 = bolt11_decode(tmpctx, badstr, NULL, NULL, NULL, &fail);
+	assert(node_id_eq(&b11->receiver_id, &node));
+
 	/* FIXME: Test the others! */
 	common_shutdown();
 }
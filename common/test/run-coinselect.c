@@ -0,0 +1,99 @@
+#include "config.h"
+#include <assert.h>
+#include <common/coinselect.h>
+#include <common/pseudorand.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* AUTOGENERATED MOCKS END */
+
+static struct amount_sat *values(const tal_t *ctx, size_t n, const u64 *sats)
+{
+	struct amount_sat *v = tal_arr(ctx, struct amount_sat, n);
+	for (size_t i = 0; i < n; i++)
+		v[i] = amount_sat(sats[i]);
+	return v;
+}
+
+static u64 selected_total(const struct amount_sat *effective,
+			  const size_t *sel)
+{
+	u64 total = 0;
+	for (size_t i = 0; i < tal_count(sel); i++)
+		total += effective[sel[i]].satoshis; /* Raw: test */
+	return total;
+}
+
+int main(int argc, char *argv[])
+{
+	struct amount_sat *v;
+	size_t *sel;
+
+	common_setup(argv[0]);
+
+	/* 50+10 and 30+20+10 are both exact: prefer fewer inputs. */
+	v = values(tmpctx, 4, (u64[]){ 10, 20, 30, 50 });
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(60), AMOUNT_SAT(0));
+	assert(tal_count(sel) == 2);
+	assert(selected_total(v, sel) == 60);
+
+	/* Within cost_of_change is good enough for branch-and-bound. */
+	v = values(tmpctx, 2, (u64[]){ 100, 40 });
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(35), AMOUNT_SAT(10));
+	assert(tal_count(sel) == 1);
+	assert(sel[0] == 1);
+
+	/* Otherwise, knapsack takes the smallest larger one. */
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(35), AMOUNT_SAT(0));
+	assert(tal_count(sel) == 1);
+	assert(sel[0] == 1);
+
+	/* Or adds up smaller ones. */
+	v = values(tmpctx, 3, (u64[]){ 7, 7, 7 });
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(20), AMOUNT_SAT(0));
+	assert(tal_count(sel) == 3);
+
+	/* Worthless ones are ignored. */
+	v = values(tmpctx, 2, (u64[]){ 0, 10 });
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(10), AMOUNT_SAT(0));
+	assert(tal_count(sel) == 1);
+	assert(sel[0] == 1);
+
+	/* Not enough. */
+	v = values(tmpctx, 2, (u64[]){ 5, 5 });
+	assert(!coinselect(tmpctx, v, AMOUNT_SAT(11), AMOUNT_SAT(0)));
+
+	/* Nothing to do. */
+	sel = coinselect(tmpctx, v, AMOUNT_SAT(0), AMOUNT_SAT(0));
+	assert(tal_count(sel) == 0);
+
+	/* Random wallets: always enough if possible, never twice the same. */
+	for (size_t i = 0; i < 20; i++) {
+		size_t n = 1 + pseudorand(200);
+		u64 total = 0, target;
+
+		v = tal_arr(tmpctx, struct amount_sat, n);
+		for (size_t j = 0; j < n; j++) {
+			v[j] = amount_sat(pseudorand(1000000));
+			total += v[j].satoshis; /* Raw: test */
+		}
+		target = pseudorand(total + total / 10 + 1);
+		sel = coinselect(tmpctx, v, amount_sat(target),
+				 AMOUNT_SAT(1000));
+		if (target > total) {
+			assert(!sel);
+			continue;
+		}
+		assert(sel);
+		assert(selected_total(v, sel) >= target);
+		for (size_t j = 0; j < tal_count(sel); j++) {
+			for (size_t k = j + 1; k < tal_count(sel); k++)
+				assert(sel[j] != sel[k]);
+		}
+	}
+
+	common_shutdown();
+	return 0;
+}
@@ -126,7 +126,7 @@ static void check_result(const u8 *msg, const char *hex)
 
 int main(int argc, char *argv[])
 {
-	struct crypto_state cs_out, cs_in;
+	struct crypto_state cs_out, cs_in, cs_out2, cs_in2;
 	struct secret sk, rk, ck;
 	const void *msg;
 	size_t i;
@@ -153,13 +153,21 @@ int main(int argc, char *argv[])
 	cs_out.sk = cs_in.rk = sk;
 	cs_out.rk = cs_in.sk = rk;
 	cs_out.s_ck = cs_out.r_ck = cs_in.s_ck = cs_in.r_ck = ck;
+	/* These use the in-place API: results must be identical. */
+	cs_out2 = cs_out;
+	cs_in2 = cs_in;
 
 	for (i = 0; i < 1002; i++) {
-		u8 *dec, *enc;
+		u8 *dec, *enc, *buf;
 		u16 len;
 
 		enc = cryptomsg_encrypt_msg(tmpctx, &cs_out, msg);
 
+		buf = tal_arr(tmpctx, u8, tal_bytelen(enc));
+		memcpy(buf + CRYPTOMSG_HDR_SIZE, msg, tal_bytelen(msg));
+		cryptomsg_encrypt_inplace(&cs_out2, buf, tal_bytelen(msg));
+		assert(memeq(buf, tal_bytelen(buf), enc, tal_bytelen(enc)));
+
 		/* BOLT #8:
 		 *
 		 *  output 0: 0xcf2b30ddf0cf3f80e7c35a6e6730b59fe802473180f396d88a8fb0db8cbcf25d2f214cf9ea1d95
@@ -203,6 +211,16 @@ int main(int argc, char *argv[])
 
 		dec = cryptomsg_decrypt_body(enc, &cs_in, enc);
 		assert(memeq(dec, tal_bytelen(dec), msg, tal_bytelen(msg)));
+
+		if (!cryptomsg_decrypt_header(&cs_in2, buf, &len))
+			abort();
+		assert(len == tal_bytelen(msg));
+		if (!cryptomsg_decrypt_body_inplace(&cs_in2,
+						    buf + CRYPTOMSG_HDR_SIZE,
+						    len + CRYPTOMSG_BODY_OVERHEAD))
+			abort();
+		assert(memeq(buf + CRYPTOMSG_HDR_SIZE, len,
+			     msg, tal_bytelen(msg)));
 	}
 	common_shutdown();
 	return 0;
@@ -0,0 +1,149 @@
+#include "config.h"
+#include "../daemon_conn.c"
+#include "../msg_queue.c"
+#include "../../wire/wire_io.c"
+#include "../../wire/wire_sync.c"
+#include <ccan/array_size/array_size.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/socket.h>
+
+/* AUTOGENERATED MOCKS START */
+/* AUTOGENERATED MOCKS END */
+
+/* Messages are this many bytes, cycling, like gossip. */
+static const size_t msg_sizes[] = { 2, 3, 100, 2, 300, 150, 2, 7 };
+
+static u8 *make_msg(const tal_t *ctx, size_t i)
+{
+	size_t len = msg_sizes[i % ARRAY_SIZE(msg_sizes)];
+	u8 *msg;
+
+	/* Occasional one won't fit in the socket buffer: partial writes. */
+	if (i % 500 == 499)
+		len = 300000;
+	msg = tal_arr(ctx, u8, len);
+	for (size_t j = 0; j < len; j++)
+		msg[j] = i + j;
+	return msg;
+}
+
+struct test_state {
+	struct daemon_conn *dc;
+	size_t num, sent, received, batch;
+	u8 *in;
+};
+
+static void refill(struct test_state *ts)
+{
+	/* Queue a batch at a time, like gossipd does when streaming. */
+	for (size_t i = 0; i < ts->batch && ts->sent < ts->num; i++)
+		daemon_conn_send(ts->dc, take(make_msg(NULL, ts->sent++)));
+}
+
+static struct io_plan *never_recv(struct io_conn *conn, const u8 *msg,
+				  struct test_state *ts)
+{
+	abort();
+}
+
+static struct io_plan *read_one(struct io_conn *conn, struct test_state *ts);
+
+static struct io_plan *check_one(struct io_conn *conn, struct test_state *ts)
+{
+	u8 *expect = make_msg(tmpctx, ts->received);
+
+	assert(tal_bytelen(ts->in) == tal_bytelen(expect));
+	assert(memeq(ts->in, tal_bytelen(ts->in), expect, tal_bytelen(expect)));
+	tal_free(expect);
+	ts->in = tal_free(ts->in);
+	if (++ts->received == ts->num) {
+		io_break(ts);
+		return io_close(conn);
+	}
+	return read_one(conn, ts);
+}
+
+static struct io_plan *read_one(struct io_conn *conn, struct test_state *ts)
+{
+	return io_read_wire(conn, conn, &ts->in, check_one, ts);
+}
+
+static void test_ring(void)
+{
+	struct msg_queue *q = msg_queue_new(tmpctx, true);
+	const u8 **msgs;
+	size_t next_in = 0, next_out = 0;
+
+	/* Move head along, then wrap and grow. */
+	for (size_t i = 0; i < 5; i++)
+		msg_enqueue(q, take(make_msg(NULL, next_in++)));
+	for (size_t i = 0; i < 3; i++)
+		tal_free(msg_dequeue(q));
+	next_out = 3;
+	for (size_t i = 0; i < 20; i++)
+		msg_enqueue(q, take(make_msg(NULL, next_in++)));
+	msg_enqueue_fd(q, 7);
+	msg_enqueue(q, take(make_msg(NULL, next_in++)));
+	assert(msg_queue_length(q) == 2 + 20 + 1 + 1);
+
+	/* Stops before the fd. */
+	msgs = msg_dequeue_many(tmpctx, q, 1000);
+	assert(tal_count(msgs) == 22);
+	for (size_t i = 0; i < tal_count(msgs); i++) {
+		u8 *expect = make_msg(tmpctx, next_out++);
+		assert(tal_parent(msgs[i]) == msgs);
+		assert(memeq(msgs[i], tal_bytelen(msgs[i]),
+			     expect, tal_bytelen(expect)));
+	}
+	assert(msg_dequeue_many(tmpctx, q, 1000) == NULL);
+	assert(msg_extract_fd(q, msg_dequeue(q)) == 7);
+
+	/* Respects max */
+	msgs = msg_dequeue_many(tmpctx, q, 0);
+	assert(msgs == NULL);
+	msgs = msg_dequeue_many(tmpctx, q, 1);
+	assert(tal_count(msgs) == 1);
+	assert(msg_queue_length(q) == 0);
+	assert(msg_dequeue(q) == NULL);
+	assert(tal_count(q->q) == MSG_QUEUE_MIN_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct test_state ts;
+	int fds[2];
+	struct timemono start;
+
+	common_setup(argv[0]);
+
+	test_ring();
+
+	/* With arguments, this is a benchmark: "num [batchsize]". */
+	ts.num = argc > 1 ? atol(argv[1]) : 1000;
+	ts.batch = argc > 2 ? atol(argv[2]) : 100;
+	ts.sent = ts.received = 0;
+	ts.in = NULL;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		abort();
+	ts.dc = daemon_conn_new(tmpctx, fds[0], never_recv, refill, &ts);
+	io_new_conn(tmpctx, fds[1], read_one, &ts);
+	/* outq_empty isn't called until we've sent something. */
+	refill(&ts);
+
+	start = time_mono();
+	assert(io_loop(NULL, NULL) == &ts);
+	assert(ts.sent == ts.num);
+
+	if (argc > 1)
+		printf("%zu msgs in %"PRIu64" usec\n",
+		       ts.num,
+		       time_to_usec(timemono_since(start)));
+
+	tal_free(ts.dc);
+	common_shutdown();
+	return 0;
+}
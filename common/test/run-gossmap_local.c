@@ -286,11 +286,62 @@ static void check_nannounce(const u8 *nannounce,
 	assert(node_id_eq(&node_id, n));
 }
 
+/* Same nodes and channels, with the same values */
+static void check_same(const struct gossmap *map1, const struct gossmap *map2)
+{
+	struct node_id id;
+	struct short_channel_id scid;
+
+	assert(gossmap_num_nodes(map1) == gossmap_num_nodes(map2));
+	assert(gossmap_num_chans(map1) == gossmap_num_chans(map2));
+
+	for (struct gossmap_node *n = gossmap_first_node(map1);
+	     n;
+	     n = gossmap_next_node(map1, n)) {
+		struct gossmap_node *n2;
+
+		gossmap_node_get_id(map1, n, &id);
+		n2 = gossmap_find_node(map2, &id);
+		assert(n2);
+		assert(n2->num_chans == n->num_chans);
+		assert(n2->nann_off == n->nann_off);
+	}
+
+	for (struct gossmap_chan *c = gossmap_first_chan(map1);
+	     c;
+	     c = gossmap_next_chan(map1, c)) {
+		struct gossmap_chan *c2;
+
+		scid = gossmap_chan_scid(map1, c);
+		c2 = gossmap_find_chan(map2, &scid);
+		assert(c2);
+		assert(c2->cann_off == c->cann_off);
+		assert(c2->private == c->private);
+		for (size_t h = 0; h < 2; h++) {
+			struct node_id id2;
+
+			assert(c2->cupdate_off[h] == c->cupdate_off[h]);
+			assert(c2->half[h].enabled == c->half[h].enabled);
+			assert(c2->half[h].htlc_min == c->half[h].htlc_min);
+			assert(c2->half[h].htlc_max == c->half[h].htlc_max);
+			assert(c2->half[h].base_fee == c->half[h].base_fee);
+			assert(c2->half[h].proportional_fee
+			       == c->half[h].proportional_fee);
+			assert(c2->half[h].delay == c->half[h].delay);
+			gossmap_node_get_id(map1, gossmap_nth_node(map1, c, h),
+					    &id);
+			gossmap_node_get_id(map2, gossmap_nth_node(map2, c2, h),
+					    &id2);
+			assert(node_id_eq(&id, &id2));
+		}
+	}
+}
+
 int main(int argc, char *argv[])
 {
-	int fd;
-	char *gossfile;
-	struct gossmap *map;
+	int fd, fd2;
+	char *gossfile, *gossfile2;
+	struct gossmap *map, *map2;
 	struct node_id l1, l2, l3, l4;
 	struct short_channel_id scid23, scid12, scid_local;
 	struct gossmap_chan *chan;
@@ -499,5 +550,36 @@ int main(int argc, char *argv[])
 	/* Now we can refresh. */
 	assert(write(fd, "", 1) == 1);
 	gossmap_refresh(map, NULL);
+
+	/* An index gives us the same map, without parsing the store. */
+	assert(!map->idx_mmap);
+	assert(gossmap_write_index(map));
+	map2 = gossmap_load(tmpctx, gossfile, NULL);
+	assert(map2);
+	assert(map2->idx_mmap);
+	assert(map2->map_end == map->map_end);
+	check_same(map, map2);
+
+	/* Local mods work on it too (this grows the arrays out of it). */
+	mods = gossmap_localmods_new(tmpctx);
+	assert(gossmap_local_addchan(mods, &l1, &l4, &scid_local, NULL));
+	gossmap_apply_localmods(map2, mods);
+	assert(gossmap_find_node(map2, &l4));
+	assert(gossmap_find_chan(map2, &scid_local));
+	gossmap_remove_localmods(map2, mods);
+	assert(!gossmap_find_node(map2, &l4));
+	check_same(map, map2);
+	tal_free(map2);
+
+	/* A different store with the same name doesn't use it. */
+	fd2 = tmpdir_mkstemp(tmpctx, "run-gossip_local.XXXXXX", &gossfile2);
+	assert(write_all(fd2, canned_map, sizeof(canned_map)));
+	assert(rename(gossfile2, gossfile) == 0);
+	map2 = gossmap_load(tmpctx, gossfile, NULL);
+	assert(map2);
+	assert(!map2->idx_mmap);
+	check_same(map, map2);
+
+	unlink(tal_fmt(tmpctx, "%s"GOSSMAP_INDEX_SUFFIX, gossfile));
 	common_shutdown();
 }
@@ -0,0 +1,96 @@
+#include "config.h"
+#include "../json_validate.c"
+#include <assert.h>
+#include <ccan/array_size/array_size.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* AUTOGENERATED MOCKS END */
+
+static bool validate(const char *str, size_t split)
+{
+	struct json_validator v;
+
+	json_validator_init(&v);
+	return json_validate(&v, str, split)
+		&& json_validate(&v, str + split, strlen(str) - split)
+		&& json_validate_done(&v);
+}
+
+/* Same answer, wherever it's split. */
+static bool validate_all_splits(const char *str)
+{
+	bool ret = validate(str, 0);
+
+	for (size_t i = 1; i <= strlen(str); i++)
+		assert(validate(str, i) == ret);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *good[] = {
+		"{}",
+		"[]",
+		" { } ",
+		"0",
+		"-0.5e+10",
+		"1E9",
+		"true",
+		"null",
+		"\"\"",
+		"\"\\u00e9\\n\\\"\"",
+		"\"caf\xc3\xa9\"",
+		"{\"a\":[1,2,{\"b\":false}],\"c\":\"d\"}",
+		"[[[[[]]]]]",
+		"{\"result\":{\"id\":\"02eec7245d6b7d2ccb30380bfbe2a3648cd7a942653f5aa340edcea1f283686619\",\"num_peers\":0,\"fees_collected_msat\":\"0msat\"}}",
+	};
+	const char *bad[] = {
+		"",
+		"{",
+		"}",
+		"{]",
+		"[1,]",
+		"{\"a\":1,}",
+		"{\"a\" 1}",
+		"{1:2}",
+		"[1 2]",
+		"01",
+		"-",
+		"1.",
+		"1e",
+		".5",
+		"tru",
+		"nul",
+		"\"unterminated",
+		"\"\\x\"",
+		"\"\\u12g4\"",
+		"\"tab\there\"",
+		"\"bad\xc3\"",
+		"\"overlong\xc0\x80\"",
+		"{} {}",
+		"[1]]",
+	};
+	char deep[JSON_VALIDATE_MAX_DEPTH * 2 + 3];
+
+	common_setup(argv[0]);
+
+	for (size_t i = 0; i < ARRAY_SIZE(good); i++)
+		assert(validate_all_splits(good[i]));
+	for (size_t i = 0; i < ARRAY_SIZE(bad); i++)
+		assert(!validate_all_splits(bad[i]));
+
+	/* Too deep for us. */
+	memset(deep, '[', JSON_VALIDATE_MAX_DEPTH + 1);
+	memset(deep + JSON_VALIDATE_MAX_DEPTH + 1, ']',
+	       JSON_VALIDATE_MAX_DEPTH + 1);
+	deep[JSON_VALIDATE_MAX_DEPTH * 2 + 2] = '\0';
+	assert(!validate_all_splits(deep));
+	deep[JSON_VALIDATE_MAX_DEPTH * 2 + 1] = '\0';
+	assert(validate_all_splits(deep + 1));
+
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,292 @@
+#include "config.h"
+#include <assert.h>
+#include <bitcoin/chainparams.h>
+#include <common/fp16.h>
+#include <common/gossip_store.h>
+#include <common/gossmap.h>
+#include <common/mcf.h>
+#include <common/route.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <wire/peer_wiregen.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_bigsize */
+bigsize_t fromwire_bigsize(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_bigsize called!\n"); abort(); }
+/* Generated stub for fromwire_channel_id */
+bool fromwire_channel_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
+			 struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_channel_id called!\n"); abort(); }
+/* Generated stub for fromwire_tlv */
+bool fromwire_tlv(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
+		  const struct tlv_record_type *types UNNEEDED, size_t num_types UNNEEDED,
+		  void *record UNNEEDED, struct tlv_field **fields UNNEEDED,
+		  const u64 *extra_types UNNEEDED, size_t *err_off UNNEEDED, u64 *err_type UNNEEDED)
+{ fprintf(stderr, "fromwire_tlv called!\n"); abort(); }
+/* Generated stub for towire_bigsize */
+void towire_bigsize(u8 **pptr UNNEEDED, const bigsize_t val UNNEEDED)
+{ fprintf(stderr, "towire_bigsize called!\n"); abort(); }
+/* Generated stub for towire_channel_id */
+void towire_channel_id(u8 **pptr UNNEEDED, const struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "towire_channel_id called!\n"); abort(); }
+/* Generated stub for towire_tlv */
+void towire_tlv(u8 **pptr UNNEEDED,
+		const struct tlv_record_type *types UNNEEDED, size_t num_types UNNEEDED,
+		const void *record UNNEEDED)
+{ fprintf(stderr, "towire_tlv called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static void write_to_store(int store_fd, const u8 *msg)
+{
+	struct gossip_hdr hdr;
+
+	hdr.len = cpu_to_be32(tal_count(msg));
+	/* We don't actually check these! */
+	hdr.crc = 0;
+	hdr.timestamp = 0;
+	assert(write(store_fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+	assert(write(store_fd, msg, tal_count(msg)) == tal_count(msg));
+}
+
+static void update_connection(int store_fd,
+			      const struct node_id *from,
+			      const struct node_id *to,
+			      const struct short_channel_id *scid,
+			      u32 base_fee, s32 proportional_fee,
+			      struct amount_msat htlc_max)
+{
+	secp256k1_ecdsa_signature dummy_sig;
+	u8 *msg;
+
+	/* So valgrind doesn't complain */
+	memset(&dummy_sig, 0, sizeof(dummy_sig));
+
+	msg = towire_channel_update_option_channel_htlc_max(tmpctx,
+							    &dummy_sig,
+							    &chainparams->genesis_blockhash,
+							    scid, 0,
+							    ROUTING_OPT_HTLC_MAX_MSAT,
+							    node_id_idx(from, to),
+							    6,
+							    AMOUNT_MSAT(0),
+							    base_fee,
+							    proportional_fee,
+							    htlc_max);
+	write_to_store(store_fd, msg);
+}
+
+/* Both directions have the same capacity and fees. */
+static void add_connection(int store_fd,
+			   const struct node_id *from,
+			   const struct node_id *to,
+			   u32 base_fee, s32 proportional_fee,
+			   struct amount_msat htlc_max)
+{
+	struct short_channel_id scid;
+	secp256k1_ecdsa_signature dummy_sig;
+	struct secret not_a_secret;
+	struct pubkey dummy_key;
+	u8 *msg;
+	const struct node_id *ids[2];
+
+	/* So valgrind doesn't complain */
+	memset(&dummy_sig, 0, sizeof(dummy_sig));
+	memset(&not_a_secret, 1, sizeof(not_a_secret));
+	pubkey_from_secret(&not_a_secret, &dummy_key);
+
+	/* Make a unique scid. */
+	memcpy(&scid, from, sizeof(scid) / 2);
+	memcpy((char *)&scid + sizeof(scid) / 2, to, sizeof(scid) / 2);
+
+	if (node_id_cmp(from, to) > 0) {
+		ids[0] = to;
+		ids[1] = from;
+	} else {
+		ids[0] = from;
+		ids[1] = to;
+	}
+	msg = towire_channel_announcement(tmpctx, &dummy_sig, &dummy_sig,
+					  &dummy_sig, &dummy_sig,
+					  /* features */ NULL,
+					  &chainparams->genesis_blockhash,
+					  &scid,
+					  ids[0], ids[1],
+					  &dummy_key, &dummy_key);
+	write_to_store(store_fd, msg);
+
+	update_connection(store_fd, from, to, &scid,
+			  base_fee, proportional_fee, htlc_max);
+	update_connection(store_fd, to, from, &scid,
+			  base_fee, proportional_fee, htlc_max);
+}
+
+static void node_id_from_privkey(const struct privkey *p, struct node_id *id)
+{
+	struct pubkey k;
+	pubkey_from_privkey(p, &k);
+	node_id_from_pubkey(id, &k);
+}
+
+/* We don't have capacities in the store, so use htlc_maximum_msat */
+static struct amount_msat htlc_max_capacity(const struct gossmap *map,
+					    const struct gossmap_chan *c,
+					    int dir,
+					    void *unused)
+{
+	if (!gossmap_chan_set(c, dir) || !c->half[dir].enabled)
+		return AMOUNT_MSAT(0);
+	return amount_msat(fp16_to_u64(c->half[dir].htlc_max));
+}
+
+/* Paths must go from src to dst, and add up to amount. */
+static void check_paths(const struct gossmap *map,
+			const struct mcf_path *paths,
+			const struct gossmap_node *src,
+			const struct gossmap_node *dst,
+			struct amount_msat amount)
+{
+	struct amount_msat total = AMOUNT_MSAT(0);
+
+	for (size_t i = 0; i < tal_count(paths); i++) {
+		u32 idx = gossmap_node_idx(map, src);
+
+		assert(tal_count(paths[i].chans) == tal_count(paths[i].dirs));
+		for (size_t j = 0; j < tal_count(paths[i].chans); j++) {
+			const struct gossmap_chan *c = paths[i].chans[j];
+			int dir = paths[i].dirs[j];
+
+			assert(c->half[dir].nodeidx == idx);
+			assert(amount_msat_less_eq(paths[i].amount,
+						   htlc_max_capacity(map, c, dir,
+								     NULL)));
+			idx = c->half[!dir].nodeidx;
+		}
+		assert(idx == gossmap_node_idx(map, dst));
+		assert(amount_msat_add(&total, total, paths[i].amount));
+	}
+	assert(amount_msat_eq(total, amount));
+}
+
+int main(int argc, char *argv[])
+{
+	struct node_id a, b, c;
+	struct gossmap_node *a_node, *b_node, *c_node;
+	struct privkey tmp;
+	struct mcf_path *paths;
+	struct route_hop *route;
+	int store_fd;
+	struct gossmap *gossmap;
+	char gossip_version = GOSSIP_STORE_VERSION;
+	char *gossipfilename;
+
+	common_setup(argv[0]);
+	chainparams = chainparams_for_network("regtest");
+
+	store_fd = tmpdir_mkstemp(tmpctx, "run-mcf-gossipstore.XXXXXX",
+				  &gossipfilename);
+	assert(write(store_fd, &gossip_version, sizeof(gossip_version))
+	       == sizeof(gossip_version));
+
+	memset(&tmp, 'a', sizeof(tmp));
+	node_id_from_privkey(&tmp, &a);
+	memset(&tmp, 'b', sizeof(tmp));
+	node_id_from_privkey(&tmp, &b);
+	memset(&tmp, 'c', sizeof(tmp));
+	node_id_from_privkey(&tmp, &c);
+
+	/* A<->B directly, and A<->C<->B which costs more. */
+	add_connection(store_fd, &a, &b, 0, 0, AMOUNT_MSAT(6000000));
+	add_connection(store_fd, &a, &c, 1, 10, AMOUNT_MSAT(5000000));
+	add_connection(store_fd, &c, &b, 1, 10, AMOUNT_MSAT(5000000));
+
+	gossmap = gossmap_load(tmpctx, gossipfilename, NULL);
+	a_node = gossmap_find_node(gossmap, &a);
+	b_node = gossmap_find_node(gossmap, &b);
+	c_node = gossmap_find_node(gossmap, &c);
+	assert(a_node && b_node && c_node);
+
+	/* Small amounts take the cheap direct path. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(100000), 1000, 16,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 1);
+	assert(tal_count(paths[0].chans) == 1);
+	check_paths(gossmap, paths, a_node, b_node, AMOUNT_MSAT(100000));
+
+	/* Needs both. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(10000000), 1000, 16,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 2);
+	check_paths(gossmap, paths, a_node, b_node, AMOUNT_MSAT(10000000));
+
+	/* Limited to one part, which can't carry it all. */
+	assert(!min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(10000000), 1000, 1,
+			      htlc_max_capacity, NULL));
+
+	/* Limited to one part, the rest gets squeezed into it if it fits. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(5500000), 1000000, 1,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 1);
+	assert(tal_count(paths[0].chans) == 1);
+	check_paths(gossmap, paths, a_node, b_node, AMOUNT_MSAT(5500000));
+
+	/* If we only care about fees, the direct path can take it all... */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(5500000), 1, 16,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 1);
+	check_paths(gossmap, paths, a_node, b_node, AMOUNT_MSAT(5500000));
+
+	/* ... but it's unlikely to succeed, so caring about that sends some
+	 * the expensive way. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(5500000), 1000000, 16,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 2);
+	check_paths(gossmap, paths, a_node, b_node, AMOUNT_MSAT(5500000));
+
+	/* Too much! */
+	assert(!min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(12000000), 1000, 16,
+			      htlc_max_capacity, NULL));
+
+	/* Nothing to do. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(0), 1000, 16,
+			      htlc_max_capacity, NULL);
+	assert(tal_count(paths) == 0);
+
+	/* Route along A->C->B: C takes 1msat + 10ppm. */
+	paths = min_cost_flow(tmpctx, gossmap, a_node, b_node,
+			      AMOUNT_MSAT(10000000), 1000, 16,
+			      htlc_max_capacity, NULL);
+	for (size_t i = 0; i < tal_count(paths); i++) {
+		struct amount_msat expect = paths[i].amount;
+
+		route = route_from_chans(tmpctx, gossmap, paths[i].chans,
+					 paths[i].dirs, paths[i].amount, 10);
+		assert(route);
+		assert(tal_count(route) == tal_count(paths[i].chans));
+		assert(node_id_eq(&route[tal_count(route) - 1].node_id, &b));
+		assert(amount_msat_eq(route[tal_count(route) - 1].amount,
+				      paths[i].amount));
+		assert(route[tal_count(route) - 1].delay == 10);
+		if (tal_count(route) == 1)
+			continue;
+
+		assert(node_id_eq(&route[0].node_id, &c));
+		assert(amount_msat_add_fee(&expect, 1, 10));
+		assert(amount_msat_eq(route[0].amount, expect));
+		assert(route[0].delay == 16);
+	}
+
+	tal_free(gossmap);
+	common_shutdown();
+	return 0;
+}
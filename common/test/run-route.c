@@ -9,6 +9,7 @@
 #include <common/type_to_string.h>
 #include <common/utils.h>
 #include <bitcoin/chainparams.h>
+#include <ccan/array_size/array_size.h>
 #include <stdio.h>
 #include <wire/peer_wiregen.h>
 #include <unistd.h>
@@ -164,6 +165,48 @@ static void node_id_from_privkey(const struct privkey *p, struct node_id *id)
 	node_id_from_pubkey(id, &k);
 }
 
+struct batch_check {
+	const struct gossmap *map;
+	const struct gossmap_node *src, *dst;
+	struct amount_msat amount;
+	bool done;
+};
+
+static void check_batch_route(const struct dijkstra *dij, struct batch_check *bc)
+{
+	const struct dijkstra *single;
+	struct route_hop *r1, *r2;
+
+	single = dijkstra(tmpctx, bc->map, bc->dst, bc->amount, 1.0,
+			  route_can_carry_unless_disabled,
+			  route_score_cheaper, NULL);
+	r1 = route_from_dijkstra(tmpctx, bc->map, single, bc->src,
+				 bc->amount, 10);
+	r2 = route_from_dijkstra(tmpctx, bc->map, dij, bc->src,
+				 bc->amount, 10);
+	assert(r1 && r2);
+	assert(tal_count(r1) == tal_count(r2));
+	for (size_t i = 0; i < tal_count(r1); i++) {
+		assert(short_channel_id_eq(&r1[i].scid, &r2[i].scid));
+		assert(amount_msat_eq(r1[i].amount, r2[i].amount));
+	}
+	bc->done = true;
+}
+
+static bool batch_can_carry(const struct gossmap *map,
+			    const struct gossmap_chan *c,
+			    int dir,
+			    struct amount_msat amount,
+			    void *arg)
+{
+	return route_can_carry_unless_disabled(map, c, dir, amount, NULL);
+}
+
+static void batch_done(const struct dijkstra *dij, void *arg)
+{
+	check_batch_route(dij, arg);
+}
+
 int main(int argc, char *argv[])
 {
 	common_setup(argv[0]);
@@ -300,6 +343,31 @@ int main(int argc, char *argv[])
 	assert(amount_msat_eq(route[0].amount, AMOUNT_MSAT(3000000 + 6)));
 	assert(route[0].delay == 15);
 
+	/* Batch gives the same answers, however many threads. */
+	for (size_t threads = 1; threads < 4; threads++) {
+		const struct gossmap_node *dsts[] = { b_node, c_node, d_node };
+		const struct amount_msat amounts[] = { AMOUNT_MSAT(1000),
+						       AMOUNT_MSAT(3000000) };
+		struct batch_check checks[ARRAY_SIZE(dsts) * ARRAY_SIZE(amounts)];
+		struct dijkstra_query queries[ARRAY_SIZE(checks)];
+
+		for (size_t i = 0; i < ARRAY_SIZE(checks); i++) {
+			checks[i].map = gossmap;
+			checks[i].src = a_node;
+			checks[i].dst = dsts[i % ARRAY_SIZE(dsts)];
+			checks[i].amount = amounts[i / ARRAY_SIZE(dsts)];
+			checks[i].done = false;
+			queries[i].start = checks[i].dst;
+			queries[i].amount = checks[i].amount;
+			queries[i].riskfactor = riskfactor;
+			queries[i].arg = &checks[i];
+		}
+		dijkstra_batch(gossmap, queries, ARRAY_SIZE(queries), threads,
+			       batch_can_carry, route_score_cheaper, batch_done);
+		for (size_t i = 0; i < ARRAY_SIZE(checks); i++)
+			assert(checks[i].done);
+	}
+
 	common_shutdown();
 	return 0;
 }
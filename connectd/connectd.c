@@ -242,7 +242,7 @@ static struct peer *new_peer(struct daemon *daemon,
 	peer->cs = *cs;
 	peer->subds = tal_arr(peer, struct subd *, 0);
 	peer->peer_in = NULL;
-	peer->sent_to_peer = NULL;
+	peer->sent_to_peer = tal_arr(peer, u8, 0);
 	peer->urgent = false;
 	peer->draining = false;
 	peer->peer_outq = msg_queue_new(peer, false);
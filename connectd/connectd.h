@@ -71,8 +71,8 @@ struct peer {
 	/* Output buffer. */
 	struct msg_queue *peer_outq;
 
-	/* Peer sent buffer (for freeing after sending) */
-	const u8 *sent_to_peer;
+	/* Encrypted output buffer, reused for each message sent */
+	u8 *sent_to_peer;
 
 	/* We stream from the gossip_store for them, when idle */
 	struct gossip_state gs;
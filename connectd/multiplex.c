@@ -459,8 +459,17 @@ static struct io_plan *encrypt_and_send(struct peer *peer,
 		next = io_sock_shutdown_cb;
 	}
 
-	/* We free this and the encrypted version in next write_to_peer */
-	peer->sent_to_peer = cryptomsg_encrypt_msg(peer, &peer->cs, msg);
+	/* We reuse the same output buffer for every message, encrypting in
+	 * place: this is the hot path when streaming gossip. */
+	tal_resize(&peer->sent_to_peer,
+		   CRYPTOMSG_HDR_SIZE + tal_bytelen(msg)
+		   + CRYPTOMSG_BODY_OVERHEAD);
+	memcpy(peer->sent_to_peer + CRYPTOMSG_HDR_SIZE, msg, tal_bytelen(msg));
+	cryptomsg_encrypt_inplace(&peer->cs, peer->sent_to_peer,
+				  tal_bytelen(msg));
+	if (taken(msg))
+		tal_free(msg);
+
 	return io_write(peer->to_peer,
 			peer->sent_to_peer,
 			tal_bytelen(peer->sent_to_peer),
@@ -949,9 +958,6 @@ static struct io_plan *write_to_peer(struct io_conn *peer_conn,
 	const u8 *msg;
 	assert(peer->to_peer == peer_conn);
 
-	/* Free last sent one (if any) */
-	peer->sent_to_peer = tal_free(peer->sent_to_peer);
-
 	/* Pop tail of send queue */
 	msg = msg_dequeue(peer->peer_outq);
 
@@ -1085,14 +1091,16 @@ static struct io_plan *read_body_from_peer_done(struct io_conn *peer_conn,
        struct channel_id channel_id;
        struct subd *subd;
 
-       decrypted = cryptomsg_decrypt_body(tmpctx, &peer->cs,
-					  peer->peer_in);
-       if (!decrypted) {
+       if (!cryptomsg_decrypt_body_inplace(&peer->cs, peer->peer_in,
+					   tal_bytelen(peer->peer_in))) {
 	       status_peer_debug(&peer->id, "Bad encrypted packet len %zu",
 				 tal_bytelen(peer->peer_in));
                return io_close(peer_conn);
        }
-       tal_free(peer->peer_in);
+       /* Decrypted in place: just trim off the MAC. */
+       decrypted = tal_steal(tmpctx, peer->peer_in);
+       tal_resize(&decrypted, tal_bytelen(decrypted) - CRYPTOMSG_BODY_OVERHEAD);
+       peer->peer_in = NULL;
 
        /* dev_disconnect can disable read */
        if (!IFDEV(peer->dev_read_enabled, true))
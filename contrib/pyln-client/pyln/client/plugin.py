@@ -59,6 +59,7 @@ class Method(object):
         self.deprecated = deprecated
         self.before: List[str] = []
         self.after: List[str] = []
+        self.observer = False
 
 
 class RpcException(Exception):
@@ -476,8 +477,12 @@ class Plugin(object):
     def add_hook(self, name: str, func: Callable[..., JSONType],
                  background: bool = False,
                  before: Optional[List[str]] = None,
-                 after: Optional[List[str]] = None) -> None:
+                 after: Optional[List[str]] = None,
+                 observer: bool = False) -> None:
         """Register a hook that is called synchronously by lightningd on events
+
+        If `observer` is set, the hook promises to always return
+        `continue`, so lightningd doesn't wait for it.
         """
         if name in self.methods:
             raise ValueError(
@@ -504,17 +509,20 @@ class Plugin(object):
         method.after = []
         if after:
             method.after = after
+        method.observer = observer
         self.methods[name] = method
 
     def hook(self, method_name: str,
              before: List[str] = None,
-             after: List[str] = None) -> JsonDecoratorType:
+             after: List[str] = None,
+             observer: bool = False) -> JsonDecoratorType:
         """Decorator to add a plugin hook to the dispatch table.
 
         Internally uses add_hook.
         """
         def decorator(f: Callable[..., JSONType]) -> Callable[..., JSONType]:
-            self.add_hook(method_name, f, background=False, before=before, after=after)
+            self.add_hook(method_name, f, background=False, before=before,
+                          after=after, observer=observer)
             return f
         return decorator
 
@@ -859,9 +867,12 @@ class Plugin(object):
                 continue
 
             if method.mtype == MethodType.HOOK:
-                hooks.append({'name': method.name,
-                              'before': method.before,
-                              'after': method.after})
+                hook = {'name': method.name,
+                        'before': method.before,
+                        'after': method.after}
+                if method.observer:
+                    hook['observer'] = True
+                hooks.append(hook)
                 continue
 
             doc = inspect.getdoc(method.func)
@@ -0,0 +1,166 @@
+/* Measures the cost of gossmap_refresh() while a gossip_store is being
+ * appended to at a steady rate, as happens when plugins refresh before
+ * every payment. */
+#include "config.h"
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/tal/path/path.h>
+#include <ccan/tal/str/str.h>
+#include <ccan/time/time.h>
+#include <common/gossip_store.h>
+#include <common/gossmap.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static u8 *read_store(const tal_t *ctx, const char *fname)
+{
+	struct stat st;
+	u8 *contents;
+	int fd = open(fname, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &st) != 0)
+		err(1, "Opening %s", fname);
+	contents = tal_arr(ctx, u8, st.st_size);
+	if (!read_all(fd, contents, st.st_size))
+		err(1, "Reading %s", fname);
+	close(fd);
+	return contents;
+}
+
+/* Returns offsets of each record. */
+static size_t *record_offsets(const tal_t *ctx, const u8 *store)
+{
+	size_t *offs = tal_arr(ctx, size_t, 0);
+	size_t off = 1;
+
+	while (off + sizeof(struct gossip_hdr) <= tal_bytelen(store)) {
+		struct gossip_hdr hdr;
+		size_t len;
+
+		memcpy(&hdr, store + off, sizeof(hdr));
+		len = sizeof(hdr)
+			+ (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_MASK);
+		if (off + len > tal_bytelen(store))
+			break;
+		tal_arr_expand(&offs, off);
+		off += len;
+	}
+	tal_arr_expand(&offs, off);
+	return offs;
+}
+
+int main(int argc, char *argv[])
+{
+	u8 *store;
+	size_t *offs, start, num_recs;
+	char *dir, *fname;
+	int fd;
+	u64 *seq = NULL;
+	struct gossmap *map;
+	struct timemono tstart;
+	struct timerel unchanged = time_from_sec(0), changed = time_from_sec(0);
+	u64 num_unchanged = 0, num_changed = 0;
+	unsigned int refreshes = 10, startpercent = 50;
+	bool use_seq = true;
+
+	common_setup(argv[0]);
+
+	opt_register_arg("--refreshes", opt_set_uintval, opt_show_uintval,
+			 &refreshes, "Refreshes between each append");
+	opt_register_arg("--start-percent", opt_set_uintval, opt_show_uintval,
+			 &startpercent,
+			 "Percentage of records in store before we load it");
+	opt_register_noarg("--no-seq", opt_set_invbool, &use_seq,
+			   "Don't provide a change counter, like gossipd does");
+	opt_register_noarg("-h|--help", opt_usage_and_exit,
+			   "<gossipstore>\n"
+			   "Loads part of the gossip store, then appends the"
+			   " rest one record at a time, timing gossmap_refresh.",
+			   "Get usage information");
+	opt_parse(&argc, argv, opt_log_stderr_exit);
+	if (argc != 2)
+		opt_usage_exit_fail("Expect 1 argument");
+	if (startpercent > 100)
+		opt_usage_exit_fail("--start-percent must be <= 100");
+
+	store = read_store(tmpctx, argv[1]);
+	if (tal_bytelen(store) < 1 || store[0] != GOSSIP_STORE_VERSION)
+		errx(1, "%s is not a version %u gossip_store",
+		     argv[1], GOSSIP_STORE_VERSION);
+	offs = record_offsets(tmpctx, store);
+	num_recs = tal_count(offs) - 1;
+	start = num_recs * startpercent / 100;
+
+	dir = tal_strdup(tmpctx, "/tmp/bench-gossmap-refresh-XXXXXX");
+	if (!mkdtemp(dir))
+		err(1, "Creating temporary directory");
+	fname = path_join(tmpctx, dir, "gossip_store");
+
+	fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if (fd < 0 || !write_all(fd, store, offs[start]))
+		err(1, "Writing %s", fname);
+
+	if (use_seq) {
+		int seqfd = open(tal_fmt(tmpctx, "%s"GOSSIP_STORE_SEQ_SUFFIX,
+					 fname), O_RDWR|O_CREAT, 0600);
+		if (seqfd < 0 || ftruncate(seqfd, sizeof(*seq)) != 0)
+			err(1, "Creating seq file");
+		seq = mmap(NULL, sizeof(*seq), PROT_READ|PROT_WRITE,
+			   MAP_SHARED, seqfd, 0);
+		if (seq == MAP_FAILED)
+			err(1, "Mapping seq file");
+		close(seqfd);
+	}
+
+	tstart = time_mono();
+	map = gossmap_load(tmpctx, fname, NULL);
+	if (!map)
+		err(1, "Loading %s", fname);
+	printf("# Loaded %zu/%zu records in %"PRIu64" msec\n",
+	       start, num_recs,
+	       time_to_msec(timemono_since(tstart)));
+
+	for (size_t i = start; i < num_recs; i++) {
+		if (!write_all(fd, store + offs[i], offs[i+1] - offs[i]))
+			err(1, "Appending to %s", fname);
+		if (seq)
+			(*seq)++;
+
+		/* First one picks up the append, rest should be free */
+		for (size_t r = 0; r < refreshes; r++) {
+			struct timemono before = time_mono();
+			gossmap_refresh(map, NULL);
+			if (r == 0) {
+				changed = timerel_add(changed,
+						      timemono_since(before));
+				num_changed++;
+			} else {
+				unchanged = timerel_add(unchanged,
+							timemono_since(before));
+				num_unchanged++;
+			}
+		}
+	}
+
+	printf("# Appended %zu records (%zu bytes)\n",
+	       num_recs - start, offs[num_recs] - offs[start]);
+	if (num_changed)
+		printf("refresh_after_append_nsec: %"PRIu64"\n",
+		       time_to_nsec(changed) / num_changed);
+	if (num_unchanged)
+		printf("refresh_unchanged_nsec: %"PRIu64"\n",
+		       time_to_nsec(unchanged) / num_unchanged);
+
+	close(fd);
+	unlink(tal_fmt(tmpctx, "%s"GOSSIP_STORE_SEQ_SUFFIX, fname));
+	unlink(fname);
+	rmdir(dir);
+	common_shutdown();
+}
@@ -1,8 +1,10 @@
 /* Routines to make our own gossip messages.  Not as in "we're the gossip
  * generation, man!" */
 #include "config.h"
+#include <ccan/array_size/array_size.h>
 #include <ccan/asort/asort.h>
 #include <ccan/cast/cast.h>
+#include <ccan/crc32c/crc32c.h>
 #include <ccan/mem/mem.h>
 #include <common/daemon_conn.h>
 #include <common/features.h>
@@ -106,6 +108,26 @@ void get_cupdate_parts(const u8 *channel_update,
 	sizes[1] = tal_count(channel_update) - (64 + 2 + 32 + 8 + 4);
 }
 
+/* BOLT #7:
+ *
+ * The checksum of a `channel_update` is the CRC32C checksum as specified in
+ * [RFC3720](https://tools.ietf.org/html/rfc3720#appendix-B.4) of this
+ * `channel_update` without its `signature` and `timestamp` fields.
+ */
+u32 crc32_of_update(const u8 *channel_update)
+{
+	u32 sum;
+	const u8 *parts[2];
+	size_t sizes[ARRAY_SIZE(parts)];
+
+	get_cupdate_parts(channel_update, parts, sizes);
+
+	sum = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(parts); i++)
+		sum = crc32c(sum, parts[i], sizes[i]);
+	return sum;
+}
+
 /* Is this channel_update different from prev (not sigs and timestamps)? */
 bool cupdate_different(struct gossip_store *gs,
 		       const struct half_chan *hc,
@@ -115,6 +137,11 @@ bool cupdate_different(struct gossip_store *gs,
 	size_t osizes[2], nsizes[2];
 	const u8 *orig;
 
+	/* Different checksums means different contents: no need to hit
+	 * the store. */
+	if (crc32_of_update(cupdate) != hc->bcast_checksum)
+		return true;
+
 	/* Get last one we have. */
 	orig = gossip_store_get(tmpctx, gs, hc->bcast.index);
 	get_cupdate_parts(orig, oparts, osizes);
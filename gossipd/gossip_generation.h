@@ -18,6 +18,8 @@ void get_cupdate_parts(const u8 *channel_update,
 		       const u8 *parts[2],
 		       size_t sizes[2]);
 
+/* BOLT #7 checksum of a (valid!) channel_update, for reply_channel_range */
+u32 crc32_of_update(const u8 *channel_update);
 
 /* Is this channel_update different from prev (not sigs and timestamps)?
  * is_halfchan_defined(hc) must be true! */
@@ -7,10 +7,12 @@
 #include <common/gossip_store.h>
 #include <common/private_channel_announcement.h>
 #include <common/status.h>
+#include <common/timeout.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <gossipd/gossip_store.h>
 #include <gossipd/gossip_store_wiregen.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -18,6 +20,15 @@
 
 #define GOSSIP_STORE_TEMP_FILENAME "gossip_store.tmp"
 
+/* We compact in the background once more than half of this many entries
+ * are deleted. */
+#define COMPACT_MIN_ENTRIES 10000
+
+/* How much of the old store we copy each time compaction gets to run, and
+ * how often it does: this bounds how long we stall everything else. */
+#define COMPACT_STEP_BYTES (1024 * 1024)
+#define COMPACT_STEP_INTERVAL_MSEC 10
+
 struct gossip_store {
 	/* This is false when we're loading */
 	bool writable;
@@ -44,13 +55,62 @@ struct gossip_store {
 	 * compaction */
 	bool disable_compaction;
 
+	/* Non-NULL if we're part way through compacting */
+	struct compaction *compaction;
+
 	/* Timestamp of store when we opened it (0 if we created it) */
 	u32 timestamp;
+
+	/* Shared counter we bump on every append, so gossmap readers
+	 * don't need to check the file size (NULL if we couldn't map it). */
+	u64 *seq;
 };
 
 static void gossip_store_destroy(struct gossip_store *gs)
 {
 	close(gs->fd);
+	if (gs->seq)
+		munmap(gs->seq, sizeof(*gs->seq));
+}
+
+/* We keep the old value if there is one: readers only look for changes,
+ * and this way a restart can't accidentally look like "no change". */
+static u64 *map_seq(void)
+{
+	int fd;
+	void *p;
+
+	fd = open(GOSSIP_STORE_FILENAME GOSSIP_STORE_SEQ_SUFFIX,
+		  O_RDWR|O_CREAT, 0600);
+	if (fd < 0) {
+		status_unusual("Opening %s: %s",
+			       GOSSIP_STORE_FILENAME GOSSIP_STORE_SEQ_SUFFIX,
+			       strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(u64)) != 0) {
+		status_unusual("Extending %s: %s",
+			       GOSSIP_STORE_FILENAME GOSSIP_STORE_SEQ_SUFFIX,
+			       strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, sizeof(u64), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		status_unusual("Mapping %s: %s",
+			       GOSSIP_STORE_FILENAME GOSSIP_STORE_SEQ_SUFFIX,
+			       strerror(errno));
+		return NULL;
+	}
+	return p;
+}
+
+/* Tell gossmap readers there's something new (after it's written!) */
+static void bump_seq(struct gossip_store *gs)
+{
+	if (gs->seq)
+		(*(volatile u64 *)gs->seq)++;
 }
 
 #if HAVE_PWRITEV
@@ -101,6 +161,27 @@ static bool append_msg(int fd, const u8 *msg, u32 timestamp,
 	return true;
 }
 
+/* Set deleted bit on entry, returns index of following entry. */
+static u32 mark_deleted(int fd, u32 index)
+{
+	beint32_t belen;
+
+	if (pread(fd, &belen, sizeof(belen), index) != sizeof(belen))
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Failed reading len to delete @%u: %s",
+			      index, strerror(errno));
+
+	assert((be32_to_cpu(belen) & GOSSIP_STORE_LEN_DELETED_BIT) == 0);
+	belen |= cpu_to_be32(GOSSIP_STORE_LEN_DELETED_BIT);
+	if (pwrite(fd, &belen, sizeof(belen), index) != sizeof(belen))
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Failed writing len to delete @%u: %s",
+			      index, strerror(errno));
+
+	return index + sizeof(struct gossip_hdr)
+		+ (be32_to_cpu(belen) & GOSSIP_STORE_LEN_MASK);
+}
+
 #ifdef COMPAT_V082
 static u8 *mk_private_channelmsg(const tal_t *ctx,
 				 struct routing_state *rstate,
@@ -175,6 +256,52 @@ static bool upgrade_field(u8 oldversion,
 }
 #endif /* !COMPAT_V082 */
 
+/* The whole store, mapped (or read) into memory. */
+struct store_map {
+	u8 *data;
+	size_t len;
+};
+
+static void destroy_store_map(struct store_map *map)
+{
+	munmap(map->data, map->len);
+}
+
+/* Map the whole store, falling back to reading it: NULL on error. */
+static struct store_map *map_store(const tal_t *ctx, int fd)
+{
+	struct store_map *map = tal(ctx, struct store_map);
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		return tal_free(map);
+
+	map->len = st.st_size;
+	map->data = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map->data != MAP_FAILED) {
+		tal_add_destructor(map, destroy_store_map);
+		/* We only ever walk it front to back. */
+		madvise(map->data, map->len, MADV_SEQUENTIAL);
+		return map;
+	}
+
+	map->data = tal_arr(map, u8, map->len);
+	if (lseek(fd, 0, SEEK_SET) != 0
+	    || !read_all(fd, map->data, map->len))
+		return tal_free(map);
+	return map;
+}
+
+/* Type of this (possibly not tal-allocated) message, or -1. */
+static int store_msg_type(const u8 *msg, size_t msglen)
+{
+	int type = fromwire_u16(&msg, &msglen);
+
+	if (!msg)
+		return -1;
+	return type;
+}
+
 /* Read gossip store entries, copy non-deleted ones.  This code is written
  * as simply and robustly as possible! */
 static u32 gossip_store_compact_offline(struct routing_state *rstate)
@@ -185,6 +312,10 @@ static u32 gossip_store_compact_offline(struct routing_state *rstate)
 	struct gossip_hdr hdr;
 	u8 oldversion, version = GOSSIP_STORE_VERSION;
 	struct stat st;
+	struct store_map *map;
+	struct timemono start = time_mono();
+	size_t off, outlen;
+	u8 *out;
 
 	old_fd = open(GOSSIP_STORE_FILENAME, O_RDWR);
 	if (old_fd == -1)
@@ -203,8 +334,16 @@ static u32 gossip_store_compact_offline(struct routing_state *rstate)
 		goto close_old;
 	}
 
-	if (!read_all(old_fd, &oldversion, sizeof(oldversion))
-	    || (oldversion != version && !can_upgrade(oldversion))) {
+	map = map_store(tmpctx, old_fd);
+	if (!map) {
+		status_broken("gossip_store_compact_offline: reading store: %s",
+			      strerror(errno));
+		goto close_and_delete;
+	}
+
+	if (map->len < sizeof(oldversion)
+	    || ((oldversion = map->data[0]) != version
+		&& !can_upgrade(oldversion))) {
 		status_broken("gossip_store_compact: bad version");
 		goto close_and_delete;
 	}
@@ -214,57 +353,74 @@ static u32 gossip_store_compact_offline(struct routing_state *rstate)
 			      strerror(errno));
 		goto close_and_delete;
 	}
-
-	/* Read everything, write non-deleted ones to new_fd */
-	while (read_all(old_fd, &hdr, sizeof(hdr))) {
+	newlen = sizeof(version);
+
+	/* Walk everything, write non-deleted ones to new_fd a buffer at
+	 * a time. */
+	out = tal_arr(tmpctx, u8, COMPACT_STEP_BYTES);
+	outlen = 0;
+	off = sizeof(oldversion);
+	while (off + sizeof(hdr) <= map->len) {
 		size_t msglen;
-		u8 *msg;
+		const u8 *msg;
 
+		memcpy(&hdr, map->data + off, sizeof(hdr));
 		msglen = (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_MASK);
-		msg = tal_arr(NULL, u8, msglen);
-		if (!read_all(old_fd, msg, msglen)) {
-			status_broken("gossip_store_compact_offline: reading msg len %zu from store: %s",
-				      msglen, strerror(errno));
-			tal_free(msg);
+		if (off + sizeof(hdr) + msglen > map->len) {
+			status_broken("gossip_store_compact_offline: reading msg len %zu from store: truncated",
+				      msglen);
 			goto close_and_delete;
 		}
+		msg = map->data + off + sizeof(hdr);
+		off += sizeof(hdr) + msglen;
 
 		if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT) {
 			deleted++;
-			tal_free(msg);
 			continue;
 		}
 
 		if (oldversion != version) {
-			if (!upgrade_field(oldversion, rstate, &msg)) {
-				tal_free(msg);
+			u8 *upgraded = tal_dup_arr(tmpctx, u8, msg, msglen, 0);
+			if (!upgrade_field(oldversion, rstate, &upgraded))
 				goto close_and_delete;
-			}
 
 			/* Recalc msglen and header */
-			msglen = tal_bytelen(msg);
+			msg = upgraded;
+			msglen = tal_bytelen(upgraded);
 			hdr.len = cpu_to_be32(msglen);
 			hdr.crc = cpu_to_be32(crc32c(be32_to_cpu(hdr.timestamp),
 						      msg, msglen));
 		}
 
 		/* Don't write out old tombstones */
-		if (fromwire_peektype(msg) == WIRE_GOSSIP_STORE_DELETE_CHAN) {
+		if (store_msg_type(msg, msglen) == WIRE_GOSSIP_STORE_DELETE_CHAN) {
 			deleted++;
-			tal_free(msg);
 			continue;
 		}
 
-		if (!write_all(new_fd, &hdr, sizeof(hdr))
-		    || !write_all(new_fd, msg, msglen)) {
-			status_broken("gossip_store_compact_offline: writing msg len %zu to new store: %s",
-				      msglen, strerror(errno));
-			tal_free(msg);
-			goto close_and_delete;
+		if (outlen + sizeof(hdr) + msglen > tal_bytelen(out)) {
+			if (!write_all(new_fd, out, outlen)) {
+				status_broken("gossip_store_compact_offline: writing %zu to new store: %s",
+					      outlen, strerror(errno));
+				goto close_and_delete;
+			}
+			newlen += outlen;
+			outlen = 0;
 		}
-		tal_free(msg);
+		memcpy(out + outlen, &hdr, sizeof(hdr));
+		memcpy(out + outlen + sizeof(hdr), msg, msglen);
+		outlen += sizeof(hdr) + msglen;
 		count++;
 	}
+	if (!write_all(new_fd, out, outlen)) {
+		status_broken("gossip_store_compact_offline: writing %zu to new store: %s",
+			      outlen, strerror(errno));
+		goto close_and_delete;
+	}
+	newlen += outlen;
+	oldlen = map->len;
+	tal_free(map);
+
 	if (close(new_fd) != 0) {
 		status_broken("gossip_store_compact_offline: closing new store: %s",
 			      strerror(errno));
@@ -276,13 +432,13 @@ static u32 gossip_store_compact_offline(struct routing_state *rstate)
 	}
 
 	/* Create end marker now new file exists. */
-	oldlen = lseek(old_fd, SEEK_END, 0);
-	newlen = lseek(new_fd, SEEK_END, 0);
 	append_msg(old_fd, towire_gossip_store_ended(tmpctx, newlen),
 		   0, true, false, &oldlen);
 	close(old_fd);
-	status_debug("gossip_store_compact_offline: %zu deleted, %zu copied",
-		     deleted, count);
+	status_debug("gossip_store_compact_offline: %zu deleted, %zu copied"
+		     " in %"PRIu64" msec",
+		     deleted, count,
+		     time_to_msec(timemono_between(time_mono(), start)));
 	return st.st_mtime;
 
 close_and_delete:
@@ -307,8 +463,10 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate,
 			      strerror(errno));
 	gs->rstate = rstate;
 	gs->disable_compaction = false;
+	gs->compaction = NULL;
 	gs->len = sizeof(gs->version);
 	gs->peers = peers;
+	gs->seq = map_seq();
 
 	tal_add_destructor(gs, gossip_store_destroy);
 
@@ -322,6 +480,8 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate,
 
 		status_unusual("Gossip store version %u not %u: removing",
 			       gs->version, GOSSIP_STORE_VERSION);
+		/* Same inode, so index would look valid: remove it */
+		unlink(GOSSIP_STORE_FILENAME GOSSMAP_INDEX_SUFFIX);
 		if (ftruncate(gs->fd, 0) != 0)
 			status_failed(STATUS_FAIL_INTERNAL_ERROR,
 				      "Truncating store: %s", strerror(errno));
@@ -340,63 +500,6 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate,
 	return gs;
 }
 
-/* Returns bytes transferred, or 0 on error */
-static size_t transfer_store_msg(int from_fd, size_t from_off,
-				 int to_fd, size_t to_off,
-				 int *type)
-{
-	struct gossip_hdr hdr;
-	u32 msglen;
-	u8 *msg;
-	const u8 *p;
-	size_t tmplen;
-
-	*type = -1;
-	if (pread(from_fd, &hdr, sizeof(hdr), from_off) != sizeof(hdr)) {
-		status_broken("Failed reading header from to gossip store @%zu"
-			      ": %s",
-			      from_off, strerror(errno));
-		return 0;
-	}
-
-	msglen = be32_to_cpu(hdr.len);
-	if (msglen & GOSSIP_STORE_LEN_DELETED_BIT) {
-		status_broken("Can't transfer deleted msg from gossip store @%zu",
-			      from_off);
-		return 0;
-	}
-
-	/* Ignore any non-length bits (e.g. push) */
-	msglen &= GOSSIP_STORE_LEN_MASK;
-
-	/* FIXME: Reuse buffer? */
-	msg = tal_arr(tmpctx, u8, sizeof(hdr) + msglen);
-	memcpy(msg, &hdr, sizeof(hdr));
-	if (pread(from_fd, msg + sizeof(hdr), msglen, from_off + sizeof(hdr))
-	    != msglen) {
-		status_broken("Failed reading %u from to gossip store @%zu"
-			      ": %s",
-			      msglen, from_off, strerror(errno));
-		return 0;
-	}
-
-	if (pwrite(to_fd, msg, msglen + sizeof(hdr), to_off)
-	    != msglen + sizeof(hdr)) {
-		status_broken("Failed writing to gossip store: %s",
-			      strerror(errno));
-		return 0;
-	}
-
-	/* Can't use peektype here, since we have header on front */
-	p = msg + sizeof(hdr);
-	tmplen = msglen;
-	*type = fromwire_u16(&p, &tmplen);
-	if (!p)
-		*type = -1;
-	tal_free(msg);
-	return sizeof(hdr) + msglen;
-}
-
 /* We keep a htable map of old gossip_store offsets to new ones. */
 struct offset_map {
 	size_t from, to;
@@ -420,89 +523,128 @@ static bool offset_map_eq(const struct offset_map *omap, const size_t from)
 HTABLE_DEFINE_TYPE(struct offset_map,
 		   offset_map_key, hash_offset, offset_map_eq, offmap);
 
-static void move_broadcast(struct offmap *offmap,
-			   struct broadcastable *bcast,
-			   const char *what)
-{
-	struct offset_map *omap;
-
-	if (!bcast->index)
-		return;
-
-	omap = offmap_get(offmap, bcast->index);
-	if (!omap)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "Could not relocate %s at offset %u",
-			      what, bcast->index);
-	bcast->index = omap->to;
-	offmap_del(offmap, omap);
-}
-
 static void destroy_offmap(struct offmap *offmap)
 {
 	offmap_clear(offmap);
 }
 
-/**
- * Rewrite the on-disk gossip store, compacting it along the way
- *
- * Creates a new file, writes all the updates from the `broadcast_state`, and
- * then atomically swaps the files.
- */
-bool gossip_store_compact(struct gossip_store *gs)
-{
-	size_t count = 0, deleted = 0;
+/* A compaction in progress: we copy the live entries of the old store into
+ * a new file a chunk at a time, while still appending to (and deleting from)
+ * the old one.  Once we've caught up, we swap the new one into place. */
+struct compaction {
+	/* The new store, and its length so far. */
 	int fd;
-	u64 off, len = sizeof(gs->version), idx;
+	u64 len;
+
+	/* Offset in the old store we've copied up to. */
+	u64 off;
+
+	/* Entries in new store (count includes deleted). */
+	size_t count, deleted;
+
+	/* Where everything we'll need to relocate went. */
 	struct offmap *offmap;
-	struct gossip_hdr hdr;
-	struct offmap_iter oit;
-	struct node_map_iter nit;
-	struct offset_map *omap;
 
-	if (gs->disable_compaction)
-		return false;
+	/* Non-NULL if we're compacting in the background. */
+	struct oneshot *step_timer;
 
-	status_debug(
-	    "Compacting gossip_store with %zu entries, %zu of which are stale",
-	    gs->count, gs->deleted);
+	/* For the log. */
+	struct timemono start;
+	struct timerel longest_step;
+	size_t steps;
+	u64 bytes_read;
+};
 
-	fd = open(GOSSIP_STORE_TEMP_FILENAME, O_RDWR|O_TRUNC|O_CREAT, 0600);
+static void destroy_compaction(struct compaction *c)
+{
+	if (c->fd >= 0) {
+		close(c->fd);
+		unlink(GOSSIP_STORE_TEMP_FILENAME);
+	}
+}
 
-	if (fd < 0) {
-		status_broken(
-		    "Could not open file for gossip_store compaction");
-		goto disable;
+static struct compaction *compaction_start(struct gossip_store *gs)
+{
+	struct compaction *c = tal(gs, struct compaction);
+
+	c->fd = open(GOSSIP_STORE_TEMP_FILENAME, O_RDWR|O_TRUNC|O_CREAT, 0600);
+	if (c->fd < 0) {
+		status_broken("Could not open file for gossip_store compaction");
+		return tal_free(c);
 	}
+	tal_add_destructor(c, destroy_compaction);
 
-	if (write(fd, &gs->version, sizeof(gs->version))
+	if (write(c->fd, &gs->version, sizeof(gs->version))
 	    != sizeof(gs->version)) {
 		status_broken("Writing version to store: %s", strerror(errno));
-		goto unlink_disable;
+		return tal_free(c);
 	}
 
-	/* Walk old file, copy everything and remember new offsets. */
-	offmap = tal(tmpctx, struct offmap);
-	offmap_init_sized(offmap, gs->count);
-	tal_add_destructor(offmap, destroy_offmap);
+	c->len = c->off = sizeof(gs->version);
+	c->count = c->deleted = 0;
+	c->offmap = tal(c, struct offmap);
+	offmap_init_sized(c->offmap, gs->count - gs->deleted);
+	tal_add_destructor(c->offmap, destroy_offmap);
+	c->step_timer = NULL;
+	c->start = time_mono();
+	c->longest_step = time_from_msec(0);
+	c->steps = 0;
+	c->bytes_read = 0;
 
-	/* Start by writing all channel announcements and updates. */
-	off = 1;
-	while (pread(gs->fd, &hdr, sizeof(hdr), off) == sizeof(hdr)) {
-		u32 msglen, wlen;
+	status_debug(
+	    "Compacting gossip_store with %zu entries, %zu of which are stale",
+	    gs->count, gs->deleted);
+	return c;
+}
+
+/* Copy (up to) the next COMPACT_STEP_BYTES of the old store across,
+ * remembering new offsets.  Returns false on error. */
+static bool compaction_step(struct gossip_store *gs, struct compaction *c)
+{
+	struct timemono start = time_mono();
+	struct timerel elapsed;
+	u64 readlen;
+	size_t off, outlen;
+	u8 *buf, *out;
+
+	readlen = gs->len - c->off;
+	if (readlen > COMPACT_STEP_BYTES)
+		readlen = COMPACT_STEP_BYTES;
+
+	buf = tal_arr(tmpctx, u8, readlen);
+	if (pread(gs->fd, buf, readlen, c->off) != readlen) {
+		status_broken("Failed reading %"PRIu64" from gossip store @%"PRIu64
+			      ": %s",
+			      readlen, c->off, strerror(errno));
+		return false;
+	}
+	c->bytes_read += readlen;
+
+	/* Live entries can't take more room than we read. */
+	out = tal_arr(tmpctx, u8, readlen);
+	outlen = 0;
+
+	off = 0;
+	while (off + sizeof(struct gossip_hdr) <= readlen) {
+		struct gossip_hdr hdr;
+		u32 msglen;
+		size_t entlen;
 		int msgtype;
 
+		memcpy(&hdr, buf + off, sizeof(hdr));
 		msglen = (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_MASK);
+		entlen = sizeof(hdr) + msglen;
+
+		/* Partial entry?  We'll get it next time. */
+		if (off + entlen > readlen)
+			break;
+
 		if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT) {
-			off += sizeof(hdr) + msglen;
-			deleted++;
+			off += entlen;
 			continue;
 		}
 
-		count++;
-		wlen = transfer_store_msg(gs->fd, off, fd, len, &msgtype);
-		if (wlen == 0)
-			goto unlink_disable;
+		msgtype = store_msg_type(buf + off + sizeof(hdr), msglen);
 
 		/* We track location of all these message types. */
 		if (msgtype == WIRE_GOSSIP_STORE_PRIVATE_CHANNEL
@@ -510,50 +652,116 @@ bool gossip_store_compact(struct gossip_store *gs)
 		    || msgtype == WIRE_CHANNEL_ANNOUNCEMENT
 		    || msgtype == WIRE_CHANNEL_UPDATE
 		    || msgtype == WIRE_NODE_ANNOUNCEMENT) {
-			omap = tal(offmap, struct offset_map);
-			omap->from = off;
-			omap->to = len;
-			offmap_add(offmap, omap);
+			struct offset_map *omap = tal(c->offmap,
+						      struct offset_map);
+			omap->from = c->off + off;
+			omap->to = c->len + outlen;
+			offmap_add(c->offmap, omap);
 		}
-		len += wlen;
-		off += wlen;
+
+		memcpy(out + outlen, buf + off, entlen);
+		outlen += entlen;
+		off += entlen;
+		c->count++;
+	}
+
+	/* Every entry fits in a step, so we must make progress! */
+	if (off == 0 && readlen != 0) {
+		status_broken("Truncated entry in gossip store @%"PRIu64,
+			      c->off);
+		return false;
 	}
 
-	/* OK, now we've written file successfully, we can move broadcasts. */
+	if (pwrite(c->fd, out, outlen, c->len) != outlen) {
+		status_broken("Failed writing to gossip store: %s",
+			      strerror(errno));
+		return false;
+	}
+	c->len += outlen;
+	c->off += off;
+
+	c->steps++;
+	elapsed = timemono_between(time_mono(), start);
+	if (time_greater(elapsed, c->longest_step))
+		c->longest_step = elapsed;
+	return true;
+}
+
+static void move_broadcast(struct offmap *offmap,
+			   struct broadcastable *bcast,
+			   const char *what)
+{
+	struct offset_map *omap;
+
+	if (!bcast->index)
+		return;
+
+	omap = offmap_get(offmap, bcast->index);
+	if (!omap)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Could not relocate %s at offset %u",
+			      what, bcast->index);
+	bcast->index = omap->to;
+	offmap_del(offmap, omap);
+}
+
+/* The rgraph entry is either the bcast one, or a separate rate-limited one */
+static void move_broadcasts(struct offmap *offmap,
+			    struct broadcastable *bcast,
+			    struct broadcastable *rgraph,
+			    const char *what)
+{
+	if (rgraph->index == bcast->index) {
+		move_broadcast(offmap, bcast, what);
+		rgraph->index = bcast->index;
+	} else {
+		move_broadcast(offmap, bcast, what);
+		move_broadcast(offmap, rgraph, what);
+	}
+}
+
+/* We've copied everything: move broadcasts and swap new store into place. */
+static bool compaction_finish(struct gossip_store *gs, struct compaction *c)
+{
+	struct offmap_iter oit;
+	struct node_map_iter nit;
+	struct offset_map *omap;
+	u64 idx;
+
+	assert(c->off == gs->len);
+
 	/* Remap node announcements. */
 	for (struct node *n = node_map_first(gs->rstate->nodes, &nit);
 	     n;
 	     n = node_map_next(gs->rstate->nodes, &nit)) {
-		move_broadcast(offmap, &n->bcast, "node_announce");
+		move_broadcasts(c->offmap, &n->bcast, &n->rgraph,
+				"node_announce");
 	}
 
 	/* Remap channel announcements and updates */
-	for (struct chan *c = uintmap_first(&gs->rstate->chanmap, &idx);
-	     c;
-	     c = uintmap_after(&gs->rstate->chanmap, &idx)) {
-		move_broadcast(offmap, &c->bcast, "channel_announce");
-		move_broadcast(offmap, &c->half[0].bcast, "channel_update");
-		move_broadcast(offmap, &c->half[1].bcast, "channel_update");
+	for (struct chan *ch = uintmap_first(&gs->rstate->chanmap, &idx);
+	     ch;
+	     ch = uintmap_after(&gs->rstate->chanmap, &idx)) {
+		move_broadcast(c->offmap, &ch->bcast, "channel_announce");
+		for (int dir = 0; dir < 2; dir++)
+			move_broadcasts(c->offmap,
+					&ch->half[dir].bcast,
+					&ch->half[dir].rgraph,
+					"channel_update");
 	}
 
 	/* That should be everything. */
-	omap = offmap_first(offmap, &oit);
+	omap = offmap_first(c->offmap, &oit);
 	if (omap)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "gossip_store: Entry at %zu->%zu not updated?",
 			      omap->from, omap->to);
 
-	if (count != gs->count - gs->deleted)
+	if (c->count - c->deleted != gs->count - gs->deleted)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "gossip_store: Expected %zu msgs in new"
 			      " gossip store, got %zu",
-			      gs->count - gs->deleted, count);
-
-	if (deleted != gs->deleted)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: Expected %zu deleted msgs in old"
-			      " gossip store, got %zu",
-			      gs->deleted, deleted);
+			      gs->count - gs->deleted, c->count - c->deleted);
 
 	if (rename(GOSSIP_STORE_TEMP_FILENAME, GOSSIP_STORE_FILENAME) == -1)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
@@ -563,26 +771,135 @@ bool gossip_store_compact(struct gossip_store *gs)
 
 	status_debug(
 	    "Compaction completed: dropped %zu messages, new count %zu, len %"PRIu64,
-	    deleted, count, len);
+	    gs->count - c->count, c->count, c->len);
+	status_debug("Compaction took %"PRIu64" msec in %zu steps"
+		     " (longest %"PRIu64" msec), read %"PRIu64" bytes",
+		     time_to_msec(timemono_between(time_mono(), c->start)),
+		     c->steps, time_to_msec(c->longest_step), c->bytes_read);
 
 	/* Write end marker now new one is ready */
-	append_msg(gs->fd, towire_gossip_store_ended(tmpctx, len),
+	append_msg(gs->fd, towire_gossip_store_ended(tmpctx, c->len),
 		   0, true, false, &gs->len);
+	bump_seq(gs);
 
-	gs->count = count;
-	gs->deleted = 0;
-	gs->len = len;
+	gs->count = c->count;
+	gs->deleted = c->deleted;
+	gs->len = c->len;
 	close(gs->fd);
-	gs->fd = fd;
+	gs->fd = c->fd;
 
+	/* Don't close or unlink it now! */
+	c->fd = -1;
+	gs->compaction = tal_free(c);
 	return true;
+}
 
-unlink_disable:
-	unlink(GOSSIP_STORE_TEMP_FILENAME);
-disable:
+static void compaction_failed(struct gossip_store *gs)
+{
 	status_debug("Encountered an error while compacting, disabling "
 		     "future compactions.");
 	gs->disable_compaction = true;
+	gs->compaction = tal_free(gs->compaction);
+}
+
+static void compaction_timer(struct gossip_store *gs)
+{
+	struct compaction *c = gs->compaction;
+
+	c->step_timer = NULL;
+	if (!compaction_step(gs, c)) {
+		compaction_failed(gs);
+		return;
+	}
+
+	if (c->off == gs->len) {
+		compaction_finish(gs, c);
+		return;
+	}
+
+	c->step_timer = new_reltimer(gs->rstate->timers, c,
+				     time_from_msec(COMPACT_STEP_INTERVAL_MSEC),
+				     compaction_timer, gs);
+}
+
+/* Once the store is mostly deleted entries, rewrite it in the background. */
+static void maybe_compact(struct gossip_store *gs)
+{
+	if (gs->compaction || gs->disable_compaction)
+		return;
+
+	if (gs->count < COMPACT_MIN_ENTRIES || gs->deleted < gs->count / 2)
+		return;
+
+	gs->compaction = compaction_start(gs);
+	if (!gs->compaction) {
+		compaction_failed(gs);
+		return;
+	}
+
+	gs->compaction->step_timer
+		= new_reltimer(gs->rstate->timers, gs->compaction,
+			       time_from_msec(COMPACT_STEP_INTERVAL_MSEC),
+			       compaction_timer, gs);
+}
+
+/* They deleted an entry from the old store: if we've already copied it,
+ * we need to delete it from the new store too. */
+static void compaction_delete(struct compaction *c,
+			      u32 index, u32 next_index, int type)
+{
+	struct offset_map *omap;
+	u32 new_next;
+
+	/* Not copied yet?  It will be skipped. */
+	if (index >= c->off)
+		return;
+
+	omap = offmap_get(c->offmap, index);
+	if (!omap)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "gossip_store: deleted entry %u not copied?",
+			      index);
+
+	new_next = mark_deleted(c->fd, omap->to);
+	c->deleted++;
+	offmap_del(c->offmap, omap);
+	tal_free(omap);
+
+	/* Amount is copied immediately after its channel_announcement. */
+	if (type == WIRE_CHANNEL_ANNOUNCEMENT && next_index < c->off) {
+		mark_deleted(c->fd, new_next);
+		c->deleted++;
+	}
+}
+
+/**
+ * Rewrite the on-disk gossip store, compacting it along the way
+ *
+ * Finishes any background compaction, or does a whole one now.
+ */
+bool gossip_store_compact(struct gossip_store *gs)
+{
+	if (gs->disable_compaction)
+		return false;
+
+	if (!gs->compaction) {
+		gs->compaction = compaction_start(gs);
+		if (!gs->compaction)
+			goto disable;
+	} else
+		gs->compaction->step_timer
+			= tal_free(gs->compaction->step_timer);
+
+	while (gs->compaction->off != gs->len) {
+		if (!compaction_step(gs, gs->compaction))
+			goto disable;
+	}
+
+	return compaction_finish(gs, gs->compaction);
+
+disable:
+	compaction_failed(gs);
 	return false;
 }
 
@@ -609,6 +926,7 @@ u64 gossip_store_add(struct gossip_store *gs, const u8 *gossip_msg,
 	gs->count++;
 	if (addendum)
 		gs->count++;
+	bump_seq(gs);
 	return off;
 }
 
@@ -623,8 +941,6 @@ u64 gossip_store_add_private_update(struct gossip_store *gs, const u8 *update)
 /* Returns index of following entry. */
 static u32 delete_by_index(struct gossip_store *gs, u32 index, int type)
 {
-	beint32_t belen;
-
 	/* Should never get here during loading! */
 	assert(gs->writable);
 
@@ -636,33 +952,21 @@ static u32 delete_by_index(struct gossip_store *gs, u32 index, int type)
 	assert(fromwire_peektype(msg) == type);
 #endif
 
-	if (pread(gs->fd, &belen, sizeof(belen), index) != sizeof(belen))
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "Failed reading len to delete @%u: %s",
-			      index, strerror(errno));
-
-	assert((be32_to_cpu(belen) & GOSSIP_STORE_LEN_DELETED_BIT) == 0);
-	belen |= cpu_to_be32(GOSSIP_STORE_LEN_DELETED_BIT);
-	if (pwrite(gs->fd, &belen, sizeof(belen), index) != sizeof(belen))
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "Failed writing len to delete @%u: %s",
-			      index, strerror(errno));
 	gs->deleted++;
-
-	return index + sizeof(struct gossip_hdr)
-		+ (be32_to_cpu(belen) & GOSSIP_STORE_LEN_MASK);
+	return mark_deleted(gs->fd, index);
 }
 
 void gossip_store_delete(struct gossip_store *gs,
 			 struct broadcastable *bcast,
 			 int type)
 {
-	u32 next_index;
+	u32 index, next_index;
 
 	if (!bcast->index)
 		return;
 
-	next_index = delete_by_index(gs, bcast->index, type);
+	index = bcast->index;
+	next_index = delete_by_index(gs, index, type);
 
 	/* Reset index. */
 	bcast->index = 0;
@@ -671,6 +975,11 @@ void gossip_store_delete(struct gossip_store *gs,
 	if (type == WIRE_CHANNEL_ANNOUNCEMENT)
 		delete_by_index(gs, next_index,
 				WIRE_GOSSIP_STORE_CHANNEL_AMOUNT);
+
+	if (gs->compaction)
+		compaction_delete(gs->compaction, index, next_index, type);
+	else
+		maybe_compact(gs);
 }
 
 void gossip_store_mark_channel_deleted(struct gossip_store *gs,
@@ -758,19 +1067,33 @@ u32 gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 	struct timeabs start = time_now();
 	u8 *chan_ann = NULL;
 	u64 chan_ann_off = 0; /* Spurious gcc-9 (Ubuntu 9-20190402-1ubuntu1) 9.0.1 20190402 (experimental) warning */
+	struct store_map *map;
 
 	gs->writable = false;
-	while (pread(gs->fd, &hdr, sizeof(hdr), gs->len) == sizeof(hdr)) {
+	map = map_store(gs, gs->fd);
+	if (!map) {
+		bad = tal_fmt(tmpctx, "gossip_store: reading: %s",
+			      strerror(errno));
+		goto corrupt;
+	}
+
+	/* Don't rehash the node table all the way up. */
+	routing_presize(rstate, map->len);
+
+	while (gs->len + sizeof(hdr) <= map->len) {
+		const u8 *p = map->data + gs->len + sizeof(hdr);
+
+		memcpy(&hdr, map->data + gs->len, sizeof(hdr));
 		msglen = be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_MASK;
 		checksum = be32_to_cpu(hdr.crc);
-		msg = tal_arr(tmpctx, u8, msglen);
 
-		if (pread(gs->fd, msg, msglen, gs->len+sizeof(hdr)) != msglen) {
+		if (gs->len + sizeof(hdr) + msglen > map->len) {
 			bad = "gossip_store: truncated file?";
 			goto corrupt;
 		}
 
-		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen)) {
+		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), p, msglen)) {
+			msg = tal_dup_arr(tmpctx, u8, p, msglen, 0);
 			bad = "Checksum verification failed";
 			goto badmsg;
 		}
@@ -783,6 +1106,8 @@ u32 gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 			goto next;
 		}
 
+		msg = tal_dup_arr(tmpctx, u8, p, msglen, 0);
+
 		switch (fromwire_peektype(msg)) {
 		case WIRE_GOSSIP_STORE_PRIVATE_CHANNEL: {
 			u8 *chan_ann;
@@ -878,6 +1203,7 @@ u32 gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 	if (bad)
 		goto corrupt;
 
+	tal_free(map);
 	goto out;
 
 badmsg:
@@ -887,8 +1213,11 @@ corrupt:
 	status_broken("gossip_store: %s. Moving to %s.corrupt and truncating",
 		      bad, GOSSIP_STORE_FILENAME);
 
+	tal_free(map);
+
 	/* FIXME: Debug partial truncate case. */
 	rename(GOSSIP_STORE_FILENAME, GOSSIP_STORE_FILENAME ".corrupt");
+	unlink(GOSSIP_STORE_FILENAME GOSSMAP_INDEX_SUFFIX);
 	close(gs->fd);
 	gs->fd = open(GOSSIP_STORE_FILENAME, O_RDWR|O_TRUNC|O_CREAT, 0600);
 	if (gs->fd < 0 || !write_all(gs->fd, &gs->version, sizeof(gs->version)))
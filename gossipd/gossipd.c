@@ -30,6 +30,7 @@
 #include <gossipd/gossip_generation.h>
 #include <gossipd/gossip_store_wiregen.h>
 #include <gossipd/gossipd.h>
+#include <gossipd/gossmap_index.h>
 #include <gossipd/gossipd_peerd_wiregen.h>
 #include <gossipd/gossipd_wiregen.h>
 #include <gossipd/queries.h>
@@ -668,6 +669,19 @@ static void gossip_refresh_network(struct daemon *daemon)
 	route_prune(daemon->rstate);
 }
 
+/*~ Every plugin which routes (pay, keysend, topology...) loads the
+ * gossip_store into a `struct gossmap` at startup, which means parsing
+ * every message in it.  We write out an index every so often: they can mmap
+ * that and only catch up on what's been appended since. */
+static void write_gossmap_index(struct daemon *daemon)
+{
+	notleak(new_reltimer(&daemon->timers, daemon,
+			     time_from_sec(GOSSMAP_INDEX_INTERVAL(daemon->rstate->dev_fast_gossip)),
+			     write_gossmap_index, daemon));
+
+	update_gossmap_index(daemon, &daemon->gossmap);
+}
+
 /* Disables all channels connected to our node. */
 static void gossip_disable_local_channels(struct daemon *daemon)
 {
@@ -764,6 +778,11 @@ static void gossip_init(struct daemon *daemon, const u8 *msg)
 			     time_from_sec(GOSSIP_PRUNE_INTERVAL(daemon->rstate->dev_fast_gossip_prune) / 4),
 			     gossip_refresh_network, daemon));
 
+	/* We don't slow startup by writing the index immediately. */
+	notleak(new_reltimer(&daemon->timers, daemon,
+			     time_from_sec(GOSSMAP_INDEX_INTERVAL(daemon->rstate->dev_fast_gossip)),
+			     write_gossmap_index, daemon));
+
 	/* Fire up the seeker! */
 	daemon->seeker = new_seeker(daemon);
 
@@ -1103,6 +1122,7 @@ int main(int argc, char *argv[])
 	daemon->remote_addr_v4 = NULL;
 	daemon->remote_addr_v6 = NULL;
 	list_head_init(&daemon->deferred_updates);
+	daemon->gossmap = NULL;
 
 	/* Tell the ecdh() function how to talk to hsmd */
 	ecdh_hsmd_setup(HSM_FD, status_failed);
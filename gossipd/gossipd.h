@@ -13,6 +13,7 @@
 
 struct chan;
 struct channel_update_timestamps;
+struct gossmap;
 struct broadcastable;
 struct lease_rates;
 struct seeker;
@@ -71,6 +72,9 @@ struct daemon {
 
 	/* Any of our channel_updates we're deferring. */
 	struct list_head deferred_updates;
+
+	/* Our own view of the gossip_store, to write the index for plugins. */
+	struct gossmap *gossmap;
 };
 
 struct range_query_reply {
@@ -0,0 +1,25 @@
+#include "config.h"
+#include <common/gossip_constants.h>
+#include <common/gossmap.h>
+#include <common/status.h>
+#include <errno.h>
+#include <gossipd/gossmap_index.h>
+
+/*~ This is in its own file, since common/gossmap.h and
+ * gossipd/routing.h both define `struct half_chan`. */
+void update_gossmap_index(const tal_t *ctx, struct gossmap **gossmap)
+{
+	if (!*gossmap) {
+		*gossmap = gossmap_load(ctx, GOSSIP_STORE_FILENAME, NULL);
+		if (!*gossmap) {
+			status_unusual("Could not load %s for gossmap index: %s",
+				       GOSSIP_STORE_FILENAME, strerror(errno));
+			return;
+		}
+	} else if (!gossmap_refresh(*gossmap, NULL))
+		return;
+
+	if (!gossmap_write_index(*gossmap))
+		status_unusual("Could not write gossmap index: %s",
+			       strerror(errno));
+}
@@ -0,0 +1,12 @@
+#ifndef LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H
+#define LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H
+#include "config.h"
+#include <ccan/tal/tal.h>
+
+struct gossmap;
+
+/* Load (first time) or refresh *gossmap from the gossip_store, and write out
+ * the index for plugins if anything changed. */
+void update_gossmap_index(const tal_t *ctx, struct gossmap **gossmap);
+
+#endif /* LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H */
@@ -3,13 +3,11 @@
 #include <bitcoin/chainparams.h>
 #include <ccan/array_size/array_size.h>
 #include <ccan/asort/asort.h>
-#include <ccan/crc32c/crc32c.h>
 #include <common/daemon_conn.h>
 #include <common/decode_array.h>
 #include <common/status.h>
 #include <common/type_to_string.h>
 #include <common/wire_error.h>
-#include <gossipd/gossip_generation.h>
 #include <gossipd/gossipd.h>
 #include <gossipd/gossipd_wiregen.h>
 #include <gossipd/queries.h>
@@ -328,28 +326,7 @@ static void send_reply_channel_range(struct peer *peer,
 	queue_peer_msg(peer, take(msg));
 }
 
-/* BOLT #7:
- *
- * The checksum of a `channel_update` is the CRC32C checksum as specified in
- * [RFC3720](https://tools.ietf.org/html/rfc3720#appendix-B.4) of this
- * `channel_update` without its `signature` and `timestamp` fields.
- */
-static u32 crc32_of_update(const u8 *channel_update)
-{
-	u32 sum;
-	const u8 *parts[2];
-	size_t sizes[ARRAY_SIZE(parts)];
-
-	get_cupdate_parts(channel_update, parts, sizes);
-
-	sum = 0;
-	for (size_t i = 0; i < ARRAY_SIZE(parts); i++)
-		sum = crc32c(sum, parts[i], sizes[i]);
-	return sum;
-}
-
-static void get_checksum_and_timestamp(struct routing_state *rstate,
-				       const struct chan *chan,
+static void get_checksum_and_timestamp(const struct chan *chan,
 				       int direction,
 				       u32 *tstamp, u32 *csum)
 {
@@ -358,10 +335,8 @@ static void get_checksum_and_timestamp(struct routing_state *rstate,
 	if (!is_chan_public(chan) || !is_halfchan_defined(hc)) {
 		*tstamp = *csum = 0;
 	} else {
-		const u8 *update = gossip_store_get(tmpctx, rstate->gs,
-						    hc->bcast.index);
 		*tstamp = hc->bcast.timestamp;
-		*csum = crc32_of_update(update);
+		*csum = hc->bcast_checksum;
 	}
 }
 
@@ -427,6 +402,7 @@ static struct short_channel_id *gather_range(const tal_t *ctx,
 					     struct channel_update_checksums **csums)
 {
 	struct short_channel_id scid, *scids;
+	struct chan *chan;
 	u32 end_block;
 	bool scid_ok;
 
@@ -464,16 +440,13 @@ static struct short_channel_id *gather_range(const tal_t *ctx,
 	 * integer.
 	 *
 	 * First we iterate and gather all the short channel ids. */
-	while (uintmap_after(&rstate->chanmap, &scid.u64)) {
-		struct chan *chan;
+	while ((chan = uintmap_after(&rstate->chanmap, &scid.u64)) != NULL) {
 		struct channel_update_timestamps ts;
 		struct channel_update_checksums cs;
 
 		if (short_channel_id_blocknum(&scid) > end_block)
 			break;
 
-		/* FIXME: Store csum in header. */
-		chan = get_channel(rstate, &scid);
 		if (!is_chan_public(chan))
 			continue;
 
@@ -484,10 +457,10 @@ static struct short_channel_id *gather_range(const tal_t *ctx,
 		      & (QUERY_ADD_TIMESTAMPS|QUERY_ADD_CHECKSUMS)))
 			continue;
 
-		get_checksum_and_timestamp(rstate, chan, 0,
+		get_checksum_and_timestamp(chan, 0,
 					   &ts.timestamp_node_id_1,
 					   &cs.checksum_node_id_1);
-		get_checksum_and_timestamp(rstate, chan, 1,
+		get_checksum_and_timestamp(chan, 1,
 					   &ts.timestamp_node_id_2,
 					   &cs.checksum_node_id_2);
 		if (query_option_flags & QUERY_ADD_TIMESTAMPS)
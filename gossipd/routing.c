@@ -121,6 +121,17 @@ static struct node_map *new_node_map(const tal_t *ctx)
 	return map;
 }
 
+void routing_presize(struct routing_state *rstate, size_t store_len)
+{
+	/* Like gossmap, assume each node accounts for about 2500 bytes of
+	 * store, and halve it since some records will be deleted. */
+	struct node_map_iter it;
+
+	assert(!node_map_first(rstate->nodes, &it));
+	node_map_clear(rstate->nodes);
+	node_map_init_sized(rstate->nodes, store_len / 2500 / 2);
+}
+
 /* We use a simple array (with NULL entries) until we have too many. */
 static bool node_uses_chan_map(const struct node *node)
 {
@@ -548,6 +559,7 @@ static void init_half_chan(struct routing_state *rstate,
 
 	broadcastable_init(&c->bcast);
 	broadcastable_init(&c->rgraph);
+	c->bcast_checksum = 0;
 	c->tokens = TOKEN_MAX;
 }
 
@@ -1436,6 +1448,7 @@ bool routing_add_channel_update(struct routing_state *rstate,
 	} else {
 		/* Safe to broadcast */
 		hc->bcast.timestamp = timestamp;
+		hc->bcast_checksum = crc32_of_update(update);
 		/* Remove prior spam update if one exists. */
 		if (hc->rgraph.index != hc->bcast.index) {
 			/* If it's a private channel it would be a
@@ -27,6 +27,10 @@ struct half_chan {
 	 * non-broadcastable. If there is no spam, rgraph == bcast. */
 	struct broadcastable rgraph;
 
+	/* crc32_of_update() of the bcast channel_update, so we can answer
+	 * query_channel_range without reading back from the store. */
+	u32 bcast_checksum;
+
 	/* Token bucket */
 	u8 tokens;
 };
@@ -242,6 +246,9 @@ struct routing_state {
 #endif
 };
 
+/* We're about to load a gossip_store this big: size tables to suit. */
+void routing_presize(struct routing_state *rstate, size_t store_len);
+
 /* Which direction are we?  False if neither. */
 static inline bool local_direction(struct routing_state *rstate,
 				   const struct chan *chan,
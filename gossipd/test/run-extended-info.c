@@ -51,20 +51,10 @@ void ecdh(const struct pubkey *point UNNEEDED, struct secret *ss UNNEEDED)
 /* Generated stub for fromwire_gossipd_dev_set_max_scids_encode_size */
 bool fromwire_gossipd_dev_set_max_scids_encode_size(const void *p UNNEEDED, u32 *max UNNEEDED)
 { fprintf(stderr, "fromwire_gossipd_dev_set_max_scids_encode_size called!\n"); abort(); }
-/* Generated stub for get_cupdate_parts */
-void get_cupdate_parts(const u8 *channel_update UNNEEDED,
-		       const u8 *parts[2] UNNEEDED,
-		       size_t sizes[2])
-{ fprintf(stderr, "get_cupdate_parts called!\n"); abort(); }
 /* Generated stub for get_node */
 struct node *get_node(struct routing_state *rstate UNNEEDED,
 		      const struct node_id *id UNNEEDED)
 { fprintf(stderr, "get_node called!\n"); abort(); }
-/* Generated stub for gossip_store_get */
-const u8 *gossip_store_get(const tal_t *ctx UNNEEDED,
-			   struct gossip_store *gs UNNEEDED,
-			   u64 offset UNNEEDED)
-{ fprintf(stderr, "gossip_store_get called!\n"); abort(); }
 /* Generated stub for master_badmsg */
 void master_badmsg(u32 type_expected UNNEEDED, const u8 *msg)
 { fprintf(stderr, "master_badmsg called!\n"); abort(); }
@@ -0,0 +1,364 @@
+#include "config.h"
+#include "../gossip_store.c"
+#include <ccan/tal/path/path.h>
+#include <common/pseudorand.h>
+#include <common/setup.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* Generated stub for private_channel_announcement */
+const u8 *private_channel_announcement(const tal_t *ctx UNNEEDED,
+				       const struct short_channel_id *scid UNNEEDED,
+				       const struct node_id *local_node_id UNNEEDED,
+				       const struct node_id *remote_node_id UNNEEDED,
+				       const u8 *features UNNEEDED)
+{ fprintf(stderr, "private_channel_announcement called!\n"); abort(); }
+/* Generated stub for remove_all_gossip */
+void remove_all_gossip(struct routing_state *rstate UNNEEDED)
+{ fprintf(stderr, "remove_all_gossip called!\n"); abort(); }
+/* Generated stub for routing_add_channel_announcement */
+bool routing_add_channel_announcement(struct routing_state *rstate UNNEEDED,
+				      const u8 *msg TAKES UNNEEDED,
+				      struct amount_sat sat UNNEEDED,
+				      u32 index UNNEEDED,
+				      struct peer *peer UNNEEDED)
+{ fprintf(stderr, "routing_add_channel_announcement called!\n"); abort(); }
+/* Generated stub for routing_add_channel_update */
+bool routing_add_channel_update(struct routing_state *rstate UNNEEDED,
+				const u8 *update TAKES UNNEEDED,
+				u32 index UNNEEDED,
+				struct peer *peer UNNEEDED,
+				bool ignore_timestamp UNNEEDED,
+				bool force_spam_flag UNNEEDED)
+{ fprintf(stderr, "routing_add_channel_update called!\n"); abort(); }
+/* Generated stub for routing_add_node_announcement */
+bool routing_add_node_announcement(struct routing_state *rstate UNNEEDED,
+				   const u8 *msg TAKES UNNEEDED,
+				   u32 index UNNEEDED,
+				   struct peer *peer UNNEEDED,
+				   bool *was_unknown UNNEEDED,
+				   bool force_spam_flag UNNEEDED)
+{ fprintf(stderr, "routing_add_node_announcement called!\n"); abort(); }
+/* Generated stub for routing_add_private_channel */
+bool routing_add_private_channel(struct routing_state *rstate UNNEEDED,
+				 const struct node_id *id UNNEEDED,
+				 struct amount_sat sat UNNEEDED,
+				 const u8 *chan_ann UNNEEDED, u64 index UNNEEDED)
+{ fprintf(stderr, "routing_add_private_channel called!\n"); abort(); }
+/* Generated stub for routing_presize */
+void routing_presize(struct routing_state *rstate UNNEEDED, size_t store_len UNNEEDED)
+{ fprintf(stderr, "routing_presize called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for unfinalized_entries */
+const char *unfinalized_entries(const tal_t *ctx UNNEEDED, struct routing_state *rstate UNNEEDED)
+{ fprintf(stderr, "unfinalized_entries called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+void status_fmt(enum log_level level UNNEEDED,
+		const struct node_id *node_id UNNEEDED,
+		const char *fmt UNNEEDED, ...)
+{
+}
+
+const struct node_id *node_map_keyof_node(const struct node *n)
+{
+	return &n->id;
+}
+
+size_t node_map_hash_key(const struct node_id *pc)
+{
+	return siphash24(siphash_seed(), pc->k, sizeof(pc->k));
+}
+
+bool node_map_node_eq(const struct node *n, const struct node_id *pc)
+{
+	return node_id_eq(&n->id, pc);
+}
+
+/* Big enough that a compaction step only covers a few dozen entries. */
+#define FAKE_MSG_PAD 40000
+#define NUM_CHANS 32
+#define NUM_NODES 8
+
+/* type, id, dir, version */
+#define FAKE_MSG_HDR (2 + 8 + 1 + 4)
+#define ENTRY_LEN(pad) (sizeof(struct gossip_hdr) + FAKE_MSG_HDR + (pad))
+
+/* We don't care what's in them, as long as we can tell them apart:
+ * type, id (scid or node number), direction and version. */
+static u8 *fake_msg(const tal_t *ctx, int type, u64 id, u8 dir, u32 version,
+		    size_t pad)
+{
+	u8 *msg = tal_arr(ctx, u8, 0);
+
+	towire_u16(&msg, type);
+	towire_u64(&msg, id);
+	towire_u8(&msg, dir);
+	towire_u32(&msg, version);
+	towire_pad(&msg, pad);
+	return msg;
+}
+
+static u8 *amount_msg(const tal_t *ctx)
+{
+	return towire_gossip_store_channel_amount(ctx, AMOUNT_SAT(1000));
+}
+
+/* The amount is appended right after its channel_announcement. */
+static u32 amount_index(const struct chan *chan)
+{
+	return chan->bcast.index + ENTRY_LEN(FAKE_MSG_PAD);
+}
+
+static void check_entry(struct gossip_store *gs,
+			const struct broadcastable *bcast,
+			int type, u64 id, u8 dir, u32 version)
+{
+	const u8 *msg = gossip_store_get(tmpctx, gs, bcast->index);
+	size_t len = tal_bytelen(msg);
+
+	assert(fromwire_u16(&msg, &len) == type);
+	assert(fromwire_u64(&msg, &len) == id);
+	assert(fromwire_u8(&msg, &len) == dir);
+	assert(fromwire_u32(&msg, &len) == version);
+}
+
+struct test_chan {
+	struct chan *chan;
+	/* Version of the current channel_update in each direction. */
+	u32 version[2];
+};
+
+static void add_update(struct gossip_store *gs, struct test_chan *tc, int dir)
+{
+	struct half_chan *hc = &tc->chan->half[dir];
+
+	if (hc->bcast.index)
+		gossip_store_delete(gs, &hc->bcast, WIRE_CHANNEL_UPDATE);
+	tc->version[dir]++;
+	hc->bcast.index = gossip_store_add(gs,
+					   fake_msg(tmpctx, WIRE_CHANNEL_UPDATE,
+						    tc->chan->scid.u64,
+						    dir, tc->version[dir],
+						    FAKE_MSG_PAD),
+					   0, false, false, NULL);
+	hc->rgraph = hc->bcast;
+}
+
+static void add_chan(struct routing_state *rstate, struct test_chan *tc, u64 scid)
+{
+	struct chan *chan = tal(rstate, struct chan);
+
+	chan->scid.u64 = scid;
+	chan->bcast.index
+		= gossip_store_add(rstate->gs,
+				   fake_msg(tmpctx, WIRE_CHANNEL_ANNOUNCEMENT,
+					    scid, 0, 0, FAKE_MSG_PAD),
+				   0, false, false, amount_msg(tmpctx));
+	for (int dir = 0; dir < 2; dir++) {
+		chan->half[dir].bcast.index = 0;
+		tc->version[dir] = 0;
+	}
+	tc->chan = chan;
+	uintmap_add(&rstate->chanmap, scid, chan);
+	for (int dir = 0; dir < 2; dir++)
+		add_update(rstate->gs, tc, dir);
+}
+
+static void del_chan(struct routing_state *rstate, struct test_chan *tc)
+{
+	for (int dir = 0; dir < 2; dir++)
+		gossip_store_delete(rstate->gs, &tc->chan->half[dir].bcast,
+				    WIRE_CHANNEL_UPDATE);
+	gossip_store_delete(rstate->gs, &tc->chan->bcast,
+			    WIRE_CHANNEL_ANNOUNCEMENT);
+	uintmap_del(&rstate->chanmap, tc->chan->scid.u64);
+	tc->chan = tal_free(tc->chan);
+}
+
+static void add_nannounce(struct gossip_store *gs, struct node *node,
+			  u32 *version, size_t pad)
+{
+	if (node->bcast.index)
+		gossip_store_delete(gs, &node->bcast, WIRE_NODE_ANNOUNCEMENT);
+	(*version)++;
+	node->bcast.index = gossip_store_add(gs,
+					     fake_msg(tmpctx,
+						      WIRE_NODE_ANNOUNCEMENT,
+						      node->id.k[0], 0,
+						      *version, pad),
+					     0, false, false, NULL);
+	node->rgraph = node->bcast;
+}
+
+/* Walk the whole file: every live entry must be one we point at. */
+static size_t count_live(struct gossip_store *gs)
+{
+	struct gossip_hdr hdr;
+	size_t live = 0;
+	u64 off = sizeof(gs->version);
+
+	while (pread(gs->fd, &hdr, sizeof(hdr), off) == sizeof(hdr)) {
+		if (!(be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT))
+			live++;
+		off += sizeof(hdr) + (be32_to_cpu(hdr.len)
+				      & GOSSIP_STORE_LEN_MASK);
+	}
+	assert(off == gs->len);
+	return live;
+}
+
+int main(int argc, char *argv[])
+{
+	struct routing_state *rstate;
+	struct gossip_store *gs;
+	struct test_chan chans[NUM_CHANS];
+	struct node *nodes[NUM_NODES];
+	u32 node_version[NUM_NODES];
+	char *dir;
+	size_t live, copied_before, chanlen, first_len;
+	struct test_chan *split;
+
+	common_setup(argv[0]);
+
+	/* The store lives in the current directory. */
+	dir = path_join(tmpctx, getenv("TMPDIR") ?: "/tmp",
+			"run-gossip_store_compact.XXXXXX");
+	assert(mkdtemp(dir));
+	assert(chdir(dir) == 0);
+
+	rstate = tal(tmpctx, struct routing_state);
+	rstate->nodes = tal(rstate, struct node_map);
+	node_map_init(rstate->nodes);
+	uintmap_init(&rstate->chanmap);
+	rstate->gs = gs = gossip_store_new(rstate, NULL);
+
+	chanlen = 3 * ENTRY_LEN(FAKE_MSG_PAD)
+		+ sizeof(struct gossip_hdr) + tal_bytelen(amount_msg(tmpctx));
+	first_len = (COMPACT_STEP_BYTES - NUM_NODES * ENTRY_LEN(FAKE_MSG_PAD))
+		% chanlen;
+	assert(first_len >= ENTRY_LEN(0));
+
+	for (size_t i = 0; i < NUM_NODES; i++) {
+		nodes[i] = tal(rstate, struct node);
+		memset(&nodes[i]->id, 0, sizeof(nodes[i]->id));
+		nodes[i]->id.k[0] = i;
+		nodes[i]->bcast.index = 0;
+		node_version[i] = 0;
+		node_map_add(rstate->nodes, nodes[i]);
+		/* Size the first one so the first compaction step ends
+		 * between a channel_announcement and its amount. */
+		if (i == 0)
+			add_nannounce(gs, nodes[i], &node_version[i],
+				      first_len - ENTRY_LEN(0));
+		else
+			add_nannounce(gs, nodes[i], &node_version[i],
+				      FAKE_MSG_PAD);
+	}
+
+	for (size_t i = 0; i < NUM_CHANS; i++)
+		add_chan(rstate, &chans[i], 1000 + i);
+
+	/* Supersede half the updates, so there's something to drop. */
+	for (size_t i = 0; i < NUM_CHANS; i += 2)
+		add_update(gs, &chans[i], i % 4 == 0);
+
+	/* Copy the first part across. */
+	gs->compaction = compaction_start(gs);
+	assert(gs->compaction);
+	assert(compaction_step(gs, gs->compaction));
+	copied_before = gs->compaction->off;
+	assert(copied_before < gs->len);
+
+	split = NULL;
+	for (size_t i = 0; i < NUM_CHANS; i++) {
+		if (amount_index(chans[i].chan) == copied_before)
+			split = &chans[i];
+	}
+	assert(split);
+	assert(split->chan->bcast.index < copied_before);
+
+	/* A channel_announcement copied without its amount. */
+	del_chan(rstate, split);
+
+	/* Now change things on both sides of where we're up to. */
+	for (size_t i = 0; i < NUM_CHANS; i++) {
+		if (!chans[i].chan)
+			continue;
+		if (i % 3 == 0)
+			add_update(gs, &chans[i], 0);
+		if (i % 5 == 0)
+			del_chan(rstate, &chans[i]);
+	}
+	for (size_t i = 0; i < NUM_NODES; i += 2)
+		add_nannounce(gs, nodes[i], &node_version[i], FAKE_MSG_PAD);
+
+	/* Another step, then more changes (including a new channel). */
+	assert(compaction_step(gs, gs->compaction));
+	if (chans[1].chan)
+		del_chan(rstate, &chans[1]);
+	add_chan(rstate, &chans[0], 2000);
+	for (size_t i = 0; i < NUM_CHANS; i++) {
+		if (chans[i].chan && i % 4 == 1)
+			add_update(gs, &chans[i], 1);
+	}
+
+	/* Finish it off. */
+	assert(gossip_store_compact(gs));
+	assert(!gs->compaction);
+
+	/* Everything we point to is where we expect, with what we expect. */
+	live = 0;
+	for (size_t i = 0; i < NUM_NODES; i++) {
+		assert(nodes[i]->rgraph.index == nodes[i]->bcast.index);
+		check_entry(gs, &nodes[i]->bcast, WIRE_NODE_ANNOUNCEMENT,
+			    i, 0, node_version[i]);
+		live++;
+	}
+	for (size_t i = 0; i < NUM_CHANS; i++) {
+		const struct chan *chan = chans[i].chan;
+		const u8 *amt;
+		struct amount_sat sat;
+
+		if (!chan)
+			continue;
+		check_entry(gs, &chan->bcast, WIRE_CHANNEL_ANNOUNCEMENT,
+			    chan->scid.u64, 0, 0);
+		/* Amount follows announcement */
+		amt = gossip_store_get(tmpctx, gs, amount_index(chan));
+		assert(fromwire_gossip_store_channel_amount(amt, &sat));
+		assert(amount_sat_eq(sat, AMOUNT_SAT(1000)));
+		live += 2;
+		for (int dir = 0; dir < 2; dir++) {
+			assert(chan->half[dir].rgraph.index
+			       == chan->half[dir].bcast.index);
+			check_entry(gs, &chan->half[dir].bcast,
+				    WIRE_CHANNEL_UPDATE,
+				    chan->scid.u64, dir, chans[i].version[dir]);
+			live++;
+		}
+	}
+
+	/* And nothing else is left. */
+	assert(count_live(gs) == live);
+	assert(gs->count - gs->deleted == live);
+
+	/* The temporary file was renamed into place. */
+	assert(access(GOSSIP_STORE_TEMP_FILENAME, F_OK) != 0);
+
+	tal_free(gs);
+	unlink(GOSSIP_STORE_FILENAME);
+	unlink(GOSSIP_STORE_FILENAME GOSSIP_STORE_SEQ_SUFFIX);
+	assert(rmdir(dir) == 0);
+	common_shutdown();
+	return 0;
+}
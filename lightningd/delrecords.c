@@ -0,0 +1,112 @@
+#include "config.h"
+#include <ccan/array_size/array_size.h>
+#include <common/json_command.h>
+#include <common/json_param.h>
+#include <common/json_stream.h>
+#include <lightningd/jsonrpc.h>
+#include <lightningd/lightningd.h>
+#include <wallet/wallet.h>
+
+/* The things autoclean (or anyone else) can bulk-delete. */
+enum del_subsystem {
+	DEL_EXPIREDINVOICES,
+	DEL_SUCCEEDEDPAYS,
+	DEL_FAILEDPAYS,
+	DEL_SUCCEEDEDFORWARDS,
+	DEL_FAILEDFORWARDS,
+};
+
+static const char *del_subsystem_names[] = {
+	"expiredinvoices",
+	"succeededpays",
+	"failedpays",
+	"succeededforwards",
+	"failedforwards",
+};
+
+static struct command_result *param_del_subsystem(struct command *cmd,
+						  const char *name,
+						  const char *buffer,
+						  const jsmntok_t *tok,
+						  enum del_subsystem **subsystem)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(del_subsystem_names); i++) {
+		if (json_tok_streq(buffer, tok, del_subsystem_names[i])) {
+			*subsystem = tal(cmd, enum del_subsystem);
+			**subsystem = i;
+			return NULL;
+		}
+	}
+	return command_fail_badparam(cmd, name, buffer, tok,
+				     "should be 'expiredinvoices',"
+				     " 'succeededpays', 'failedpays',"
+				     " 'succeededforwards' or 'failedforwards'");
+}
+
+static struct command_result *json_delrecords(struct command *cmd,
+					      const char *buffer,
+					      const jsmntok_t *obj UNNEEDED,
+					      const jsmntok_t *params)
+{
+	enum del_subsystem *subsystem;
+	u64 *before;
+	u32 *limit;
+	size_t deleted;
+	struct wallet *w = cmd->ld->wallet;
+	struct json_stream *response;
+
+	if (!param(cmd, buffer, params,
+		   p_req("subsystem", param_del_subsystem, &subsystem),
+		   p_req("before", param_u64, &before),
+		   p_opt_def("limit", param_number, &limit, 1000),
+		   NULL))
+		return command_param_failed();
+
+	if (*limit == 0)
+		return command_fail_badparam(cmd, "limit", buffer, params,
+					     "must be non-zero");
+
+	/* Every call is its own db transaction: keep limit small and
+	 * call it repeatedly, rather than locking us up for minutes. */
+	switch (*subsystem) {
+	case DEL_EXPIREDINVOICES:
+		deleted = wallet_invoice_delete_expired_limit(w, *before,
+							      *limit);
+		break;
+	case DEL_SUCCEEDEDPAYS:
+		deleted = wallet_payments_delete_old(w, PAYMENT_COMPLETE,
+						     *before, *limit);
+		break;
+	case DEL_FAILEDPAYS:
+		deleted = wallet_payments_delete_old(w, PAYMENT_FAILED,
+						     *before, *limit);
+		break;
+	case DEL_SUCCEEDEDFORWARDS:
+		deleted = wallet_forwarded_payments_delete_old(w,
+							       FORWARD_SETTLED,
+							       *before,
+							       *limit);
+		break;
+	case DEL_FAILEDFORWARDS:
+		deleted = wallet_forwarded_payments_delete_old(w,
+							       FORWARD_FAILED,
+							       *before,
+							       *limit);
+		break;
+	}
+
+	response = json_stream_success(cmd);
+	json_add_string(response, "subsystem", del_subsystem_names[*subsystem]);
+	json_add_u64(response, "deleted", deleted);
+	return command_success(cmd, response);
+}
+
+static const struct json_command delrecords_command = {
+	"delrecords",
+	"utility",
+	json_delrecords,
+	"Delete up to {limit} (default 1000) records of {subsystem} older than {before} (a UNIX epoch time)",
+	false,
+	"Deletes records of {subsystem}: 'expiredinvoices' (by expiry time), 'succeededpays' or 'failedpays' (by creation time), or 'succeededforwards' or 'failedforwards' (by resolution time), which are at or before {before}, oldest first.  Returns the number deleted: if this is less than {limit}, there are no more."
+};
+AUTODATA(json_command, &delrecords_command);
@@ -1,6 +1,8 @@
 #include "config.h"
 #include <ccan/err/err.h>
 #include <ccan/fdpass/fdpass.h>
+#include <ccan/list/list.h>
+#include <common/daemon_conn.h>
 #include <common/ecdh.h>
 #include <common/errcode.h>
 #include <common/hsm_encryption.h>
@@ -8,7 +10,9 @@
 #include <common/json_param.h>
 #include <common/jsonrpc_errors.h>
 #include <common/type_to_string.h>
+#include <db/exec.h>
 #include <errno.h>
+#include <hsmd/capabilities.h>
 #include <hsmd/hsmd_wiregen.h>
 #include <lightningd/hsm_control.h>
 #include <lightningd/jsonrpc.h>
@@ -16,6 +20,7 @@
 #include <lightningd/subd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <wallet/wallet.h>
 #include <wally_bip32.h>
 #include <wire/wire_sync.h>
 
@@ -75,6 +80,117 @@ static unsigned int hsm_msg(struct subd *hsmd,
 	return 0;
 }
 
+/* Our own hsmd client connection for hsm_req(), so sync requests on
+ * ld->hsm_fd never see its replies. */
+struct hsm_async {
+	struct lightningd *ld;
+	struct daemon_conn *dc;
+	/* Requests we've sent, in order: hsmd replies in the same order. */
+	struct list_head pending;
+};
+
+/* On hsm->pending: stays there even if the request is freed, since hsmd
+ * will still reply. */
+struct hsm_pending {
+	struct list_node list;
+	struct hsm_request *req;
+};
+
+/* Allocated off the caller's ctx */
+struct hsm_request {
+	struct hsm_pending *pending;
+	void (*cb)(struct lightningd *ld, const u8 *reply, void *arg);
+	void *arg;
+};
+
+static void destroy_hsm_request(struct hsm_request *req)
+{
+	req->pending->req = NULL;
+}
+
+static struct io_plan *hsm_async_reply(struct io_conn *conn,
+				       const u8 *msg,
+				       struct hsm_async *hsm)
+{
+	struct hsm_pending *pending;
+	struct hsm_request *req;
+
+	pending = list_pop(&hsm->pending, struct hsm_pending, list);
+	if (!pending)
+		fatal("Unexpected reply from HSM: %s", tal_hex(tmpctx, msg));
+
+	req = pending->req;
+	tal_free(pending);
+	if (req) {
+		void (*cb)(struct lightningd *, const u8 *, void *) = req->cb;
+		void *arg = req->arg;
+
+		/* cb may free req's parent, so get it out of the way. */
+		tal_del_destructor(req, destroy_hsm_request);
+		tal_free(req);
+
+		/* Everything we do, we wrap in a database transaction */
+		db_begin_transaction(hsm->ld->wallet->db);
+		cb(hsm->ld, msg, arg);
+		db_commit_transaction(hsm->ld->wallet->db);
+	}
+
+	return daemon_conn_read_next(conn, hsm->dc);
+}
+
+static void hsm_async_died(struct daemon_conn *dc, struct hsm_async *hsm)
+{
+	fatal("HSM async connection died");
+}
+
+void hsm_req_(const tal_t *ctx,
+	      struct lightningd *ld,
+	      const u8 *msg TAKES,
+	      void (*cb)(struct lightningd *ld, const u8 *reply, void *arg),
+	      void *arg)
+{
+	struct hsm_pending *pending = tal(ld->hsm_async, struct hsm_pending);
+	struct hsm_request *req = tal(ctx ? ctx : ld->hsm_async,
+				      struct hsm_request);
+
+	req->pending = pending;
+	req->cb = cb;
+	req->arg = arg;
+	tal_add_destructor(req, destroy_hsm_request);
+
+	pending->req = req;
+	list_add_tail(&ld->hsm_async->pending, &pending->list);
+	daemon_conn_send(ld->hsm_async->dc, msg);
+}
+
+void hsm_async_shutdown(struct lightningd *ld)
+{
+	struct hsm_pending *pending;
+
+	/* Requests which are still around must not touch pending now */
+	list_for_each(&ld->hsm_async->pending, pending, list) {
+		if (pending->req)
+			tal_del_destructor(pending->req, destroy_hsm_request);
+	}
+	tal_del_destructor2(ld->hsm_async->dc, hsm_async_died, ld->hsm_async);
+	tal_free(ld->hsm_async->dc);
+	ld->hsm_async = tal_free(ld->hsm_async);
+}
+
+static struct hsm_async *new_hsm_async(struct lightningd *ld)
+{
+	struct hsm_async *hsm = tal(ld, struct hsm_async);
+
+	hsm->ld = ld;
+	list_head_init(&hsm->pending);
+	hsm->dc = daemon_conn_new(hsm,
+				  hsm_get_global_fd(ld, HSM_CAP_ECDH
+						    | HSM_CAP_MASTER),
+				  hsm_async_reply, NULL, hsm);
+	tal_add_destructor2(hsm->dc, hsm_async_died, hsm);
+	return hsm;
+}
+
 struct ext_key *hsm_init(struct lightningd *ld)
 {
 	u8 *msg;
@@ -123,6 +239,7 @@ struct ext_key *hsm_init(struct lightningd *ld)
 		errx(EXITCODE_HSM_GENERIC_ERROR, "HSM did not give init reply");
 	}
 
+	ld->hsm_async = new_hsm_async(ld);
 	return bip32_base;
 }
 
@@ -2,6 +2,9 @@
 #define LIGHTNING_LIGHTNINGD_HSM_CONTROL_H
 #include "config.h"
 #include <ccan/short_types/short_types.h>
+#include <ccan/take/take.h>
+#include <ccan/tal/tal.h>
+#include <ccan/typesafe_cb/typesafe_cb.h>
 
 struct lightningd;
 struct node_id;
@@ -17,4 +20,24 @@ int hsm_get_client_fd(struct lightningd *ld,
 int hsm_get_global_fd(struct lightningd *ld, int capabilities);
 
 struct ext_key *hsm_init(struct lightningd *ld);
+
+/* Ask hsmd something without waiting for the answer: @cb is called with
+ * the reply (only valid until @cb returns).  Requests are pipelined: many
+ * can be outstanding at once, and hsmd answers them in the order sent.
+ * If @ctx is freed first, @cb is never called. */
+#define hsm_req(ctx, ld, msg, cb, arg)					\
+	hsm_req_((ctx), (ld), (msg),					\
+		 typesafe_cb_preargs(void, void *, (cb), (arg),		\
+				     struct lightningd *,		\
+				     const u8 *),			\
+		 (arg))
+
+void hsm_req_(const tal_t *ctx,
+	      struct lightningd *ld,
+	      const u8 *msg TAKES,
+	      void (*cb)(struct lightningd *ld, const u8 *reply, void *arg),
+	      void *arg);
+
+/* Stop hsm_req() connection (at shutdown, hsmd goes away). */
+void hsm_async_shutdown(struct lightningd *ld);
 #endif /* LIGHTNING_LIGHTNINGD_HSM_CONTROL_H */
@@ -19,12 +19,12 @@
 #include <errno.h>
 #include <hsmd/hsmd_wiregen.h>
 #include <lightningd/channel.h>
+#include <lightningd/hsm_control.h>
 #include <lightningd/invoice.h>
 #include <lightningd/notification.h>
 #include <lightningd/plugin_hook.h>
 #include <lightningd/routehint.h>
 #include <sodium/randombytes.h>
-#include <wire/wire_sync.h>
 
 static const char *invoice_status_str(const struct invoice_details *inv)
 {
@@ -472,43 +472,49 @@ void invoice_try_pay(struct lightningd *ld,
 	plugin_hook_call_invoice_payment(ld, payload);
 }
 
-static bool hsm_sign_b11(const u5 *u5bytes,
-			 const u8 *hrpu8,
-			 secp256k1_ecdsa_recoverable_signature *rsig,
-			 struct lightningd *ld)
+/* bolt11_encode() wants to sign as it goes: the first time through we just
+ * grab what hsmd needs to sign, so we don't have to wait for it. */
+static bool hsm_sign_b11_req(const u5 *u5bytes,
+			     const u8 *hrpu8,
+			     secp256k1_ecdsa_recoverable_signature *rsig,
+			     const u8 **req)
 {
-	u8 *msg = towire_hsmd_sign_invoice(NULL, u5bytes, hrpu8);
-
-	if (!wire_sync_write(ld->hsm_fd, take(msg)))
-		fatal("Could not write to HSM: %s", strerror(errno));
+	*req = towire_hsmd_sign_invoice(tmpctx, u5bytes, hrpu8);
+	/* We don't have a signature yet! */
+	return false;
+}
 
-	msg = wire_sync_read(tmpctx, ld->hsm_fd);
-        if (!fromwire_hsmd_sign_invoice_reply(msg, rsig))
+/* Then we encode it again using hsmd's reply. */
+static bool hsm_signed_b11(const u5 *u5bytes,
+			   const u8 *hrpu8,
+			   secp256k1_ecdsa_recoverable_signature *rsig,
+			   u8 *reply)
+{
+	if (!fromwire_hsmd_sign_invoice_reply(reply, rsig))
 		fatal("HSM gave bad sign_invoice_reply %s",
-		      tal_hex(msg, msg));
-
+		      tal_hex(tmpctx, reply));
 	return true;
 }
 
-static void hsm_sign_b12_invoice(struct lightningd *ld,
-				 struct tlv_invoice *invoice)
+static const u8 *hsm_sign_b12_invoice_req(const tal_t *ctx,
+					  const struct tlv_invoice *invoice)
 {
 	struct sha256 merkle;
-	u8 *msg;
 
 	assert(!invoice->signature);
 
- 	merkle_tlv(invoice->fields, &merkle);
-	msg = towire_hsmd_sign_bolt12(NULL, "invoice", "signature", &merkle, NULL);
-
-	if (!wire_sync_write(ld->hsm_fd, take(msg)))
-		fatal("Could not write to HSM: %s", strerror(errno));
+	merkle_tlv(invoice->fields, &merkle);
+	return towire_hsmd_sign_bolt12(ctx, "invoice", "signature", &merkle,
+				       NULL);
+}
 
-	msg = wire_sync_read(tmpctx, ld->hsm_fd);
+static void hsm_signed_b12_invoice(const u8 *reply,
+				   struct tlv_invoice *invoice)
+{
 	invoice->signature = tal(invoice, struct bip340sig);
-        if (!fromwire_hsmd_sign_bolt12_reply(msg, invoice->signature))
+	if (!fromwire_hsmd_sign_bolt12_reply(reply, invoice->signature))
 		fatal("HSM gave bad sign_invoice_reply %s",
-		      tal_hex(msg, msg));
+		      tal_hex(tmpctx, reply));
 }
 
 static struct command_result *parse_fallback(struct command *cmd,
@@ -689,24 +695,62 @@ struct invoice_info {
 	struct bolt11 *b11;
 	struct json_escape *label;
 	struct chanhints *chanhints;
+	/* Set by invoice_complete, for after hsmd has signed */
+	bool warning_no_listincoming, warning_mpp, warning_capacity,
+		warning_deadends, warning_offline, warning_private_unused;
+};
+
+/* What routehint_candidates() tells us: the same for every invoice in a
+ * createinvoices batch, so we only ask once. */
+struct inchan_candidates {
+	struct routehint_candidate *candidates;
+	bool node_unpublished;
+	struct amount_msat avail_capacity, private_capacity,
+		deadend_capacity, offline_capacity;
 };
 
-/* Add routehints based on listincoming results: NULL means success. */
+static struct inchan_candidates *
+get_inchan_candidates(const tal_t *ctx,
+		      struct lightningd *ld,
+		      const struct gossmap_incoming *incoming,
+		      const struct chanhints *chanhints)
+{
+	struct inchan_candidates *ic = tal(ctx, struct inchan_candidates);
+
+	ic->candidates = routehint_candidates(ic, ld, incoming,
+					      chanhints ? &chanhints->expose_all_private : NULL,
+					      chanhints ? chanhints->hints : NULL,
+					      &ic->node_unpublished,
+					      &ic->avail_capacity,
+					      &ic->private_capacity,
+					      &ic->deadend_capacity,
+					      &ic->offline_capacity);
+	return ic;
+}
+
+/* If they told us to use scids and we couldn't, that's an error. */
+static bool inchan_hints_unusable(const struct inchan_candidates *ic,
+				  const struct chanhints *chanhints)
+{
+	return tal_count(ic->candidates) == 0
+		&& chanhints && tal_count(chanhints->hints) != 0;
+}
+
+/* Add routehints based on our incoming channels: NULL means success. */
 static struct command_result *
 add_routehints(struct invoice_info *info,
-	       const char *buffer,
-	       const jsmntok_t *toks,
+	       const struct inchan_candidates *ic,
 	       bool *warning_mpp,
 	       bool *warning_capacity,
 	       bool *warning_deadends,
 	       bool *warning_offline,
 	       bool *warning_private_unused)
 {
-	const struct chanhints *chanhints = info->chanhints;
-	bool node_unpublished;
-	struct amount_msat avail_capacity, deadend_capacity, offline_capacity,
-		private_capacity;
-	struct routehint_candidate *candidates;
+	struct amount_msat avail_capacity = ic->avail_capacity,
+		deadend_capacity = ic->deadend_capacity,
+		offline_capacity = ic->offline_capacity,
+		private_capacity = ic->private_capacity;
+	struct routehint_candidate *candidates = ic->candidates;
 	struct amount_msat total, needed;
 
 	/* Dev code can force routes. */
@@ -717,19 +761,7 @@ add_routehints(struct invoice_info *info,
 		return NULL;
 	}
 
-	candidates = routehint_candidates(tmpctx, info->cmd->ld,
-					  buffer, toks,
-					  chanhints ? &chanhints->expose_all_private : NULL,
-					  chanhints ? chanhints->hints : NULL,
-					  &node_unpublished,
-					  &avail_capacity,
-					  &private_capacity,
-					  &deadend_capacity,
-					  &offline_capacity);
-
-	/* If they told us to use scids and we couldn't, fail. */
-	if (tal_count(candidates) == 0
-	    && chanhints && tal_count(chanhints->hints) != 0) {
+	if (inchan_hints_unusable(ic, info->chanhints)) {
 		return command_fail(info->cmd,
 				    INVOICE_HINTS_GAVE_NO_ROUTES,
 				    "None of those hints were suitable local channels");
@@ -752,7 +784,7 @@ add_routehints(struct invoice_info *info,
 	 * should make an effort to avoid overlapping incoming
 	 * channels, which is done by select_inchan_mpp.
 	 */
-	if (!node_unpublished)
+	if (!ic->node_unpublished)
 		info->b11->routes = select_inchan(info->b11,
 						  info->cmd->ld,
 						  needed,
@@ -830,31 +862,53 @@ done:
 	return NULL;
 }
 
-static struct command_result *
-invoice_complete(struct invoice_info *info,
-		 bool warning_no_listincoming,
-		 bool warning_mpp,
-		 bool warning_capacity,
-		 bool warning_deadends,
-		 bool warning_offline,
-		 bool warning_private_unused)
+static void json_add_invoice_warnings(struct json_stream *response,
+				      const struct invoice_info *info)
+{
+	if (info->warning_no_listincoming)
+		json_add_string(response, "warning_listincoming",
+				"No listincoming command available, cannot add routehints to invoice");
+	if (info->warning_mpp)
+		json_add_string(response, "warning_mpp",
+				"The invoice is only payable by MPP-capable payers.");
+	if (info->warning_capacity)
+		json_add_string(response, "warning_capacity",
+				"Insufficient incoming channel capacity to pay invoice");
+
+	if (info->warning_deadends)
+		json_add_string(response, "warning_deadends",
+				"Insufficient incoming capacity, once dead-end peers were excluded");
+
+	if (info->warning_offline)
+		json_add_string(response, "warning_offline",
+				"Insufficient incoming capacity, once offline peers were excluded");
+
+	if (info->warning_private_unused)
+		json_add_string(response, "warning_private_unused",
+				"Insufficient incoming capacity, once private channels were excluded (try exposeprivatechannels=true?)");
+}
+
+static void invoice_signed(struct lightningd *ld,
+			   const u8 *reply,
+			   struct invoice_info *info)
 {
 	struct json_stream *response;
 	struct invoice invoice;
 	char *b11enc;
 	const struct invoice_details *details;
 	struct secret payment_secret;
-	struct wallet *wallet = info->cmd->ld->wallet;
+	struct wallet *wallet = ld->wallet;
 
-	b11enc = bolt11_encode(info, info->b11, false,
-			       hsm_sign_b11, info->cmd->ld);
+	b11enc = bolt11_encode(info, info->b11, false, hsm_signed_b11,
+			       cast_const(u8 *, reply));
 
 	/* Check duplicate preimage (unlikely unless they specified it!) */
 	if (wallet_invoice_find_by_rhash(wallet,
 					 &invoice, &info->b11->payment_hash)) {
-		return command_fail(info->cmd,
-				    INVOICE_PREIMAGE_ALREADY_EXISTS,
-				    "preimage already used");
+		was_pending(command_fail(info->cmd,
+					 INVOICE_PREIMAGE_ALREADY_EXISTS,
+					 "preimage already used"));
+		return;
 	}
 
 	if (!wallet_invoice_create(wallet,
@@ -868,9 +922,11 @@ invoice_complete(struct invoice_info *info,
 				   &info->payment_preimage,
 				   &info->b11->payment_hash,
 				   NULL)) {
-		return command_fail(info->cmd, INVOICE_LABEL_ALREADY_EXISTS,
-				    "Duplicate label '%s'",
-				    info->label->s);
+		was_pending(command_fail(info->cmd,
+					 INVOICE_LABEL_ALREADY_EXISTS,
+					 "Duplicate label '%s'",
+					 info->label->s));
+		return;
 	}
 
 	/* Get details */
@@ -883,32 +939,39 @@ invoice_complete(struct invoice_info *info,
 	invoice_secret(&details->r, &payment_secret);
 	json_add_secret(response, "payment_secret", &payment_secret);
 
-	notify_invoice_creation(info->cmd->ld, info->b11->msat,
+	notify_invoice_creation(ld, info->b11->msat,
 				info->payment_preimage, info->label);
 
-	if (warning_no_listincoming)
-		json_add_string(response, "warning_listincoming",
-				"No listincoming command available, cannot add routehints to invoice");
-	if (warning_mpp)
-		json_add_string(response, "warning_mpp",
-				"The invoice is only payable by MPP-capable payers.");
-	if (warning_capacity)
-		json_add_string(response, "warning_capacity",
-				"Insufficient incoming channel capacity to pay invoice");
-
-	if (warning_deadends)
-		json_add_string(response, "warning_deadends",
-				"Insufficient incoming capacity, once dead-end peers were excluded");
-
-	if (warning_offline)
-		json_add_string(response, "warning_offline",
-				"Insufficient incoming capacity, once offline peers were excluded");
-
-	if (warning_private_unused)
-		json_add_string(response, "warning_private_unused",
-				"Insufficient incoming capacity, once private channels were excluded (try exposeprivatechannels=true?)");
+	json_add_invoice_warnings(response, info);
+	was_pending(command_success(info->cmd, response));
+}
 
-	return command_success(info->cmd, response);
+/* Ask hsmd to sign it: we finish in invoice_signed. */
+static struct command_result *
+invoice_complete(struct invoice_info *info,
+		 bool warning_no_listincoming,
+		 bool warning_mpp,
+		 bool warning_capacity,
+		 bool warning_deadends,
+		 bool warning_offline,
+		 bool warning_private_unused)
+{
+	const u8 *req = NULL;
+
+	info->warning_no_listincoming = warning_no_listincoming;
+	info->warning_mpp = warning_mpp;
+	info->warning_capacity = warning_capacity;
+	info->warning_deadends = warning_deadends;
+	info->warning_offline = warning_offline;
+	info->warning_private_unused = warning_private_unused;
+
+	bolt11_encode(tmpctx, info->b11, false, hsm_sign_b11_req, &req);
+	if (!req)
+		return command_fail(info->cmd, LIGHTNINGD,
+				    "Could not encode invoice");
+
+	hsm_req(info, info->cmd->ld, take(req), invoice_signed, info);
+	return command_still_pending(info->cmd);
 }
 
 /* Return from "listincoming". */
@@ -921,7 +984,11 @@ static void listincoming_done(const char *buffer,
 	struct command_result *ret;
 	bool warning_mpp, warning_capacity, warning_deadends, warning_offline, warning_private_unused;
 
-	ret = add_routehints(info, buffer, toks,
+	ret = add_routehints(info,
+			     get_inchan_candidates(tmpctx, ld,
+						   routehint_incoming_from_json(tmpctx, ld,
+										buffer, toks),
+						   info->chanhints),
 			     &warning_mpp,
 			     &warning_capacity,
 			     &warning_deadends,
@@ -1123,6 +1190,80 @@ static struct command_result *param_preimage(struct command *cmd,
 	return NULL;
 }
 
+static struct command_result *check_label_and_desc(struct command *cmd,
+						   const struct json_escape *label,
+						   const char *desc,
+						   bool hashonly)
+{
+	if (strlen(label->s) > INVOICE_MAX_LABEL_LEN) {
+		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+				    "Label '%s' over %u bytes", label->s,
+				    INVOICE_MAX_LABEL_LEN);
+	}
+
+	if (strlen(desc) > BOLT11_FIELD_BYTE_LIMIT && !hashonly) {
+		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+				    "Descriptions greater than %d bytes "
+				    "not yet supported "
+				    "(description length %zu)",
+				    BOLT11_FIELD_BYTE_LIMIT,
+				    strlen(desc));
+	}
+	return NULL;
+}
+
+/* Fill in info->payment_preimage and info->b11, all but the routes and
+ * fallbacks.  If @preimage is NULL, we make one up. */
+static void new_invoice_b11(struct invoice_info *info,
+			    struct lightningd *ld,
+			    const struct preimage *preimage,
+			    struct amount_msat *msat,
+			    const char *desc,
+			    u64 expiry,
+			    u32 cltv,
+			    bool hashonly)
+{
+	struct sha256 rhash;
+	struct secret payment_secret;
+
+	if (preimage)
+		info->payment_preimage = *preimage;
+	else
+		/* Generate random secret preimage. */
+		randombytes_buf(&info->payment_preimage,
+				sizeof(info->payment_preimage));
+	/* Generate preimage hash. */
+	sha256(&rhash, &info->payment_preimage, sizeof(info->payment_preimage));
+	/* Generate payment secret. */
+	invoice_secret(&info->payment_preimage, &payment_secret);
+
+	info->b11 = new_bolt11(info, msat);
+	info->b11->chain = chainparams;
+	info->b11->timestamp = time_now().ts.tv_sec;
+	info->b11->payment_hash = rhash;
+	info->b11->receiver_id = ld->id;
+	info->b11->min_final_cltv_expiry = cltv;
+	info->b11->expiry = expiry;
+	info->b11->description = tal_steal(info->b11, desc);
+	/* BOLT #11:
+	 * * `h` (23): `data_length` 52. 256-bit description of purpose of payment (SHA256).
+	 *...
+	 * A writer:
+	 *...
+	 *    - MUST include either exactly one `d` or exactly one `h` field.
+	 */
+	if (hashonly) {
+		info->b11->description_hash = tal(info->b11, struct sha256);
+		sha256(info->b11->description_hash, desc, strlen(desc));
+	} else
+		info->b11->description_hash = NULL;
+	info->b11->payment_secret = tal_dup(info->b11, struct secret,
+					    &payment_secret);
+	info->b11->features = tal_dup_talarr(info->b11, u8,
+					     ld->our_features
+					     ->bits[BOLT11_FEATURE]);
+}
+
 static struct command_result *json_invoice(struct command *cmd,
 					   const char *buffer,
 					   const jsmntok_t *obj UNNEEDED,
@@ -1134,13 +1275,13 @@ static struct command_result *json_invoice(struct command *cmd,
 	const char *desc_val;
 	const u8 **fallback_scripts = NULL;
 	u64 *expiry;
-	struct sha256 rhash;
-	struct secret payment_secret;
 	struct preimage *preimage;
 	u32 *cltv;
+	const struct gossmap_incoming *incoming;
 	struct jsonrpc_request *req;
 	struct plugin *plugin;
 	bool *hashonly;
+	struct command_result *ret;
 #if DEVELOPER
 	const jsmntok_t *routes;
 #endif
@@ -1166,20 +1307,9 @@ static struct command_result *json_invoice(struct command *cmd,
 		   NULL))
 		return command_param_failed();
 
-	if (strlen(info->label->s) > INVOICE_MAX_LABEL_LEN) {
-		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
-				    "Label '%s' over %u bytes", info->label->s,
-				    INVOICE_MAX_LABEL_LEN);
-	}
-
-	if (strlen(desc_val) > BOLT11_FIELD_BYTE_LIMIT && !*hashonly) {
-		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
-				    "Descriptions greater than %d bytes "
-				    "not yet supported "
-				    "(description length %zu)",
-				    BOLT11_FIELD_BYTE_LIMIT,
-				    strlen(desc_val));
-	}
+	ret = check_label_and_desc(cmd, info->label, desc_val, *hashonly);
+	if (ret)
+		return ret;
 
 	if (fallbacks) {
 		size_t i;
@@ -1195,42 +1325,8 @@ static struct command_result *json_invoice(struct command *cmd,
 		}
 	}
 
-	if (preimage)
-		info->payment_preimage = *preimage;
-	else
-		/* Generate random secret preimage. */
-		randombytes_buf(&info->payment_preimage,
-				sizeof(info->payment_preimage));
-	/* Generate preimage hash. */
-	sha256(&rhash, &info->payment_preimage, sizeof(info->payment_preimage));
-	/* Generate payment secret. */
-	invoice_secret(&info->payment_preimage, &payment_secret);
-
-	info->b11 = new_bolt11(info, msatoshi_val);
-	info->b11->chain = chainparams;
-	info->b11->timestamp = time_now().ts.tv_sec;
-	info->b11->payment_hash = rhash;
-	info->b11->receiver_id = cmd->ld->id;
-	info->b11->min_final_cltv_expiry = *cltv;
-	info->b11->expiry = *expiry;
-	info->b11->description = tal_steal(info->b11, desc_val);
-	/* BOLT #11:
-	 * * `h` (23): `data_length` 52. 256-bit description of purpose of payment (SHA256).
-	 *...
-	 * A writer:
-	 *...
-	 *    - MUST include either exactly one `d` or exactly one `h` field.
-	 */
-	if (*hashonly) {
-		info->b11->description_hash = tal(info->b11, struct sha256);
-		sha256(info->b11->description_hash, desc_val, strlen(desc_val));
-	} else
-		info->b11->description_hash = NULL;
-	info->b11->payment_secret = tal_dup(info->b11, struct secret,
-					    &payment_secret);
-	info->b11->features = tal_dup_talarr(info->b11, u8,
-					     cmd->ld->our_features
-					     ->bits[BOLT11_FEATURE]);
+	new_invoice_b11(info, cmd->ld, preimage, msatoshi_val, desc_val,
+			*expiry, *cltv, *hashonly);
 
 #if DEVELOPER
 	info->b11->routes = unpack_routes(info->b11, buffer, routes);
@@ -1240,6 +1336,33 @@ static struct command_result *json_invoice(struct command *cmd,
 	if (fallback_scripts)
 		info->b11->fallbacks = tal_steal(info->b11, fallback_scripts);
 
+	/* Usually we can read our channels from the gossip_store ourselves. */
+	incoming = routehint_incoming(cmd->ld);
+	if (incoming) {
+		bool warning_mpp, warning_capacity, warning_deadends,
+			warning_offline, warning_private_unused;
+
+		ret = add_routehints(info,
+				     get_inchan_candidates(tmpctx, cmd->ld,
+							   incoming,
+							   info->chanhints),
+				     &warning_mpp,
+				     &warning_capacity,
+				     &warning_deadends,
+				     &warning_offline,
+				     &warning_private_unused);
+		if (ret)
+			return ret;
+		return invoice_complete(info,
+					false,
+					warning_mpp,
+					warning_capacity,
+					warning_deadends,
+					warning_offline,
+					warning_private_unused);
+	}
+
+	/* Otherwise, ask the topology plugin. */
 	req = jsonrpc_request_start(info, "listincoming",
 				    cmd->ld->log,
 				    NULL, listincoming_done,
@@ -1268,6 +1391,265 @@ static const struct json_command invoice_command = {
 	"(default autogenerated)"};
 AUTODATA(json_command, &invoice_command);
 
+/* One invoice in a createinvoices batch */
+struct batch_invoice {
+	struct invoice_batch *batch;
+	struct invoice_info *info;
+	/* Once hsmd has signed it */
+	const char *b11enc;
+};
+
+struct invoice_batch {
+	struct command *cmd;
+	struct chanhints *chanhints;
+	struct batch_invoice *invs;
+	size_t num_signed;
+};
+
+static void json_add_batch_error(struct json_stream *response,
+				 errcode_t code, const char *message)
+{
+	json_object_start(response, "error");
+	json_add_errcode(response, "code", code);
+	json_add_string(response, "message", message);
+	json_object_end(response);
+}
+
+/* Everything is signed: store them all in this one db transaction, and
+ * write each result out as we go. */
+static void createinvoices_store(struct lightningd *ld,
+				 struct invoice_batch *batch)
+{
+	struct json_stream *response = json_stream_success(batch->cmd);
+
+	json_array_start(response, "invoices");
+	for (size_t i = 0; i < tal_count(batch->invs); i++) {
+		const struct invoice_info *info = batch->invs[i].info;
+		const struct invoice_details *details;
+		struct invoice invoice;
+		struct secret payment_secret;
+
+		json_object_start(response, NULL);
+		json_add_escaped_string(response, "label", info->label);
+		if (wallet_invoice_find_by_rhash(ld->wallet, &invoice,
+						 &info->b11->payment_hash)) {
+			json_add_batch_error(response,
+					     INVOICE_PREIMAGE_ALREADY_EXISTS,
+					     "preimage already used");
+			json_object_end(response);
+			continue;
+		}
+		if (!wallet_invoice_create(ld->wallet,
+					   &invoice,
+					   info->b11->msat,
+					   info->label,
+					   info->b11->expiry,
+					   batch->invs[i].b11enc,
+					   info->b11->description,
+					   info->b11->features,
+					   &info->payment_preimage,
+					   &info->b11->payment_hash,
+					   NULL)) {
+			json_add_batch_error(response,
+					     INVOICE_LABEL_ALREADY_EXISTS,
+					     "Duplicate label");
+			json_object_end(response);
+			continue;
+		}
+
+		details = wallet_invoice_details(tmpctx, ld->wallet, invoice);
+		json_add_sha256(response, "payment_hash", &details->rhash);
+		json_add_u64(response, "expires_at", details->expiry_time);
+		json_add_string(response, "bolt11", details->invstring);
+		invoice_secret(&details->r, &payment_secret);
+		json_add_secret(response, "payment_secret", &payment_secret);
+		json_add_invoice_warnings(response, info);
+		json_object_end(response);
+
+		notify_invoice_creation(ld, info->b11->msat,
+					info->payment_preimage, info->label);
+	}
+	json_array_end(response);
+
+	was_pending(command_success(batch->cmd, response));
+}
+
+static void createinvoices_signed(struct lightningd *ld,
+				  const u8 *reply,
+				  struct batch_invoice *binv)
+{
+	struct invoice_batch *batch = binv->batch;
+
+	binv->b11enc = bolt11_encode(batch, binv->info->b11, false,
+				     hsm_signed_b11, cast_const(u8 *, reply));
+	if (++batch->num_signed == tal_count(batch->invs))
+		createinvoices_store(ld, batch);
+}
+
+/* Add routehints to them all, and send them all to hsmd at once: it
+ * replies in order, and we store them when the last one comes back. */
+static struct command_result *
+createinvoices_sign(struct invoice_batch *batch,
+		    const struct inchan_candidates *ic,
+		    bool warning_no_listincoming)
+{
+	struct command *cmd = batch->cmd;
+
+	if (ic && inchan_hints_unusable(ic, batch->chanhints))
+		return command_fail(cmd, INVOICE_HINTS_GAVE_NO_ROUTES,
+				    "None of those hints were suitable local channels");
+
+	for (size_t i = 0; i < tal_count(batch->invs); i++) {
+		struct invoice_info *info = batch->invs[i].info;
+		const u8 *req = NULL;
+
+		info->warning_no_listincoming = warning_no_listincoming;
+		if (ic)
+			add_routehints(info, ic,
+				       &info->warning_mpp,
+				       &info->warning_capacity,
+				       &info->warning_deadends,
+				       &info->warning_offline,
+				       &info->warning_private_unused);
+		else
+			info->warning_mpp = info->warning_capacity
+				= info->warning_deadends
+				= info->warning_offline
+				= info->warning_private_unused
+				= false;
+
+		bolt11_encode(tmpctx, info->b11, false, hsm_sign_b11_req, &req);
+		if (!req)
+			return command_fail(cmd, LIGHTNINGD,
+					    "Could not encode invoice");
+		hsm_req(batch, cmd->ld, take(req),
+			createinvoices_signed, &batch->invs[i]);
+	}
+	return command_still_pending(cmd);
+}
+
+/* Return from "listincoming": one call for the whole batch. */
+static void createinvoices_listincoming_done(const char *buffer,
+					     const jsmntok_t *toks,
+					     const jsmntok_t *idtok UNUSED,
+					     struct invoice_batch *batch)
+{
+	struct lightningd *ld = batch->cmd->ld;
+	const struct inchan_candidates *ic;
+
+	/* We're actually outside a db transaction here: spooky! */
+	db_begin_transaction(ld->wallet->db);
+	ic = get_inchan_candidates(tmpctx, ld,
+				   routehint_incoming_from_json(tmpctx, ld,
+								buffer, toks),
+				   batch->chanhints);
+	createinvoices_sign(batch, ic, false);
+	db_commit_transaction(ld->wallet->db);
+}
+
+static struct command_result *json_createinvoices(struct command *cmd,
+						  const char *buffer,
+						  const jsmntok_t *obj UNNEEDED,
+						  const jsmntok_t *params)
+{
+	const jsmntok_t *invoices, *t;
+	struct invoice_batch *batch;
+	u64 *expiry;
+	u32 *cltv;
+	const struct gossmap_incoming *incoming;
+	struct jsonrpc_request *req;
+	struct plugin *plugin;
+	size_t i;
+
+	batch = tal(cmd, struct invoice_batch);
+	batch->cmd = cmd;
+	batch->num_signed = 0;
+
+	if (!param(cmd, buffer, params,
+		   p_req("invoices", param_array, &invoices),
+		   p_opt_def("expiry", param_time, &expiry, 3600*24*7),
+		   p_opt("exposeprivatechannels", param_chanhints,
+			 &batch->chanhints),
+		   p_opt_def("cltv", param_number, &cltv,
+			     cmd->ld->config.cltv_final),
+		   NULL))
+		return command_param_failed();
+
+	if (invoices->size == 0)
+		return command_fail_badparam(cmd, "invoices", buffer, invoices,
+					     "should not be empty");
+
+	batch->invs = tal_arr(batch, struct batch_invoice, invoices->size);
+	json_for_each_arr(i, t, invoices) {
+		struct invoice_info *info = tal(batch, struct invoice_info);
+		struct amount_msat *msat;
+		const char *desc;
+		struct preimage *preimage;
+		u64 *inv_expiry;
+		bool *hashonly;
+		struct command_result *ret;
+
+		if (!param(cmd, buffer, t,
+			   p_req("amount_msat", param_positive_msat_or_any, &msat),
+			   p_req("label", param_label, &info->label),
+			   p_req("description", param_escaped_string, &desc),
+			   p_opt("expiry", param_time, &inv_expiry),
+			   p_opt("preimage", param_preimage, &preimage),
+			   p_opt_def("deschashonly", param_bool, &hashonly,
+				     false),
+			   NULL))
+			return command_param_failed();
+
+		ret = check_label_and_desc(cmd, info->label, desc, *hashonly);
+		if (ret)
+			return ret;
+
+		info->cmd = cmd;
+		info->chanhints = batch->chanhints;
+		new_invoice_b11(info, cmd->ld, preimage, msat, desc,
+				inv_expiry ? *inv_expiry : *expiry,
+				*cltv, *hashonly);
+		info->b11->routes = NULL;
+
+		batch->invs[i].batch = batch;
+		batch->invs[i].info = info;
+		batch->invs[i].b11enc = NULL;
+	}
+
+	/* We work out the routehint candidates once, for all of them. */
+	incoming = routehint_incoming(cmd->ld);
+	if (incoming)
+		return createinvoices_sign(batch,
+					   get_inchan_candidates(tmpctx, cmd->ld,
+								 incoming,
+								 batch->chanhints),
+					   false);
+
+	req = jsonrpc_request_start(batch, "listincoming",
+				    cmd->ld->log,
+				    NULL, createinvoices_listincoming_done,
+				    batch);
+	jsonrpc_request_end(req);
+
+	plugin = find_plugin_for_command(cmd->ld, "listincoming");
+	if (plugin) {
+		plugin_request_send(plugin, req);
+		return command_still_pending(cmd);
+	}
+
+	return createinvoices_sign(batch, NULL, true);
+}
+
+static const struct json_command createinvoices_command = {
+	"createinvoices",
+	"payment",
+	json_createinvoices,
+	"Create an invoice for each of {invoices} (objects with "
+	"{amount_msat}, {label} and {description}, and optional "
+	"{expiry}, {preimage} and {deschashonly}), with optional "
+	"{expiry}, {exposeprivatechannels} and {cltv} for all of them"};
+AUTODATA(json_command, &createinvoices_command);
+
 static void json_add_invoices(struct json_stream *response,
 			      struct wallet *wallet,
 			      const struct json_escape *label,
@@ -1635,84 +2017,154 @@ static struct command_result *fail_exists(struct command *cmd,
 	return command_failed(cmd, data);
 }
 
+struct createinvoice_info {
+	struct command *cmd;
+	struct json_escape *label;
+	struct preimage *preimage;
+	struct sha256 payment_hash;
+
+	/* If it's a bolt11 */
+	struct bolt11 *b11;
+	bool have_n;
+
+	/* If it's a bolt12 */
+	struct tlv_invoice *inv;
+	struct amount_msat msat;
+	const char *desc;
+	u32 expiry;
+	struct sha256 *local_offer_id;
+};
+
+static struct command_result *createinvoice_success(struct command *cmd,
+						    struct invoice invoice)
+{
+	struct json_stream *response;
+
+	response = json_stream_success(cmd);
+	json_add_invoice(response,
+			 wallet_invoice_details(cmd, cmd->ld->wallet, invoice));
+	return command_success(cmd, response);
+}
+
+static void createinvoice_b11_signed(struct lightningd *ld,
+				     const u8 *reply,
+				     struct createinvoice_info *info)
+{
+	const struct bolt11 *b11 = info->b11;
+	struct invoice invoice;
+	char *b11enc;
+
+	/* This adds the signature */
+	b11enc = bolt11_encode(info, b11, info->have_n, hsm_signed_b11,
+			       cast_const(u8 *, reply));
+
+	if (!wallet_invoice_create(ld->wallet,
+				   &invoice,
+				   b11->msat,
+				   info->label,
+				   b11->expiry,
+				   b11enc,
+				   b11->description,
+				   b11->features,
+				   info->preimage,
+				   &info->payment_hash,
+				   NULL)) {
+		was_pending(fail_exists(info->cmd, info->label));
+		return;
+	}
+
+	notify_invoice_creation(ld, b11->msat, *info->preimage, info->label);
+	was_pending(createinvoice_success(info->cmd, invoice));
+}
+
+static void createinvoice_b12_signed(struct lightningd *ld,
+				     const u8 *reply,
+				     struct createinvoice_info *info)
+{
+	struct tlv_invoice *inv = info->inv;
+	struct invoice invoice;
+	char *b12enc;
+
+	hsm_signed_b12_invoice(reply, inv);
+	b12enc = invoice_encode(info, inv);
+
+	if (!wallet_invoice_create(ld->wallet,
+				   &invoice,
+				   inv->amount ? &info->msat : NULL,
+				   info->label,
+				   info->expiry,
+				   b12enc,
+				   info->desc,
+				   inv->features,
+				   info->preimage,
+				   &info->payment_hash,
+				   info->local_offer_id)) {
+		was_pending(fail_exists(info->cmd, info->label));
+		return;
+	}
+
+	notify_invoice_creation(ld, inv->amount ? &info->msat : NULL,
+				*info->preimage, info->label);
+	was_pending(createinvoice_success(info->cmd, invoice));
+}
+
 static struct command_result *json_createinvoice(struct command *cmd,
 						 const char *buffer,
 						 const jsmntok_t *obj UNNEEDED,
 						 const jsmntok_t *params)
 {
 	const char *invstring;
-	struct json_escape *label;
-	struct preimage *preimage;
-	struct invoice invoice;
-	struct sha256 payment_hash;
-	struct json_stream *response;
-	struct bolt11 *b11;
+	struct createinvoice_info *info = tal(cmd, struct createinvoice_info);
 	struct sha256 hash;
 	u5 *sig;
-	bool have_n;
 	char *fail;
+	const u8 *req = NULL;
 
+	info->cmd = cmd;
 	if (!param(cmd, buffer, params,
 		   p_req("invstring", param_string, &invstring),
-		   p_req("label", param_label, &label),
-		   p_req("preimage", param_preimage, &preimage),
+		   p_req("label", param_label, &info->label),
+		   p_req("preimage", param_preimage, &info->preimage),
 		   NULL))
 		return command_param_failed();
 
-	sha256(&payment_hash, preimage, sizeof(*preimage));
-	b11 = bolt11_decode_nosig(cmd, invstring, cmd->ld->our_features,
-				  NULL, chainparams, &hash, &sig, &have_n,
-				  &fail);
-	if (b11) {
-		/* This adds the signature */
-		char *b11enc = bolt11_encode(cmd, b11, have_n,
-					     hsm_sign_b11, cmd->ld);
-
-		if (!b11->description)
+	sha256(&info->payment_hash, info->preimage, sizeof(*info->preimage));
+	info->b11 = bolt11_decode_nosig(info, invstring, cmd->ld->our_features,
+					NULL, chainparams, &hash, &sig,
+					&info->have_n, &fail);
+	if (info->b11) {
+		if (!info->b11->description)
 			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 					    "Missing description in invoice");
 
-		if (!b11->expiry)
+		if (!info->b11->expiry)
 			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 					    "Missing expiry in invoice");
 
-		if (!sha256_eq(&payment_hash, &b11->payment_hash))
+		if (!sha256_eq(&info->payment_hash, &info->b11->payment_hash))
 			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 					    "Incorrect preimage");
 
-		if (!wallet_invoice_create(cmd->ld->wallet,
-					   &invoice,
-					   b11->msat,
-					   label,
-					   b11->expiry,
-					   b11enc,
-					   b11->description,
-					   b11->features,
-					   preimage,
-					   &payment_hash,
-					   NULL))
-			return fail_exists(cmd, label);
-
-		notify_invoice_creation(cmd->ld, b11->msat, *preimage, label);
+		bolt11_encode(tmpctx, info->b11, info->have_n,
+			      hsm_sign_b11_req, &req);
+		if (!req)
+			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					    "Could not encode invoice");
+
+		hsm_req(info, cmd->ld, take(req),
+			createinvoice_b11_signed, info);
+		return command_still_pending(cmd);
 	} else {
 		struct tlv_invoice *inv;
-		struct sha256 *local_offer_id;
+		enum offer_status status;
 
-		inv = invoice_decode_nosig(cmd, invstring, strlen(invstring),
+		inv = invoice_decode_nosig(info, invstring, strlen(invstring),
 					   cmd->ld->our_features, chainparams,
 					   &fail);
 		if (inv) {
-			char *b12enc;
-			struct amount_msat msat;
-			const char *desc;
-			u32 expiry;
-			enum offer_status status;
-
 			if (inv->signature)
 				return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 						    "invoice already signed");
-			hsm_sign_b12_invoice(cmd->ld, inv);
-			b12enc = invoice_encode(cmd, inv);
 
 			if (inv->offer_id
 			    && wallet_offer_find(tmpctx, cmd->ld->wallet,
@@ -1720,58 +2172,42 @@ static struct command_result *json_createinvoice(struct command *cmd,
 				if (!offer_status_active(status))
 					return command_fail(cmd, INVOICE_OFFER_INACTIVE,
 							    "offer not active");
-				local_offer_id = inv->offer_id;
+				info->local_offer_id = inv->offer_id;
 			} else
-				local_offer_id = NULL;
+				info->local_offer_id = NULL;
 
 			if (inv->amount)
-				msat = amount_msat(*inv->amount);
+				info->msat = amount_msat(*inv->amount);
 
 			if (inv->relative_expiry)
-				expiry = *inv->relative_expiry;
+				info->expiry = *inv->relative_expiry;
 			else
-				expiry = BOLT12_DEFAULT_REL_EXPIRY;
+				info->expiry = BOLT12_DEFAULT_REL_EXPIRY;
 
 			if (!inv->payment_hash)
 				return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 						    "Missing payment_hash in invoice");
-			if (!sha256_eq(&payment_hash, inv->payment_hash))
+			if (!sha256_eq(&info->payment_hash, inv->payment_hash))
 				return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 					    "Incorrect preimage");
 
 			if (!inv->description)
 				return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 						    "Missing description in invoice");
-			desc = tal_strndup(cmd,
-					   cast_signed(char *, inv->description),
-					   tal_bytelen(inv->description));
-
-			if (!wallet_invoice_create(cmd->ld->wallet,
-						   &invoice,
-						   inv->amount ? &msat : NULL,
-						   label,
-						   expiry,
-						   b12enc,
-						   desc,
-						   inv->features,
-						   preimage,
-						   &payment_hash,
-						   local_offer_id))
-				return fail_exists(cmd, label);
-
-			notify_invoice_creation(cmd->ld,
-						inv->amount ? &msat : NULL,
-						*preimage, label);
+			info->desc = tal_strndup(info,
+						 cast_signed(char *, inv->description),
+						 tal_bytelen(inv->description));
+
+			info->inv = inv;
+			hsm_req(info, cmd->ld,
+				take(hsm_sign_b12_invoice_req(NULL, inv)),
+				createinvoice_b12_signed, info);
+			return command_still_pending(cmd);
 		} else
 			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 					    "Unparsable invoice '%s': %s",
 					    invstring, fail);
 	}
-
-	response = json_stream_success(cmd);
-	json_add_invoice(response,
-			 wallet_invoice_details(cmd, cmd->ld->wallet, invoice));
-	return command_success(cmd, response);
 }
 
 static const struct json_command createinvoice_command = {
@@ -102,8 +102,75 @@ struct jsonrpc {
 	/* Map from json command names to usage strings: we don't put this inside
 	 * struct json_command as it's good practice to have those const. */
 	STRMAP(const char *) usagemap;
+
+	/* Map from json command names to their metrics: we keep these even
+	 * if the (plugin) command goes away. */
+	STRMAP(struct rpc_method_stats *) statsmap;
+};
+
+/* Latencies up to 100usec, 1msec, ... 10sec, and more than that. */
+#define NUM_LATENCY_BUCKETS 7
+
+struct rpc_method_stats {
+	u64 calls, failures;
+	/* Total and maximum time to complete, in usec */
+	u64 total_usec, max_usec;
+	u64 latency_histogram[NUM_LATENCY_BUCKETS];
+	/* Time spent waiting for rpc_command hooks before we even started */
+	u64 hook_usec;
+	/* Request and response sizes */
+	u64 bytes_in, bytes_out;
+	/* tal allocations during the (synchronous part of the) handler */
+	u64 allocations;
+
+	/* calls, failures and total_usec when we last logged them */
+	u64 logged_calls, logged_failures, logged_usec;
 };
 
+/* Every allocation goes through here, so counting them is cheap. */
+static u64 tal_allocations;
+
+static void *counting_alloc(size_t size)
+{
+	tal_allocations++;
+	return malloc(size);
+}
+
+static struct rpc_method_stats *get_stats(struct jsonrpc *rpc,
+					  const char *method)
+{
+	struct rpc_method_stats *stats = strmap_get(&rpc->statsmap, method);
+
+	if (!stats) {
+		stats = talz(rpc, struct rpc_method_stats);
+		strmap_add(&rpc->statsmap, tal_strdup(stats, method), stats);
+	}
+	return stats;
+}
+
+static void record_completion(struct command *cmd, struct json_stream *js)
+{
+	struct rpc_method_stats *stats = cmd->stats;
+	u64 usec = time_to_usec(timemono_between(time_mono(), cmd->start));
+	u64 bucket_max = 100;
+	size_t i, unread;
+
+	stats->calls++;
+	stats->total_usec += usec;
+	if (usec > stats->max_usec)
+		stats->max_usec = usec;
+	for (i = 0; i < NUM_LATENCY_BUCKETS - 1; i++) {
+		if (usec <= bucket_max)
+			break;
+		bucket_max *= 10;
+	}
+	stats->latency_histogram[i]++;
+
+	/* Some may not be written out yet */
+	json_out_contents(js->jout, &unread);
+	stats->bytes_out += js->bytes_written + unread;
+}
+
 /* The command itself usually owns the stream, because jcon may get closed.
  * The command transfers ownership once it's done though. */
 static struct json_stream *jcon_new_json_stream(const tal_t *ctx,
@@ -136,10 +203,15 @@ static void jcon_remove_json_stream(struct json_connection *jcon,
 /* jcon and cmd have separate lifetimes: we detach them on either destruction */
 static void destroy_jcon(struct json_connection *jcon)
 {
-	struct command *c;
+	struct command *c, *next;
 
-	list_for_each(&jcon->commands, c, list)
+	list_for_each_safe(&jcon->commands, c, next, list) {
 		c->jcon = NULL;
+		/* If it's waiting for output to be read, it'll never be. */
+		if (c->json_stream && c->json_stream->drained_cb)
+			c->json_stream->drained_cb(c->json_stream,
+						   c->json_stream->drained_arg);
+	}
 
 	/* Make sure this happens last! */
 	tal_free(jcon->log);
@@ -438,6 +510,9 @@ static void destroy_command(struct command *cmd)
 struct command_result *command_raw_complete(struct command *cmd,
 					    struct json_stream *result)
 {
+	if (cmd->stats)
+		record_completion(cmd, result);
+
 	json_stream_close(result, cmd);
 
 	/* If we have a jcon, it will free result for us. */
@@ -463,6 +538,8 @@ struct command_result *command_failed(struct command *cmd,
 				      struct json_stream *result)
 {
 	assert(cmd->json_stream == result);
+	if (cmd->stats)
+		cmd->stats->failures++;
 	/* Have to close error */
 	json_object_end(result);
 	json_object_end(result);
@@ -621,9 +698,15 @@ static struct command_result *command_exec(struct json_connection *jcon,
                                            const jsmntok_t *params)
 {
 	struct command_result *res;
+	struct rpc_method_stats *stats = cmd->stats;
+	u64 allocs = tal_allocations;
 
 	res = cmd->json_cmd->dispatch(cmd, buffer, request, params);
 
+	/* cmd may be freed already, so don't use it! */
+	if (stats)
+		stats->allocations += tal_allocations - allocs;
+
 	assert(res == &param_failed
 	       || res == &complete
 	       || res == &pending
@@ -713,6 +796,7 @@ static void replace_command(struct rpc_command_hook_payload *p,
 			      buffer + method->start);
 		goto fail;
 	}
+	p->cmd->stats = get_stats(p->cmd->ld->jsonrpc, p->cmd->json_cmd->name);
 
 	// deprecated phase to give the possibility to all to migrate and stay safe
 	// from this more restrictive change.
@@ -740,6 +824,9 @@ static void rpc_command_hook_final(struct rpc_command_hook_payload *p STEALS)
 	/* Free payload with cmd */
 	tal_steal(p->cmd, p);
 
+	p->cmd->stats->hook_usec
+		+= time_to_usec(timemono_between(time_mono(), p->cmd->start));
+
 	if (p->custom_result != NULL) {
 		struct json_stream *s = json_start(p->cmd);
 		json_add_jsonstr(s, "result",
@@ -898,6 +985,8 @@ parse_request(struct json_connection *jcon, const jsmntok_t tok[])
 	/* Allocate the command off of the `jsonrpc` object and not
 	 * the connection since the command may outlive `conn`. */
 	c = tal(jcon->ld->jsonrpc, struct command);
+	c->start = time_mono();
+	c->stats = NULL;
 	c->jcon = jcon;
 	c->send_notifications = jcon->notifications_enabled;
 	c->ld = jcon->ld;
@@ -938,6 +1027,9 @@ parse_request(struct json_connection *jcon, const jsmntok_t tok[])
 				    "lightningd is shutting down");
 	}
 
+	c->stats = get_stats(jcon->ld->jsonrpc, c->json_cmd->name);
+	c->stats->bytes_in += json_tok_full_len(tok);
+
 	rpc_hook = tal(c, struct rpc_command_hook_payload);
 	rpc_hook->cmd = c;
 	/* Duplicate since we might outlive the connection */
@@ -1183,6 +1275,7 @@ static bool jsonrpc_command_add_perm(struct lightningd *ld,
 static void destroy_jsonrpc(struct jsonrpc *jsonrpc)
 {
 	strmap_clear(&jsonrpc->usagemap);
+	strmap_clear(&jsonrpc->statsmap);
 }
 
 #if DEVELOPER
@@ -1190,6 +1283,7 @@ static void memleak_help_jsonrpc(struct htable *memtable,
 				 struct jsonrpc *jsonrpc)
 {
 	memleak_remove_strmap(memtable, &jsonrpc->usagemap);
+	memleak_remove_strmap(memtable, &jsonrpc->statsmap);
 }
 #endif /* DEVELOPER */
 
@@ -1197,8 +1291,12 @@ void jsonrpc_setup(struct lightningd *ld)
 {
 	struct json_command **commands = get_cmdlist();
 
+	/* So getmetrics can tell how much commands allocate. */
+	tal_set_backend(counting_alloc, NULL, NULL, NULL);
+
 	ld->jsonrpc = tal(ld, struct jsonrpc);
 	strmap_init(&ld->jsonrpc->usagemap);
+	strmap_init(&ld->jsonrpc->statsmap);
 	ld->jsonrpc->commands = tal_arr(ld->jsonrpc, struct json_command *, 0);
 	for (size_t i=0; i<num_cmdlist; i++) {
 		if (!jsonrpc_command_add_perm(ld, ld->jsonrpc, commands[i]))
@@ -1227,6 +1325,9 @@ bool command_check_only(const struct command *cmd)
 	return cmd->mode == CMD_CHECK;
 }
 
+/* Periodically logs what's in getmetrics, if they asked */
+static void log_metrics(struct lightningd *ld);
+
 void jsonrpc_listen(struct jsonrpc *jsonrpc, struct lightningd *ld)
 {
 	struct sockaddr_un addr;
@@ -1236,6 +1337,11 @@ void jsonrpc_listen(struct jsonrpc *jsonrpc, struct lightningd *ld)
 	/* Should not initialize it twice. */
 	assert(!jsonrpc->rpc_listener);
 
+	if (ld->rpc_metrics_interval)
+		notleak(new_reltimer(ld->timers, ld,
+				     time_from_sec(ld->rpc_metrics_interval),
+				     log_metrics, ld));
+
 	if (streq(rpc_filename, "/dev/tty")) {
 		fd = open(rpc_filename, O_RDWR);
 		if (fd == -1)
@@ -1442,3 +1548,95 @@ static const struct json_command notifications_command = {
 };
 
 AUTODATA(json_command, &notifications_command);
+
+static bool json_add_method_stats(const char *method,
+				  struct rpc_method_stats *stats,
+				  struct json_stream *js)
+{
+	u64 bucket_max = 100;
+
+	json_object_start(js, NULL);
+	json_add_string(js, "method", method);
+	json_add_u64(js, "calls", stats->calls);
+	json_add_u64(js, "failures", stats->failures);
+	json_add_u64(js, "total_usec", stats->total_usec);
+	json_add_u64(js, "max_usec", stats->max_usec);
+	json_array_start(js, "latency_histogram");
+	for (size_t i = 0; i < NUM_LATENCY_BUCKETS; i++) {
+		json_object_start(js, NULL);
+		/* Last one catches everything else */
+		if (i != NUM_LATENCY_BUCKETS - 1)
+			json_add_u64(js, "max_usec", bucket_max);
+		json_add_u64(js, "count", stats->latency_histogram[i]);
+		json_object_end(js);
+		bucket_max *= 10;
+	}
+	json_array_end(js);
+	json_add_u64(js, "hook_usec", stats->hook_usec);
+	json_add_u64(js, "bytes_in", stats->bytes_in);
+	json_add_u64(js, "bytes_out", stats->bytes_out);
+	json_add_u64(js, "allocations", stats->allocations);
+	json_object_end(js);
+
+	/* Keep going */
+	return true;
+}
+
+static struct command_result *json_getmetrics(struct command *cmd,
+					      const char *buffer,
+					      const jsmntok_t *obj UNNEEDED,
+					      const jsmntok_t *params)
+{
+	struct json_stream *response;
+
+	if (!param(cmd, buffer, params, NULL))
+		return command_param_failed();
+
+	response = json_stream_success(cmd);
+	json_add_u64(response, "allocations", tal_allocations);
+	json_array_start(response, "rpc");
+	strmap_iterate(&cmd->ld->jsonrpc->statsmap,
+		       json_add_method_stats, response);
+	json_array_end(response);
+	json_add_hook_metrics(response, "hooks");
+	return command_success(cmd, response);
+}
+
+static const struct json_command getmetrics_command = {
+	"getmetrics",
+	"utility",
+	json_getmetrics,
+	"Show call counts, latencies, sizes and allocations for each JSON-RPC method, "
+	"and latencies for each plugin hook",
+};
+AUTODATA(json_command, &getmetrics_command);
+
+static bool log_method_stats(const char *method,
+			     struct rpc_method_stats *stats,
+			     struct lightningd *ld)
+{
+	u64 calls = stats->calls - stats->logged_calls;
+
+	if (calls)
+		log_info(ld->log,
+			 "JSON-RPC %s: %"PRIu64" calls (%"PRIu64" failed),"
+			 " average %"PRIu64"usec, max %"PRIu64"usec",
+			 method, calls, stats->failures - stats->logged_failures,
+			 (stats->total_usec - stats->logged_usec) / calls,
+			 stats->max_usec);
+
+	stats->logged_calls = stats->calls;
+	stats->logged_failures = stats->failures;
+	stats->logged_usec = stats->total_usec;
+
+	/* Keep going */
+	return true;
+}
+
+static void log_metrics(struct lightningd *ld)
+{
+	strmap_iterate(&ld->jsonrpc->statsmap, log_method_stats, ld);
+	notleak(new_reltimer(ld->timers, ld,
+			     time_from_sec(ld->rpc_metrics_interval),
+			     log_metrics, ld));
+}
@@ -7,6 +7,7 @@
 #include <common/status_levels.h>
 
 struct jsonrpc;
+struct rpc_method_stats;
 
 /* The command mode tells param() how to process. */
 enum command_mode {
@@ -39,6 +40,9 @@ struct command {
 	enum command_mode mode;
 	/* Have we started a json stream already?  For debugging. */
 	struct json_stream *json_stream;
+	/* For getmetrics: when we started, and what to account it to */
+	struct timemono start;
+	struct rpc_method_stats *stats;
 };
 
 /**
@@ -282,6 +282,7 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	 * RPC. Can be overridden with `--rpc-file-mode`.
 	 */
 	ld->rpc_filemode = 0600;
+	ld->rpc_metrics_interval = 0;
 
 	/*~ This is the exit code to use on exit.
 	 * Set to NULL meaning we are not interested in exiting yet.
@@ -292,6 +293,7 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	 * This round-robin list of channels is used to ensure that
 	 * each invoice we generate has a different set of channels.  */
 	ld->rr_counter = 0;
+	ld->routehint_cache = NULL;
 
 	/*~ Because fee estimates on testnet and regtest are unreliable,
 	 * we allow overriding them with --force-feerates, in which
@@ -530,6 +532,7 @@ static void shutdown_subdaemons(struct lightningd *ld)
 	db_begin_transaction(ld->wallet->db);
 
 	/* Let everyone shutdown cleanly. */
+	hsm_async_shutdown(ld);
 	close(ld->hsm_fd);
 	/*~ The three "global" daemons, which we shutdown explicitly: we
 	 * give them 10 seconds to exit gracefully before killing them.  */
@@ -585,20 +588,19 @@ static void shutdown_subdaemons(struct lightningd *ld)
  * filter here. */
 static void init_txfilter(struct wallet *w, struct txfilter *filter)
 {
-	/*~ This is defined in libwally, so we didn't have to reimplement */
-	struct ext_key ext;
 	/*~ Note the use of ccan/short_types u64 rather than uint64_t.
 	 * Thank me later. */
 	u64 bip32_max_index;
+	const u8 *derkeys;
 
 	bip32_max_index = db_get_intvar(w->db, "bip32_max_index", 0);
+	/*~ Deriving keys is slow (elliptic curve operations!), and nodes can
+	 * hand out millions of addresses, so the wallet keeps the ones it has
+	 * derived in the db and only derives the new ones. */
+	derkeys = wallet_derkeys(tmpctx, w, bip32_max_index + w->keyscan_gap);
 	/*~ One of the C99 things I unequivocally approve: for-loop scope. */
-	for (u64 i = 0; i <= bip32_max_index + w->keyscan_gap; i++) {
-		if (bip32_key_from_parent(w->bip32_base, i, BIP32_FLAG_KEY_PUBLIC, &ext) != WALLY_OK) {
-			abort();
-		}
-		txfilter_add_derkey(filter, ext.pub_key);
-	}
+	for (u64 i = 0; i <= bip32_max_index + w->keyscan_gap; i++)
+		txfilter_add_derkey(filter, derkeys + i * PUBKEY_CMPR_LEN);
 }
 
 /*~ The normal advice for daemons is to move into the root directory, so you
@@ -94,6 +94,8 @@ struct lightningd {
 	char *rpc_filename;
 	/* Mode of the RPC filename. */
 	mode_t rpc_filemode;
+	/* How often to log JSON-RPC metrics, in seconds (0 = never) */
+	u32 rpc_metrics_interval;
 
 	/* The root of the jsonrpc interface. Can be shut down
 	 * separately from the rest of the daemon to allow a clean
@@ -161,6 +163,8 @@ struct lightningd {
 	/* Bearer of all my secrets. */
 	int hsm_fd;
 	struct subd *hsm;
+	/* Separate connection for hsm_req() */
+	struct hsm_async *hsm_async;
 
 	/* Daemon for routing */
  	struct subd *gossip;
@@ -310,6 +314,9 @@ struct lightningd {
 	/* The round-robin list of channels, for use when doing MPP.  */
 	u64 rr_counter;
 
+	/* Our channels as seen in gossip, for routehints (NULL until used). */
+	struct routehint_cache *routehint_cache;
+
 	/* Should we re-exec ourselves instead of just exiting? */
 	bool try_reexec;
 
@@ -33,6 +33,8 @@ struct log_book {
 	size_t mem_used;
 	size_t max_mem;
 	size_t num_entries;
+	/* The seq the next entry will get */
+	u64 next_seq;
 	struct list_head print_filters;
 
 	/* Non-null once it's been initialized */
@@ -277,6 +279,7 @@ struct log_book *new_log_book(struct lightningd *ld, size_t max_mem)
 	assert(max_mem > sizeof(struct log) * 2);
 	lr->mem_used = 0;
 	lr->num_entries = 0;
+	lr->next_seq = 0;
 	lr->max_mem = max_mem;
 	lr->outfiles = NULL;
 	lr->default_print_level = NULL;
@@ -380,6 +383,7 @@ static struct log_entry *new_log_entry(struct log *log, enum log_level level,
 		tal_resize(&log->lr->log, tal_count(log->lr->log) * 2);
 
 	l = &log->lr->log[log->lr->num_entries];
+	l->seq = log->lr->next_seq++;
 	l->time = time_now();
 	l->level = level;
 	l->skipped = 0;
@@ -871,6 +875,8 @@ struct log_info {
 	unsigned int num_skipped;
 	/* If non-null, only show messages about this peer */
 	const struct node_id *node_id;
+	/* How many entries we've output (not counting SKIPPED) */
+	u64 num_output;
 };
 
 static void add_skipped(struct log_info *info)
@@ -906,6 +912,7 @@ static void log_to_json(unsigned int skipped,
 	}
 
 	add_skipped(info);
+	info->num_output++;
 
 	json_object_start(info->response, NULL);
 	json_add_string(info->response, "type",
@@ -938,6 +945,7 @@ void json_add_log(struct json_stream *response,
 	info.response = response;
 	info.num_skipped = 0;
 	info.node_id = node_id;
+	info.num_output = 0;
 
 	json_array_start(info.response, "log");
 	log_each_line(lr, log_to_json, &info);
@@ -960,6 +968,78 @@ struct command_result *param_loglevel(struct command *cmd,
 				     "'unusual'");
 }
 
+/* How many entries getlog outputs before waiting for them to be read. */
+#define GETLOG_BATCH 1000
+
+struct getlog {
+	struct command *cmd;
+	struct json_stream *response;
+	const struct log_book *lr;
+	struct log_info info;
+	/* The next seq to look at, and the first we won't (so we finish even
+	 * if they're logging faster than the client reads!) */
+	u64 next, end;
+	/* Stop after outputting this many entries */
+	u64 limit;
+};
+
+/* Index of the first entry with seq at least @seq */
+static size_t log_find_seq(const struct log_book *lr, u64 seq)
+{
+	size_t lo = 0, hi = lr->num_entries;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (lr->log[mid].seq < seq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Outputs the next batch: returns true if that's all of them.  We look
+ * them up again each time, since entries move when the log is pruned. */
+static bool getlog_some(struct getlog *gl)
+{
+	const struct log_book *lr = gl->lr;
+	u64 start = gl->info.num_output;
+
+	for (size_t i = log_find_seq(lr, gl->next); i < lr->num_entries; i++) {
+		const struct log_entry *l = &lr->log[i];
+
+		if (l->seq >= gl->end)
+			break;
+		if (gl->info.num_output == gl->limit)
+			return true;
+		if (gl->info.num_output - start == GETLOG_BATCH)
+			return false;
+
+		log_to_json(l->skipped, time_between(l->time, lr->init_time),
+			    l->level, l->nc ? &l->nc->node_id : NULL,
+			    l->prefix->prefix, l->log, l->io, &gl->info);
+		gl->next = l->seq + 1;
+	}
+
+	gl->next = gl->end;
+	return true;
+}
+
+static struct command_result *getlog_done(struct getlog *gl)
+{
+	add_skipped(&gl->info);
+	json_array_end(gl->response);
+	json_add_u64(gl->response, "next_seq", gl->next);
+	return command_success(gl->cmd, gl->response);
+}
+
+static void getlog_drained(struct json_stream *js, struct getlog *gl)
+{
+	/* If they've gone away, don't bother with the rest. */
+	if (!gl->cmd->jcon || getlog_some(gl))
+		was_pending(getlog_done(gl));
+}
+
 static struct command_result *json_getlog(struct command *cmd,
 					  const char *buffer,
 					  const jsmntok_t *obj UNNEEDED,
@@ -967,10 +1047,14 @@ static struct command_result *json_getlog(struct command *cmd,
 {
 	struct json_stream *response;
 	enum log_level *minlevel;
+	u64 *since, *limit;
 	struct log_book *lr = cmd->ld->log_book;
+	struct getlog *gl;
 
 	if (!param(cmd, buffer, params,
 		   p_opt_def("level", param_loglevel, &minlevel, LOG_INFORM),
+		   p_opt_def("since", param_u64, &since, 0),
+		   p_opt_def("limit", param_u64, &limit, UINT64_MAX),
 		   NULL))
 		return command_param_failed();
 
@@ -980,14 +1064,40 @@ static struct command_result *json_getlog(struct command *cmd,
 	json_add_time(response, "created_at", lr->init_time.ts);
 	json_add_num(response, "bytes_used", (unsigned int)lr->mem_used);
 	json_add_num(response, "bytes_max", (unsigned int)lr->max_mem);
-	json_add_log(response, lr, NULL, *minlevel);
-	return command_success(cmd, response);
+
+	gl = tal(cmd, struct getlog);
+	gl->cmd = cmd;
+	gl->response = response;
+	gl->lr = lr;
+	gl->info.level = *minlevel;
+	gl->info.response = response;
+	gl->info.num_skipped = 0;
+	gl->info.node_id = NULL;
+	gl->info.num_output = 0;
+	gl->next = *since;
+	gl->end = lr->next_seq;
+	gl->limit = *limit;
+
+	json_array_start(response, "log");
+	if (getlog_some(gl))
+		return getlog_done(gl);
+
+	/* Nobody to stream it to?  Just do it all. */
+	if (!cmd->jcon) {
+		while (!getlog_some(gl));
+		return getlog_done(gl);
+	}
+
+	/* We add the rest as it's read. */
+	json_stream_on_drained(response, getlog_drained, gl);
+	return command_still_pending(cmd);
 }
 
 static const struct json_command getlog_command = {
 	"getlog",
 	"utility",
 	json_getlog,
-	"Show logs, with optional log {level} (info|unusual|debug|io)"
+	"Show logs, with optional log {level} (info|unusual|debug|io), "
+	"only from {since} (a previous next_seq), and at most {limit} entries"
 };
 AUTODATA(json_command, &getlog_command);
@@ -78,6 +78,8 @@ struct log_prefix {
 };
 
 struct log_entry {
+	/* Increases with every entry (including deleted ones) */
+	u64 seq;
 	struct timeabs time;
 	enum log_level level;
 	unsigned int skipped;
@@ -1191,6 +1191,10 @@ static void register_opts(struct lightningd *ld)
 			 &ld->rpc_filemode,
 			 "Set the file mode (permissions) for the "
 			 "JSON-RPC socket");
+	opt_register_arg("--rpc-metrics-interval=<seconds>",
+			 opt_set_u32, opt_show_u32,
+			 &ld->rpc_metrics_interval,
+			 "Log JSON-RPC command metrics this often (0 = never)");
 
 	opt_register_arg("--force-feerates",
 			 opt_force_feerates, NULL, ld,
@@ -2098,7 +2098,6 @@ void setup_peers(struct lightningd *ld)
 /* Pull peers, channels and HTLCs from db, and wire them up. */
 struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld)
 {
-	struct peer *peer;
 	struct htlc_in_map *unconnected_htlcs_in = tal(ld, struct htlc_in_map);
 
 	/* Load channels from database */
@@ -2106,34 +2105,16 @@ struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld)
 		fatal("Could not load channels from the database");
 
 	/* First we load the incoming htlcs */
-	list_for_each(&ld->peers, peer, list) {
-		struct channel *channel;
-
-		list_for_each(&peer->channels, channel, list) {
-			if (!wallet_htlcs_load_in_for_channel(ld->wallet,
-							      channel,
-							      &ld->htlcs_in)) {
-				fatal("could not load htlcs for channel");
-			}
-		}
-	}
+	if (!wallet_htlcs_load_in(ld->wallet, &ld->htlcs_in))
+		fatal("could not load htlcs for channels");
 
 	/* Make a copy of the htlc_map: entries removed as they're matched */
 	htlc_in_map_copy(unconnected_htlcs_in, &ld->htlcs_in);
 
 	/* Now we load the outgoing HTLCs, so we can connect them. */
-	list_for_each(&ld->peers, peer, list) {
-		struct channel *channel;
-
-		list_for_each(&peer->channels, channel, list) {
-			if (!wallet_htlcs_load_out_for_channel(ld->wallet,
-							       channel,
-							       &ld->htlcs_out,
-							       unconnected_htlcs_in)) {
-				fatal("could not load outgoing htlcs for channel");
-			}
-		}
-	}
+	if (!wallet_htlcs_load_out(ld->wallet, &ld->htlcs_out,
+				   unconnected_htlcs_in))
+		fatal("could not load outgoing htlcs for channels");
 
 #ifdef COMPAT_V061
 	fixup_htlcs_out(ld);
@@ -4,7 +4,6 @@
 #include <channeld/channeld_wiregen.h>
 #include <common/blinding.h>
 #include <common/configdir.h>
-#include <common/ecdh.h>
 #include <common/json_command.h>
 #include <common/json_param.h>
 #include <common/onion.h>
@@ -13,9 +12,11 @@
 #include <common/type_to_string.h>
 #include <db/exec.h>
 #include <gossipd/gossipd_wiregen.h>
+#include <hsmd/hsmd_wiregen.h>
 #include <lightningd/chaintopology.h>
 #include <lightningd/channel.h>
 #include <lightningd/coin_mvts.h>
+#include <lightningd/hsm_control.h>
 #include <lightningd/pay.h>
 #include <lightningd/peer_control.h>
 #include <lightningd/peer_htlcs.h>
@@ -1122,13 +1123,13 @@ htlc_accepted_hook_final(struct htlc_accepted_hook_payload *request STEALS)
 	tal_free(request);
 }
 
-/* Apply tweak to ephemeral key if blinding is non-NULL, then do ECDH */
-static bool ecdh_maybe_blinding(const struct pubkey *ephemeral_key,
-				const struct pubkey *blinding,
-				const struct secret *blinding_ss,
-				struct secret *ss)
+/* Apply tweak to ephemeral key if blinding is non-NULL, ready for ECDH */
+static bool ecdh_point_maybe_blinding(const struct pubkey *ephemeral_key,
+				      const struct pubkey *blinding,
+				      const struct secret *blinding_ss,
+				      struct pubkey *point)
 {
-	struct pubkey point = *ephemeral_key;
+	*point = *ephemeral_key;
 
 #if EXPERIMENTAL_FEATURES
 	if (blinding) {
@@ -1141,13 +1142,12 @@ static bool ecdh_maybe_blinding(const struct pubkey *ephemeral_key,
 		 * our normal privkey: since hsmd knows only how to ECDH with
 		 * our real key */
 		if (secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx,
-						  &point.pubkey,
+						  &point->pubkey,
 						  hmac.data) != 1) {
 			return false;
 		}
 	}
 #endif /* EXPERIMENTAL_FEATURES */
-	ecdh(&point, ss);
 	return true;
 }
 
@@ -1981,13 +1981,11 @@ void peer_sending_commitsig(struct channel *channel, const u8 *msg)
 }
 
 static bool channel_added_their_htlc(struct channel *channel,
-				     const struct added_htlc *added)
+				     const struct added_htlc *added,
+				     const struct secret *shared_secret)
 {
 	struct lightningd *ld = channel->peer->ld;
 	struct htlc_in *hin;
-	struct secret shared_secret;
-	struct onionpacket *op;
-	enum onion_wire failcode;
 
 	/* BOLT #2:
 	 *
@@ -2009,26 +2007,11 @@ static bool channel_added_their_htlc(struct channel *channel,
 		return false;
 	}
 
-	/* Do the work of extracting shared secret now if possible. */
-	/* FIXME: We do this *again* in peer_accepted_htlc! */
-	op = parse_onionpacket(tmpctx, added->onion_routing_packet,
-			       sizeof(added->onion_routing_packet),
-			       &failcode);
-	if (op) {
-		if (!ecdh_maybe_blinding(&op->ephemeralkey,
-					 added->blinding, &added->blinding_ss,
-					 &shared_secret)) {
-			log_debug(channel->log, "htlc %"PRIu64
-				  ": can't tweak pubkey", added->id);
-			return false;
-		}
-	}
-
 	/* This stays around even if we fail it immediately: it *is*
 	 * part of the current commitment. */
 	hin = new_htlc_in(channel, channel, added->id, added->amount,
 			  added->cltv_expiry, &added->payment_hash,
-			  op ? &shared_secret : NULL,
+			  shared_secret,
 			  added->blinding, &added->blinding_ss,
 			  added->onion_routing_packet,
 			  added->fail_immediate);
@@ -2044,6 +2027,96 @@ static bool channel_added_their_htlc(struct channel *channel,
 	return true;
 }
 
+/* While we wait for hsmd to do ECDH on the new HTLCs' onions. */
+struct commitsig_secrets {
+	struct channel *channel;
+	const u8 *msg;
+	/* One for each added htlc: NULL if we couldn't parse its onion. */
+	struct secret **shared_secrets;
+	size_t num_pending;
+};
+
+struct onion_ecdh {
+	struct commitsig_secrets *cs;
+	struct secret *ss;
+};
+
+static void got_commitsig(struct channel *channel, const u8 *msg,
+			  struct secret **shared_secrets);
+
+static void onion_ecdh_done(struct lightningd *ld,
+			    const u8 *reply,
+			    struct onion_ecdh *oe)
+{
+	struct commitsig_secrets *cs = oe->cs;
+
+	if (!fromwire_hsmd_ecdh_resp(reply, oe->ss))
+		fatal("Invalid hsmd ECDH response %s", tal_hex(tmpctx, reply));
+
+	if (--cs->num_pending != 0)
+		return;
+
+	/* This can free channel->owner (and hence cs) */
+	tal_steal(tmpctx, cs);
+	got_commitsig(cs->channel, cs->msg, cs->shared_secrets);
+}
+
+/* Ask hsmd for all the onion shared secrets at once, rather than waiting for
+ * each one in turn: we come back to got_commitsig when they're all done. */
+static void get_onion_secrets(struct channel *channel,
+			      const u8 *msg,
+			      const struct added_htlc *added)
+{
+	struct lightningd *ld = channel->peer->ld;
+	struct commitsig_secrets *cs;
+
+	/* If subdaemon dies, we want to forget this. */
+	cs = tal(channel->owner, struct commitsig_secrets);
+	cs->channel = channel;
+	cs->msg = tal_dup_talarr(cs, u8, msg);
+	cs->shared_secrets = tal_arrz(cs, struct secret *, tal_count(added));
+	cs->num_pending = 0;
+
+	for (size_t i = 0; i < tal_count(added); i++) {
+		struct onionpacket *op;
+		struct onion_ecdh *oe;
+		struct pubkey point;
+		enum onion_wire failcode;
+
+		/* Do the work of extracting shared secret now if possible. */
+		/* FIXME: We do this *again* in peer_accepted_htlc! */
+		op = parse_onionpacket(tmpctx, added[i].onion_routing_packet,
+				       sizeof(added[i].onion_routing_packet),
+				       &failcode);
+		if (!op)
+			continue;
+
+		if (!ecdh_point_maybe_blinding(&op->ephemeralkey,
+					       added[i].blinding,
+					       &added[i].blinding_ss,
+					       &point)) {
+			log_debug(channel->log, "htlc %"PRIu64
+				  ": can't tweak pubkey", added[i].id);
+			tal_free(cs);
+			return;
+		}
+
+		oe = tal(cs, struct onion_ecdh);
+		oe->cs = cs;
+		oe->ss = cs->shared_secrets[i] = tal(cs->shared_secrets,
+						     struct secret);
+		cs->num_pending++;
+		hsm_req(cs, ld, take(towire_hsmd_ecdh_req(NULL, &point)),
+			onion_ecdh_done, oe);
+	}
+
+	/* None of them were parsable? */
+	if (cs->num_pending == 0) {
+		tal_steal(tmpctx, cs);
+		got_commitsig(channel, cs->msg, cs->shared_secrets);
+	}
+}
+
 /* The peer doesn't tell us this separately, but logically it's a separate
  * step to receiving commitsig */
 static bool peer_sending_revocation(struct channel *channel,
@@ -2097,6 +2170,14 @@ static void retry_deferred_commitsig(struct chain_topology *topo,
 
 /* This also implies we're sending revocation */
 void peer_got_commitsig(struct channel *channel, const u8 *msg)
+{
+	got_commitsig(channel, msg, NULL);
+}
+
+/* If there are new HTLCs, we need their onion's @shared_secrets: if NULL,
+ * we go and get them first. */
+static void got_commitsig(struct channel *channel, const u8 *msg,
+			  struct secret **shared_secrets)
 {
 	u64 commitnum;
 	struct fee_states *fee_states;
@@ -2147,6 +2228,11 @@ void peer_got_commitsig(struct channel *channel, const u8 *msg)
 		return;
 	}
 
+	if (tal_count(added) && !shared_secrets) {
+		get_onion_secrets(channel, msg, added);
+		return;
+	}
+
 	tx->chainparams = chainparams;
 
 	log_debug(channel->log,
@@ -2159,7 +2245,8 @@ void peer_got_commitsig(struct channel *channel, const u8 *msg)
 
 	/* New HTLCs */
 	for (i = 0; i < tal_count(added); i++) {
-		if (!channel_added_their_htlc(channel, &added[i]))
+		if (!channel_added_their_htlc(channel, &added[i],
+					      shared_secrets[i]))
 			return;
 	}
 
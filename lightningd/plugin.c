@@ -1300,7 +1300,7 @@ static const char *plugin_subscriptions_add(struct plugin *plugin,
 static const char *plugin_hooks_add(struct plugin *plugin, const char *buffer,
 				    const jsmntok_t *resulttok)
 {
-	const jsmntok_t *t, *hookstok, *beforetok, *aftertok;
+	const jsmntok_t *t, *hookstok, *beforetok, *aftertok, *observertok;
 	size_t i;
 
 	hookstok = json_get_member(buffer, resulttok, "hooks");
@@ -1310,6 +1310,7 @@ static const char *plugin_hooks_add(struct plugin *plugin, const char *buffer,
 	json_for_each_arr(i, t, hookstok) {
 		char *name;
 		struct plugin_hook *hook;
+		bool observer = false;
 
 		if (t->type == JSMN_OBJECT) {
 			const jsmntok_t *nametok;
@@ -1322,13 +1323,25 @@ static const char *plugin_hooks_add(struct plugin *plugin, const char *buffer,
 			name = json_strdup(tmpctx, buffer, nametok);
 			beforetok = json_get_member(buffer, t, "before");
 			aftertok = json_get_member(buffer, t, "after");
+			observertok = json_get_member(buffer, t, "observer");
+			if (observertok
+			    && !json_to_bool(buffer, observertok, &observer))
+				return tal_fmt(plugin,
+					       "observer must be a boolean in"
+					       " hook obj %.*s",
+					       json_tok_full_len(t),
+					       json_tok_full(buffer, t));
+			/* We always wait for all of those. */
+			if (observer && streq(name, "db_write"))
+				return tal_fmt(plugin,
+					       "db_write hook cannot be observed");
 		} else {
 			/* FIXME: deprecate in 3 releases after v0.9.2! */
 			name = json_strdup(tmpctx, plugin->buffer, t);
 			beforetok = aftertok = NULL;
 		}
 
-		hook = plugin_hook_register(plugin, name);
+		hook = plugin_hook_register(plugin, name, observer);
 		if (!hook) {
 			return tal_fmt(plugin,
 				    "could not register hook '%s', either the "
@@ -1,5 +1,6 @@
 #include "config.h"
 #include <ccan/io/io.h>
+#include <common/json_stream.h>
 #include <common/json_parse.h>
 #include <common/memleak.h>
 #include <db/exec.h>
@@ -15,6 +16,14 @@ struct plugin_hook_request {
 	void *cb_arg;
 	struct db *db;
 	struct lightningd *ld;
+	/* When we called the first plugin, and the current one */
+	struct timemono start, called;
+};
+
+/* How long plugins take to respond */
+struct hook_latency {
+	u64 calls;
+	u64 total_usec, max_usec;
 };
 
 struct hook_instance {
@@ -23,6 +32,11 @@ struct hook_instance {
 
 	/* Dependencies it asked for. */
 	const char **before, **after;
+
+	/* Does it promise to always return continue?  Then we don't wait. */
+	bool observer;
+
+	struct hook_latency latency;
 };
 
 /* A link in the plugin_hook call chain (there's a joke in there about
@@ -34,9 +48,31 @@ struct hook_instance {
 struct plugin_hook_call_link {
 	struct list_node list;
 	struct plugin *plugin;
+	struct hook_instance *h;
 	struct plugin_hook_request *req;
 };
 
+/* A call to an observer: nobody waits for this. */
+struct plugin_hook_observer {
+	struct lightningd *ld;
+	const struct plugin_hook *hook;
+	struct hook_instance *h;
+	struct timemono called;
+};
+
+/* Returns the usec since @start */
+static u64 hook_latency_add(struct hook_latency *latency,
+			    struct timemono start)
+{
+	u64 usec = time_to_usec(timemono_between(time_mono(), start));
+
+	latency->calls++;
+	latency->total_usec += usec;
+	if (usec > latency->max_usec)
+		latency->max_usec = usec;
+	return usec;
+}
+
 static struct plugin_hook **get_hooks(size_t *num)
 {
 	static struct plugin_hook **hooks = NULL;
@@ -71,7 +107,9 @@ static void destroy_hook_instance(struct hook_instance *h,
 	abort();
 }
 
-struct plugin_hook *plugin_hook_register(struct plugin *plugin, const char *method)
+struct plugin_hook *plugin_hook_register(struct plugin *plugin,
+					 const char *method,
+					 bool observer)
 {
 	struct hook_instance *h;
 	struct plugin_hook *hook = plugin_hook_by_name(method);
@@ -83,6 +121,8 @@ struct plugin_hook *plugin_hook_register(struct plugin *plugin, const char *meth
 	/* Make sure the hook_elements array is initialized. */
 	if (hook->hooks == NULL)
 		hook->hooks = notleak(tal_arr(NULL, struct hook_instance *, 0));
+	if (hook->latency == NULL)
+		hook->latency = notleak(talz(NULL, struct hook_latency));
 
 	/* Ensure we don't register the same plugin multple times. */
 	for (size_t i=0; i<tal_count(hook->hooks); i++)
@@ -95,6 +135,8 @@ struct plugin_hook *plugin_hook_register(struct plugin *plugin, const char *meth
 	h->plugin = plugin;
 	h->before = tal_arr(h, const char *, 0);
 	h->after = tal_arr(h, const char *, 0);
+	h->observer = observer;
+	memset(&h->latency, 0, sizeof(h->latency));
 	tal_add_destructor2(h, destroy_hook_instance, hook);
 
 	tal_arr_expand(&hook->hooks, h);
@@ -165,16 +207,21 @@ static void plugin_hook_callback(const char *buffer, const jsmntok_t *toks,
 	last = list_pop(&r->call_chain, struct plugin_hook_call_link, list);
 	assert(last != NULL);
 	tal_del_destructor(last, plugin_hook_killed);
-	tal_free(last);
 
 	if (r->ld->state == LD_STATE_SHUTDOWN) {
+		tal_free(last);
 		log_debug(r->ld->log,
 			  "Abandoning plugin hook call due to shutdown");
 		return;
 	}
 
-	log_debug(r->ld->log, "Plugin %s returned from %s hook call",
-		  r->plugin->shortname, r->hook->name);
+	/* If it died, its hook_instance may be gone already */
+	if (buffer)
+		log_debug(r->ld->log,
+			  "Plugin %s returned from %s hook call after %"PRIu64"usec",
+			  r->plugin->shortname, r->hook->name,
+			  hook_latency_add(&last->h->latency, r->called));
+	tal_free(last);
 
 	if (buffer) {
 		resulttok = json_get_member(buffer, toks, "result");
@@ -187,6 +234,7 @@ static void plugin_hook_callback(const char *buffer, const jsmntok_t *toks,
 		db_begin_transaction(db);
 		if (!r->hook->deserialize_cb(r->cb_arg, buffer,
 					     resulttok)) {
+			hook_latency_add(r->hook->latency, r->start);
 			tal_free(r->cb_arg);
 			db_commit_transaction(db);
 			goto cleanup;
@@ -204,6 +252,8 @@ static void plugin_hook_callback(const char *buffer, const jsmntok_t *toks,
 		return;
 	}
 
+	hook_latency_add(r->hook->latency, r->start);
+
 	/* We optimize for the case where we already called deserialize_cb */
 	if (!in_transaction)
 		db_begin_transaction(db);
@@ -231,6 +281,7 @@ static void plugin_hook_call_next(struct plugin_hook_request *ph_req)
 
 	log_debug(ph_req->ld->log, "Calling %s hook of plugin %s",
 		  ph_req->hook->name, ph_req->plugin->shortname);
+	ph_req->called = time_mono();
 	req = jsonrpc_request_start(NULL, hook->name,
 				    plugin_get_log(ph_req->plugin),
 				    NULL,
@@ -241,12 +292,68 @@ static void plugin_hook_call_next(struct plugin_hook_request *ph_req)
 	plugin_request_send(ph_req->plugin, req);
 }
 
+static void plugin_hook_observed(const char *buffer, const jsmntok_t *toks,
+				 const jsmntok_t *idtok,
+				 struct plugin_hook_observer *o)
+{
+	const jsmntok_t *resulttok = json_get_member(buffer, toks, "result");
+
+	log_debug(o->ld->log,
+		  "Observer %s returned from %s hook call after %"PRIu64"usec",
+		  o->h->plugin->shortname, o->hook->name,
+		  hook_latency_add(&o->h->latency, o->called));
+
+	/* It's too late to do anything else, so complain. */
+	if (!resulttok || !plugin_hook_continue(NULL, buffer, resulttok))
+		log_unusual(o->h->plugin->log,
+			    "Observer of %s hook returned %.*s: ignoring",
+			    o->hook->name,
+			    json_tok_full_len(toks), json_tok_full(buffer, toks));
+}
+
+static void plugin_hook_observe(struct lightningd *ld,
+				const struct plugin_hook *hook,
+				struct hook_instance *h,
+				void *cb_arg)
+{
+	struct jsonrpc_request *req;
+	struct plugin_hook_observer *o = tal(NULL, struct plugin_hook_observer);
+
+	o->ld = ld;
+	o->hook = hook;
+	o->h = h;
+
+	log_debug(ld->log, "Calling %s hook of observer %s",
+		  hook->name, h->plugin->shortname);
+	o->called = time_mono();
+	req = jsonrpc_request_start(NULL, hook->name,
+				    plugin_get_log(h->plugin),
+				    NULL,
+				    plugin_hook_observed, o);
+	/* Freed with the request (or the plugin, if it dies first) */
+	tal_steal(req, o);
+
+	hook->serialize_payload(cb_arg, req->stream, h->plugin);
+	jsonrpc_request_end(req);
+	plugin_request_send(h->plugin, req);
+}
+
 bool plugin_hook_call_(struct lightningd *ld, const struct plugin_hook *hook,
 		       tal_t *cb_arg STEALS)
 {
 	struct plugin_hook_request *ph_req;
 	struct plugin_hook_call_link *link;
-	if (tal_count(hook->hooks)) {
+	size_t num_chained = 0;
+
+	/* Observers can't change the outcome, so tell them all at once. */
+	for (size_t i = 0; i < tal_count(hook->hooks); i++) {
+		if (hook->hooks[i]->observer)
+			plugin_hook_observe(ld, hook, hook->hooks[i], cb_arg);
+		else
+			num_chained++;
+	}
+
+	if (num_chained) {
 		/* If we have a plugin that has registered for this
 		 * hook, serialize and call it */
 		/* FIXME: technically this is a leak, but we don't
@@ -258,12 +365,17 @@ bool plugin_hook_call_(struct lightningd *ld, const struct plugin_hook *hook,
 		ph_req->db = ld->wallet->db;
 		ph_req->ld = ld;
 
+		ph_req->start = time_mono();
+
 		list_head_init(&ph_req->call_chain);
 		for (size_t i=0; i<tal_count(hook->hooks); i++) {
+			if (hook->hooks[i]->observer)
+				continue;
 			/* We allocate this off of the plugin so we get notified if the plugin dies. */
 			link = tal(hook->hooks[i]->plugin,
 				   struct plugin_hook_call_link);
 			link->plugin = hook->hooks[i]->plugin;
+			link->h = hook->hooks[i];
 			link->req = ph_req;
 			tal_add_destructor(link, plugin_hook_killed);
 			list_add_tail(&ph_req->call_chain, &link->list);
@@ -271,8 +383,8 @@ bool plugin_hook_call_(struct lightningd *ld, const struct plugin_hook *hook,
 		plugin_hook_call_next(ph_req);
 		return false;
 	} else {
-		/* If no plugin has registered for this hook, just
-		 * call the callback with a NULL result. Saves us the
+		/* If no plugin (except observers) has registered for this
+		 * hook, just call the callback with a NULL result. Saves us the
 		 * roundtrip to the serializer and deserializer. If we
 		 * were expecting a default response it should have
 		 * been part of the `cb_arg`. */
@@ -291,6 +403,7 @@ AUTODATA(hooks, &db_write_hook);
 /* A `db_write` for one particular plugin hook.  */
 struct db_write_hook_req {
 	struct plugin *plugin;
+	struct hook_instance *h;
 	struct plugin_hook_request *ph_req;
 	size_t *num_hooks;
 };
@@ -326,6 +439,8 @@ static void db_hook_response(const char *buffer, const jsmntok_t *toks,
 		      json_tok_full_len(toks),
 		      json_tok_full(buffer, toks));
 
+	hook_latency_add(&dwh_req->h->latency, dwh_req->ph_req->start);
+
 	assert((*dwh_req->num_hooks) != 0);
 	--(*dwh_req->num_hooks);
 	/* If there are other runners, do not exit yet.  */
@@ -361,12 +476,14 @@ void plugin_hook_db_sync(struct db *db)
 	ph_req->hook = hook;
 	ph_req->db = db;
 	ph_req->cb_arg = &num_hooks;
+	ph_req->start = time_mono();
 
 	for (i = 0; i < num_hooks; ++i) {
 		/* Create an object for this plugin.  */
 		struct db_write_hook_req *dwh_req;
 		dwh_req = tal(ph_req, struct db_write_hook_req);
 		dwh_req->plugin = plugins[i];
+		dwh_req->h = hook->hooks[i];
 		dwh_req->ph_req = ph_req;
 		dwh_req->num_hooks = &num_hooks;
 
@@ -398,6 +515,7 @@ void plugin_hook_db_sync(struct db *db)
 		io_break(ret);
 	}
 	assert(num_hooks == 0);
+	hook_latency_add(hook->latency, ph_req->start);
 	tal_free(plugins);
 	tal_free(ph_req);
 }
@@ -564,3 +682,40 @@ struct plugin **plugin_hooks_make_ordered(const tal_t *ctx)
 
 	return ret;
 }
+
+static void json_add_hook_latency(struct json_stream *js,
+				  const struct hook_latency *latency)
+{
+	json_add_u64(js, "calls", latency->calls);
+	json_add_u64(js, "total_usec", latency->total_usec);
+	json_add_u64(js, "max_usec", latency->max_usec);
+}
+
+void json_add_hook_metrics(struct json_stream *js, const char *fieldname)
+{
+	size_t num_hooks;
+	struct plugin_hook **hooks = get_hooks(&num_hooks);
+
+	json_array_start(js, fieldname);
+	for (size_t i = 0; i < num_hooks; i++) {
+		/* Never registered? */
+		if (!hooks[i]->latency)
+			continue;
+
+		json_object_start(js, NULL);
+		json_add_string(js, "hook", hooks[i]->name);
+		json_add_hook_latency(js, hooks[i]->latency);
+		json_array_start(js, "plugins");
+		for (size_t j = 0; j < tal_count(hooks[i]->hooks); j++) {
+			const struct hook_instance *h = hooks[i]->hooks[j];
+			json_object_start(js, NULL);
+			json_add_string(js, "plugin", h->plugin->shortname);
+			json_add_bool(js, "observer", h->observer);
+			json_add_hook_latency(js, &h->latency);
+			json_object_end(js);
+		}
+		json_array_end(js);
+		json_object_end(js);
+	}
+	json_array_end(js);
+}
@@ -30,6 +30,10 @@
  * - If all `deserialize_cb` return true, `final_cb` is called.  It must free
  *   or otherwise take ownership of the cb_arg_type argument.
  *
+ * Plugins which registered as observers are sent the payload at once, and
+ * their responses are ignored (other than timing them), so we never wait
+ * for them.
+ *
  * To make hook invocations easier, each hook provides a `plugin_hook_call_hookname`
  * function that performs typechecking at compile time, and makes sure
  * that all the provided functions for serialization, deserialization
@@ -50,6 +54,9 @@ struct plugin_hook {
 	/* Which plugins have registered this hook? This is a `tal_arr`
 	 * initialized at creation. */
 	struct hook_instance **hooks;
+
+	/* How long we wait for them all, once anyone has registered. */
+	struct hook_latency *latency;
 };
 AUTODATA_TYPE(hooks, struct plugin_hook);
 
@@ -101,12 +108,15 @@ bool plugin_hook_continue(void *arg, const char *buffer, const jsmntok_t *toks);
 		void (*)(cb_arg_type, struct json_stream *, struct plugin *),  \
 		serialize_payload),                                            \
 	    NULL, /* .plugins */                                               \
+	    NULL, /* .latency */                                               \
 	};                                                                     \
 	AUTODATA(hooks, &name##_hook_gen);                                     \
 	PLUGIN_HOOK_CALL_DEF(name, cb_arg_type)
 
+/* Returns NULL if no such hook, or @plugin already registered it. */
 struct plugin_hook *plugin_hook_register(struct plugin *plugin,
-					 const char *method);
+					 const char *method,
+					 bool observer);
 
 /* Special sync plugin hook for db. */
 void plugin_hook_db_sync(struct db *db);
@@ -121,4 +131,7 @@ void plugin_hook_add_deps(struct plugin_hook *hook,
 /* Returns array of plugins which cannot be ordered (empty on success) */
 struct plugin **plugin_hooks_make_ordered(const tal_t *ctx);
 
+/* Add an array of how long each hook (and each plugin) took, for getmetrics */
+void json_add_hook_metrics(struct json_stream *js, const char *fieldname);
+
 #endif /* LIGHTNING_LIGHTNINGD_PLUGIN_HOOK_H */
@@ -1,7 +1,10 @@
 #include "config.h"
 #include <common/bolt11.h>
+#include <common/gossip_constants.h>
+#include <common/gossmap.h>
 #include <common/json_parse.h>
 #include <common/type_to_string.h>
+#include <errno.h>
 #include <gossipd/gossipd_wiregen.h>
 #include <lightningd/channel.h>
 #include <lightningd/lightningd.h>
@@ -18,20 +21,48 @@ static bool scid_in_arr(const struct short_channel_id *scidarr,
 	return false;
 }
 
-struct routehint_candidate *
-routehint_candidates(const tal_t *ctx,
-		     struct lightningd *ld,
-		     const char *buf,
-		     const jsmntok_t *toks,
-		     const bool *expose_all_private,
-		     const struct short_channel_id *hints,
-		     bool *none_public,
-		     struct amount_msat *avail_capacity,
-		     struct amount_msat *private_capacity,
-		     struct amount_msat *deadend_capacity,
-		     struct amount_msat *offline_capacity)
+/* Our view of the gossip_store, for routehints. */
+struct routehint_cache {
+	struct gossmap *gossmap;
+	/* NULL if gossip changed since we last looked */
+	struct gossmap_incoming *incoming;
+};
+
+const struct gossmap_incoming *routehint_incoming(struct lightningd *ld)
 {
-	struct routehint_candidate *candidates, *privcandidates;
+	struct routehint_cache *cache = ld->routehint_cache;
+
+	if (!cache) {
+		cache = ld->routehint_cache = tal(ld, struct routehint_cache);
+		cache->gossmap = NULL;
+		cache->incoming = NULL;
+	}
+
+	/* gossipd creates it at startup, but be careful. */
+	if (!cache->gossmap) {
+		cache->gossmap = gossmap_load(cache, GOSSIP_STORE_FILENAME,
+					      NULL);
+		if (!cache->gossmap) {
+			log_debug(ld->log, "routehint: cannot load %s: %s",
+				  GOSSIP_STORE_FILENAME, strerror(errno));
+			return NULL;
+		}
+	} else if (gossmap_refresh(cache->gossmap, NULL))
+		cache->incoming = tal_free(cache->incoming);
+
+	if (!cache->incoming)
+		cache->incoming = gossmap_incoming_chans(cache, cache->gossmap,
+							 &ld->id);
+	return cache->incoming;
+}
+
+struct gossmap_incoming *
+routehint_incoming_from_json(const tal_t *ctx,
+			     struct lightningd *ld,
+			     const char *buf,
+			     const jsmntok_t *toks)
+{
+	struct gossmap_incoming *incoming;
 	const jsmntok_t *t, *arr;
 	size_t i;
 
@@ -47,26 +78,10 @@ routehint_candidates(const tal_t *ctx,
 		      json_tok_full(buf, toks));
 	arr = json_get_member(buf, t, "incoming");
 
-	candidates = tal_arr(ctx, struct routehint_candidate, 0);
-	privcandidates = tal_arr(tmpctx, struct routehint_candidate, 0);
-	*none_public = true;
-	*deadend_capacity = AMOUNT_MSAT(0);
-	*offline_capacity = AMOUNT_MSAT(0);
-	*avail_capacity = AMOUNT_MSAT(0);
-	*private_capacity = AMOUNT_MSAT(0);
-
-	/* We combine the JSON output which knows the peers' details,
-	 * with our internal information */
+	incoming = tal_arr(ctx, struct gossmap_incoming, 0);
 	json_for_each_arr(i, t, arr) {
-		struct amount_msat capacity;
+		struct gossmap_incoming in;
 		const char *err;
-		struct routehint_candidate candidate;
-		struct amount_msat fee_base, htlc_max;
-		struct route_info *r;
-		struct peer *peer;
-		bool is_public;
-
-		r = tal(tmpctx, struct route_info);
 
 		err = json_scan(tmpctx, buf, t,
 				"{id:%"
@@ -77,15 +92,14 @@ routehint_candidates(const tal_t *ctx,
 				",htlc_max_msat:%"
 				",incoming_capacity_msat:%"
 				"}",
-				JSON_SCAN(json_to_node_id, &r->pubkey),
-				JSON_SCAN(json_to_short_channel_id,
-					  &r->short_channel_id),
-				JSON_SCAN(json_to_msat, &fee_base),
+				JSON_SCAN(json_to_node_id, &in.peer_id),
+				JSON_SCAN(json_to_short_channel_id, &in.scid),
+				JSON_SCAN(json_to_msat, &in.fee_base),
 				JSON_SCAN(json_to_u32,
-					  &r->fee_proportional_millionths),
-				JSON_SCAN(json_to_u16, &r->cltv_expiry_delta),
-				JSON_SCAN(json_to_msat, &htlc_max),
-				JSON_SCAN(json_to_msat, &capacity));
+					  &in.fee_proportional_millionths),
+				JSON_SCAN(json_to_u16, &in.cltv_expiry_delta),
+				JSON_SCAN(json_to_msat, &in.htlc_max),
+				JSON_SCAN(json_to_msat, &in.incoming_capacity));
 
 		if (err) {
 			fatal("Invalid return from listincoming (%s): %.*s",
@@ -93,6 +107,47 @@ routehint_candidates(const tal_t *ctx,
 			      json_tok_full_len(toks),
 			      json_tok_full(buf, toks));
 		}
+		tal_arr_expand(&incoming, in);
+	}
+	return incoming;
+}
+
+struct routehint_candidate *
+routehint_candidates(const tal_t *ctx,
+		     struct lightningd *ld,
+		     const struct gossmap_incoming *incoming,
+		     const bool *expose_all_private,
+		     const struct short_channel_id *hints,
+		     bool *none_public,
+		     struct amount_msat *avail_capacity,
+		     struct amount_msat *private_capacity,
+		     struct amount_msat *deadend_capacity,
+		     struct amount_msat *offline_capacity)
+{
+	struct routehint_candidate *candidates, *privcandidates;
+
+	candidates = tal_arr(ctx, struct routehint_candidate, 0);
+	privcandidates = tal_arr(tmpctx, struct routehint_candidate, 0);
+	*none_public = true;
+	*deadend_capacity = AMOUNT_MSAT(0);
+	*offline_capacity = AMOUNT_MSAT(0);
+	*avail_capacity = AMOUNT_MSAT(0);
+	*private_capacity = AMOUNT_MSAT(0);
+
+	/* We combine what gossip says about the peers' side of our channels
+	 * with our internal information */
+	for (size_t i = 0; i < tal_count(incoming); i++) {
+		const struct gossmap_incoming *in = &incoming[i];
+		struct routehint_candidate candidate;
+		struct route_info *r;
+		struct peer *peer;
+		bool is_public;
+
+		r = tal(tmpctx, struct route_info);
+		r->pubkey = in->peer_id;
+		r->short_channel_id = in->scid;
+		r->fee_proportional_millionths = in->fee_proportional_millionths;
+		r->cltv_expiry_delta = in->cltv_expiry_delta;
 
 		/* Do we know about this peer? */
 		peer = peer_by_id(ld, &r->pubkey);
@@ -142,8 +197,8 @@ routehint_candidates(const tal_t *ctx,
 		 * limit anyway */
 		/* FIXME: Present max capacity of multiple channels? */
 		candidate.capacity = channel_amount_receivable(candidate.c);
-		if (amount_msat_greater(candidate.capacity, htlc_max))
-			candidate.capacity = htlc_max;
+		if (amount_msat_greater(candidate.capacity, in->htlc_max))
+			candidate.capacity = in->htlc_max;
 
 		/* Now we can tell if it's public.  If so (even if it's otherwise
 		 * unusable), we *don't* expose private channels! */
@@ -158,13 +213,16 @@ routehint_candidates(const tal_t *ctx,
 		if (expose_all_private != NULL && *expose_all_private)
 			is_public = true;
 
-		r->fee_base_msat = fee_base.millisatoshis; /* Raw: route_info */
+		r->fee_base_msat = in->fee_base.millisatoshis; /* Raw: route_info */
 		/* Could wrap: if so ignore */
-		if (!amount_msat_eq(amount_msat(r->fee_base_msat), fee_base)) {
+		if (!amount_msat_eq(amount_msat(r->fee_base_msat), in->fee_base)) {
 			log_debug(ld->log,
-				  "Peer charging insane fee %.*s; ignoring",
-				  json_tok_full_len(t),
-				  json_tok_full(buf, t));
+				  "%s: peer charging insane fee %s; ignoring",
+				  type_to_string(tmpctx,
+						 struct short_channel_id,
+						 &r->short_channel_id),
+				  type_to_string(tmpctx, struct amount_msat,
+						 &in->fee_base));
 			continue;
 		}
 
@@ -179,7 +237,7 @@ routehint_candidates(const tal_t *ctx,
 				continue;
 			}
 			/* If they give us a hint, we use even if capacity 0 */
-		} else if (amount_msat_eq(capacity, AMOUNT_MSAT(0))) {
+		} else if (amount_msat_eq(in->incoming_capacity, AMOUNT_MSAT(0))) {
 			log_debug(ld->log, "%s: deadend",
 				  type_to_string(tmpctx,
 						 struct short_channel_id,
@@ -2,13 +2,16 @@
 #ifndef LIGHTNING_LIGHTNINGD_ROUTEHINT_H
 #define LIGHTNING_LIGHTNINGD_ROUTEHINT_H
 #include "config.h"
+#include <bitcoin/short_channel_id.h>
 #include <ccan/short_types/short_types.h>
 #include <ccan/tal/tal.h>
 #include <common/amount.h>
+#include <common/gossmap_incoming.h>
+#include <common/json_parse_simple.h>
+#include <common/node_id.h>
 #include <stdbool.h>
 
 struct lightningd;
-struct short_channel_id;
 
 struct routehint_candidate {
 	struct route_info *r;
@@ -17,10 +20,33 @@ struct routehint_candidate {
 };
 
 /**
- * routehint_candidates - get possible incoming channels for routehinting.
+ * routehint_incoming - our channels as the topology plugin's listincoming
+ * would show them.
+ * @ld: lightningd
+ *
+ * We read the gossip_store ourselves, and only recalculate this when it
+ * changes, so invoices don't have to wait for a plugin.  Returns NULL if
+ * we can't read the gossip_store.
+ */
+const struct gossmap_incoming *routehint_incoming(struct lightningd *ld);
+
+/**
+ * routehint_incoming_from_json - parse the output of listincoming.
  * @ctx: tal context to allocate return off
  * @ld: lightningd
  * @buf, @toks: output of listincoming command
+ */
+struct gossmap_incoming *
+routehint_incoming_from_json(const tal_t *ctx,
+			     struct lightningd *ld,
+			     const char *buf,
+			     const jsmntok_t *toks);
+
+/**
+ * routehint_candidates - get possible incoming channels for routehinting.
+ * @ctx: tal context to allocate return off
+ * @ld: lightningd
+ * @incoming: from routehint_incoming or routehint_incoming_from_json.
  * @expose_all_private: trinary.  NULL=iff no public, true=always, false=never.
  * @hints: only consider these channels (if !expose_all_private).
  * @none_public: set to true if we used private channels because none were public.
@@ -32,8 +58,7 @@ struct routehint_candidate {
 struct routehint_candidate *
 routehint_candidates(const tal_t *ctx,
 		     struct lightningd *ld,
-		     const char *buf,
-		     const jsmntok_t *toks,
+		     const struct gossmap_incoming *incoming,
 		     const bool *expose_all_private,
 		     const struct short_channel_id *hints,
 		     bool *none_public,
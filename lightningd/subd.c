@@ -1,4 +1,5 @@
 #include "config.h"
+#include <assert.h>
 #include <ccan/closefrom/closefrom.h>
 #include <ccan/err/err.h>
 #include <ccan/io/fdpass/fdpass.h>
@@ -662,26 +663,32 @@ static void destroy_subd(struct subd *sd)
 	}
 }
 
+/* Messages to write in a single writev() */
+#define SUBD_WRITE_BATCH 64
+
 static struct io_plan *msg_send_next(struct io_conn *conn, struct subd *sd)
 {
-	const u8 *msg;
+	const u8 **msgs, *msg;
 	int fd;
 
 	/* Don't send if we haven't read version! */
 	if (!sd->rcvd_version)
 		return msg_queue_wait(conn, sd->outq, msg_send_next, sd);
 
+	/* Write as many as we can in one go (up to any fd). */
+	msgs = msg_dequeue_many(NULL, sd->outq, SUBD_WRITE_BATCH);
+	if (msgs)
+		return io_write_wires(conn, take(msgs), msg_send_next, sd);
+
 	/* Nothing to do?  Wait for msg_enqueue. */
 	msg = msg_dequeue(sd->outq);
 	if (!msg)
 		return msg_queue_wait(conn, sd->outq, msg_send_next, sd);
 
 	fd = msg_extract_fd(sd->outq, msg);
-	if (fd >= 0) {
-		tal_free(msg);
-		return io_send_fd(conn, fd, true, msg_send_next, sd);
-	}
-	return io_write_wire(conn, take(msg), msg_send_next, sd);
+	assert(fd >= 0);
+	tal_free(msg);
+	return io_send_fd(conn, fd, true, msg_send_next, sd);
 }
 
 static struct io_plan *msg_setup(struct io_conn *conn, struct subd *sd)
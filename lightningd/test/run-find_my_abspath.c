@@ -223,6 +223,9 @@ void waitblockheight_notify_new_block(struct lightningd *ld UNNEEDED,
 /* Generated stub for wallet_blocks_heights */
 void wallet_blocks_heights(struct wallet *w UNNEEDED, u32 def UNNEEDED, u32 *min UNNEEDED, u32 *max UNNEEDED)
 { fprintf(stderr, "wallet_blocks_heights called!\n"); abort(); }
+/* Generated stub for wallet_derkeys */
+u8 *wallet_derkeys(const tal_t *ctx UNNEEDED, struct wallet *w UNNEEDED, u64 max_index UNNEEDED)
+{ fprintf(stderr, "wallet_derkeys called!\n"); abort(); }
 /* Generated stub for wallet_new */
 struct wallet *wallet_new(struct lightningd *ld UNNEEDED, struct timers *timers UNNEEDED,
 			  struct ext_key *bip32_base UNNEEDED)
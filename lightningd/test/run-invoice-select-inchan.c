@@ -260,9 +260,28 @@ u32 get_feerate(const struct fee_states *fee_states UNNEEDED,
 		enum side opener UNNEEDED,
 		enum side side UNNEEDED)
 { fprintf(stderr, "get_feerate called!\n"); abort(); }
+/* Generated stub for gossmap_incoming_chans */
+struct gossmap_incoming *gossmap_incoming_chans(const tal_t *ctx UNNEEDED,
+						const struct gossmap *gossmap UNNEEDED,
+						const struct node_id *local_id UNNEEDED)
+{ fprintf(stderr, "gossmap_incoming_chans called!\n"); abort(); }
+/* Generated stub for gossmap_load */
+struct gossmap *gossmap_load(const tal_t *ctx UNNEEDED, const char *filename UNNEEDED,
+			     size_t *num_channel_updates_rejected UNNEEDED)
+{ fprintf(stderr, "gossmap_load called!\n"); abort(); }
+/* Generated stub for gossmap_refresh */
+bool gossmap_refresh(struct gossmap *map UNNEEDED, size_t *num_channel_updates_rejected UNNEEDED)
+{ fprintf(stderr, "gossmap_refresh called!\n"); abort(); }
 /* Generated stub for hash_htlc_key */
 size_t hash_htlc_key(const struct htlc_key *htlc_key UNNEEDED)
 { fprintf(stderr, "hash_htlc_key called!\n"); abort(); }
+/* Generated stub for hsm_req_ */
+void hsm_req_(const tal_t *ctx UNNEEDED,
+	      struct lightningd *ld UNNEEDED,
+	      const u8 *msg TAKES UNNEEDED,
+	      void (*cb)(struct lightningd *ld UNNEEDED, const u8 *reply UNNEEDED, void *arg) UNNEEDED,
+	      void *arg UNNEEDED)
+{ fprintf(stderr, "hsm_req_ called!\n"); abort(); }
 /* Generated stub for htlc_is_trimmed */
 bool htlc_is_trimmed(enum side htlc_owner UNNEEDED,
 		     struct amount_msat htlc_amount UNNEEDED,
@@ -340,6 +359,10 @@ void json_add_bolt11(struct json_stream *response UNNEEDED,
 void json_add_bool(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
 		   bool value UNNEEDED)
 { fprintf(stderr, "json_add_bool called!\n"); abort(); }
+/* Generated stub for json_add_errcode */
+void json_add_errcode(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		      errcode_t code UNNEEDED)
+{ fprintf(stderr, "json_add_errcode called!\n"); abort(); }
 /* Generated stub for json_add_escaped_string */
 void json_add_escaped_string(struct json_stream *result UNNEEDED,
 			     const char *fieldname UNNEEDED,
@@ -785,17 +808,15 @@ void wallet_channeltxs_add(struct wallet *w UNNEEDED, struct channel *chan UNNEE
 			    const int type UNNEEDED, const struct bitcoin_txid *txid UNNEEDED,
 			   const u32 input_num UNNEEDED, const u32 blockheight UNNEEDED)
 { fprintf(stderr, "wallet_channeltxs_add called!\n"); abort(); }
-/* Generated stub for wallet_htlcs_load_in_for_channel */
-bool wallet_htlcs_load_in_for_channel(struct wallet *wallet UNNEEDED,
-				      struct channel *chan UNNEEDED,
-				      struct htlc_in_map *htlcs_in UNNEEDED)
-{ fprintf(stderr, "wallet_htlcs_load_in_for_channel called!\n"); abort(); }
-/* Generated stub for wallet_htlcs_load_out_for_channel */
-bool wallet_htlcs_load_out_for_channel(struct wallet *wallet UNNEEDED,
-				       struct channel *chan UNNEEDED,
-				       struct htlc_out_map *htlcs_out UNNEEDED,
-				       struct htlc_in_map *remaining_htlcs_in UNNEEDED)
-{ fprintf(stderr, "wallet_htlcs_load_out_for_channel called!\n"); abort(); }
+/* Generated stub for wallet_htlcs_load_in */
+bool wallet_htlcs_load_in(struct wallet *wallet UNNEEDED,
+			  struct htlc_in_map *htlcs_in UNNEEDED)
+{ fprintf(stderr, "wallet_htlcs_load_in called!\n"); abort(); }
+/* Generated stub for wallet_htlcs_load_out */
+bool wallet_htlcs_load_out(struct wallet *wallet UNNEEDED,
+			   struct htlc_out_map *htlcs_out UNNEEDED,
+			   struct htlc_in_map *remaining_htlcs_in UNNEEDED)
+{ fprintf(stderr, "wallet_htlcs_load_out called!\n"); abort(); }
 /* Generated stub for wallet_init_channels */
 bool wallet_init_channels(struct wallet *w UNNEEDED)
 { fprintf(stderr, "wallet_init_channels called!\n"); abort(); }
@@ -12,6 +12,10 @@ struct command_result *command_fail(struct command *cmd UNNEEDED, errcode_t code
 struct command_result *command_param_failed(void)
 
 { fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_still_pending */
+struct command_result *command_still_pending(struct command *cmd UNNEEDED)
+
+{ fprintf(stderr, "command_still_pending called!\n"); abort(); }
 /* Generated stub for command_success */
 struct command_result *command_success(struct command *cmd UNNEEDED,
 				       struct json_stream *response)
@@ -55,6 +59,10 @@ void json_add_string(struct json_stream *js UNNEEDED,
 void json_add_time(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
 			  struct timespec ts UNNEEDED)
 { fprintf(stderr, "json_add_time called!\n"); abort(); }
+/* Generated stub for json_add_u64 */
+void json_add_u64(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  uint64_t value UNNEEDED)
+{ fprintf(stderr, "json_add_u64 called!\n"); abort(); }
 /* Generated stub for json_array_end */
 void json_array_end(struct json_stream *js UNNEEDED)
 { fprintf(stderr, "json_array_end called!\n"); abort(); }
@@ -71,6 +79,11 @@ void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UN
 void json_stream_log_suppress_for_cmd(struct json_stream *js UNNEEDED,
 					    const struct command *cmd UNNEEDED)
 { fprintf(stderr, "json_stream_log_suppress_for_cmd called!\n"); abort(); }
+/* Generated stub for json_stream_on_drained_ */
+void json_stream_on_drained_(struct json_stream *js UNNEEDED,
+			     void (*cb)(struct json_stream *js UNNEEDED, void *arg) UNNEEDED,
+			     void *arg UNNEEDED)
+{ fprintf(stderr, "json_stream_on_drained_ called!\n"); abort(); }
 /* Generated stub for json_stream_success */
 struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
 { fprintf(stderr, "json_stream_success called!\n"); abort(); }
@@ -91,6 +104,11 @@ void notify_warning(struct lightningd *ld UNNEEDED, struct log_entry *l UNNEEDED
 bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
 	   const jsmntok_t params[] UNNEEDED, ...)
 { fprintf(stderr, "param called!\n"); abort(); }
+/* Generated stub for param_u64 */
+struct command_result *param_u64(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				 const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				 uint64_t **num UNNEEDED)
+{ fprintf(stderr, "param_u64 called!\n"); abort(); }
 /* Generated stub for towire_bigsize */
 void towire_bigsize(u8 **pptr UNNEEDED, const bigsize_t val UNNEEDED)
 { fprintf(stderr, "towire_bigsize called!\n"); abort(); }
@@ -148,6 +166,15 @@ int main(int argc, char *argv[])
 		total += 1 + lb->log[i].skipped;
 	assert(total == 102);
 
+	/* Pruning keeps them in order, so getlog can find where it was */
+	for (size_t i = 1; i < lb->num_entries; i++)
+		assert(lb->log[i].seq > lb->log[i-1].seq);
+	assert(lb->log[lb->num_entries - 1].seq == lb->next_seq - 1);
+	assert(log_find_seq(lb, 0) == 0);
+	assert(log_find_seq(lb, lb->next_seq) == lb->num_entries);
+	for (size_t i = 0; i < lb->num_entries; i++)
+		assert(log_find_seq(lb, lb->log[i].seq) == i);
+
 	/* Freeing (last) log frees logbook */
 	tal_free(l);
 	common_shutdown();
@@ -1,34 +1,170 @@
 #include "config.h"
 #include <ccan/array_size/array_size.h>
+#include <ccan/tal/str/str.h>
 #include <common/json_param.h>
 #include <common/json_stream.h>
 #include <plugins/libplugin.h>
 
+/* Must match the subsystems delrecords understands. */
+enum subsystem {
+	EXPIREDINVOICES,
+	SUCCEEDEDPAYS,
+	FAILEDPAYS,
+	SUCCEEDEDFORWARDS,
+	FAILEDFORWARDS,
+	NUM_SUBSYSTEMS,
+};
+
+static const char *subsystem_str[] = {
+	"expiredinvoices",
+	"succeededpays",
+	"failedpays",
+	"succeededforwards",
+	"failedforwards",
+};
+
+/* Legacy autocleaninvoice settings. */
 static u64 cycle_seconds = 0, expired_by = 86400;
+/* How old things have to be before we delete them: 0 means never. */
+static u64 subsystem_age[NUM_SUBSYSTEMS];
+static u64 autoclean_cycle = 3600;
+/* Each delrecords call is one db transaction in lightningd: keep it short. */
+static u32 autoclean_batch = 100;
 static struct plugin_timer *cleantimer;
 
+/* The cycle in progress, if any. */
+static bool cleaning;
+static enum subsystem cleaning_subsystem;
+static struct timemono cycle_start;
+static u64 cycle_cleaned[NUM_SUBSYSTEMS];
+static u64 total_cleaned[NUM_SUBSYSTEMS];
+
 static void do_clean(void *cb_arg);
 
-static struct command_result *ignore(struct command *timer,
-				     const char *buf,
-				     const jsmntok_t *result,
-				     void *arg)
+static u64 get_age(enum subsystem s)
+{
+	/* autocleaninvoice-cycle implies we clean expired invoices */
+	if (s == EXPIREDINVOICES
+	    && subsystem_age[s] == 0
+	    && cycle_seconds != 0)
+		return expired_by;
+	return subsystem_age[s];
+}
+
+static bool any_enabled(void)
 {
-	struct plugin *p = arg;
-	cleantimer = plugin_timer(p, time_from_sec(cycle_seconds), do_clean, p);
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++) {
+		if (get_age(i))
+			return true;
+	}
+	return false;
+}
+
+static void schedule_clean(struct plugin *p)
+{
+	u64 interval = cycle_seconds ? cycle_seconds : autoclean_cycle;
+
+	cleantimer = tal_free(cleantimer);
+	if (any_enabled())
+		cleantimer = plugin_timer(p, time_from_sec(interval),
+					  do_clean, p);
+}
+
+static struct command_result *clean_finished(struct plugin *p)
+{
+	char *summary = tal_strdup(tmpctx, "");
+	u64 total = 0;
+
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++) {
+		if (!get_age(i))
+			continue;
+		tal_append_fmt(&summary, "%s%"PRIu64" %s",
+			       strlen(summary) ? ", " : "",
+			       cycle_cleaned[i], subsystem_str[i]);
+		total += cycle_cleaned[i];
+	}
+	plugin_log(p, total ? LOG_INFORM : LOG_DBG,
+		   "Cleaned %s in %"PRIu64" msec",
+		   summary, time_to_msec(timemono_since(cycle_start)));
+
+	cleaning = false;
+	schedule_clean(p);
 	return timer_complete(p);
 }
 
+static struct command_result *clean_next(struct plugin *p);
+
+static struct command_result *del_done(struct command *cmd,
+				       const char *buf,
+				       const jsmntok_t *result,
+				       struct plugin *p)
+{
+	u64 deleted;
+	const char *err;
+
+	err = json_scan(tmpctx, buf, result, "{deleted:%}",
+			JSON_SCAN(json_to_u64, &deleted));
+	if (err)
+		plugin_err(p, "Bad delrecords response %s: %.*s",
+			   err,
+			   json_tok_full_len(result),
+			   json_tok_full(buf, result));
+
+	cycle_cleaned[cleaning_subsystem] += deleted;
+	total_cleaned[cleaning_subsystem] += deleted;
+
+	/* A short batch means there are no more (for now). */
+	if (deleted < autoclean_batch)
+		cleaning_subsystem++;
+	return clean_next(p);
+}
+
+static struct command_result *del_failed(struct command *cmd,
+					 const char *buf,
+					 const jsmntok_t *result,
+					 struct plugin *p)
+{
+	plugin_log(p, LOG_UNUSUAL, "Cleaning %s failed: %.*s",
+		   subsystem_str[cleaning_subsystem],
+		   json_tok_full_len(result),
+		   json_tok_full(buf, result));
+	cleaning_subsystem++;
+	return clean_next(p);
+}
+
+/* We delete a batch at a time, so lightningd can do other things between. */
+static struct command_result *clean_next(struct plugin *p)
+{
+	struct out_req *req;
+	u64 now = time_now().ts.tv_sec, age;
+
+	while (cleaning_subsystem < NUM_SUBSYSTEMS
+	       && !get_age(cleaning_subsystem))
+		cleaning_subsystem++;
+	if (cleaning_subsystem == NUM_SUBSYSTEMS)
+		return clean_finished(p);
+
+	age = get_age(cleaning_subsystem);
+	req = jsonrpc_request_start(p, NULL, "delrecords",
+				    del_done, del_failed, p);
+	json_add_string(req->js, "subsystem",
+			subsystem_str[cleaning_subsystem]);
+	json_add_u64(req->js, "before", age > now ? 0 : now - age);
+	json_add_u32(req->js, "limit", autoclean_batch);
+	return send_outreq(p, req);
+}
+
 static void do_clean(void *cb_arg)
 {
 	struct plugin *p = cb_arg;
-	/* FIXME: delexpiredinvoice should be in our plugin too! */
-	struct out_req *req = jsonrpc_request_start(p, NULL, "delexpiredinvoice",
-						    ignore, ignore, p);
-	json_add_u64(req->js, "maxexpirytime",
-		     time_now().ts.tv_sec - expired_by);
 
-	send_outreq(p, req);
+	/* The timer is freed once we return. */
+	cleantimer = NULL;
+	cleaning = true;
+	cleaning_subsystem = 0;
+	cycle_start = time_mono();
+	memset(cycle_cleaned, 0, sizeof(cycle_cleaned));
+	clean_next(p);
 }
 
 static struct command_result *json_autocleaninvoice(struct command *cmd,
@@ -48,7 +184,9 @@ static struct command_result *json_autocleaninvoice(struct command *cmd,
 	cycle_seconds = *cycle;
 	expired_by = *exby;
 
-	cleantimer = tal_free(cleantimer);
+	/* If we're cleaning now, we'll reschedule when done. */
+	if (!cleaning)
+		schedule_clean(cmd->plugin);
 
 	if (cycle_seconds == 0) {
 		response = jsonrpc_stream_success(cmd);
@@ -56,9 +194,6 @@ static struct command_result *json_autocleaninvoice(struct command *cmd,
 		return command_finished(cmd, response);
 	}
 
-	cleantimer = plugin_timer(cmd->plugin, time_from_sec(cycle_seconds),
-				  do_clean, cmd->plugin);
-
 	response = jsonrpc_stream_success(cmd);
 	json_add_bool(response, "enabled", true);
 	json_add_u64(response, "cycle_seconds", cycle_seconds);
@@ -66,13 +201,72 @@ static struct command_result *json_autocleaninvoice(struct command *cmd,
 	return command_finished(cmd, response);
 }
 
+static struct command_result *param_subsystem(struct command *cmd,
+					      const char *name,
+					      const char *buffer,
+					      const jsmntok_t *tok,
+					      enum subsystem **subsystem)
+{
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++) {
+		if (json_tok_streq(buffer, tok, subsystem_str[i])) {
+			*subsystem = tal(cmd, enum subsystem);
+			**subsystem = i;
+			return NULL;
+		}
+	}
+	return command_fail_badparam(cmd, name, buffer, tok,
+				     "should be 'expiredinvoices',"
+				     " 'succeededpays', 'failedpays',"
+				     " 'succeededforwards' or 'failedforwards'");
+}
+
+static void json_add_subsystem(struct json_stream *js, enum subsystem s)
+{
+	u64 age = get_age(s);
+
+	json_object_start(js, subsystem_str[s]);
+	json_add_bool(js, "enabled", age != 0);
+	if (age)
+		json_add_u64(js, "age", age);
+	json_add_u64(js, "cleaned", total_cleaned[s]);
+	json_object_end(js);
+}
+
+static struct command_result *json_autoclean_status(struct command *cmd,
+						    const char *buffer,
+						    const jsmntok_t *params)
+{
+	enum subsystem *subsystem;
+	struct json_stream *response;
+
+	if (!param(cmd, buffer, params,
+		   p_opt("subsystem", param_subsystem, &subsystem),
+		   NULL))
+		return command_param_failed();
+
+	response = jsonrpc_stream_success(cmd);
+	json_object_start(response, "autoclean");
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++) {
+		if (subsystem && *subsystem != i)
+			continue;
+		json_add_subsystem(response, i);
+	}
+	json_object_end(response);
+	return command_finished(cmd, response);
+}
+
 static const char *init(struct plugin *p,
 			const char *buf UNUSED, const jsmntok_t *config UNUSED)
 {
-	if (cycle_seconds) {
-		plugin_log(p, LOG_INFORM, "autocleaning every %"PRIu64" seconds", cycle_seconds);
-		cleantimer = plugin_timer(p, time_from_sec(cycle_seconds),
-					  do_clean, p);
+	if (autoclean_cycle == 0)
+		return "autoclean-cycle must be non-zero";
+	if (autoclean_batch == 0)
+		return "autoclean-batch must be non-zero";
+
+	if (any_enabled()) {
+		plugin_log(p, LOG_INFORM, "autocleaning every %"PRIu64" seconds",
+			   cycle_seconds ? cycle_seconds : autoclean_cycle);
+		schedule_clean(p);
 	} else
 		plugin_log(p, LOG_DBG, "autocleaning not active");
 
@@ -86,6 +280,13 @@ static const struct plugin_command commands[] = { {
 	"Perform cleanup every {cycle_seconds} (default 3600), or disable autoclean if 0. "
 	"Clean up expired invoices that have expired for {expired_by} seconds (default 86400). ",
 	json_autocleaninvoice
+	},
+	{
+	"autoclean-status",
+	"utility",
+	"Show which subsystems are being cleaned, and how much has been cleaned",
+	"Show autoclean settings and total cleaned for {subsystem} (default all)",
+	json_autoclean_status
 	}
 };
 
@@ -105,5 +306,40 @@ int main(int argc, char *argv[])
 				  " invoices that have expired for at least"
 				  " this given seconds are cleaned",
 				  u64_option, &expired_by),
+		    plugin_option("autoclean-cycle",
+				  "int",
+				  "Perform cleanup every"
+				  " given seconds",
+				  u64_option, &autoclean_cycle),
+		    plugin_option("autoclean-batch",
+				  "int",
+				  "Delete at most this many records in each"
+				  " call to lightningd",
+				  u32_option, &autoclean_batch),
+		    plugin_option("autoclean-expiredinvoices-age",
+				  "int",
+				  "How old do expired invoices have to be before"
+				  " deletion (0 = never)",
+				  u64_option, &subsystem_age[EXPIREDINVOICES]),
+		    plugin_option("autoclean-succeededpays-age",
+				  "int",
+				  "How old do successful pays have to be before"
+				  " deletion (0 = never)",
+				  u64_option, &subsystem_age[SUCCEEDEDPAYS]),
+		    plugin_option("autoclean-failedpays-age",
+				  "int",
+				  "How old do failed pays have to be before"
+				  " deletion (0 = never)",
+				  u64_option, &subsystem_age[FAILEDPAYS]),
+		    plugin_option("autoclean-succeededforwards-age",
+				  "int",
+				  "How old do successful forwards have to be"
+				  " before deletion (0 = never)",
+				  u64_option, &subsystem_age[SUCCEEDEDFORWARDS]),
+		    plugin_option("autoclean-failedforwards-age",
+				  "int",
+				  "How old do failed forwards have to be"
+				  " before deletion (0 = never)",
+				  u64_option, &subsystem_age[FAILEDFORWARDS]),
 		    NULL);
 }
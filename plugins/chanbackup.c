@@ -10,9 +10,11 @@
 #include <common/hsm_encryption.h>
 #include <common/json_param.h>
 #include <common/json_stream.h>
+#include <common/memleak.h>
 #include <common/scb_wiregen.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <plugins/libplugin.h>
 #include <sodium.h>
 #include <unistd.h>
@@ -103,8 +105,9 @@ static void write_scb(struct plugin *p,
 
 }
 
-/* checks if the SCB file exists, creates a new one in case it doesn't. */
-static void maybe_create_new_scb(struct plugin *p,
+/* checks if the SCB file exists, creates a new one in case it doesn't:
+ * returns false if it already existed. */
+static bool maybe_create_new_scb(struct plugin *p,
 				 struct scb_chan **channels)
 {
 
@@ -112,9 +115,9 @@ static void maybe_create_new_scb(struct plugin *p,
 	 * are set to read-only.  That's perfectly valid! */
 	int fd = open("emergency.recover", O_CREAT|O_EXCL|O_WRONLY, 0400);
 	if (fd < 0) {
-		/* Don't do anything if the file already exists. */
+		/* Caller refreshes it if it already exists. */
 		if (errno == EEXIST)
-			return;
+			return false;
 		plugin_err(p, "creating: %s", strerror(errno));
 	}
 
@@ -161,58 +164,59 @@ static void maybe_create_new_scb(struct plugin *p,
 
 	/* This will update the scb file */
 	rename("scb.tmp", "emergency.recover");
+	return true;
 }
 
 
-/* Returns decrypted SCB in form of a u8 array */
+/* Returns decrypted SCB in form of a u8 array, or NULL (and logs why). */
 static u8 *decrypt_scb(struct plugin *p)
 {
 	struct stat st;
+	crypto_secretstream_xchacha20poly1305_state crypto_state;
+	u8 *final, *ans;
 	int fd = open("emergency.recover", O_RDONLY);
 
-	if (stat("emergency.recover", &st) != 0)
-		plugin_err(p, "SCB file is corrupted!: %s",
-                          strerror(errno));
-
-	u8 final[st.st_size];
-
-	if (!read_all(fd, &final, st.st_size)) {
-		plugin_log(p, LOG_DBG, "SCB file is corrupted!: %s",
-                           strerror(errno));
+	if (fd < 0) {
+		plugin_log(p, LOG_UNUSUAL, "Opening SCB file: %s",
+			   strerror(errno));
 		return NULL;
 	}
 
-	crypto_secretstream_xchacha20poly1305_state crypto_state;
+	if (fstat(fd, &st) != 0
+	    || st.st_size < ABYTES + HEADER_LEN) {
+		plugin_log(p, LOG_UNUSUAL, "SCB file is corrupted!");
+		close(fd);
+		return NULL;
+	}
 
-	if (st.st_size < ABYTES +
-			 HEADER_LEN)
-		plugin_err(p, "SCB file is corrupted!");
+	final = tal_arr(tmpctx, u8, st.st_size);
+	if (!read_all(fd, final, st.st_size)) {
+		plugin_log(p, LOG_UNUSUAL, "SCB file is corrupted!: %s",
+			   strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	close(fd);
 
-	u8 *ans = tal_arr(tmpctx, u8, st.st_size -
-                          ABYTES -
-                          HEADER_LEN);
+	ans = tal_arr(tmpctx, u8, st.st_size -
+		      ABYTES -
+		      HEADER_LEN);
 
 	/* The header part */
 	if (crypto_secretstream_xchacha20poly1305_init_pull(&crypto_state,
 							    final,
-							    (&secret)->data) != 0)
-	{
-		plugin_err(p, "SCB file is corrupted!");
-	}
-
-	if (crypto_secretstream_xchacha20poly1305_pull(&crypto_state, ans,
-						       NULL, 0,
-						       final +
-						       HEADER_LEN,
-						       st.st_size -
-						       HEADER_LEN,
-						       NULL, 0) != 0) {
-		plugin_err(p, "SCB file is corrupted!");
+							    (&secret)->data) != 0
+	    || crypto_secretstream_xchacha20poly1305_pull(&crypto_state, ans,
+							  NULL, 0,
+							  final +
+							  HEADER_LEN,
+							  st.st_size -
+							  HEADER_LEN,
+							  NULL, 0) != 0) {
+		plugin_log(p, LOG_UNUSUAL, "SCB file is corrupted!");
+		return NULL;
 	}
 
-	if (close(fd) != 0)
-		plugin_err(p, "Closing: %s", strerror(errno));
-
 	return ans;
 }
 
@@ -317,18 +321,166 @@ static void update_scb(struct plugin *p, struct scb_chan **channels)
 	rename("scb.tmp", "emergency.recover");
 }
 
+static bool scb_has_channel(struct scb_chan **channels,
+			    const struct channel_id *cid)
+{
+	for (size_t i = 0; i < tal_count(channels); i++) {
+		if (channel_id_eq(&channels[i]->cid, cid))
+			return true;
+	}
+	return false;
+}
+
+/* We may have stopped (or crashed) before writing the last changes, so
+ * the file can be stale: rewrite it at startup.  But keep any channels
+ * the db doesn't know about: it may have been lost, and they're about to
+ * emergencyrecover from this very file! */
+static void refresh_scb(struct plugin *p, struct scb_chan **channels)
+{
+	u64 version;
+	u32 timestamp;
+	struct scb_chan **old;
+	size_t num_kept = 0;
+
+	if (!channels)
+		channels = tal_arr(tmpctx, struct scb_chan *, 0);
+
+	if (!fromwire_static_chan_backup(tmpctx, decrypt_scb(p),
+					 &version, &timestamp, &old)
+	    || version != VERSION) {
+		plugin_log(p, LOG_UNUSUAL,
+			   "Can't read existing emergency.recover:"
+			   " leaving it alone");
+		return;
+	}
+
+	for (size_t i = 0; i < tal_count(old); i++) {
+		if (scb_has_channel(channels, &old[i]->cid))
+			continue;
+		tal_arr_expand(&channels, old[i]);
+		num_kept++;
+	}
+
+	if (num_kept)
+		plugin_log(p, LOG_UNUSUAL,
+			   "Keeping %zu channels from emergency.recover"
+			   " which we don't know about", num_kept);
+	update_scb(p, channels);
+}
+
+/* Channel state changes come in bursts (eg. multifundchannel, or a mass
+ * close): we coalesce them, writing the file once things have been quiet
+ * for scb_debounce_secs, but never later than SCB_MAX_STALE times that
+ * after the first unwritten change. */
+static u32 scb_debounce_secs = 1;
+#define SCB_MAX_STALE 10
+
+/* Latest SCB we got from staticbackup, but haven't written yet. */
+static struct scb_chan **pending_scb;
+static bool scb_pending;
+static struct timemono first_pending;
+static struct plugin_timer *write_timer;
+
+/* Only one staticbackup at a time: if more changes, ask again after. */
+static bool staticbackup_inflight, staticbackup_again;
+
+/* Statistics: writes avoided is changes - writes. */
+static u64 num_changes, num_writes;
+
+static void write_pending_scb(struct plugin *p)
+{
+	update_scb(p, pending_scb);
+	num_writes++;
+	plugin_log(p, LOG_INFORM,
+		   "Updated the SCB with %zu channels"
+		   " (%"PRIu64" state changes, %"PRIu64" writes)",
+		   tal_count(pending_scb), num_changes, num_writes);
+
+	pending_scb = tal_free(pending_scb);
+	scb_pending = false;
+	write_timer = tal_free(write_timer);
+}
+
+static void write_timer_expired(struct plugin *p)
+{
+	/* It's freed after we return. */
+	write_timer = NULL;
+	write_pending_scb(p);
+	timer_complete(p);
+}
+
+static void schedule_write(struct plugin *p)
+{
+	struct timemono now = time_mono();
+	struct timerel delay = time_from_sec(scb_debounce_secs), stale;
+	struct timerel max_stale = time_from_sec(scb_debounce_secs
+						 * SCB_MAX_STALE);
+
+	if (write_timer) {
+		/* Push it back, but not past our staleness limit. */
+		stale = timemono_between(now, first_pending);
+		if (time_greater(timerel_add(stale, delay), max_stale))
+			delay = time_greater(max_stale, stale)
+				? time_sub(max_stale, stale)
+				: time_from_sec(0);
+		tal_free(write_timer);
+	} else
+		first_pending = now;
+
+	write_timer = plugin_timer(p, delay, write_timer_expired, p);
+}
+
+static void request_staticbackup(struct plugin *p);
+
 static struct command_result *after_staticbackup(struct command *cmd,
 					         const char *buf,
 					         const jsmntok_t *params,
-					         void *cb_arg UNUSED)
+					         struct plugin *p)
 {
 	struct scb_chan **scb_chan;
 	const jsmntok_t *scbs = json_get_member(buf, params, "scb");
 	json_to_scb_chan(buf, scbs, &scb_chan);
-	plugin_log(cmd->plugin, LOG_INFORM, "Updating the SCB");
 
-	update_scb(cmd->plugin, scb_chan);
-	return notification_handled(cmd);
+	/* Replaces any older one we haven't written yet. */
+	tal_free(pending_scb);
+	pending_scb = tal_steal(p, scb_chan);
+	for (size_t i = 0; i < tal_count(pending_scb); i++)
+		tal_steal(pending_scb, pending_scb[i]);
+	scb_pending = true;
+	staticbackup_inflight = false;
+
+	schedule_write(p);
+	if (staticbackup_again)
+		request_staticbackup(p);
+	return command_done();
+}
+
+static struct command_result *staticbackup_failed(struct command *cmd,
+						  const char *buf,
+						  const jsmntok_t *err,
+						  struct plugin *p)
+{
+	plugin_log(p, LOG_BROKEN, "staticbackup failed: %.*s",
+		   json_tok_full_len(err), json_tok_full(buf, err));
+	staticbackup_inflight = false;
+	return command_done();
+}
+
+static void request_staticbackup(struct plugin *p)
+{
+	struct out_req *req;
+
+	if (staticbackup_inflight) {
+		staticbackup_again = true;
+		return;
+	}
+
+	req = jsonrpc_request_start(p, NULL, "staticbackup",
+				    after_staticbackup, staticbackup_failed,
+				    p);
+	staticbackup_inflight = true;
+	staticbackup_again = false;
+	send_outreq(p, req);
 }
 
 static struct command_result *json_state_changed(struct command *cmd,
@@ -347,21 +499,33 @@ static struct command_result *json_state_changed(struct command *cmd,
 	 * So, is their no way to get a notif on CHANNELD_AWAITING_LOCKIN? */
 	if (json_tok_streq(buf, statetok, "CLOSED") ||
 		json_tok_streq(buf, statetok, "CHANNELD_NORMAL")) {
-
-		struct out_req *req;
-		req = jsonrpc_request_start(cmd->plugin,
-                                            cmd,
-                                            "staticbackup",
-                                            after_staticbackup,
-                                            &forward_error,
-                                            NULL);
-
-		return send_outreq(cmd->plugin, req);
+		num_changes++;
+		request_staticbackup(cmd->plugin);
 	}
 
 	return notification_handled(cmd);
 }
 
+/* The db is gone by now, so we can't ask for a new staticbackup, but we
+ * can write out the one we were waiting to write (anything later is
+ * picked up when we next start). */
+static struct command_result *json_shutdown(struct command *cmd,
+					    const char *buf UNUSED,
+					    const jsmntok_t *params UNUSED)
+{
+	if (scb_pending)
+		write_pending_scb(cmd->plugin);
+	plugin_exit(cmd->plugin, 0);
+}
+
+#if DEVELOPER
+static void memleak_mark_pending(struct plugin *p, struct htable *memtable)
+{
+	memleak_remove_region(memtable, &pending_scb, sizeof(pending_scb));
+	memleak_remove_region(memtable, &write_timer, sizeof(write_timer));
+}
+#endif
+
 static const char *init(struct plugin *p,
 			const char *buf UNUSED,
 			const jsmntok_t *config UNUSED)
@@ -386,8 +550,12 @@ static const char *init(struct plugin *p,
 	/* flush the tmp file, if exists */
 	unlink_noerr("scb.tmp");
 
-	maybe_create_new_scb(p, scb_chan);
+	if (!maybe_create_new_scb(p, scb_chan))
+		refresh_scb(p, scb_chan);
 
+#if DEVELOPER
+	plugin_set_memleak_handler(p, memleak_mark_pending);
+#endif
 	return NULL;
 }
 
@@ -395,6 +563,10 @@ static const struct plugin_notification notifs[] = {
 	{
 		"channel_state_changed",
 		json_state_changed,
+	},
+	{
+		"shutdown",
+		json_shutdown,
 	}
 };
 
@@ -414,5 +586,13 @@ int main(int argc, char *argv[])
 		    commands, ARRAY_SIZE(commands),
 	        notifs, ARRAY_SIZE(notifs), NULL, 0,
 		    NULL, 0,  /* Notification topics we publish */
+#if DEVELOPER
+		    plugin_option("dev-scb-debounce",
+				  "int",
+				  "Seconds without channel changes before we"
+				  " update the SCB (the most we wait is ten"
+				  " times this)",
+				  u32_option, &scb_debounce_secs),
+#endif
 		    NULL);
 }
@@ -4,11 +4,13 @@
 #include <ccan/htable/htable_type.h>
 #include <ccan/json_escape/json_escape.h>
 #include <ccan/json_out/json_out.h>
+#include <ccan/list/list.h>
 #include <ccan/rune/rune.h>
 #include <ccan/tal/str/str.h>
 #include <ccan/time/time.h>
 #include <common/json_param.h>
 #include <common/json_stream.h>
+#include <common/json_validate.h>
 #include <common/memleak.h>
 #include <common/pseudorand.h>
 #include <plugins/libplugin.h>
@@ -27,8 +29,25 @@ enum commando_msgtype {
 	/* Replies are split across multiple CONTINUES, then TERM. */
 	COMMANDO_MSG_REPLY_CONTINUES = 0x594b,
 	COMMANDO_MSG_REPLY_TERM = 0x594d,
+	/* If the command had a "window", a successful reply is just the
+	 * "result" object, split across RESULT_CONTINUES, then RESULT_TERM. */
+	COMMANDO_MSG_RESULT_CONTINUES = 0x5951,
+	COMMANDO_MSG_RESULT_TERM = 0x5953,
+	/* ... and the requester acks every reply message, so the replier
+	 * never has more than "window" of them in flight. */
+	COMMANDO_MSG_REPLY_ACK = 0x5955,
 };
 
+/* How many reply messages we let them send before we ack (~512k) */
+#define COMMANDO_REPLY_WINDOW 8
+/* ... and the most we'll have in flight, whatever they ask for. */
+#define COMMANDO_MAX_REPLY_WINDOW 64
+
+/* listchannels is 71MB, so we need to allow some headroom! */
+#define COMMANDO_MAX_REPLY_LEN (500*1024*1024)
+/* The most reply data we'll hold, across all peers, while it's sent. */
+#define COMMANDO_MAX_REPLIES_HELD (500*1024*1024)
+
 struct commando {
 	struct command *cmd;
 	struct node_id peer;
@@ -36,12 +55,31 @@ struct commando {
 
 	/* This is set to NULL if they seem to be spamming us! */
 	u8 *contents;
+
+	/* Incoming: how many reply messages they'll take unacked (0 if they
+	 * don't ack at all). */
+	u32 window;
+
+	/* Outgoing: the response we append the result to as it arrives.
+	 * It's all held here until RESULT_TERM, as libplugin only sends
+	 * complete responses. */
+	struct json_stream *res;
+	struct json_validator *jv;
+	/* How much of the result we've had so far. */
+	size_t result_len;
+	/* The last char we got, held back in case it's the closing brace. */
+	char last;
 };
 
 static struct plugin *plugin;
 static struct commando **outgoing_commands;
 static struct commando **incoming_commands;
 static u64 *rune_counter;
+/* If they stop acking a reply for this long, we give up on it. */
+static u32 reply_ack_timeout = 60;
+/* How much we're holding in copied replies, and the most we will. */
+static size_t replies_held;
+static u32 max_replies_held = COMMANDO_MAX_REPLIES_HELD;
 static struct rune *master_rune;
 
 struct usage {
@@ -131,33 +169,129 @@ struct reply {
 	struct commando *incoming;
 	char *buf;
 	size_t off, len;
+	/* How much of replies_held is ours */
+	size_t held;
+	/* Is buf just the "result" object? */
+	bool result;
+	/* Are we waiting for sendcustommsg to return? */
+	bool sending;
+	/* Messages they haven't acked yet (if incoming->window) */
+	u32 unacked;
+	/* We give up if they stop acking. */
+	struct plugin_timer *timeout;
 };
 
-/* Calls itself repeatedly: first time, result is NULL */
-static struct command_result *send_response(struct command *command UNUSED,
+/* Replies we're still sending. */
+static struct reply **replies;
+
+static void destroy_reply(struct reply *reply)
+{
+	replies_held -= reply->held;
+	for (size_t i = 0; i < tal_count(replies); i++) {
+		if (replies[i] == reply) {
+			tal_arr_remove(&replies, i);
+			return;
+		}
+	}
+	abort();
+}
+
+static struct reply *find_reply(const struct node_id *peer, u64 id)
+{
+	for (size_t i = 0; i < tal_count(replies); i++) {
+		if (replies[i]->incoming->id == id
+		    && node_id_eq(&replies[i]->incoming->peer, peer))
+			return replies[i];
+	}
+	return NULL;
+}
+
+static void reply_timeout(struct reply *reply)
+{
+	plugin_log(plugin, LOG_UNUSUAL,
+		   "%s: no ack for reply to %"PRIu64" for %u seconds, giving up",
+		   node_id_to_hexstr(tmpctx, &reply->incoming->peer),
+		   reply->incoming->id, reply_ack_timeout);
+	/* Timer frees itself */
+	reply->timeout = NULL;
+	/* sent_response will free it */
+	if (reply->sending)
+		reply->off = reply->len;
+	else
+		tal_free(reply);
+}
+
+static void reset_reply_timeout(struct reply *reply)
+{
+	tal_free(reply->timeout);
+	reply->timeout = tal_steal(reply,
+				   plugin_timer(plugin,
+						time_from_sec(reply_ack_timeout),
+						reply_timeout, reply));
+}
+
+static struct reply *new_reply(struct commando *incoming, char *buf,
+			       size_t off, size_t len, bool result)
+{
+	struct reply *reply = tal(plugin, struct reply);
+
+	reply->incoming = tal_steal(reply, incoming);
+	reply->buf = buf;
+	reply->off = off;
+	reply->len = len;
+	reply->held = 0;
+	reply->result = result;
+	reply->sending = false;
+	reply->unacked = 0;
+	reply->timeout = NULL;
+	tal_arr_expand(&replies, reply);
+	tal_add_destructor(reply, destroy_reply);
+
+	if (incoming->window)
+		reset_reply_timeout(reply);
+	return reply;
+}
+
+static void send_response(struct reply *reply);
+
+static struct command_result *sent_response(struct command *command UNUSED,
 					    const char *buf UNUSED,
-					    const jsmntok_t *result,
+					    const jsmntok_t *result UNUSED,
 					    struct reply *reply)
+{
+	reply->sending = false;
+	send_response(reply);
+	return command_done();
+}
+
+/* Sends the next message, unless one is in flight or they owe us acks. */
+static void send_response(struct reply *reply)
 {
 	size_t msglen = reply->len - reply->off;
 	u8 *cmd_msg;
 	enum commando_msgtype msgtype;
 	struct out_req *req;
 
+	if (reply->sending)
+		return;
+
+	if (msglen == 0) {
+		tal_free(reply);
+		return;
+	}
+
+	if (reply->incoming->window
+	    && reply->unacked >= reply->incoming->window)
+		return;
+
 	/* Limit is 64k, but there's a little overhead */
 	if (msglen > 65000) {
 		msglen = 65000;
-		msgtype = COMMANDO_MSG_REPLY_CONTINUES;
-		/* We need to make a copy first time before we call back, since
-		 * plugin will reuse it! */
-		if (!result)
-			reply->buf = tal_dup_talarr(reply, char, reply->buf);
+		msgtype = reply->result ? COMMANDO_MSG_RESULT_CONTINUES
+			: COMMANDO_MSG_REPLY_CONTINUES;
 	} else {
-		if (msglen == 0) {
-			tal_free(reply);
-			return command_done();
-		}
-		msgtype = COMMANDO_MSG_REPLY_TERM;
+		msgtype = reply->result ? COMMANDO_MSG_RESULT_TERM
+			: COMMANDO_MSG_REPLY_TERM;
 	}
 
 	cmd_msg = tal_arr(NULL, u8, 0);
@@ -165,33 +299,29 @@ static struct command_result *send_response(struct command *command UNUSED,
 	towire_u64(&cmd_msg, reply->incoming->id);
 	towire(&cmd_msg, reply->buf + reply->off, msglen);
 	reply->off += msglen;
+	reply->sending = true;
+	reply->unacked++;
 
 	req = jsonrpc_request_start(plugin, NULL, "sendcustommsg",
-				    send_response, send_response,
+				    sent_response, sent_response,
 				    reply);
 	json_add_node_id(req->js, "node_id", &reply->incoming->peer);
 	json_add_hex_talarr(req->js, "msg", cmd_msg);
 	tal_free(cmd_msg);
 	send_outreq(plugin, req);
-
-	return command_done();
 }
 
-static struct command_result *cmd_done(struct command *command,
-				       const char *buf,
-				       const jsmntok_t *obj,
-				       struct commando *incoming)
+static void handle_ack(struct node_id *peer, u64 idnum)
 {
-	struct reply *reply = tal(plugin, struct reply);
-	reply->incoming = tal_steal(reply, incoming);
-	reply->buf = (char *)buf;
+	struct reply *reply = find_reply(peer, idnum);
 
-	/* result is contents of "error" or "response": we want top-leve
-	 * object */
-	reply->off = obj->start;
-	reply->len = obj->end;
+	/* We may have finished already. */
+	if (!reply || !reply->incoming->window || reply->unacked == 0)
+		return;
 
-	return send_response(command, NULL, NULL, reply);
+	reply->unacked--;
+	reset_reply_timeout(reply);
+	send_response(reply);
 }
 
 static void commando_error(struct commando *incoming,
@@ -199,123 +329,368 @@ static void commando_error(struct commando *incoming,
 			   const char *fmt, ...)
 	PRINTF_FMT(3,4);
 
+static struct command_result *cmd_done(struct command *command UNUSED,
+				       const char *buf,
+				       const jsmntok_t *obj,
+				       struct commando *incoming)
+{
+	const jsmntok_t *result = NULL;
+	const jsmntok_t *tok;
+	struct reply *reply;
+
+	/* If they can ack, we only need to send them the result object. */
+	if (incoming->window)
+		result = json_get_member(buf, obj, "result");
+	if (result && result->type == JSMN_OBJECT)
+		tok = result;
+	else {
+		/* obj is the top-level object: error gets sent whole */
+		result = NULL;
+		tok = obj;
+	}
+
+	/* We need to make a copy if we won't send it all now, since plugin
+	 * will reuse buf!  So we hold the whole reply until it's sent: the
+	 * window only paces how fast it goes out, and slow peers could make
+	 * us hold a lot of them. */
+	if (json_tok_full_len(tok) > 65000
+	    && replies_held + json_tok_full_len(tok) > max_replies_held) {
+		plugin_log(plugin, LOG_UNUSUAL,
+			   "%s: already holding %zu bytes of replies,"
+			   " refusing %i more for %"PRIu64,
+			   node_id_to_hexstr(tmpctx, &incoming->peer),
+			   replies_held, json_tok_full_len(tok),
+			   incoming->id);
+		commando_error(incoming, COMMANDO_ERROR_REMOTE,
+			       "Too many large replies in flight:"
+			       " try again later");
+		return command_done();
+	}
+
+	reply = new_reply(incoming, (char *)buf, tok->start, tok->end,
+			  result != NULL);
+
+	if (reply->len - reply->off > 65000) {
+		reply->buf = tal_strndup(reply, json_tok_full(buf, tok),
+					 json_tok_full_len(tok));
+		reply->off = 0;
+		reply->len = reply->held = json_tok_full_len(tok);
+		replies_held += reply->held;
+	}
+
+	send_response(reply);
+	return command_done();
+}
+
 static void commando_error(struct commando *incoming,
 			   int ecode,
 			   const char *fmt, ...)
 {
-	struct reply *reply = tal(plugin, struct reply);
+	struct reply *reply = new_reply(incoming, NULL, 0, 0, false);
 	va_list ap;
 
-	reply->incoming = tal_steal(reply, incoming);
 	reply->buf = tal_fmt(reply, "{\"error\":{\"code\":%i,\"message\":\"", ecode);
 	va_start(ap, fmt);
 	tal_append_vfmt(&reply->buf, fmt, ap);
 	va_end(ap);
 	tal_append_fmt(&reply->buf, "\"}}");
-	reply->off = 0;
 	reply->len = tal_bytelen(reply->buf) - 1;
 
-	send_response(NULL, NULL, NULL, reply);
+	send_response(reply);
 }
 
 struct cond_info {
 	const struct node_id *peer;
+	/* Hex of peer, once we need it */
+	const char *peer_hex;
 	const char *buf;
 	const jsmntok_t *method;
 	const jsmntok_t *params;
-	STRMAP(const jsmntok_t *) cached_params;
 	struct usage *usage;
 };
 
+/* What each alternative's fieldname refers to, worked out when we first
+ * see a rune, rather than on every command. */
+enum cond_field {
+	COND_TIME,
+	COND_ID,
+	COND_METHOD,
+	COND_PNUM,
+	COND_RATE,
+	/* pnameFOO: the param named FOO (ignoring punctuation) */
+	COND_PNAME,
+	/* parrN: the Nth param */
+	COND_PARR,
+	/* Anything else is never present. */
+	COND_MISSING,
+};
+
+struct compiled_altern {
+	const struct rune_altern *alt;
+	enum cond_field field;
+	/* COND_PNAME: name after "pname" */
+	const char *pname;
+	/* COND_PARR: index.  COND_RATE: rate per minute. */
+	unsigned long num;
+	/* COND_RATE: fails with this, if it's malformed. */
+	const char *err;
+};
+
+struct compiled_restr {
+	struct compiled_altern *alts;
+};
+
+/* A rune we've already checked is derived from master_rune: only its
+ * restrictions need testing for each command. */
+struct cached_rune {
+	struct list_node list;
+	/* Exactly as they sent it */
+	const char *str;
+	struct rune *rune;
+	/* For rate limiting */
+	u32 usage_id;
+	struct compiled_restr *restrs;
+};
+
+/* Enough for every rune a busy node hands out, but bounded against a
+ * peer trying many different (valid) runes. */
+#define RUNE_CACHE_MAX 1000
+
+static const char *cached_rune_str(const struct cached_rune *cr)
+{
+	return cr->str;
+}
+
+static size_t rune_str_hash(const char *str)
+{
+	return siphash24(siphash_seed(), str, strlen(str));
+}
+
+static bool cached_rune_eq_str(const struct cached_rune *cr, const char *str)
+{
+	return streq(cr->str, str);
+}
+HTABLE_DEFINE_TYPE(struct cached_rune, cached_rune_str, rune_str_hash,
+		   cached_rune_eq_str, rune_cache);
+static struct rune_cache rune_cache;
+/* Oldest first, for eviction */
+static struct list_head rune_cache_list;
+
+static void destroy_cached_rune(struct cached_rune *cr)
+{
+	rune_cache_del(&rune_cache, cr);
+	list_del_from(&rune_cache_list, &cr->list);
+}
+
+static void compile_altern(struct compiled_altern *calt,
+			   const struct rune_altern *alt)
+{
+	const char *f = alt->fieldname;
+
+	calt->alt = alt;
+	calt->pname = NULL;
+	calt->num = 0;
+	calt->err = NULL;
+
+	if (streq(f, "time"))
+		calt->field = COND_TIME;
+	else if (streq(f, "id"))
+		calt->field = COND_ID;
+	else if (streq(f, "method"))
+		calt->field = COND_METHOD;
+	else if (streq(f, "pnum"))
+		calt->field = COND_PNUM;
+	else if (streq(f, "rate")) {
+		char *endp;
+
+		calt->field = COND_RATE;
+		if (alt->condition != '=') {
+			calt->err = "rate operator must be =";
+			return;
+		}
+		calt->num = strtoul(alt->value, &endp, 10);
+		if (endp == alt->value || *endp
+		    || calt->num == 0 || calt->num >= UINT32_MAX)
+			calt->err = "malformed rate";
+	} else if (strstarts(f, "pname")) {
+		calt->field = COND_PNAME;
+		calt->pname = f + strlen("pname");
+	} else if (strstarts(f, "parr")) {
+		char *endp;
+
+		/* Only exactly "parr%zu" ever matched */
+		calt->num = strtoul(f + strlen("parr"), &endp, 10);
+		if (cisdigit(f[strlen("parr")]) && !*endp
+		    && streq(f, tal_fmt(tmpctx, "parr%lu", calt->num)))
+			calt->field = COND_PARR;
+		else
+			calt->field = COND_MISSING;
+	} else
+		calt->field = COND_MISSING;
+}
+
+static struct cached_rune *cache_rune(const char *str, struct rune *rune)
+{
+	struct cached_rune *cr;
+	size_t n = 0;
+
+	if (rune_cache_count(&rune_cache) >= RUNE_CACHE_MAX)
+		tal_free(list_top(&rune_cache_list, struct cached_rune, list));
+
+	cr = tal(plugin, struct cached_rune);
+	cr->str = tal_strdup(cr, str);
+	cr->rune = tal_steal(cr, rune);
+	cr->usage_id = rune->unique_id ? atol(rune->unique_id) : 0;
+	cr->restrs = tal_arr(cr, struct compiled_restr,
+			     tal_count(rune->restrs));
+	for (size_t i = 0; i < tal_count(rune->restrs); i++) {
+		const struct rune_restr *restr = rune->restrs[i];
+
+		/* Like rune_meets_criteria, we don't check the unique_id */
+		if (i == 0 && streq(restr->alterns[0]->fieldname, ""))
+			continue;
+
+		cr->restrs[n].alts = tal_arr(cr->restrs,
+					     struct compiled_altern,
+					     tal_count(restr->alterns));
+		for (size_t j = 0; j < tal_count(restr->alterns); j++)
+			compile_altern(&cr->restrs[n].alts[j],
+				       restr->alterns[j]);
+		n++;
+	}
+	tal_resize(&cr->restrs, n);
+
+	rune_cache_add(&rune_cache, cr);
+	list_add_tail(&rune_cache_list, &cr->list);
+	tal_add_destructor(cr, destroy_cached_rune);
+	return cr;
+}
+
 static const char *rate_limit_check(const tal_t *ctx,
-				    const struct rune *rune,
-				    const struct rune_altern *alt,
+				    const struct cached_rune *cr,
+				    const struct compiled_altern *calt,
 				    struct cond_info *cinfo)
 {
-	unsigned long r;
-	char *endp;
-	if (alt->condition != '=')
-		return "rate operator must be =";
-
-	r = strtoul(alt->value, &endp, 10);
-	if (endp == alt->value || *endp || r == 0 || r >= UINT32_MAX)
-		return "malformed rate";
+	if (calt->err)
+		return calt->err;
 
 	/* We cache this: we only add usage counter if whole rune succeeds! */
 	if (!cinfo->usage) {
-		cinfo->usage = usage_table_get(&usage_table, atol(rune->unique_id));
+		cinfo->usage = usage_table_get(&usage_table, cr->usage_id);
 		if (!cinfo->usage) {
 			cinfo->usage = tal(plugin, struct usage);
-			cinfo->usage->id = atol(rune->unique_id);
+			cinfo->usage->id = cr->usage_id;
 			cinfo->usage->counter = 0;
 			usage_table_add(&usage_table, cinfo->usage);
 		}
 	}
 
 	/* >= becuase if we allow this, counter will increment */
-	if (cinfo->usage->counter >= r)
-		return tal_fmt(ctx, "Rate of %lu per minute exceeded", r);
+	if (cinfo->usage->counter >= calt->num)
+		return tal_fmt(ctx, "Rate of %lu per minute exceeded", calt->num);
 	return NULL;
 }
 
+/* Does this param name, without its punctuation, equal @name? */
+static bool pname_eq(const char *buf, const jsmntok_t *t, const char *name)
+{
+	for (int i = t->start; i < t->end; i++) {
+		if (cispunct(buf[i]))
+			continue;
+		if (*name != buf[i])
+			return false;
+		name++;
+	}
+	return *name == '\0';
+}
+
+static const jsmntok_t *find_param(const struct compiled_altern *calt,
+				   const struct cond_info *cinfo)
+{
+	const jsmntok_t *t;
+	size_t i;
+
+	if (calt->field == COND_PNAME) {
+		if (cinfo->params->type != JSMN_OBJECT)
+			return NULL;
+		/* If several match, the first one counts. */
+		json_for_each_obj(i, t, cinfo->params) {
+			if (pname_eq(cinfo->buf, t, calt->pname))
+				return t + 1;
+		}
+		return NULL;
+	}
+
+	assert(calt->field == COND_PARR);
+	if (cinfo->params->type != JSMN_ARRAY)
+		return NULL;
+	return json_get_arr(cinfo->params, calt->num);
+}
+
 static const char *check_condition(const tal_t *ctx,
-				   const struct rune *rune,
-				   const struct rune_altern *alt,
+				   const struct cached_rune *cr,
+				   const struct compiled_altern *calt,
 				   struct cond_info *cinfo)
 {
 	const jsmntok_t *ptok;
 
-	if (streq(alt->fieldname, "time")) {
-		return rune_alt_single_int(ctx, alt, time_now().ts.tv_sec);
-	} else if (streq(alt->fieldname, "id")) {
-		const char *id = node_id_to_hexstr(tmpctx, cinfo->peer);
-		return rune_alt_single_str(ctx, alt, id, strlen(id));
-	} else if (streq(alt->fieldname, "method")) {
-		return rune_alt_single_str(ctx, alt,
+	switch (calt->field) {
+	case COND_TIME:
+		return rune_alt_single_int(ctx, calt->alt, time_now().ts.tv_sec);
+	case COND_ID:
+		if (!cinfo->peer_hex)
+			cinfo->peer_hex = node_id_to_hexstr(tmpctx, cinfo->peer);
+		return rune_alt_single_str(ctx, calt->alt, cinfo->peer_hex,
+					   strlen(cinfo->peer_hex));
+	case COND_METHOD:
+		return rune_alt_single_str(ctx, calt->alt,
 					   cinfo->buf + cinfo->method->start,
 					   cinfo->method->end - cinfo->method->start);
-	} else if (streq(alt->fieldname, "pnum")) {
-		return rune_alt_single_int(ctx, alt, cinfo->params->size);
-	} else if (streq(alt->fieldname, "rate")) {
-		return rate_limit_check(ctx, rune, alt, cinfo);
+	case COND_PNUM:
+		return rune_alt_single_int(ctx, calt->alt, cinfo->params->size);
+	case COND_RATE:
+		return rate_limit_check(ctx, cr, calt, cinfo);
+	case COND_PNAME:
+	case COND_PARR:
+		ptok = find_param(calt, cinfo);
+		if (!ptok)
+			break;
+		return rune_alt_single_str(ctx, calt->alt,
+					   cinfo->buf + ptok->start,
+					   ptok->end - ptok->start);
+	case COND_MISSING:
+		break;
 	}
+	return rune_alt_single_missing(ctx, calt->alt);
+}
 
-	/* Rest are params looksup: generate this once! */
-	if (strmap_empty(&cinfo->cached_params)) {
-		const jsmntok_t *t;
-		size_t i;
-
-		if (cinfo->params->type == JSMN_OBJECT) {
-			json_for_each_obj(i, t, cinfo->params) {
-				char *pmemname = tal_fmt(tmpctx,
-							 "pname%.*s",
-							 t->end - t->start,
-							 cinfo->buf + t->start);
-				size_t off = strlen("pname");
-				/* Remove punctuation! */
-				for (size_t n = off; pmemname[n]; n++) {
-					if (cispunct(pmemname[n]))
-						continue;
-					pmemname[off++] = pmemname[n];
-				}
-				pmemname[off++] = '\0';
-				strmap_add(&cinfo->cached_params, pmemname, t+1);
-			}
-		} else if (cinfo->params->type == JSMN_ARRAY) {
-			json_for_each_arr(i, t, cinfo->params) {
-				char *pmemname = tal_fmt(tmpctx, "parr%zu", i);
-				strmap_add(&cinfo->cached_params, pmemname, t);
-			}
+/* Same as rune_meets_criteria, on the compiled form. */
+static const char *meets_criteria(const tal_t *ctx,
+				  const struct cached_rune *cr,
+				  struct cond_info *cinfo)
+{
+	for (size_t i = 0; i < tal_count(cr->restrs); i++) {
+		const struct compiled_restr *restr = &cr->restrs[i];
+		char *err = NULL;
+		bool passed = false;
+
+		/* Only one alternative has to pass! */
+		for (size_t j = 0; j < tal_count(restr->alts) && !passed; j++) {
+			const char *e;
+
+			e = check_condition(tmpctx, cr, &restr->alts[j], cinfo);
+			if (!e)
+				passed = true;
+			else if (!err)
+				err = tal_strdup(ctx, e);
+			else
+				tal_append_fmt(&err, " AND %s", e);
 		}
+		if (!passed)
+			return err ? err : "Empty restriction";
+		tal_free(err);
 	}
-
-	ptok = strmap_get(&cinfo->cached_params, alt->fieldname);
-	if (!ptok)
-		return rune_alt_single_missing(ctx, alt);
-
-	return rune_alt_single_str(ctx, alt,
-				   cinfo->buf + ptok->start,
-				   ptok->end - ptok->start);
+	return NULL;
 }
 
 static const char *check_rune(const tal_t *ctx,
@@ -326,31 +701,40 @@ static const char *check_rune(const tal_t *ctx,
 			      const jsmntok_t *params,
 			      const jsmntok_t *runetok)
 {
-	struct rune *rune;
+	struct cached_rune *cr;
 	struct cond_info cinfo;
-	const char *err;
+	const char *err, *runestr;
 
 	if (!runetok)
 		return "Missing rune";
 
-	rune = rune_from_base64n(tmpctx, buf + runetok->start,
-				 runetok->end - runetok->start);
-	if (!rune)
-		return "Invalid rune";
+	runestr = json_strdup(tmpctx, buf, runetok);
+	cr = rune_cache_get(&rune_cache, runestr);
+	if (!cr) {
+		struct rune *rune;
+
+		rune = rune_from_base64(tmpctx, runestr);
+		if (!rune)
+			return "Invalid rune";
+
+		/* We only remember ones which are really ours. */
+		err = rune_is_derived(master_rune, rune);
+		if (err)
+			return json_escape(ctx, err)->s;
+		cr = cache_rune(runestr, rune);
+	}
 
 	cinfo.peer = peer;
+	cinfo.peer_hex = NULL;
 	cinfo.buf = buf;
 	cinfo.method = method;
 	cinfo.params = params;
 	cinfo.usage = NULL;
-	strmap_init(&cinfo.cached_params);
-	err = rune_test(tmpctx, master_rune, rune, check_condition, &cinfo);
+	err = meets_criteria(tmpctx, cr, &cinfo);
 	/* Just in case they manage to make us speak non-JSON, escape! */
 	if (err)
 		err = json_escape(ctx, err)->s;
 
-	strmap_clear(&cinfo.cached_params);
-
 	/* If it succeeded, *now* we increment any associated usage counter. */
 	if (!err && cinfo.usage)
 		cinfo.usage->counter++;
@@ -362,12 +746,13 @@ static void try_command(struct node_id *peer,
 			const u8 *msg, size_t msglen)
 {
 	struct commando *incoming = tal(plugin, struct commando);
-	const jsmntok_t *toks, *method, *params, *rune;
+	const jsmntok_t *toks, *method, *params, *rune, *window;
 	const char *buf = (const char *)msg, *failmsg;
 	struct out_req *req;
 
 	incoming->peer = *peer;
 	incoming->id = idnum;
+	incoming->window = 0;
 
 	toks = json_parse_simple(incoming, buf, msglen);
 	if (!toks) {
@@ -381,6 +766,18 @@ static void try_command(struct node_id *peer,
 			       "Not a JSON object");
 		return;
 	}
+
+	/* Newer peers ack our replies, so we can pace them. */
+	window = json_get_member(buf, toks, "window");
+	if (window) {
+		if (!json_to_u32(buf, window, &incoming->window)) {
+			commando_error(incoming, COMMANDO_ERROR_REMOTE,
+				       "Invalid window");
+			return;
+		}
+		if (incoming->window > COMMANDO_MAX_REPLY_WINDOW)
+			incoming->window = COMMANDO_MAX_REPLY_WINDOW;
+	}
 	method = json_get_member(buf, toks, "method");
 	if (!method) {
 		commando_error(incoming, COMMANDO_ERROR_REMOTE,
@@ -488,6 +885,106 @@ static void handle_incmd(struct node_id *peer,
 	tal_free(incmd);
 }
 
+static struct command_result *ack_sent(struct command *command UNUSED,
+				       const char *buf UNUSED,
+				       const jsmntok_t *result UNUSED,
+				       void *unused UNUSED)
+{
+	return command_done();
+}
+
+/* Tell them we've processed a reply message, so they can send another. */
+static void send_ack(const struct node_id *peer, u64 idnum)
+{
+	struct out_req *req;
+	u8 *ack_msg = tal_arr(NULL, u8, 0);
+
+	towire_u16(&ack_msg, COMMANDO_MSG_REPLY_ACK);
+	towire_u64(&ack_msg, idnum);
+
+	req = jsonrpc_request_start(plugin, NULL, "sendcustommsg",
+				    ack_sent, ack_sent, NULL);
+	json_add_node_id(req->js, "node_id", peer);
+	json_add_hex_talarr(req->js, "msg", ack_msg);
+	tal_free(ack_msg);
+	send_outreq(plugin, req);
+}
+
+static struct command_result *result_unparsable(struct commando *ocmd)
+{
+	tal_free(ocmd->res);
+	return command_fail(ocmd->cmd, COMMANDO_ERROR_LOCAL,
+			    "Reply was unparsable");
+}
+
+/* The result object, which we validate and append to our own response as
+ * it arrives, rather than buffering and parsing it all at the end. */
+static struct command_result *handle_result(struct node_id *peer,
+					    u64 idnum,
+					    const u8 *msg, size_t msglen,
+					    bool terminal)
+{
+	struct commando *ocmd;
+	const char *str = (const char *)msg;
+
+	ocmd = find_commando(outgoing_commands, peer, &idnum);
+	if (!ocmd) {
+		plugin_log(plugin, LOG_DBG,
+			   "Ignoring unexpected %s result from %s (id %"PRIu64")",
+			   terminal ? "terminal" : "partial",
+			   node_id_to_hexstr(tmpctx, peer),
+			   idnum);
+		return NULL;
+	}
+
+	send_ack(peer, idnum);
+
+	if (!ocmd->res) {
+		/* It must be an object, and not follow a REPLY. */
+		if (tal_bytelen(ocmd->contents) != 0
+		    || msglen == 0 || str[0] != '{')
+			return result_unparsable(ocmd);
+
+		ocmd->res = jsonrpc_stream_success(ocmd->cmd);
+		ocmd->jv = tal(ocmd, struct json_validator);
+		json_validator_init(ocmd->jv);
+		ocmd->result_len = 0;
+		ocmd->last = '\0';
+
+		/* We've already opened the result object */
+		if (!json_validate(ocmd->jv, str, 1))
+			return result_unparsable(ocmd);
+		str++;
+		msglen--;
+	}
+
+	ocmd->result_len += msglen;
+	if (ocmd->result_len > COMMANDO_MAX_REPLY_LEN) {
+		tal_free(ocmd->res);
+		return command_fail(ocmd->cmd, COMMANDO_ERROR_LOCAL,
+				    "Reply was oversize");
+	}
+
+	if (!json_validate(ocmd->jv, str, msglen))
+		return result_unparsable(ocmd);
+
+	/* We hold back the last char: json_object_end will close it. */
+	if (msglen) {
+		if (ocmd->last)
+			json_stream_append(ocmd->res, &ocmd->last, 1);
+		json_stream_append(ocmd->res, str, msglen - 1);
+		ocmd->last = str[msglen - 1];
+	}
+
+	if (!terminal)
+		return NULL;
+
+	if (!json_validate_done(ocmd->jv) || ocmd->last != '}')
+		return result_unparsable(ocmd);
+
+	return command_finished(ocmd->cmd, ocmd->res);
+}
+
 static struct command_result *handle_reply(struct node_id *peer,
 					   u64 idnum,
 					   const u8 *msg, size_t msglen,
@@ -510,9 +1007,13 @@ static struct command_result *handle_reply(struct node_id *peer,
 		return NULL;
 	}
 
-	/* FIXME: We buffer, but ideally we would stream! */
-	/* listchannels is 71MB, so we need to allow some headroom! */
-	append_contents(ocmd, msg, msglen, 500*1024*1024);
+	send_ack(peer, idnum);
+
+	/* They must have sent a RESULT first: that's not how it works. */
+	if (ocmd->res)
+		return result_unparsable(ocmd);
+
+	append_contents(ocmd, msg, msglen, COMMANDO_MAX_REPLY_LEN);
 
 	if (!terminal)
 		return NULL;
@@ -604,6 +1105,14 @@ static struct command_result *handle_custommsg(struct command *cmd,
 			handle_reply(&peer, idnum, msg, len,
 				     mtype == COMMANDO_MSG_REPLY_TERM);
 			break;
+		case COMMANDO_MSG_RESULT_CONTINUES:
+		case COMMANDO_MSG_RESULT_TERM:
+			handle_result(&peer, idnum, msg, len,
+				      mtype == COMMANDO_MSG_RESULT_TERM);
+			break;
+		case COMMANDO_MSG_REPLY_ACK:
+			handle_ack(&peer, idnum);
+			break;
 		}
 	}
 
@@ -667,6 +1176,7 @@ static struct command_result *json_commando(struct command *cmd,
 	ocmd->cmd = cmd;
 	ocmd->peer = *peer;
 	ocmd->contents = tal_arr(ocmd, u8, 0);
+	ocmd->res = NULL;
 	do {
 		ocmd->id = pseudorand_u64();
 	} while (find_commando(outgoing_commands, NULL, &ocmd->id));
@@ -678,7 +1188,8 @@ static struct command_result *json_commando(struct command *cmd,
 		       cparams ? cparams : "{}");
 	if (rune)
 		tal_append_fmt(&json, ",\"rune\":\"%s\"", rune);
-	tal_append_fmt(&json, "}");
+	/* Older peers ignore this, and just send a whole reply. */
+	tal_append_fmt(&json, ",\"window\":%u}", COMMANDO_REPLY_WINDOW);
 
 	/* This is not a leak, but we don't keep a pointer. */
 	outgoing = notleak(tal(cmd, struct outgoing));
@@ -863,8 +1374,10 @@ static void memleak_mark_globals(struct plugin *p, struct htable *memtable)
 {
 	memleak_remove_region(memtable, outgoing_commands, tal_bytelen(outgoing_commands));
 	memleak_remove_region(memtable, incoming_commands, tal_bytelen(incoming_commands));
+	memleak_remove_region(memtable, replies, tal_bytelen(replies));
 	memleak_remove_region(memtable, master_rune, sizeof(*master_rune));
 	memleak_remove_htable(memtable, &usage_table.raw);
+	memleak_remove_htable(memtable, &rune_cache.raw);
 	if (rune_counter)
 		memleak_remove_region(memtable, rune_counter, sizeof(*rune_counter));
 }
@@ -877,7 +1390,10 @@ static const char *init(struct plugin *p,
 
 	outgoing_commands = tal_arr(p, struct commando *, 0);
 	incoming_commands = tal_arr(p, struct commando *, 0);
+	replies = tal_arr(p, struct reply *, 0);
 	usage_table_init(&usage_table);
+	rune_cache_init(&rune_cache);
+	list_head_init(&rune_cache_list);
 	plugin = p;
 #if DEVELOPER
 	plugin_set_memleak_handler(p, memleak_mark_globals);
@@ -938,5 +1454,17 @@ int main(int argc, char *argv[])
 	            NULL, 0,
 		    hooks, ARRAY_SIZE(hooks),
 		    NULL, 0,
+#if DEVELOPER
+		    plugin_option("dev-commando-ack-timeout",
+				  "int",
+				  "Seconds to wait for a reply ack before"
+				  " giving up on the reply",
+				  u32_option, &reply_ack_timeout),
+		    plugin_option("dev-commando-max-replies-held",
+				  "int",
+				  "Most bytes of replies to hold while"
+				  " sending them",
+				  u32_option, &max_replies_held),
+#endif
 		    NULL);
 }
@@ -2,8 +2,10 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/tal/str/str.h>
 #include <common/dijkstra.h>
+#include <common/fp16.h>
 #include <common/gossmap.h>
 #include <common/json_stream.h>
+#include <common/mcf.h>
 #include <common/memleak.h>
 #include <common/pseudorand.h>
 #include <common/random_select.h>
@@ -63,6 +65,7 @@ struct payment *payment_new(tal_t *ctx, struct command *cmd,
 	p->abort = false;
 	p->invstring_used = false;
 	p->route = NULL;
+	p->planned_path = NULL;
 	p->temp_exclusion = NULL;
 	p->failroute_retry = false;
 	p->routetxt = NULL;
@@ -463,7 +466,7 @@ payment_constraints_update(struct payment_constraints *cons,
 }
 
 static struct channel_hint *payment_chanhints_get(struct payment *p,
-						  struct route_hop *h)
+						  const struct route_hop *h)
 {
 	struct payment *root = payment_root(p);
 	struct channel_hint *curhint;
@@ -486,13 +489,15 @@ static struct channel_hint *payment_chanhints_get(struct payment *p,
  * through, since the balances really changed in that case. The `remove`
  * argument indicates whether we want to apply (`remove=false`), or clear a
  * prior application (`remove=true`). */
-static bool payment_chanhints_apply_route(struct payment *p, bool remove)
+static bool chanhints_apply_route(struct payment *p,
+				  const struct route_hop *route,
+				  bool remove)
 {
 	bool apply;
-	struct route_hop *curhop;
+	const struct route_hop *curhop;
 	struct channel_hint *curhint;
 	struct payment *root = payment_root(p);
-	assert(p->route != NULL);
+	assert(route != NULL);
 
 	/* No need to check for applicability if we increase
 	 * capacity and budgets. */
@@ -500,8 +505,8 @@ static bool payment_chanhints_apply_route(struct payment *p, bool remove)
 		goto apply_changes;
 
 	/* First round: make sure we can cleanly apply the update. */
-	for (size_t i = 0; i < tal_count(p->route); i++) {
-		curhop = &p->route[i];
+	for (size_t i = 0; i < tal_count(route); i++) {
+		curhop = &route[i];
 		curhint = payment_chanhints_get(root, curhop);
 
 		/* If we don't have a hint we can't fail updating it. */
@@ -536,8 +541,8 @@ static bool payment_chanhints_apply_route(struct payment *p, bool remove)
 
 apply_changes:
 	/* Second round: apply the changes, now that we know they'll succeed. */
-	for (size_t i = 0; i < tal_count(p->route); i++) {
-		curhop = &p->route[i];
+	for (size_t i = 0; i < tal_count(route); i++) {
+		curhop = &route[i];
 		curhint = payment_chanhints_get(root, curhop);
 		if (!curhint)
 			continue;
@@ -571,6 +576,11 @@ apply_changes:
 	return true;
 }
 
+static bool payment_chanhints_apply_route(struct payment *p, bool remove)
+{
+	return chanhints_apply_route(p, p->route, remove);
+}
+
 static const struct short_channel_id_dir *
 payment_get_excluded_channels(const tal_t *ctx, struct payment *p)
 {
@@ -741,8 +751,11 @@ static u64 route_score(u32 distance,
 	return costs;
 }
 
+/* @dij is the result of dijkstra() using payment_route_can_carry and
+ * route_score: if that doesn't give a usable route, we try harder. */
 static struct route_hop *route(const tal_t *ctx,
 			       struct gossmap *gossmap,
+			       const struct dijkstra *dij,
 			       const struct gossmap_node *src,
 			       const struct gossmap_node *dst,
 			       struct amount_msat amount,
@@ -752,7 +765,6 @@ static struct route_hop *route(const tal_t *ctx,
 			       struct payment *p,
 			       const char **errmsg)
 {
-	const struct dijkstra *dij;
 	struct route_hop *r;
 	bool (*can_carry)(const struct gossmap *,
 			  const struct gossmap_chan *,
@@ -761,8 +773,6 @@ static struct route_hop *route(const tal_t *ctx,
 			  struct payment *);
 
 	can_carry = payment_route_can_carry;
-	dij = dijkstra(tmpctx, gossmap, dst, amount, riskfactor,
-		       can_carry, route_score, p);
 	r = route_from_dijkstra(ctx, gossmap, dij, src, amount, final_delay);
 	if (!r) {
 		/* Try using disabled channels too */
@@ -802,40 +812,238 @@ static struct route_hop *route(const tal_t *ctx,
 	return r;
 }
 
-static struct command_result *payment_getroute(struct payment *p)
+/* getroute for sibling payments (e.g. from the presplitter) tends to happen
+ * all at once, so we gather them up until the end of this loop iteration,
+ * then do all their dijkstras in parallel. */
+struct getroute_query {
+	struct payment *p;
+	const struct gossmap_node *src, *dst;
+	struct route_hop *route;
+	const char *errmsg;
+	/* Is route applied to the channel_hints? */
+	bool reserved;
+};
+
+/* Waiting for the timer, and currently being routed, respectively. */
+static struct payment **pending_getroutes;
+static struct getroute_query *getroute_batch;
+
+static void destroy_pending_getroute(struct payment *p)
 {
-	const struct gossmap_node *dst, *src;
-	struct amount_msat fee;
-	const char *errstr;
+	for (size_t i = 0; i < tal_count(pending_getroutes); i++) {
+		if (pending_getroutes[i] == p)
+			tal_arr_remove(&pending_getroutes, i);
+	}
+	for (size_t i = 0; i < tal_count(getroute_batch); i++) {
+		if (getroute_batch[i].p == p)
+			getroute_batch[i].p = NULL;
+	}
+}
+
+/* Called from multiple threads at once! */
+static bool getroute_can_carry(const struct gossmap *map,
+			       const struct gossmap_chan *c,
+			       int dir,
+			       struct amount_msat amount,
+			       void *arg)
+{
+	struct getroute_query *q = arg;
+	return payment_route_can_carry(map, c, dir, amount, q->p);
+}
+
+static void getroute_dijkstra_done(const struct dijkstra *dij, void *arg)
+{
+	struct getroute_query *q = arg;
+	struct payment *p = q->p;
+
+	q->route = route(p, global_gossmap, dij, q->src, q->dst,
+			 p->getroute->amount, p->getroute->cltv,
+			 p->getroute->riskfactorppm / 1000000.0,
+			 p->getroute->max_hops, p, &q->errmsg);
+}
+
+/* The dijkstras in a batch all ran against the same channel_hints, so
+ * siblings may have piled onto the same channels.  Routing them one at a
+ * time, each would have seen the ones before it applied. */
+static void getroute_reserve(struct getroute_query *q)
+{
+	struct route_hop *orig = q->route;
+	const struct dijkstra *dij;
+
+	q->reserved = chanhints_apply_route(q->p, q->route, false);
+	if (q->reserved)
+		return;
+
+	paymod_log(q->p, LOG_DBG,
+		   "Route overlaps with a sibling's, looking for another");
+	dij = dijkstra(tmpctx, global_gossmap, q->dst, q->p->getroute->amount,
+		       q->p->getroute->riskfactorppm / 1000000.0,
+		       payment_route_can_carry, route_score, q->p);
+	getroute_dijkstra_done(dij, q);
+
+	/* Nothing else?  Let payment_compute_onion_payloads sort it out. */
+	if (!q->route) {
+		q->route = orig;
+		q->errmsg = NULL;
+		return;
+	}
+	tal_free(orig);
+	q->reserved = chanhints_apply_route(q->p, q->route, false);
+}
+
+static struct command_result *payment_getroute_done(struct payment *p,
+						   struct route_hop *route,
+						   const char *errmsg);
+
+static void payment_getroute_batch(struct plugin *plugin)
+{
+	struct payment **payments = tal_steal(tmpctx, pending_getroutes);
+	struct dijkstra_query *queries;
 	struct gossmap *gossmap;
 
-	gossmap = get_gossmap(p->plugin);
+	pending_getroutes = NULL;
+	gossmap = get_gossmap(plugin);
+
+	getroute_batch = tal_arr(tmpctx, struct getroute_query,
+				 tal_count(payments));
+	queries = tal_arr(tmpctx, struct dijkstra_query, 0);
+	for (size_t i = 0; i < tal_count(payments); i++) {
+		struct getroute_query *q = &getroute_batch[i];
+		struct payment *p = payments[i];
+		struct dijkstra_query dq;
+
+		q->p = p;
+		q->route = NULL;
+		q->errmsg = NULL;
+		q->reserved = false;
+		q->dst = gossmap_find_node(gossmap, p->getroute->destination);
+		if (!q->dst) {
+			q->errmsg = tal_fmt(p, "Unknown destination %s",
+					    type_to_string(tmpctx,
+							   struct node_id,
+							   p->getroute->destination));
+			continue;
+		}
 
-	dst = gossmap_find_node(gossmap, p->getroute->destination);
-	if (!dst) {
-		payment_fail(
-			p, "Unknown destination %s",
-			type_to_string(tmpctx, struct node_id,
-				       p->getroute->destination));
+		/* If we don't exist in gossip, routing can't happen. */
+		q->src = gossmap_find_node(gossmap, p->local_id);
+		if (!q->src) {
+			q->errmsg = "We don't have any channels";
+			continue;
+		}
 
-		/* Let payment_finished_ handle this, so we mark it as pending */
-		return command_still_pending(p->cmd);
+		dq.start = q->dst;
+		dq.amount = p->getroute->amount;
+		dq.riskfactor = p->getroute->riskfactorppm / 1000000.0;
+		dq.arg = q;
+		tal_arr_expand(&queries, dq);
 	}
 
-	/* If we don't exist in gossip, routing can't happen. */
-	src = gossmap_find_node(gossmap, p->local_id);
-	if (!src) {
-		payment_fail(p, "We don't have any channels");
+	dijkstra_batch(gossmap, queries, tal_count(queries), 0,
+		       getroute_can_carry, route_score,
+		       getroute_dijkstra_done);
 
-		/* Let payment_finished_ handle this, so we mark it as pending */
-		return command_still_pending(p->cmd);
+	for (size_t i = 0; i < tal_count(getroute_batch); i++) {
+		if (getroute_batch[i].route)
+			getroute_reserve(&getroute_batch[i]);
+	}
+
+	/* They fit together: now unapply, since each payment applies its
+	 * own route once it's about to build the onion. */
+	for (size_t i = 0; i < tal_count(getroute_batch); i++) {
+		if (getroute_batch[i].reserved)
+			chanhints_apply_route(getroute_batch[i].p,
+					      getroute_batch[i].route, true);
+	}
+
+	/* Now the payments can continue (which may free others in the batch,
+	 * or start new getroutes, which go into the next batch). */
+	for (size_t i = 0; i < tal_count(getroute_batch); i++) {
+		struct payment *p = getroute_batch[i].p;
+		if (!p)
+			continue;
+		tal_del_destructor(p, destroy_pending_getroute);
+		payment_getroute_done(p, getroute_batch[i].route,
+				      getroute_batch[i].errmsg);
+	}
+	getroute_batch = tal_free(getroute_batch);
+}
+
+/* Turn p->planned_path into a route, if it still works and is within our
+ * budgets: otherwise we'll just look for a route as normal. */
+static struct route_hop *payment_planned_route(struct payment *p)
+{
+	struct gossmap *gossmap = get_gossmap(p->plugin);
+	size_t n = tal_count(p->planned_path);
+	struct gossmap_chan **chans = tal_arr(tmpctx, struct gossmap_chan *, n);
+	int *dirs = tal_arr(tmpctx, int, n);
+	struct route_hop *r;
+	struct amount_msat fee;
+
+	if (n == 0 || n > p->getroute->max_hops)
+		return NULL;
+
+	for (size_t i = 0; i < n; i++) {
+		chans[i] = gossmap_find_chan(gossmap,
+					     &p->planned_path[i].scid);
+		if (!chans[i])
+			return NULL;
+		dirs[i] = p->planned_path[i].dir;
 	}
 
-	p->route = route(p, gossmap, src, dst, p->getroute->amount, p->getroute->cltv,
-			 p->getroute->riskfactorppm / 1000000.0, p->getroute->max_hops,
-			 p, &errstr);
+	r = route_from_chans(p, gossmap, chans, dirs,
+			     p->getroute->amount, p->getroute->cltv);
+	if (!r)
+		return NULL;
+
+	/* Something else (e.g. a routehint) may want to go elsewhere. */
+	if (!node_id_eq(&r[n - 1].node_id, p->getroute->destination))
+		return tal_free(r);
+
+	for (size_t i = 0; i < n; i++) {
+		if (!payment_route_can_carry(gossmap, chans[i], dirs[i],
+					     r[i].amount, p))
+			return tal_free(r);
+	}
+
+	if (!amount_msat_sub(&fee, r[0].amount, p->amount)
+	    || amount_msat_greater(fee, p->constraints.fee_budget)
+	    || r[0].delay > p->constraints.cltv_budget)
+		return tal_free(r);
+
+	return r;
+}
+
+static struct command_result *payment_getroute(struct payment *p)
+{
+	if (p->planned_path) {
+		struct route_hop *r = payment_planned_route(p);
+		p->planned_path = tal_free(p->planned_path);
+		if (r)
+			return payment_getroute_done(p, r, NULL);
+		paymod_log(p, LOG_DBG,
+			   "Planned path no longer usable, finding a route");
+	}
+
+	if (!pending_getroutes) {
+		pending_getroutes = notleak(tal_arr(NULL, struct payment *, 0));
+		plugin_timer(p->plugin, time_from_sec(0),
+			     payment_getroute_batch, p->plugin);
+	}
+	tal_arr_expand(&pending_getroutes, p);
+	tal_add_destructor(p, destroy_pending_getroute);
+	return command_still_pending(p->cmd);
+}
+
+static struct command_result *payment_getroute_done(struct payment *p,
+						   struct route_hop *route,
+						   const char *errmsg)
+{
+	struct amount_msat fee;
+
+	p->route = route;
 	if (!p->route) {
-		payment_fail(p, "%s", errstr);
+		payment_fail(p, "%s", errmsg);
 		/* Let payment_finished_ handle this, so we mark it as pending */
 		return command_still_pending(p->cmd);
 	}
@@ -3781,6 +3989,211 @@ static void adaptive_splitter_cb(struct adaptive_split_mod_data *d, struct payme
 REGISTER_PAYMENT_MODIFIER(adaptive_splitter, struct adaptive_split_mod_data *,
 			  adaptive_splitter_data_init, adaptive_splitter_cb);
 
+/*****************************************************************************
+ * mcf -- Plan the parts using a min-cost flow.
+ *
+ * Rather than splitting by size up front and halving whatever fails, this
+ * models each channel's liquidity as uniformly distributed over what we know
+ * it could carry (its capacity and htlc_maximum_msat, narrowed by the
+ * channel_hints we learn from failures and in-flight parts), and finds the
+ * parts (amounts *and* paths) which together are most likely to succeed,
+ * trading that off against fees (see common/mcf.h).
+ *
+ * When a part fails, its amount is replanned the same way, which now takes
+ * into account what we learned from that failure.
+ */
+
+/* We never plan more parts than this at once. */
+#define MCF_MAX_PARTS 16
+
+/* What fraction of our fee budget we'd spend to double our chances. */
+#define MCF_FEE_BUDGET_PER_BIT 4
+
+static struct mcf_mod_data *mcf_data_init(struct payment *p)
+{
+	struct mcf_mod_data *d;
+	if (p->parent == NULL) {
+		d = tal(p, struct mcf_mod_data);
+		d->enable = false;
+		d->htlc_budget = 0;
+		return d;
+	} else {
+		return payment_mod_mcf_get_data(p->parent);
+	}
+}
+
+static struct amount_msat mcf_capacity(const struct gossmap *map,
+				       const struct gossmap_chan *c,
+				       int dir,
+				       struct payment *p)
+{
+	struct payment *root = payment_root(p);
+	const struct channel_hint *hint;
+	struct short_channel_id scid;
+	struct amount_sat cap;
+	struct amount_msat capmsat, htlc_max;
+
+	if (!gossmap_chan_set(c, dir) || !c->half[dir].enabled)
+		return AMOUNT_MSAT(0);
+
+	if (dst_is_excluded(map, c, dir, root->excluded_nodes))
+		return AMOUNT_MSAT(0);
+
+	if (!gossmap_chan_get_capacity(map, c, &cap)
+	    || !amount_sat_to_msat(&capmsat, cap))
+		return AMOUNT_MSAT(0);
+
+	htlc_max = amount_msat(fp16_to_u64(c->half[dir].htlc_max));
+	if (amount_msat_less(htlc_max, capmsat))
+		capmsat = htlc_max;
+
+	scid = gossmap_chan_scid(map, c);
+	hint = find_hint(root->channel_hints, &scid, dir);
+	if (hint) {
+		if (!hint->enabled || (hint->local && hint->htlc_budget == 0))
+			return AMOUNT_MSAT(0);
+		if (amount_msat_less(hint->estimated_capacity, capmsat))
+			capmsat = hint->estimated_capacity;
+	}
+	return capmsat;
+}
+
+/* Plan p->amount and start a child for each part, or return false. */
+static bool mcf_split(struct mcf_mod_data *d, struct payment *p,
+		      size_t max_parts)
+{
+	struct payment *root = payment_root(p);
+	struct gossmap *gossmap;
+	const struct gossmap_node *src, *dst;
+	struct mcf_path *paths;
+	u64 mu;
+	size_t used;
+	char *partids = tal_strdup(tmpctx, "");
+
+	/* Each part picks its own routehint, so we can only plan when we're
+	 * paying the destination directly. */
+	if (tal_count(root->routes) != 0)
+		return false;
+
+	gossmap = get_gossmap(p->plugin);
+	src = gossmap_find_node(gossmap, p->local_id);
+	dst = gossmap_find_node(gossmap, p->destination);
+	if (!src || !dst || src == dst)
+		return false;
+
+	mu = p->start_constraints->fee_budget.millisatoshis /* Raw: mu */
+		/ MCF_FEE_BUDGET_PER_BIT;
+	if (mu == 0)
+		mu = 1;
+
+	paths = min_cost_flow(tmpctx, gossmap, src, dst, p->amount, mu,
+			      max_parts, mcf_capacity, p);
+	if (!paths) {
+		paymod_log(p, LOG_INFORM,
+			   "No flow found which could carry %s",
+			   type_to_string(tmpctx, struct amount_msat,
+					  &p->amount));
+		return false;
+	}
+
+	payment_set_step(p, PAYMENT_STEP_SPLIT);
+	for (size_t i = 0; i < tal_count(paths); i++) {
+		struct payment *c = payment_new(p, NULL, p, p->modifiers);
+		double multiplier;
+
+		c->amount = paths[i].amount;
+		c->planned_path = tal_arr(c, struct short_channel_id_dir,
+					  tal_count(paths[i].chans));
+		for (size_t j = 0; j < tal_count(paths[i].chans); j++) {
+			c->planned_path[j].scid
+				= gossmap_chan_scid(gossmap, paths[i].chans[j]);
+			c->planned_path[j].dir = paths[i].dirs[j];
+		}
+
+		/* Don't multiply our fee allowance when splitting. */
+		multiplier = amount_msat_ratio(c->amount, p->amount);
+		if (!amount_msat_scale(&c->constraints.fee_budget,
+				       p->start_constraints->fee_budget,
+				       multiplier))
+			abort(); /* multiplier <= 1! */
+		payment_start(c);
+		tal_append_fmt(&partids, "%snew partid %"PRIu32" (%s)",
+			       i ? ", " : "", c->partid,
+			       type_to_string(tmpctx, struct amount_msat,
+					      &c->amount));
+	}
+
+	/* A failed part's HTLC is gone, so its replacement is free. */
+	used = tal_count(paths) - (p->parent != NULL);
+	d->htlc_budget = used > d->htlc_budget ? 0 : d->htlc_budget - used;
+	p->why = tal_fmt(p, "Planned %zu sub-payments for %s",
+			 tal_count(paths),
+			 type_to_string(tmpctx, struct amount_msat,
+					&p->amount));
+	paymod_log(p, LOG_INFORM, "%s: %s", p->why, partids);
+	return true;
+}
+
+static void mcf_cb(struct mcf_mod_data *d, struct payment *p)
+{
+	struct payment *root = payment_root(p);
+	size_t max_parts;
+
+	if (!d->enable || !payment_supports_mpp(p) || root->abort)
+		return payment_continue(p);
+
+	if (p->step == PAYMENT_STEP_ONION_PAYLOAD) {
+		/* We need to tell the last hop the total we're going to
+		 * send. */
+		size_t lastidx = tal_count(p->createonion_request->hops) - 1;
+		struct createonion_hop *hop = &p->createonion_request->hops[lastidx];
+		struct tlv_field **fields = &hop->tlv_payload->fields;
+		tlvstream_set_tlv_payload_data(
+			    fields, root->payment_secret,
+			    root->amount.millisatoshis); /* Raw: onion payload */
+	} else if (p->step == PAYMENT_STEP_INITIALIZED && p->parent == NULL) {
+		/* We need to opt-in to the MPP sending facility no matter
+		 * what we do (see presplit_cb). */
+		root->partid++;
+		root->next_partid++;
+
+		d->htlc_budget = payment_max_htlcs(p);
+		if (d->htlc_budget == 0) {
+			p->abort = true;
+			return payment_fail(
+			    p, "Cannot attempt payment, we have no channel to "
+			       "which we can add an HTLC");
+		}
+
+		/* Keep some HTLCs back for replanning failed parts. */
+		max_parts = d->htlc_budget;
+		if (max_parts >= PRESPLIT_MAX_HTLC_SHARE)
+			max_parts /= PRESPLIT_MAX_HTLC_SHARE;
+		if (max_parts > MCF_MAX_PARTS)
+			max_parts = MCF_MAX_PARTS;
+		if (!mcf_split(d, p, max_parts)) {
+			paymod_log(p, LOG_INFORM,
+				   "Could not plan parts, splitting "
+				   "heuristically instead");
+			d->enable = false;
+			payment_mod_presplit_get_data(p)->disable = false;
+			payment_mod_adaptive_splitter_get_data(p)->disable = false;
+		}
+	} else if (p->step == PAYMENT_STEP_FAILED && !p->abort
+		   && p->route != NULL && payment_can_retry(p)
+		   && !time_after(time_now(), p->deadline)) {
+		/* The failed part's HTLC is gone, so we can use that too. */
+		max_parts = 1 + d->htlc_budget;
+		if (max_parts > MCF_MAX_PARTS)
+			max_parts = MCF_MAX_PARTS;
+		/* If this fails, `retry` will try a plain route. */
+		mcf_split(d, p, max_parts);
+	}
+	payment_continue(p);
+}
+
+REGISTER_PAYMENT_MODIFIER(mcf, struct mcf_mod_data *, mcf_data_init, mcf_cb);
+
 
 /*****************************************************************************
  * payee_incoming_limit
@@ -207,6 +207,11 @@ struct payment {
 	 * here so it can be amended by mixins. */
 	struct route_hop *route;
 
+	/* If a modifier (e.g. `mcf`) already chose the channels for this
+	 * payment, we use them instead of looking for a route (as long as
+	 * they still work, and are within our budgets). */
+	struct short_channel_id_dir *planned_path;
+
 	struct channel_status *peer_channels;
 
 	/* The blockheight at which the payment attempt was
@@ -421,6 +426,13 @@ struct route_exclusions_data {
 	struct route_exclusion **exclusions;
 };
 
+struct mcf_mod_data {
+	/* Off by default: replaces `presplit` and `adaptive_splitter`, which
+	 * should be disabled when this is enabled. */
+	bool enable;
+	u32 htlc_budget;
+};
+
 /* List of globally available payment modifiers. */
 REGISTER_PAYMENT_MODIFIER_HEADER(retry, struct retry_mod_data);
 REGISTER_PAYMENT_MODIFIER_HEADER(routehints, struct routehints_data);
@@ -430,6 +442,11 @@ REGISTER_PAYMENT_MODIFIER_HEADER(directpay, struct direct_pay_data);
 extern struct payment_modifier waitblockheight_pay_mod;
 REGISTER_PAYMENT_MODIFIER_HEADER(presplit, struct presplit_mod_data);
 REGISTER_PAYMENT_MODIFIER_HEADER(adaptive_splitter, struct adaptive_split_mod_data);
+/* Plans all the parts at once using a min-cost flow (common/mcf.h), and
+ * replans the amount of any part which fails.  Must come before `presplit`
+ * (which it re-enables, along with `adaptive_splitter`, if it can't plan
+ * the payment) and `retry`. */
+REGISTER_PAYMENT_MODIFIER_HEADER(mcf, struct mcf_mod_data);
 
 /* For the root payment we can seed the channel_hints with the result from
  * `listpeers`, hence avoid channels that we know have insufficient capacity
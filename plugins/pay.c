@@ -23,6 +23,7 @@ static struct node_id my_id;
 static unsigned int maxdelay_default;
 static bool exp_offers;
 static bool disablempp = false;
+static bool use_mcf = false;
 
 static LIST_HEAD(payments);
 
@@ -915,6 +916,10 @@ struct payment_modifier *paymod_mods[] = {
 	 */
 	&routehints_pay_mod,
 	&payee_incoming_limit_pay_mod,
+	/* mcf *must* execute before presplit, which it enables if it cannot
+	 * plan the payment, and before retry, so it can replan failed
+	 * parts. */
+	&mcf_pay_mod,
 	&presplit_pay_mod,
 	&waitblockheight_pay_mod,
 	&retry_pay_mod,
@@ -1166,8 +1171,10 @@ static struct command_result *json_pay(struct command *cmd,
 	}
 
 	shadow_route = payment_mod_shadowroute_get_data(p);
-	payment_mod_presplit_get_data(p)->disable = disablempp;
-	payment_mod_adaptive_splitter_get_data(p)->disable = disablempp;
+	payment_mod_presplit_get_data(p)->disable = disablempp || use_mcf;
+	payment_mod_adaptive_splitter_get_data(p)->disable
+		= disablempp || use_mcf;
+	payment_mod_mcf_get_data(p)->enable = !disablempp && use_mcf;
 	payment_mod_route_exclusions_get_data(p)->exclusions = exclusions;
 
 	/* This is an MPP enabled pay command, disable amount fuzzing. */
@@ -1227,5 +1234,9 @@ int main(int argc, char *argv[])
 		    plugin_option("disable-mpp", "flag",
 				  "Disable multi-part payments.",
 				  flag_option, &disablempp),
+		    plugin_option("pay-mcf", "flag",
+				  "Plan multi-part payments using a min-cost"
+				  " flow, instead of splitting heuristically.",
+				  flag_option, &use_mcf),
 		    NULL);
 }
@@ -213,6 +213,12 @@ void plugin_notification_end(struct plugin *plugin UNNEEDED,
 struct json_stream *plugin_notification_start(struct plugin *plugins UNNEEDED,
 					      const char *method UNNEEDED)
 { fprintf(stderr, "plugin_notification_start called!\n"); abort(); }
+/* Generated stub for plugin_timer_ */
+struct plugin_timer *plugin_timer_(struct plugin *p UNNEEDED,
+				   struct timerel t UNNEEDED,
+				   void (*cb)(void *cb_arg) UNNEEDED,
+				   void *cb_arg UNNEEDED)
+{ fprintf(stderr, "plugin_timer_ called!\n"); abort(); }
 /* Generated stub for random_select */
 bool random_select(double weight UNNEEDED, double *tot_weight UNNEEDED)
 { fprintf(stderr, "random_select called!\n"); abort(); }
@@ -386,6 +392,7 @@ int main(int argc, char *argv[])
 	assert(gossmap_refresh(global_gossmap, NULL));
 	for (size_t i = ROUTING_MAX_HOPS; i > 2; i--) {
 		struct gossmap_node *dst, *src;
+		const struct dijkstra *dij;
 		struct route_hop *r;
 		const char *errmsg;
 		SUPERVERBOSE("%s -> %s:\n",
@@ -394,8 +401,10 @@ int main(int argc, char *argv[])
 
 		src = gossmap_find_node(global_gossmap, &ids[0]);
 		dst = gossmap_find_node(global_gossmap, &ids[NUM_NODES-1]);
-		r = route(tmpctx, global_gossmap, src, dst, AMOUNT_MSAT(1000), 0, 0.0,
-			  i - 1, p, &errmsg);
+		dij = dijkstra(tmpctx, global_gossmap, dst, AMOUNT_MSAT(1000),
+			       0.0, payment_route_can_carry, route_score, p);
+		r = route(tmpctx, global_gossmap, dij, src, dst,
+			  AMOUNT_MSAT(1000), 0, 0.0, i - 1, p, &errmsg);
 		assert(r);
 		/* FIXME: We naively fall back on shortest, rather
 		 * than biassing! */
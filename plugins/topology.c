@@ -6,6 +6,7 @@
 #include <ccan/tal/str/str.h>
 #include <common/dijkstra.h>
 #include <common/gossmap.h>
+#include <common/gossmap_incoming.h>
 #include <common/json_param.h>
 #include <common/json_stream.h>
 #include <common/memleak.h>
@@ -541,83 +542,37 @@ static struct command_result *json_listnodes(struct command *cmd,
 	return command_finished(cmd, js);
 }
 
-/* What is capacity of peer attached to chan #n? */
-static struct amount_msat peer_capacity(const struct gossmap *gossmap,
-				       const struct gossmap_node *me,
-				       const struct gossmap_node *peer,
-				       const struct gossmap_chan *ourchan)
-{
-	struct amount_msat capacity = AMOUNT_MSAT(0);
-
-	for (size_t i = 0; i < peer->num_chans; i++) {
-		int dir;
-		struct gossmap_chan *c;
-		c = gossmap_nth_chan(gossmap, peer, i, &dir);
-		if (c == ourchan)
-			continue;
-		if (!c->half[!dir].enabled)
-			continue;
-		if (!amount_msat_add(
-			&capacity, capacity,
-			amount_msat(fp16_to_u64(c->half[!dir].htlc_max))))
-			continue;
-	}
-	return capacity;
-}
-
 static struct command_result *json_listincoming(struct command *cmd,
 						const char *buffer,
 						const jsmntok_t *params)
 {
 	struct json_stream *js;
-	struct gossmap_node *me;
-	struct gossmap *gossmap;
+	struct gossmap_incoming *incoming;
 
 	if (!param(cmd, buffer, params, NULL))
 		return command_param_failed();
 
-	gossmap = get_gossmap();
+	incoming = gossmap_incoming_chans(tmpctx, get_gossmap(), &local_id);
 
 	js = jsonrpc_stream_success(cmd);
 	json_array_start(js, "incoming");
-	me = gossmap_find_node(gossmap, &local_id);
-	if (!me)
-		goto done;
-
-	for (size_t i = 0; i < me->num_chans; i++) {
-		struct node_id peer_id;
-		int dir;
-		struct gossmap_chan *ourchan;
-		struct gossmap_node *peer;
-		struct short_channel_id scid;
-
-		ourchan = gossmap_nth_chan(gossmap, me, i, &dir);
-		/* If its half is disabled, ignore. */
-		if (!ourchan->half[!dir].enabled)
-			continue;
-
-		peer = gossmap_nth_node(gossmap, ourchan, !dir);
-		scid = gossmap_chan_scid(gossmap, ourchan);
-
+	for (size_t i = 0; i < tal_count(incoming); i++) {
 		json_object_start(js, NULL);
-		gossmap_node_get_id(gossmap, peer, &peer_id);
-		json_add_node_id(js, "id", &peer_id);
-		json_add_short_channel_id(js, "short_channel_id", &scid);
+		json_add_node_id(js, "id", &incoming[i].peer_id);
+		json_add_short_channel_id(js, "short_channel_id",
+					  &incoming[i].scid);
 		json_add_amount_msat_only(js, "fee_base_msat",
-					  amount_msat(ourchan->half[!dir]
-						      .base_fee));
+					  incoming[i].fee_base);
 		json_add_amount_msat_only(js, "htlc_max_msat",
-					  amount_msat(fp16_to_u64(ourchan->half[!dir]
-								  .htlc_max)));
+					  incoming[i].htlc_max);
 		json_add_u32(js, "fee_proportional_millionths",
-			     ourchan->half[!dir].proportional_fee);
-		json_add_u32(js, "cltv_expiry_delta", ourchan->half[!dir].delay);
+			     incoming[i].fee_proportional_millionths);
+		json_add_u32(js, "cltv_expiry_delta",
+			     incoming[i].cltv_expiry_delta);
 		json_add_amount_msat_only(js, "incoming_capacity_msat",
-					 peer_capacity(gossmap,
-						       me, peer, ourchan));
+					  incoming[i].incoming_capacity);
 		json_object_end(js);
 	}
-done:
 	json_array_end(js);
 
 	return command_finished(cmd, js);
@@ -0,0 +1,123 @@
+#include "config.h"
+#include <bitcoin/chainparams.h>
+#include <bitcoin/privkey.h>
+#include <bitcoin/pubkey.h>
+#include <ccan/array_size/array_size.h>
+#include <ccan/err/err.h>
+#include <ccan/tal/str/str.h>
+#include <common/bolt11.h>
+#include <common/features.h>
+#include <common/utils.h>
+#include <stdio.h>
+#include <tests/bench/libbench.h>
+
+/* How fast we decode invoices: pay, decodepay and the offers plugin decode
+ * the same one again and again (which the signature cache helps), but
+ * decodepay on a fresh invoice is always a miss. */
+
+/* Many more than the signature cache holds. */
+#define NUM_UNIQUE 1000
+
+/* From the BOLT #11 examples */
+static const char *spec_invoices[] = {
+	"lnbc1pvjluezsp5zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zygspp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqdpl2pkx2ctnv5sxxmmwwd5kgetjypeh2ursdae8g6twvus8g6rfwvs8qun0dfjkxaq9qrsgq357wnc5r2ueh7ck6q93dj32dlqnls087fxdwk8qakdyafkq3yap9us6v52vjjsrvywa6rt52cm9r9zqt8r2t7mlcwspyetp5h2tztugp9lfyql",
+	"lnbc2500u1pvjluezsp5zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zygspp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqdq5xysxxatsyp3k7enxv4jsxqzpu9qrsgquk0rl77nj30yxdy8j9vdx85fkpmdla2087ne0xh8nhedh8w27kyke0lp53ut353s06fv3qfegext0eh0ymjpf39tuven09sam30g4vgpfna3rh",
+	"lnbc20m1pvjluezsp5zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zygspp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqhp58yjmdan79s6qqdhdzgynm4zwqd5d7xmw5fk98klysy043l2ahrqs9qrsgq7ea976txfraylvgzuxs8kgcw23ezlrszfnh8r6qtfpr6cxga50aj6txm9rxrydzd06dfeawfk6swupvz4erwnyutnjq7x39ymw6j38gp7ynn44",
+	"lnbc25m1pvjluezpp5qqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqqqsyqcyq5rqwzqfqypqdq5vdhkven9v5sxyetpdeessp5zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zyg3zygs9q5sqqqqqqqqqqqqqqqqsgq2a25dxl5hrntdtn6zvydt7d66hyzsyhqs4wdynavys42xgl6sgx9c4g7me86a27t07mdtfry458rtjr0v92cnmswpsjscgt2vcse3sgpz3uapa",
+};
+
+struct corpus {
+	const char **invoices;
+	size_t next;
+};
+
+static struct privkey privkey;
+
+static bool sign(const u5 *u5bytes,
+		 const u8 *hrpu8,
+		 secp256k1_ecdsa_recoverable_signature *rsig,
+		 void *unused UNUSED)
+{
+	struct hash_u5 hu5;
+	struct sha256 sha;
+	char *hrp = tal_strndup(tmpctx, (const char *)hrpu8, tal_count(hrpu8));
+
+	hash_u5_init(&hu5, hrp);
+	hash_u5(&hu5, u5bytes, tal_count(u5bytes));
+	hash_u5_done(&hu5, &sha);
+
+	return secp256k1_ecdsa_sign_recoverable(secp256k1_ctx, rsig,
+						(const u8 *)&sha,
+						privkey.secret.data,
+						NULL, NULL);
+}
+
+/* Roughly what we generate ourselves: a description, a payment secret, our
+ * features and one routehint. */
+static const char *make_invoice(const tal_t *ctx, size_t i)
+{
+	struct amount_msat msat = amount_msat(1000 + bench_rand() % 100000000);
+	struct bolt11 *b11 = new_bolt11(tmpctx, &msat);
+	struct route_info *r = tal_arr(tmpctx, struct route_info, 1);
+	struct pubkey k;
+
+	b11->chain = chainparams_for_network("bitcoin");
+	b11->timestamp = 1650000000 + i;
+	for (size_t j = 0; j < sizeof(b11->payment_hash); j++)
+		b11->payment_hash.u.u8[j] = bench_rand();
+	b11->payment_secret = tal(b11, struct secret);
+	for (size_t j = 0; j < sizeof(*b11->payment_secret); j++)
+		b11->payment_secret->data[j] = bench_rand();
+	if (!pubkey_from_privkey(&privkey, &k))
+		abort();
+	node_id_from_pubkey(&b11->receiver_id, &k);
+	b11->description = tal_fmt(b11, "Invoice %zu for bench", i);
+	b11->expiry = 604800;
+	set_feature_bit(&b11->features, OPTIONAL_FEATURE(OPT_VAR_ONION));
+	set_feature_bit(&b11->features, COMPULSORY_FEATURE(OPT_PAYMENT_SECRET));
+
+	b11->routes = tal_arr(b11, struct route_info *, 0);
+	r[0].pubkey = b11->receiver_id;
+	r[0].short_channel_id.u64 = bench_rand();
+	r[0].fee_base_msat = 1000;
+	r[0].fee_proportional_millionths = 10;
+	r[0].cltv_expiry_delta = 34;
+	tal_arr_expand(&b11->routes, r);
+
+	return bolt11_encode(ctx, b11, false, sign, NULL);
+}
+
+static void decode(struct corpus *c)
+{
+	char *fail;
+
+	if (!bolt11_decode(tmpctx, c->invoices[c->next], NULL, NULL, NULL,
+			   &fail))
+		errx(1, "Could not decode %s: %s", c->invoices[c->next], fail);
+	c->next = (c->next + 1) % tal_count(c->invoices);
+}
+
+int main(int argc, char *argv[])
+{
+	struct corpus c;
+
+	bench_init(&argc, &argv);
+	memset(&privkey, 0x42, sizeof(privkey));
+
+	/* Same few invoices, again and again. */
+	c.invoices = tal_dup_arr(NULL, const char *, spec_invoices,
+				 ARRAY_SIZE(spec_invoices), 0);
+	c.next = 0;
+	bench_run("bolt11_decode_repeated", decode, &c);
+	tal_free(c.invoices);
+
+	/* Never the same one twice in a row. */
+	c.invoices = tal_arr(NULL, const char *, NUM_UNIQUE);
+	for (size_t i = 0; i < NUM_UNIQUE; i++)
+		c.invoices[i] = make_invoice(c.invoices, i);
+	c.next = 0;
+	bench_run("bolt11_decode_unique", decode, &c);
+	tal_free(c.invoices);
+
+	bench_shutdown();
+}
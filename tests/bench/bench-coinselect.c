@@ -0,0 +1,63 @@
+#include "config.h"
+#include <ccan/array_size/array_size.h>
+#include <common/coinselect.h>
+#include <common/utils.h>
+#include <stdio.h>
+#include <tests/bench/libbench.h>
+
+/* How fundpsbt's coin selection scales with the size of the wallet. */
+
+/* Effective values between 1,000 and 10,000,000 sats, log-uniform: lots of
+ * small ones, like a busy node's wallet. */
+static struct amount_sat *make_wallet(const tal_t *ctx, size_t n)
+{
+	struct amount_sat *effective = tal_arr(ctx, struct amount_sat, n);
+
+	for (size_t i = 0; i < n; i++) {
+		u64 sats = 1000;
+		for (size_t j = bench_rand() % 4; j > 0; j--)
+			sats *= 10;
+		sats += bench_rand() % (sats * 9);
+		effective[i] = amount_sat(sats);
+	}
+	return effective;
+}
+
+struct selection {
+	struct amount_sat *effective;
+	struct amount_sat target;
+};
+
+static void select_coins(struct selection *s)
+{
+	/* About what a p2wpkh change output costs at 1000 sat/kw */
+	if (!coinselect(tmpctx, s->effective, s->target, AMOUNT_SAT(400)))
+		abort();
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t sizes[] = { 1000, 10000, 50000 };
+	struct selection s;
+	char name[64];
+
+	bench_init(&argc, &argv);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		s.effective = make_wallet(NULL, sizes[i]);
+
+		/* A typical channel open */
+		s.target = AMOUNT_SAT(2000000);
+		snprintf(name, sizeof(name), "coinselect_%zu_small", sizes[i]);
+		bench_run(name, select_coins, &s);
+
+		/* Most of the wallet */
+		s.target = AMOUNT_SAT(1000000000);
+		snprintf(name, sizeof(name), "coinselect_%zu_large", sizes[i]);
+		bench_run(name, select_coins, &s);
+
+		tal_free(s.effective);
+	}
+
+	bench_shutdown();
+}
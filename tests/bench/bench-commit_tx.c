@@ -0,0 +1,84 @@
+#include "config.h"
+#include <bitcoin/privkey.h>
+#include <bitcoin/pubkey.h>
+#include <bitcoin/tx.h>
+#include <ccan/err/err.h>
+#include <channeld/channeld_htlc.h>
+#include <channeld/commit_tx.h>
+#include <common/keyset.h>
+#include <common/utils.h>
+#include <tests/bench/libbench.h>
+
+/* A busy channel: half of these are ours, half theirs */
+#define NUM_HTLCS 30
+
+struct commit_bench {
+	struct bitcoin_outpoint funding;
+	struct pubkey local_funding_key, remote_funding_key;
+	struct keyset keyset;
+	const struct htlc **htlcs;
+	bool anchors;
+};
+
+static void make_pubkey(struct pubkey *key, u8 seed)
+{
+	struct privkey priv;
+
+	memset(&priv, seed, sizeof(priv));
+	if (!pubkey_from_privkey(&priv, key))
+		abort();
+}
+
+static void build_commit_tx(struct commit_bench *cb)
+{
+	const struct htlc **htlcmap;
+	struct wally_tx_output *direct_outputs[NUM_SIDES];
+
+	if (!commit_tx(tmpctx, &cb->funding, AMOUNT_SAT(10000000),
+		       &cb->local_funding_key, &cb->remote_funding_key,
+		       LOCAL, 144, 0, 0, &cb->keyset,
+		       2500, AMOUNT_SAT(546),
+		       AMOUNT_MSAT(4000000000), AMOUNT_MSAT(3000000000),
+		       cb->htlcs, &htlcmap, direct_outputs,
+		       0x2bb038521914ULL, cb->anchors, LOCAL))
+		errx(1, "commit_tx failed");
+}
+
+int main(int argc, char *argv[])
+{
+	struct commit_bench cb;
+	struct htlc *htlcs;
+
+	bench_init(&argc, &argv);
+
+	memset(&cb.funding, 0x11, sizeof(cb.funding));
+	cb.funding.n = 0;
+	make_pubkey(&cb.local_funding_key, 1);
+	make_pubkey(&cb.remote_funding_key, 2);
+	make_pubkey(&cb.keyset.self_revocation_key, 3);
+	make_pubkey(&cb.keyset.self_htlc_key, 4);
+	make_pubkey(&cb.keyset.other_htlc_key, 5);
+	make_pubkey(&cb.keyset.self_delayed_payment_key, 6);
+	make_pubkey(&cb.keyset.self_payment_key, 7);
+	make_pubkey(&cb.keyset.other_payment_key, 8);
+
+	htlcs = tal_arrz(NULL, struct htlc, NUM_HTLCS);
+	cb.htlcs = tal_arr(htlcs, const struct htlc *, NUM_HTLCS);
+	for (size_t i = 0; i < NUM_HTLCS; i++) {
+		htlcs[i].state = i % 2 ? SENT_ADD_ACK_REVOCATION
+			: RCVD_ADD_ACK_REVOCATION;
+		htlcs[i].id = i;
+		htlcs[i].amount = amount_msat(1000000 + i * 100000);
+		htlcs[i].expiry.locktime = 700000 + i;
+		memset(&htlcs[i].rhash, i, sizeof(htlcs[i].rhash));
+		cb.htlcs[i] = &htlcs[i];
+	}
+
+	cb.anchors = false;
+	bench_run("commit_tx", build_commit_tx, &cb);
+	cb.anchors = true;
+	bench_run("commit_tx_anchors", build_commit_tx, &cb);
+
+	tal_free(htlcs);
+	bench_shutdown();
+}
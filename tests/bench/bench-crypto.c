@@ -0,0 +1,175 @@
+#include "config.h"
+#include <bitcoin/privkey.h>
+#include <bitcoin/pubkey.h>
+#include <ccan/err/err.h>
+#include <common/cryptomsg.h>
+#include <common/sphinx.h>
+#include <common/utils.h>
+#include <tests/bench/libbench.h>
+
+/* A typical route length, and roughly the size of an HTLC payload */
+#define NUM_HOPS 5
+#define PAYLOAD_SIZE 50
+
+/* About the size of a commitment_signed with a few HTLCs, and of a
+ * channel_update (the bulk of what we send when streaming gossip) */
+#define MSG_SIZE 1000
+#define GOSSIP_MSG_SIZE 136
+
+struct sphinx_bench {
+	struct privkey keys[NUM_HOPS];
+	struct pubkey ids[NUM_HOPS];
+	struct secret session_key;
+	u8 assocdata[32];
+	u8 *onion;
+};
+
+struct cryptomsg_bench {
+	struct crypto_state send, recv;
+	u8 *msg;
+	/* For the in-place variants */
+	u8 *buf;
+	size_t len;
+};
+
+static struct onionpacket *make_onion(const tal_t *ctx,
+				      struct sphinx_bench *sb)
+{
+	struct sphinx_path *sp;
+	struct secret *path_secrets;
+	struct onionpacket *op;
+
+	sp = sphinx_path_new_with_key(tmpctx, sb->assocdata,
+				      &sb->session_key);
+	for (size_t i = 0; i < NUM_HOPS; i++) {
+		u8 *payload = tal_arr(tmpctx, u8, PAYLOAD_SIZE);
+		memset(payload, i, PAYLOAD_SIZE);
+		sphinx_add_modern_hop(sp, &sb->ids[i], take(payload));
+	}
+	op = create_onionpacket(ctx, sp, ROUTING_INFO_SIZE, &path_secrets);
+	if (!op)
+		errx(1, "create_onionpacket failed");
+	return op;
+}
+
+static void sphinx_create(struct sphinx_bench *sb)
+{
+	serialize_onionpacket(tmpctx, make_onion(tmpctx, sb));
+}
+
+/* What the first hop does with an incoming HTLC's onion. */
+static void sphinx_process(struct sphinx_bench *sb)
+{
+	struct onionpacket *op;
+	struct secret ss;
+	enum onion_wire failcode;
+
+	op = parse_onionpacket(tmpctx, sb->onion, tal_bytelen(sb->onion),
+			       &failcode);
+	if (!op)
+		errx(1, "parse_onionpacket failed");
+	if (!onion_shared_secret(&ss, op, &sb->keys[0]))
+		errx(1, "onion_shared_secret failed");
+	if (!process_onionpacket(tmpctx, op, &ss, sb->assocdata,
+				 sizeof(sb->assocdata), true))
+		errx(1, "process_onionpacket failed");
+}
+
+static void cryptomsg_encrypt(struct cryptomsg_bench *cb)
+{
+	cryptomsg_encrypt_msg(tmpctx, &cb->send, cb->msg);
+}
+
+static void cryptomsg_roundtrip(struct cryptomsg_bench *cb)
+{
+	u8 *enc = cryptomsg_encrypt_msg(tmpctx, &cb->send, cb->msg);
+	u16 len;
+
+	if (!cryptomsg_decrypt_header(&cb->recv, enc, &len))
+		errx(1, "cryptomsg_decrypt_header failed");
+	if (!cryptomsg_decrypt_body(tmpctx, &cb->recv,
+				    enc + CRYPTOMSG_HDR_SIZE))
+		errx(1, "cryptomsg_decrypt_body failed");
+}
+
+static void encrypt_inplace(struct cryptomsg_bench *cb)
+{
+	cryptomsg_encrypt_inplace(&cb->send, cb->buf, cb->len);
+}
+
+static void cryptomsg_roundtrip_inplace(struct cryptomsg_bench *cb)
+{
+	u16 len;
+
+	cryptomsg_encrypt_inplace(&cb->send, cb->buf, cb->len);
+	if (!cryptomsg_decrypt_header(&cb->recv, cb->buf, &len))
+		errx(1, "cryptomsg_decrypt_header failed");
+	if (!cryptomsg_decrypt_body_inplace(&cb->recv,
+					    cb->buf + CRYPTOMSG_HDR_SIZE,
+					    len + CRYPTOMSG_BODY_OVERHEAD))
+		errx(1, "cryptomsg_decrypt_body_inplace failed");
+}
+
+static void setup_inplace(struct cryptomsg_bench *cb, size_t len)
+{
+	cb->len = len;
+	tal_resize(&cb->buf,
+		   CRYPTOMSG_HDR_SIZE + len + CRYPTOMSG_BODY_OVERHEAD);
+}
+
+/* The receiver mirrors the sender's current state. */
+static void sync_recv(struct cryptomsg_bench *cb)
+{
+	memset(&cb->recv, 0, sizeof(cb->recv));
+	cb->recv.rn = cb->send.sn;
+	cb->recv.rk = cb->send.sk;
+	cb->recv.r_ck = cb->send.s_ck;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sphinx_bench sb;
+	struct cryptomsg_bench cb;
+
+	bench_init(&argc, &argv);
+
+	for (size_t i = 0; i < NUM_HOPS; i++) {
+		memset(&sb.keys[i], i + 1, sizeof(sb.keys[i]));
+		if (!pubkey_from_privkey(&sb.keys[i], &sb.ids[i]))
+			abort();
+	}
+	memset(&sb.session_key, 0x42, sizeof(sb.session_key));
+	memset(sb.assocdata, 0x99, sizeof(sb.assocdata));
+	sb.onion = serialize_onionpacket(NULL, make_onion(tmpctx, &sb));
+
+	bench_run("sphinx_create", sphinx_create, &sb);
+	bench_run("sphinx_process", sphinx_process, &sb);
+
+	memset(&cb.send, 0, sizeof(cb.send));
+	memset(&cb.send.sk, 1, sizeof(cb.send.sk));
+	memset(&cb.send.s_ck, 2, sizeof(cb.send.s_ck));
+	cb.msg = tal_arrz(NULL, u8, MSG_SIZE);
+	cb.buf = tal_arrz(NULL, u8, 0);
+
+	bench_run_bytes("cryptomsg_encrypt", cryptomsg_encrypt, &cb,
+			MSG_SIZE);
+	sync_recv(&cb);
+	bench_run_bytes("cryptomsg_roundtrip", cryptomsg_roundtrip, &cb,
+			MSG_SIZE);
+
+	setup_inplace(&cb, MSG_SIZE);
+	bench_run_bytes("cryptomsg_encrypt_inplace",
+			encrypt_inplace, &cb, MSG_SIZE);
+	sync_recv(&cb);
+	bench_run_bytes("cryptomsg_roundtrip_inplace",
+			cryptomsg_roundtrip_inplace, &cb, MSG_SIZE);
+
+	setup_inplace(&cb, GOSSIP_MSG_SIZE);
+	bench_run_bytes("cryptomsg_encrypt_inplace_gossip",
+			encrypt_inplace, &cb, GOSSIP_MSG_SIZE);
+
+	tal_free(cb.buf);
+	tal_free(cb.msg);
+	tal_free(sb.onion);
+	bench_shutdown();
+}
@@ -0,0 +1,277 @@
+#include "config.h"
+#include <ccan/err/err.h>
+#include <ccan/tal/str/str.h>
+#include <common/dijkstra.h>
+#include <common/gossip_store.h>
+#include <common/gossmap.h>
+#include <common/route.h>
+#include <common/utils.h>
+#include <tests/bench/libbench.h>
+#include <unistd.h>
+
+/* Roughly a tenth of mainnet */
+#define NUM_NODES 2000
+#define NUM_CHANS 8000
+
+/* A large payment, presplit into parts which all need routes at once */
+#define MPP_PARTS 16
+
+struct gossmap_bench {
+	const char *fname;
+	struct gossmap *map;
+	struct gossmap_node *src, *dst;
+};
+
+static void load(struct gossmap_bench *gb)
+{
+	if (!gossmap_load(tmpctx, gb->fname, NULL))
+		err(1, "Loading %s", gb->fname);
+}
+
+static void refresh(struct gossmap_bench *gb)
+{
+	gossmap_refresh(gb->map, NULL);
+}
+
+/* Long routes: the first nodes are near the root of our spanning tree,
+ * the last are leaves. */
+static void pick_route_ends(struct gossmap_bench *gb)
+{
+	gb->src = gossmap_first_node(gb->map);
+	for (struct gossmap_node *n = gb->src;
+	     n;
+	     n = gossmap_next_node(gb->map, n))
+		gb->dst = n;
+}
+
+static void run_dijkstra(struct gossmap_bench *gb)
+{
+	dijkstra(tmpctx, gb->map, gb->dst, AMOUNT_MSAT(10000000), 10,
+		 route_can_carry, route_score_cheaper, NULL);
+}
+
+static void getroute(struct gossmap_bench *gb)
+{
+	const struct dijkstra *dij;
+
+	dij = dijkstra(tmpctx, gb->map, gb->dst, AMOUNT_MSAT(10000000), 10,
+		       route_can_carry, route_score_cheaper, NULL);
+	if (!route_from_dijkstra(tmpctx, gb->map, dij, gb->src,
+				 AMOUNT_MSAT(10000000), 9))
+		errx(1, "No route?");
+}
+
+static struct amount_msat part_amount(size_t i)
+{
+	return amount_msat(10000000 + i * 100000);
+}
+
+static void mpp_serial(struct gossmap_bench *gb)
+{
+	for (size_t i = 0; i < MPP_PARTS; i++) {
+		const struct dijkstra *dij;
+
+		dij = dijkstra(tmpctx, gb->map, gb->dst, part_amount(i), 10,
+			       route_can_carry, route_score_cheaper, NULL);
+		if (!route_from_dijkstra(tmpctx, gb->map, dij, gb->src,
+					 part_amount(i), 9))
+			errx(1, "No route?");
+	}
+}
+
+struct mpp_part {
+	struct gossmap_bench *gb;
+	struct amount_msat amount;
+};
+
+static void mpp_part_done(const struct dijkstra *dij, void *arg)
+{
+	struct mpp_part *part = arg;
+
+	if (!route_from_dijkstra(tmpctx, part->gb->map, dij, part->gb->src,
+				 part->amount, 9))
+		errx(1, "No route?");
+}
+
+static void mpp_batch(struct gossmap_bench *gb)
+{
+	struct mpp_part parts[MPP_PARTS];
+	struct dijkstra_query queries[MPP_PARTS];
+
+	for (size_t i = 0; i < MPP_PARTS; i++) {
+		parts[i].gb = gb;
+		parts[i].amount = part_amount(i);
+		queries[i].start = gb->dst;
+		queries[i].amount = parts[i].amount;
+		queries[i].riskfactor = 10;
+		queries[i].arg = &parts[i];
+	}
+	dijkstra_batch(gb->map, queries, MPP_PARTS, 0,
+		       route_can_carry, route_score_cheaper, mpp_part_done);
+}
+
+/* Like libplugin-pay's channel_hints: what's left in each direction of each
+ * channel, which the parts of a payment share. */
+struct mpp_limits {
+	struct gossmap_bench *gb;
+	struct amount_msat *remaining;
+};
+
+static bool mpp_limits_can_carry(const struct gossmap *map,
+				 const struct gossmap_chan *c,
+				 int dir,
+				 struct amount_msat amount,
+				 struct mpp_limits *limits)
+{
+	if (!route_can_carry(map, c, dir, amount, NULL))
+		return false;
+	return amount_msat_less(amount,
+				limits->remaining[gossmap_chan_idx(map, c) * 2
+						  + dir]);
+}
+
+static struct amount_msat *mpp_remaining(struct mpp_limits *limits,
+					 const struct route_hop *hop)
+{
+	struct gossmap *map = limits->gb->map;
+	struct gossmap_chan *c = gossmap_find_chan(map, &hop->scid);
+
+	return &limits->remaining[gossmap_chan_idx(map, c) * 2
+				  + hop->direction];
+}
+
+/* Check first, then apply, like chanhints_apply_route. */
+static bool mpp_reserve(struct mpp_limits *limits,
+			const struct route_hop *r)
+{
+	for (size_t i = 0; i < tal_count(r); i++) {
+		if (!amount_msat_greater(*mpp_remaining(limits, &r[i]),
+					 r[i].amount))
+			return false;
+	}
+	for (size_t i = 0; i < tal_count(r); i++) {
+		struct amount_msat *rem = mpp_remaining(limits, &r[i]);
+		if (!amount_msat_sub(rem, *rem, r[i].amount))
+			abort();
+	}
+	return true;
+}
+
+struct mpp_limited_part {
+	struct mpp_limits *limits;
+	struct amount_msat amount;
+	struct route_hop *route;
+};
+
+static void mpp_limited_part_done(const struct dijkstra *dij, void *arg)
+{
+	struct mpp_limited_part *part = arg;
+	struct gossmap_bench *gb = part->limits->gb;
+
+	part->route = route_from_dijkstra(tmpctx, gb->map, dij, gb->src,
+					  part->amount, 9);
+	if (!part->route)
+		errx(1, "No route?");
+}
+
+static bool mpp_limited_can_carry(const struct gossmap *map,
+				  const struct gossmap_chan *c,
+				  int dir,
+				  struct amount_msat amount,
+				  void *arg)
+{
+	struct mpp_limited_part *part = arg;
+	return mpp_limits_can_carry(map, c, dir, amount, part->limits);
+}
+
+/* As mpp_batch, but every channel can only carry a part and a half, so
+ * parts which picked the same channels must be rerouted, one at a time,
+ * once the routes before them are reserved: as libplugin-pay does.  Our
+ * own and the destination's channels are left unlimited, since there may
+ * be only one of them. */
+static void mpp_batch_overlap(struct gossmap_bench *gb)
+{
+	struct mpp_limited_part parts[MPP_PARTS];
+	struct dijkstra_query queries[MPP_PARTS];
+	struct mpp_limits limits;
+	struct amount_msat limit;
+
+	if (!amount_msat_add(&limit, part_amount(MPP_PARTS),
+			     amount_msat_div(part_amount(MPP_PARTS), 2)))
+		abort();
+
+	limits.gb = gb;
+	limits.remaining = tal_arr(tmpctx, struct amount_msat,
+				   gossmap_max_chan_idx(gb->map) * 2);
+	for (size_t i = 0; i < tal_count(limits.remaining); i++)
+		limits.remaining[i] = AMOUNT_MSAT(-1ULL);
+	for (struct gossmap_chan *c = gossmap_first_chan(gb->map);
+	     c;
+	     c = gossmap_next_chan(gb->map, c)) {
+		u32 idx = gossmap_chan_idx(gb->map, c);
+
+		if (gossmap_nth_node(gb->map, c, 0) == gb->src
+		    || gossmap_nth_node(gb->map, c, 1) == gb->src
+		    || gossmap_nth_node(gb->map, c, 0) == gb->dst
+		    || gossmap_nth_node(gb->map, c, 1) == gb->dst)
+			continue;
+		limits.remaining[idx * 2] = limits.remaining[idx * 2 + 1]
+			= limit;
+	}
+
+	for (size_t i = 0; i < MPP_PARTS; i++) {
+		parts[i].limits = &limits;
+		parts[i].amount = part_amount(i);
+		queries[i].start = gb->dst;
+		queries[i].amount = parts[i].amount;
+		queries[i].riskfactor = 10;
+		queries[i].arg = &parts[i];
+	}
+	dijkstra_batch(gb->map, queries, MPP_PARTS, 0,
+		       mpp_limited_can_carry, route_score_cheaper,
+		       mpp_limited_part_done);
+
+	for (size_t i = 0; i < MPP_PARTS; i++) {
+		const struct dijkstra *dij;
+
+		if (mpp_reserve(&limits, parts[i].route))
+			continue;
+
+		dij = dijkstra(tmpctx, gb->map, gb->dst, parts[i].amount, 10,
+			       mpp_limited_can_carry, route_score_cheaper,
+			       &parts[i]);
+		mpp_limited_part_done(dij, &parts[i]);
+		if (!mpp_reserve(&limits, parts[i].route))
+			errx(1, "Rerouted part %zu still overlaps?", i);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct gossmap_bench gb;
+
+	bench_init(&argc, &argv);
+
+	gb.fname = bench_gossip_store(NULL, NUM_NODES, NUM_CHANS);
+	bench_run("gossmap_load", load, &gb);
+
+	gb.map = gossmap_load(NULL, gb.fname, NULL);
+	bench_run("gossmap_refresh_unchanged", refresh, &gb);
+
+	if (!gossmap_write_index(gb.map))
+		err(1, "Writing gossmap index");
+	bench_run("gossmap_load_index", load, &gb);
+
+	pick_route_ends(&gb);
+	bench_run("dijkstra", run_dijkstra, &gb);
+	bench_run("getroute", getroute, &gb);
+	bench_run("getroute_mpp_serial", mpp_serial, &gb);
+	bench_run("getroute_mpp_batch", mpp_batch, &gb);
+	bench_run("getroute_mpp_batch_overlap", mpp_batch_overlap, &gb);
+
+	unlink(tal_fmt(tmpctx, "%s"GOSSMAP_INDEX_SUFFIX, gb.fname));
+	unlink(gb.fname);
+	tal_free(gb.map);
+	tal_free(gb.fname);
+	bench_shutdown();
+}
@@ -0,0 +1,100 @@
+#include "config.h"
+#include <ccan/array_size/array_size.h>
+#include <ccan/err/err.h>
+#include <ccan/io/io.h>
+#include <ccan/tal/str/str.h>
+#include <common/utils.h>
+#include <sys/resource.h>
+#include <tests/bench/libbench.h>
+#include <unistd.h>
+
+/* One wakeup (a byte arriving on one fd) with this many others idle,
+ * like connectd with many quiet peers. */
+static const size_t num_idle[] = { 10, 100, 1000 };
+
+struct wakeup_bench {
+	int wfd;
+	char c;
+};
+
+static struct io_plan *got_byte(struct io_conn *conn, struct wakeup_bench *wb);
+
+static struct io_plan *read_byte(struct io_conn *conn, struct wakeup_bench *wb)
+{
+	return io_read(conn, &wb->c, 1, got_byte, wb);
+}
+
+static struct io_plan *got_byte(struct io_conn *conn, struct wakeup_bench *wb)
+{
+	io_break(wb);
+	return read_byte(conn, wb);
+}
+
+static struct io_plan *read_never(struct io_conn *conn, char *buf)
+{
+	/* Nobody ever writes to these. */
+	return io_read(conn, buf, 1, io_close_cb, NULL);
+}
+
+static void wakeup(struct wakeup_bench *wb)
+{
+	if (write(wb->wfd, "x", 1) != 1)
+		err(1, "write");
+	if (io_loop(NULL, NULL) != wb)
+		errx(1, "io_loop returned early");
+}
+
+static void bench_wakeup(bool epoll, size_t idle)
+{
+	const tal_t *ctx = tal(NULL, char);
+	int *idle_wfds = tal_arr(ctx, int, idle);
+	char *buf = tal(ctx, char);
+	struct wakeup_bench wb;
+	int fds[2];
+
+	if (!io_use_epoll(epoll)) {
+		tal_free(ctx);
+		return;
+	}
+
+	for (size_t i = 0; i < idle; i++) {
+		if (pipe(fds) != 0)
+			err(1, "pipe");
+		idle_wfds[i] = fds[1];
+		io_new_conn(ctx, fds[0], read_never, buf);
+	}
+
+	if (pipe(fds) != 0)
+		err(1, "pipe");
+	wb.wfd = fds[1];
+	io_new_conn(ctx, fds[0], read_byte, &wb);
+
+	bench_run(tal_fmt(ctx, "io_%s_wakeup_%zu_idle",
+			  epoll ? "epoll" : "poll", idle),
+		  wakeup, &wb);
+
+	for (size_t i = 0; i < idle; i++)
+		close(idle_wfds[i]);
+	close(wb.wfd);
+	/* Closes all the read ends. */
+	tal_free(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	struct rlimit lim;
+
+	bench_init(&argc, &argv);
+
+	/* Two fds per pipe: we may need more than the usual 1024. */
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(num_idle); i++) {
+		bench_wakeup(false, num_idle[i]);
+		bench_wakeup(true, num_idle[i]);
+	}
+	bench_shutdown();
+}
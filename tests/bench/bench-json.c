@@ -0,0 +1,85 @@
+#include "config.h"
+#include <bitcoin/short_channel_id.h>
+#include <ccan/crypto/sha256/sha256.h>
+#include <ccan/err/err.h>
+#include <ccan/json_out/json_out.h>
+#include <ccan/tal/str/str.h>
+#include <common/json_parse_simple.h>
+#include <common/json_stream.h>
+#include <common/utils.h>
+#include <tests/bench/libbench.h>
+
+/* Something like a listforwards response from a busy node */
+#define NUM_ENTRIES 1000
+
+struct json_bench {
+	const char *buf;
+	size_t len;
+};
+
+static const char *emit(const tal_t *ctx, size_t *len)
+{
+	struct json_stream *js = new_json_stream(ctx, NULL, NULL);
+
+	json_object_start(js, NULL);
+	json_array_start(js, "forwards");
+	for (size_t i = 0; i < NUM_ENTRIES; i++) {
+		struct short_channel_id in, out;
+		struct sha256 hash;
+		struct timeabs received;
+
+		if (!mk_short_channel_id(&in, 700000 + i, i % 1000, 0)
+		    || !mk_short_channel_id(&out, 710000 + i, i % 100, 1))
+			abort();
+		sha256(&hash, &i, sizeof(i));
+		received.ts.tv_sec = 1650000000 + i;
+		received.ts.tv_nsec = i * 1000;
+
+		json_object_start(js, NULL);
+		json_add_sha256(js, "payment_hash", &hash);
+		json_add_short_channel_id(js, "in_channel", &in);
+		json_add_short_channel_id(js, "out_channel", &out);
+		json_add_amount_msat_only(js, "in_msat",
+					  amount_msat(100001000 + i));
+		json_add_amount_msat_only(js, "out_msat",
+					  amount_msat(100000000 + i));
+		json_add_amount_msat_only(js, "fee_msat", AMOUNT_MSAT(1000));
+		json_add_string(js, "status", i % 3 ? "settled" : "failed");
+		json_add_timeabs(js, "received_time", received);
+		json_object_end(js);
+	}
+	json_array_end(js);
+	json_object_end(js);
+
+	json_out_finished(js->jout);
+	return json_out_contents(js->jout, len);
+}
+
+static void json_emit(struct json_bench *jb)
+{
+	size_t len;
+	emit(tmpctx, &len);
+}
+
+static void json_parse(struct json_bench *jb)
+{
+	if (!json_parse_simple(tmpctx, jb->buf, jb->len))
+		errx(1, "Failed to parse our own JSON?");
+}
+
+int main(int argc, char *argv[])
+{
+	struct json_bench jb;
+	const char *buf;
+
+	bench_init(&argc, &argv);
+
+	buf = emit(tmpctx, &jb.len);
+	jb.buf = tal_strndup(NULL, buf, jb.len);
+
+	bench_run("json_emit", json_emit, &jb);
+	bench_run("json_parse", json_parse, &jb);
+
+	tal_free(jb.buf);
+	bench_shutdown();
+}
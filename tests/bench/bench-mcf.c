@@ -0,0 +1,323 @@
+#include "config.h"
+#include <ccan/err/err.h>
+#include <ccan/tal/str/str.h>
+#include <common/dijkstra.h>
+#include <common/gossmap.h>
+#include <common/mcf.h>
+#include <common/route.h>
+#include <common/utils.h>
+#include <tests/bench/libbench.h>
+#include <unistd.h>
+
+/* Simulates paying across a network where we only know capacities, not
+ * where the liquidity is, comparing how many attempts it takes (and how
+ * long we take to work out what to attempt) for the presplit/adaptive
+ * heuristics and for planning by min-cost flow. */
+
+/* Same as bench-gossmap */
+#define NUM_NODES 2000
+#define NUM_CHANS 8000
+
+#define NUM_PAYMENTS 10
+#define PAYMENT_AMOUNT AMOUNT_MSAT(500000000)
+
+/* Give up after this many attempts on one payment */
+#define MAX_ATTEMPTS 200
+
+/* These mirror plugins/libplugin-pay.c */
+#define MPP_TARGET_SIZE (10 * 1000 * 1000)
+#define PRESPLIT_MAX_SPLITS 16
+#define MPP_ADAPTIVE_LOWER_LIMIT AMOUNT_MSAT(100 * 1000)
+#define RETRIES 10
+#define MCF_MAX_PARTS 16
+#define MCF_FEE_BUDGET_PER_BIT 4
+
+struct sim {
+	struct gossmap *map;
+	struct gossmap_node *src[NUM_PAYMENTS], *dst[NUM_PAYMENTS];
+	/* What each channel direction can really send (chan idx * 2 + dir) */
+	struct amount_msat *hidden;
+	/* For the current payment: what's left, and what we've learned */
+	struct amount_msat *liquidity, *known_max;
+	size_t attempts, succeeded;
+	/* Attempts for the current payment */
+	size_t payment_attempts;
+};
+
+static size_t half_idx(const struct gossmap *map,
+		       const struct gossmap_chan *c, int dir)
+{
+	return gossmap_chan_idx(map, c) * 2 + dir;
+}
+
+static struct amount_msat sim_capacity(const struct gossmap *map,
+				       const struct gossmap_chan *c,
+				       int dir,
+				       struct sim *sim)
+{
+	struct amount_sat cap;
+	struct amount_msat capmsat;
+
+	if (!gossmap_chan_set(c, dir) || !c->half[dir].enabled)
+		return AMOUNT_MSAT(0);
+	if (!gossmap_chan_get_capacity(map, c, &cap)
+	    || !amount_sat_to_msat(&capmsat, cap))
+		return AMOUNT_MSAT(0);
+	if (amount_msat_less(sim->known_max[half_idx(map, c, dir)], capmsat))
+		capmsat = sim->known_max[half_idx(map, c, dir)];
+	return capmsat;
+}
+
+static bool sim_can_carry(const struct gossmap *map,
+			  const struct gossmap_chan *c,
+			  int dir,
+			  struct amount_msat amount,
+			  struct sim *sim)
+{
+	if (!route_can_carry(map, c, dir, amount, NULL))
+		return false;
+	return amount_msat_less(amount, sim_capacity(map, c, dir, sim));
+}
+
+/* Does this route work?  Learn from it either way, like the pay plugin
+ * does with channel_hints. */
+static bool sim_attempt(struct sim *sim, const struct route_hop *route)
+{
+	sim->attempts++;
+	sim->payment_attempts++;
+	for (size_t i = 0; i < tal_count(route); i++) {
+		const struct gossmap_chan *c;
+		size_t idx;
+
+		c = gossmap_find_chan(sim->map, &route[i].scid);
+		idx = half_idx(sim->map, c, route[i].direction);
+		if (amount_msat_less(sim->liquidity[idx], route[i].amount)) {
+			if (amount_msat_less(route[i].amount,
+					     sim->known_max[idx]))
+				sim->known_max[idx] = route[i].amount;
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < tal_count(route); i++) {
+		const struct gossmap_chan *c;
+		size_t idx;
+
+		c = gossmap_find_chan(sim->map, &route[i].scid);
+		idx = half_idx(sim->map, c, route[i].direction);
+		if (!amount_msat_sub(&sim->liquidity[idx], sim->liquidity[idx],
+				     route[i].amount))
+			abort();
+		if (!amount_msat_sub(&sim->known_max[idx], sim->known_max[idx],
+				     route[i].amount))
+			sim->known_max[idx] = AMOUNT_MSAT(0);
+	}
+	return true;
+}
+
+static void sim_start(struct sim *sim)
+{
+	size_t n = tal_count(sim->hidden);
+
+	sim->payment_attempts = 0;
+	memcpy(sim->liquidity, sim->hidden, n * sizeof(*sim->liquidity));
+	for (size_t i = 0; i < n; i++)
+		sim->known_max[i] = AMOUNT_MSAT(UINT64_MAX);
+}
+
+struct part {
+	struct amount_msat amount;
+	int retries;
+};
+
+static void add_part(struct part **parts, struct amount_msat amount,
+		     int retries)
+{
+	struct part part = { amount, retries };
+	tal_arr_expand(parts, part);
+}
+
+/* Halve it, or give up if it's too small. */
+static bool split_part(struct part **parts, struct amount_msat amount)
+{
+	struct amount_msat half = amount_msat_div(amount, 2), rest;
+
+	if (!amount_msat_greater(amount, MPP_ADAPTIVE_LOWER_LIMIT))
+		return false;
+	if (!amount_msat_sub(&rest, amount, half))
+		abort();
+	add_part(parts, half, RETRIES);
+	add_part(parts, rest, RETRIES);
+	return true;
+}
+
+static bool pay_heuristic(struct sim *sim, size_t n)
+{
+	struct part *parts = tal_arr(tmpctx, struct part, 0);
+	struct amount_msat amount = PAYMENT_AMOUNT, target;
+	u64 target_amount = MPP_TARGET_SIZE;
+
+	sim_start(sim);
+
+	/* Like presplit, but without the fuzz */
+	while (amount_msat_less(amount_msat(target_amount * PRESPLIT_MAX_SPLITS),
+				amount))
+		target_amount *= PRESPLIT_MAX_SPLITS;
+	target = amount_msat(target_amount);
+	while (amount_msat_greater(amount, target)) {
+		add_part(&parts, target, RETRIES);
+		if (!amount_msat_sub(&amount, amount, target))
+			abort();
+	}
+	add_part(&parts, amount, RETRIES);
+
+	while (tal_count(parts)) {
+		struct part part = parts[tal_count(parts) - 1];
+		const struct dijkstra *dij;
+		struct route_hop *route;
+
+		tal_resize(&parts, tal_count(parts) - 1);
+		if (sim->payment_attempts >= MAX_ATTEMPTS)
+			return false;
+
+		dij = dijkstra(tmpctx, sim->map, sim->dst[n], part.amount, 10,
+			       sim_can_carry, route_score_cheaper, sim);
+		route = route_from_dijkstra(tmpctx, sim->map, dij, sim->src[n],
+					    part.amount, 9);
+		if (!route) {
+			if (!split_part(&parts, part.amount))
+				return false;
+			continue;
+		}
+
+		if (sim_attempt(sim, route))
+			continue;
+
+		/* Like retry, then adaptive_splitter. */
+		if (part.retries > 0)
+			add_part(&parts, part.amount, part.retries - 1);
+		else if (!split_part(&parts, part.amount))
+			return false;
+	}
+	return true;
+}
+
+static bool pay_mcf(struct sim *sim, size_t n)
+{
+	struct amount_msat *todo = tal_arr(tmpctx, struct amount_msat, 0);
+	u64 mu = PAYMENT_AMOUNT.millisatoshis / 200 /* Raw: 0.5% fee budget */
+		/ MCF_FEE_BUDGET_PER_BIT;
+
+	sim_start(sim);
+	tal_arr_expand(&todo, PAYMENT_AMOUNT);
+
+	while (tal_count(todo)) {
+		struct amount_msat amount = todo[tal_count(todo) - 1];
+		struct mcf_path *paths;
+
+		tal_resize(&todo, tal_count(todo) - 1);
+		paths = min_cost_flow(tmpctx, sim->map, sim->src[n],
+				      sim->dst[n], amount, mu, MCF_MAX_PARTS,
+				      sim_capacity, sim);
+		if (!paths)
+			return false;
+
+		for (size_t i = 0; i < tal_count(paths); i++) {
+			struct route_hop *route;
+
+			if (sim->payment_attempts >= MAX_ATTEMPTS)
+				return false;
+			route = route_from_chans(tmpctx, sim->map,
+						 paths[i].chans, paths[i].dirs,
+						 paths[i].amount, 9);
+			if (!route)
+				errx(1, "Bad path?");
+			if (!sim_attempt(sim, route))
+				tal_arr_expand(&todo, paths[i].amount);
+		}
+	}
+	return true;
+}
+
+static void simulate(struct sim *sim, bool (*pay)(struct sim *, size_t))
+{
+	sim->attempts = sim->succeeded = 0;
+	for (size_t i = 0; i < NUM_PAYMENTS; i++)
+		sim->succeeded += pay(sim, i);
+}
+
+static void sim_heuristic(struct sim *sim)
+{
+	simulate(sim, pay_heuristic);
+}
+
+static void sim_mcf(struct sim *sim)
+{
+	simulate(sim, pay_mcf);
+}
+
+static void report(const char *name, struct sim *sim)
+{
+	bench_report(name, "attempts", sim->attempts);
+	bench_report(name, "succeeded", sim->succeeded);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sim sim;
+	struct gossmap_node **nodes;
+	const char *fname;
+	size_t num_halves;
+
+	bench_init(&argc, &argv);
+
+	fname = bench_gossip_store(NULL, NUM_NODES, NUM_CHANS);
+	sim.map = gossmap_load(NULL, fname, NULL);
+	if (!sim.map)
+		err(1, "Loading %s", fname);
+
+	/* Liquidity is somewhere in each channel: one side has the rest. */
+	num_halves = gossmap_max_chan_idx(sim.map) * 2;
+	sim.hidden = tal_arrz(sim.map, struct amount_msat, num_halves);
+	sim.liquidity = tal_arr(sim.map, struct amount_msat, num_halves);
+	sim.known_max = tal_arr(sim.map, struct amount_msat, num_halves);
+	for (struct gossmap_chan *c = gossmap_first_chan(sim.map);
+	     c;
+	     c = gossmap_next_chan(sim.map, c)) {
+		struct amount_sat cap;
+		u64 msat, side;
+
+		if (!gossmap_chan_get_capacity(sim.map, c, &cap))
+			abort();
+		msat = cap.satoshis * 1000; /* Raw: simulation */
+		side = bench_rand() % (msat + 1);
+		sim.hidden[half_idx(sim.map, c, 0)] = amount_msat(side);
+		sim.hidden[half_idx(sim.map, c, 1)] = amount_msat(msat - side);
+	}
+
+	nodes = tal_arr(sim.map, struct gossmap_node *, 0);
+	for (struct gossmap_node *n = gossmap_first_node(sim.map);
+	     n;
+	     n = gossmap_next_node(sim.map, n))
+		tal_arr_expand(&nodes, n);
+
+	for (size_t i = 0; i < NUM_PAYMENTS; i++) {
+		do {
+			sim.src[i] = nodes[bench_rand() % tal_count(nodes)];
+			sim.dst[i] = nodes[bench_rand() % tal_count(nodes)];
+		} while (sim.src[i] == sim.dst[i]);
+	}
+
+	bench_run("mpp_sim_heuristic", sim_heuristic, &sim);
+	sim_heuristic(&sim);
+	report("mpp_sim_heuristic", &sim);
+
+	bench_run("mpp_sim_mcf", sim_mcf, &sim);
+	sim_mcf(&sim);
+	report("mpp_sim_mcf", &sim);
+
+	unlink(fname);
+	tal_free(sim.map);
+	tal_free(fname);
+	bench_shutdown();
+}
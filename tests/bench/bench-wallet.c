@@ -0,0 +1,1099 @@
+#include "config.h"
+#include <ccan/err/err.h>
+#include <db/common.h>
+#include <lightningd/log.h>
+
+static void db_log_(struct log *log UNUSED, enum log_level level UNUSED, const struct node_id *node_id UNUSED, bool call_notifier UNUSED, const char *fmt UNUSED, ...)
+{
+}
+#define log_ db_log_
+
+#define DB_FATAL
+void db_fatal(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	verrx(1, fmt, ap);
+	va_end(ap);
+}
+
+#include "wallet/wallet.c"
+#include "lightningd/htlc_end.c"
+#include "lightningd/peer_control.c"
+#include "lightningd/peer_htlcs.c"
+#include "lightningd/channel.c"
+
+#include "db/bindings.c"
+#include "db/db_sqlite3.c"
+#include "db/exec.c"
+#include "db/utils.c"
+#include "wallet/db.c"
+
+#include <common/setup.h>
+#include <common/utils.h>
+#include <stdio.h>
+#include <tests/bench/libbench.h>
+
+/* The same mocks as wallet/test/run-wallet.c, less those tests/bench links
+ * in anyway. */
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bitcoind_getutxout_ */
+void bitcoind_getutxout_(struct bitcoind *bitcoind UNNEEDED,
+			 const struct bitcoin_outpoint *outpoint UNNEEDED,
+			 void (*cb)(struct bitcoind *bitcoind UNNEEDED,
+				    const struct bitcoin_tx_output *txout UNNEEDED,
+				    void *arg) UNNEEDED,
+			 void *arg UNNEEDED)
+{ fprintf(stderr, "bitcoind_getutxout_ called!\n"); abort(); }
+/* Generated stub for blinding_hash_e_and_ss */
+void blinding_hash_e_and_ss(const struct pubkey *e UNNEEDED,
+			    const struct secret *ss UNNEEDED,
+			    struct sha256 *sha UNNEEDED)
+{ fprintf(stderr, "blinding_hash_e_and_ss called!\n"); abort(); }
+/* Generated stub for blinding_next_pubkey */
+bool blinding_next_pubkey(const struct pubkey *pk UNNEEDED,
+			  const struct sha256 *h UNNEEDED,
+			  struct pubkey *next UNNEEDED)
+{ fprintf(stderr, "blinding_next_pubkey called!\n"); abort(); }
+/* Generated stub for broadcast_tx */
+void broadcast_tx(struct chain_topology *topo UNNEEDED,
+		  struct channel *channel UNNEEDED, const struct bitcoin_tx *tx UNNEEDED,
+		  void (*failed)(struct channel *channel UNNEEDED,
+				 bool success UNNEEDED,
+				 const char *err))
+{ fprintf(stderr, "broadcast_tx called!\n"); abort(); }
+/* Generated stub for channel_tell_depth */
+bool channel_tell_depth(struct lightningd *ld UNNEEDED,
+				 struct channel *channel UNNEEDED,
+				 const struct bitcoin_txid *txid UNNEEDED,
+				 u32 depth UNNEEDED)
+{ fprintf(stderr, "channel_tell_depth called!\n"); abort(); }
+/* Generated stub for channel_unsaved_close_conn */
+void channel_unsaved_close_conn(struct channel *channel UNNEEDED, const char *why UNNEEDED)
+{ fprintf(stderr, "channel_unsaved_close_conn called!\n"); abort(); }
+/* Generated stub for channel_update_reserve */
+void channel_update_reserve(struct channel *channel UNNEEDED,
+			    struct channel_config *their_config UNNEEDED,
+			    struct amount_sat funding_total UNNEEDED)
+{ fprintf(stderr, "channel_update_reserve called!\n"); abort(); }
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, errcode_t code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_still_pending */
+struct command_result *command_still_pending(struct command *cmd)
+
+{ fprintf(stderr, "command_still_pending called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for connect_failed_disconnect */
+void connect_failed_disconnect(struct lightningd *ld UNNEEDED,
+			       const struct node_id *id UNNEEDED,
+			       const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "connect_failed_disconnect called!\n"); abort(); }
+/* Generated stub for connect_succeeded */
+void connect_succeeded(struct lightningd *ld UNNEEDED, const struct peer *peer UNNEEDED,
+		       bool incoming UNNEEDED,
+		       const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "connect_succeeded called!\n"); abort(); }
+/* Generated stub for create_onionreply */
+struct onionreply *create_onionreply(const tal_t *ctx UNNEEDED,
+				     const struct secret *shared_secret UNNEEDED,
+				     const u8 *failure_msg UNNEEDED)
+{ fprintf(stderr, "create_onionreply called!\n"); abort(); }
+/* Generated stub for deprecated_apis */
+bool deprecated_apis;
+/* Generated stub for ecdh */
+void ecdh(const struct pubkey *point UNNEEDED, struct secret *ss UNNEEDED)
+{ fprintf(stderr, "ecdh called!\n"); abort(); }
+/* Generated stub for encode_scriptpubkey_to_addr */
+char *encode_scriptpubkey_to_addr(const tal_t *ctx UNNEEDED,
+				  const struct chainparams *chainparams UNNEEDED,
+				  const u8 *scriptPubkey UNNEEDED)
+{ fprintf(stderr, "encode_scriptpubkey_to_addr called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for fromwire_channeld_dev_memleak_reply */
+bool fromwire_channeld_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_channeld_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for fromwire_channeld_got_commitsig */
+bool fromwire_channeld_got_commitsig(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u64 *commitnum UNNEEDED, struct fee_states **fee_states UNNEEDED, struct height_states **blockheight_states UNNEEDED, struct bitcoin_signature *signature UNNEEDED, struct bitcoin_signature **htlc_signature UNNEEDED, struct added_htlc **added UNNEEDED, struct fulfilled_htlc **fulfilled UNNEEDED, struct failed_htlc ***failed UNNEEDED, struct changed_htlc **changed UNNEEDED, struct bitcoin_tx **tx UNNEEDED)
+{ fprintf(stderr, "fromwire_channeld_got_commitsig called!\n"); abort(); }
+/* Generated stub for fromwire_channeld_got_revoke */
+bool fromwire_channeld_got_revoke(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u64 *revokenum UNNEEDED, struct secret *per_commitment_secret UNNEEDED, struct pubkey *next_per_commit_point UNNEEDED, struct fee_states **fee_states UNNEEDED, struct height_states **blockheight_states UNNEEDED, struct changed_htlc **changed UNNEEDED, struct penalty_base **pbase UNNEEDED, struct bitcoin_tx **penalty_tx UNNEEDED)
+{ fprintf(stderr, "fromwire_channeld_got_revoke called!\n"); abort(); }
+/* Generated stub for fromwire_channeld_offer_htlc_reply */
+bool fromwire_channeld_offer_htlc_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u64 *id UNNEEDED, u8 **failuremsg UNNEEDED, wirestring **failurestr UNNEEDED)
+{ fprintf(stderr, "fromwire_channeld_offer_htlc_reply called!\n"); abort(); }
+/* Generated stub for fromwire_channeld_sending_commitsig */
+bool fromwire_channeld_sending_commitsig(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u64 *commitnum UNNEEDED, struct penalty_base **pbase UNNEEDED, struct fee_states **fee_states UNNEEDED, struct height_states **blockheight_states UNNEEDED, struct changed_htlc **changed UNNEEDED, struct bitcoin_signature *commit_sig UNNEEDED, struct bitcoin_signature **htlc_sigs UNNEEDED)
+{ fprintf(stderr, "fromwire_channeld_sending_commitsig called!\n"); abort(); }
+/* Generated stub for fromwire_connectd_peer_connected */
+bool fromwire_connectd_peer_connected(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, u64 *counter UNNEEDED, struct wireaddr_internal *addr UNNEEDED, struct wireaddr **remote_addr UNNEEDED, bool *incoming UNNEEDED, u8 **features UNNEEDED)
+{ fprintf(stderr, "fromwire_connectd_peer_connected called!\n"); abort(); }
+/* Generated stub for fromwire_connectd_peer_disconnect_done */
+bool fromwire_connectd_peer_disconnect_done(const void *p UNNEEDED, struct node_id *id UNNEEDED, u64 *counter UNNEEDED)
+{ fprintf(stderr, "fromwire_connectd_peer_disconnect_done called!\n"); abort(); }
+/* Generated stub for fromwire_connectd_peer_spoke */
+bool fromwire_connectd_peer_spoke(const void *p UNNEEDED, struct node_id *id UNNEEDED, u64 *counter UNNEEDED, u16 *msgtype UNNEEDED, struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_connectd_peer_spoke called!\n"); abort(); }
+/* Generated stub for fromwire_dualopend_dev_memleak_reply */
+bool fromwire_dualopend_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_dualopend_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_get_output_scriptpubkey_reply */
+bool fromwire_hsmd_get_output_scriptpubkey_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **script UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_get_output_scriptpubkey_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_new_channel_reply */
+bool fromwire_hsmd_new_channel_reply(const void *p UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_new_channel_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_sign_commitment_tx_reply */
+bool fromwire_hsmd_sign_commitment_tx_reply(const void *p UNNEEDED, struct bitcoin_signature *sig UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_sign_commitment_tx_reply called!\n"); abort(); }
+/* Generated stub for fromwire_onchaind_dev_memleak_reply */
+bool fromwire_onchaind_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_onchaind_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for fromwire_openingd_dev_memleak_reply */
+bool fromwire_openingd_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_openingd_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for get_block_height */
+u32 get_block_height(const struct chain_topology *topo UNNEEDED)
+{ fprintf(stderr, "get_block_height called!\n"); abort(); }
+/* Generated stub for get_channel_update */
+const u8 *get_channel_update(struct channel *channel UNNEEDED)
+{ fprintf(stderr, "get_channel_update called!\n"); abort(); }
+/* Generated stub for htlc_is_trimmed */
+bool htlc_is_trimmed(enum side htlc_owner UNNEEDED,
+		     struct amount_msat htlc_amount UNNEEDED,
+		     u32 feerate_per_kw UNNEEDED,
+		     struct amount_sat dust_limit UNNEEDED,
+		     enum side side UNNEEDED,
+		     bool option_anchor_outputs UNNEEDED)
+{ fprintf(stderr, "htlc_is_trimmed called!\n"); abort(); }
+/* Generated stub for htlc_set_add */
+void htlc_set_add(struct lightningd *ld UNNEEDED,
+		  struct htlc_in *hin UNNEEDED,
+		  struct amount_msat total_msat UNNEEDED,
+		  const struct secret *payment_secret UNNEEDED)
+{ fprintf(stderr, "htlc_set_add called!\n"); abort(); }
+/* Generated stub for invoices_create */
+bool invoices_create(struct invoices *invoices UNNEEDED,
+		     struct invoice *pinvoice UNNEEDED,
+		     const struct amount_msat *msat TAKES UNNEEDED,
+		     const struct json_escape *label TAKES UNNEEDED,
+		     u64 expiry UNNEEDED,
+		     const char *b11enc UNNEEDED,
+		     const char *description UNNEEDED,
+		     const u8 *features UNNEEDED,
+		     const struct preimage *r UNNEEDED,
+		     const struct sha256 *rhash UNNEEDED,
+		     const struct sha256 *local_offer_id UNNEEDED)
+{ fprintf(stderr, "invoices_create called!\n"); abort(); }
+/* Generated stub for invoices_delete */
+bool invoices_delete(struct invoices *invoices UNNEEDED,
+		     struct invoice invoice UNNEEDED)
+{ fprintf(stderr, "invoices_delete called!\n"); abort(); }
+/* Generated stub for invoices_delete_description */
+bool invoices_delete_description(struct invoices *invoices UNNEEDED,
+				 struct invoice invoice UNNEEDED)
+{ fprintf(stderr, "invoices_delete_description called!\n"); abort(); }
+/* Generated stub for invoices_delete_expired */
+void invoices_delete_expired(struct invoices *invoices UNNEEDED,
+			     u64 max_expiry_time UNNEEDED)
+{ fprintf(stderr, "invoices_delete_expired called!\n"); abort(); }
+/* Generated stub for invoices_delete_expired_limit */
+size_t invoices_delete_expired_limit(struct invoices *invoices UNNEEDED,
+				     u64 max_expiry_time UNNEEDED, u32 limit UNNEEDED)
+{ fprintf(stderr, "invoices_delete_expired_limit called!\n"); abort(); }
+/* Generated stub for invoices_find_by_label */
+bool invoices_find_by_label(struct invoices *invoices UNNEEDED,
+			    struct invoice *pinvoice UNNEEDED,
+			    const struct json_escape *label UNNEEDED)
+{ fprintf(stderr, "invoices_find_by_label called!\n"); abort(); }
+/* Generated stub for invoices_find_by_rhash */
+bool invoices_find_by_rhash(struct invoices *invoices UNNEEDED,
+			    struct invoice *pinvoice UNNEEDED,
+			    const struct sha256 *rhash UNNEEDED)
+{ fprintf(stderr, "invoices_find_by_rhash called!\n"); abort(); }
+/* Generated stub for invoices_find_unpaid */
+bool invoices_find_unpaid(struct invoices *invoices UNNEEDED,
+			  struct invoice *pinvoice UNNEEDED,
+			  const struct sha256 *rhash UNNEEDED)
+{ fprintf(stderr, "invoices_find_unpaid called!\n"); abort(); }
+/* Generated stub for invoices_get_details */
+struct invoice_details *invoices_get_details(const tal_t *ctx UNNEEDED,
+					     struct invoices *invoices UNNEEDED,
+					     struct invoice invoice UNNEEDED)
+{ fprintf(stderr, "invoices_get_details called!\n"); abort(); }
+/* Generated stub for invoices_iterate */
+bool invoices_iterate(struct invoices *invoices UNNEEDED,
+		      struct invoice_iterator *it UNNEEDED)
+{ fprintf(stderr, "invoices_iterate called!\n"); abort(); }
+/* Generated stub for invoices_iterator_deref */
+const struct invoice_details *invoices_iterator_deref(
+	const tal_t *ctx UNNEEDED, struct invoices *invoices UNNEEDED,
+	const struct invoice_iterator *it UNNEEDED)
+{ fprintf(stderr, "invoices_iterator_deref called!\n"); abort(); }
+/* Generated stub for invoices_new */
+struct invoices *invoices_new(const tal_t *ctx UNNEEDED,
+			      struct db *db UNNEEDED,
+			      struct timers *timers UNNEEDED)
+{ fprintf(stderr, "invoices_new called!\n"); abort(); }
+/* Generated stub for invoices_resolve */
+bool invoices_resolve(struct invoices *invoices UNNEEDED,
+		      struct invoice invoice UNNEEDED,
+		      struct amount_msat received UNNEEDED)
+{ fprintf(stderr, "invoices_resolve called!\n"); abort(); }
+/* Generated stub for invoices_waitany */
+void invoices_waitany(const tal_t *ctx UNNEEDED,
+		      struct invoices *invoices UNNEEDED,
+		      u64 lastpay_index UNNEEDED,
+		      void (*cb)(const struct invoice * UNNEEDED, void*) UNNEEDED,
+		      void *cbarg UNNEEDED)
+{ fprintf(stderr, "invoices_waitany called!\n"); abort(); }
+/* Generated stub for invoices_waitone */
+void invoices_waitone(const tal_t *ctx UNNEEDED,
+		      struct invoices *invoices UNNEEDED,
+		      struct invoice invoice UNNEEDED,
+		      void (*cb)(const struct invoice * UNNEEDED, void*) UNNEEDED,
+		      void *cbarg UNNEEDED)
+{ fprintf(stderr, "invoices_waitone called!\n"); abort(); }
+/* Generated stub for json_add_address */
+void json_add_address(struct json_stream *response UNNEEDED, const char *fieldname UNNEEDED,
+		      const struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "json_add_address called!\n"); abort(); }
+/* Generated stub for json_add_address_internal */
+void json_add_address_internal(struct json_stream *response UNNEEDED,
+			       const char *fieldname UNNEEDED,
+			       const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "json_add_address_internal called!\n"); abort(); }
+/* Generated stub for json_add_amount_msat_compat */
+void json_add_amount_msat_compat(struct json_stream *result UNNEEDED,
+				 struct amount_msat msat UNNEEDED,
+				 const char *rawfieldname UNNEEDED,
+				 const char *msatfieldname)
+
+{ fprintf(stderr, "json_add_amount_msat_compat called!\n"); abort(); }
+/* Generated stub for json_add_amount_msat_only */
+void json_add_amount_msat_only(struct json_stream *result UNNEEDED,
+			  const char *msatfieldname UNNEEDED,
+			  struct amount_msat msat)
+
+{ fprintf(stderr, "json_add_amount_msat_only called!\n"); abort(); }
+/* Generated stub for json_add_amount_sat_compat */
+void json_add_amount_sat_compat(struct json_stream *result UNNEEDED,
+				struct amount_sat sat UNNEEDED,
+				const char *rawfieldname UNNEEDED,
+				const char *msatfieldname)
+
+{ fprintf(stderr, "json_add_amount_sat_compat called!\n"); abort(); }
+/* Generated stub for json_add_amount_sat_msat */
+void json_add_amount_sat_msat(struct json_stream *result UNNEEDED,
+			      const char *msatfieldname UNNEEDED,
+			      struct amount_sat sat)
+
+{ fprintf(stderr, "json_add_amount_sat_msat called!\n"); abort(); }
+/* Generated stub for json_add_bool */
+void json_add_bool(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   bool value UNNEEDED)
+{ fprintf(stderr, "json_add_bool called!\n"); abort(); }
+/* Generated stub for json_add_channel_id */
+void json_add_channel_id(struct json_stream *response UNNEEDED,
+			 const char *fieldname UNNEEDED,
+			 const struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "json_add_channel_id called!\n"); abort(); }
+/* Generated stub for json_add_hex_talarr */
+void json_add_hex_talarr(struct json_stream *result UNNEEDED,
+			 const char *fieldname UNNEEDED,
+			 const tal_t *data UNNEEDED)
+{ fprintf(stderr, "json_add_hex_talarr called!\n"); abort(); }
+/* Generated stub for json_add_log */
+void json_add_log(struct json_stream *result UNNEEDED,
+		  const struct log_book *lr UNNEEDED,
+		  const struct node_id *node_id UNNEEDED,
+		  enum log_level minlevel UNNEEDED)
+{ fprintf(stderr, "json_add_log called!\n"); abort(); }
+/* Generated stub for json_add_node_id */
+void json_add_node_id(struct json_stream *response UNNEEDED,
+				const char *fieldname UNNEEDED,
+				const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "json_add_node_id called!\n"); abort(); }
+/* Generated stub for json_add_num */
+void json_add_num(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  unsigned int value UNNEEDED)
+{ fprintf(stderr, "json_add_num called!\n"); abort(); }
+/* Generated stub for json_add_s32 */
+void json_add_s32(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  int32_t value UNNEEDED)
+{ fprintf(stderr, "json_add_s32 called!\n"); abort(); }
+/* Generated stub for json_add_secret */
+void json_add_secret(struct json_stream *response UNNEEDED,
+		     const char *fieldname UNNEEDED,
+		     const struct secret *secret UNNEEDED)
+{ fprintf(stderr, "json_add_secret called!\n"); abort(); }
+/* Generated stub for json_add_sha256 */
+void json_add_sha256(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		     const struct sha256 *hash UNNEEDED)
+{ fprintf(stderr, "json_add_sha256 called!\n"); abort(); }
+/* Generated stub for json_add_short_channel_id */
+void json_add_short_channel_id(struct json_stream *response UNNEEDED,
+			       const char *fieldname UNNEEDED,
+			       const struct short_channel_id *id UNNEEDED)
+{ fprintf(stderr, "json_add_short_channel_id called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *js UNNEEDED,
+		     const char *fieldname UNNEEDED,
+		     const char *str TAKES UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_add_timeabs */
+void json_add_timeabs(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		      struct timeabs t UNNEEDED)
+{ fprintf(stderr, "json_add_timeabs called!\n"); abort(); }
+/* Generated stub for json_add_timeiso */
+void json_add_timeiso(struct json_stream *result UNNEEDED,
+		      const char *fieldname UNNEEDED,
+		      struct timeabs *time UNNEEDED)
+{ fprintf(stderr, "json_add_timeiso called!\n"); abort(); }
+/* Generated stub for json_add_tx */
+void json_add_tx(struct json_stream *result UNNEEDED,
+		 const char *fieldname UNNEEDED,
+		 const struct bitcoin_tx *tx UNNEEDED)
+{ fprintf(stderr, "json_add_tx called!\n"); abort(); }
+/* Generated stub for json_add_txid */
+void json_add_txid(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   const struct bitcoin_txid *txid UNNEEDED)
+{ fprintf(stderr, "json_add_txid called!\n"); abort(); }
+/* Generated stub for json_add_u32 */
+void json_add_u32(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  uint32_t value UNNEEDED)
+{ fprintf(stderr, "json_add_u32 called!\n"); abort(); }
+/* Generated stub for json_add_u64 */
+void json_add_u64(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  uint64_t value UNNEEDED)
+{ fprintf(stderr, "json_add_u64 called!\n"); abort(); }
+/* Generated stub for json_add_uncommitted_channel */
+void json_add_uncommitted_channel(struct json_stream *response UNNEEDED,
+				  const struct uncommitted_channel *uc UNNEEDED)
+{ fprintf(stderr, "json_add_uncommitted_channel called!\n"); abort(); }
+/* Generated stub for json_add_unsaved_channel */
+void json_add_unsaved_channel(struct json_stream *response UNNEEDED,
+			      const struct channel *channel UNNEEDED)
+{ fprintf(stderr, "json_add_unsaved_channel called!\n"); abort(); }
+/* Generated stub for json_array_end */
+void json_array_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_array_end called!\n"); abort(); }
+/* Generated stub for json_array_start */
+void json_array_start(struct json_stream *js UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_array_start called!\n"); abort(); }
+/* Generated stub for json_get_member */
+const jsmntok_t *json_get_member(const char *buffer UNNEEDED, const jsmntok_t tok[] UNNEEDED,
+				 const char *label UNNEEDED)
+{ fprintf(stderr, "json_get_member called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_strdup */
+char *json_strdup(const tal_t *ctx UNNEEDED, const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED)
+{ fprintf(stderr, "json_strdup called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for json_to_node_id */
+bool json_to_node_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			       struct node_id *id UNNEEDED)
+{ fprintf(stderr, "json_to_node_id called!\n"); abort(); }
+/* Generated stub for json_to_number */
+bool json_to_number(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+		    unsigned int *num UNNEEDED)
+{ fprintf(stderr, "json_to_number called!\n"); abort(); }
+/* Generated stub for json_to_preimage */
+bool json_to_preimage(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED, struct preimage *preimage UNNEEDED)
+{ fprintf(stderr, "json_to_preimage called!\n"); abort(); }
+/* Generated stub for json_to_short_channel_id */
+bool json_to_short_channel_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			      struct short_channel_id *scid UNNEEDED)
+{ fprintf(stderr, "json_to_short_channel_id called!\n"); abort(); }
+/* Generated stub for json_tok_bin_from_hex */
+u8 *json_tok_bin_from_hex(const tal_t *ctx UNNEEDED, const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED)
+{ fprintf(stderr, "json_tok_bin_from_hex called!\n"); abort(); }
+/* Generated stub for json_tok_channel_id */
+bool json_tok_channel_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			 struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "json_tok_channel_id called!\n"); abort(); }
+/* Generated stub for json_tok_full */
+const char *json_tok_full(const char *buffer UNNEEDED, const jsmntok_t *t UNNEEDED)
+{ fprintf(stderr, "json_tok_full called!\n"); abort(); }
+/* Generated stub for json_tok_full_len */
+int json_tok_full_len(const jsmntok_t *t UNNEEDED)
+{ fprintf(stderr, "json_tok_full_len called!\n"); abort(); }
+/* Generated stub for json_tok_streq */
+bool json_tok_streq(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED, const char *str UNNEEDED)
+{ fprintf(stderr, "json_tok_streq called!\n"); abort(); }
+/* Generated stub for kill_uncommitted_channel */
+void kill_uncommitted_channel(struct uncommitted_channel *uc UNNEEDED,
+			      const char *why UNNEEDED)
+{ fprintf(stderr, "kill_uncommitted_channel called!\n"); abort(); }
+/* Generated stub for new_channel_mvt_invoice_hin */
+struct channel_coin_mvt *new_channel_mvt_invoice_hin(const tal_t *ctx UNNEEDED,
+						     struct htlc_in *hin UNNEEDED,
+						     struct channel *channel UNNEEDED)
+{ fprintf(stderr, "new_channel_mvt_invoice_hin called!\n"); abort(); }
+/* Generated stub for new_channel_mvt_invoice_hout */
+struct channel_coin_mvt *new_channel_mvt_invoice_hout(const tal_t *ctx UNNEEDED,
+						      struct htlc_out *hout UNNEEDED,
+						      struct channel *channel UNNEEDED)
+{ fprintf(stderr, "new_channel_mvt_invoice_hout called!\n"); abort(); }
+/* Generated stub for new_channel_mvt_routed_hin */
+struct channel_coin_mvt *new_channel_mvt_routed_hin(const tal_t *ctx UNNEEDED,
+						    struct htlc_in *hin UNNEEDED,
+						    struct channel *channel UNNEEDED)
+{ fprintf(stderr, "new_channel_mvt_routed_hin called!\n"); abort(); }
+/* Generated stub for new_channel_mvt_routed_hout */
+struct channel_coin_mvt *new_channel_mvt_routed_hout(const tal_t *ctx UNNEEDED,
+						     struct htlc_out *hout UNNEEDED,
+						     struct channel *channel UNNEEDED)
+{ fprintf(stderr, "new_channel_mvt_routed_hout called!\n"); abort(); }
+/* Generated stub for new_coin_wallet_deposit */
+struct chain_coin_mvt *new_coin_wallet_deposit(const tal_t *ctx UNNEEDED,
+					       const struct bitcoin_outpoint *outpoint UNNEEDED,
+					       u32 blockheight UNNEEDED,
+					       struct amount_sat amount UNNEEDED,
+					       enum mvt_tag tag)
+
+{ fprintf(stderr, "new_coin_wallet_deposit called!\n"); abort(); }
+/* Generated stub for new_peer_fd */
+struct peer_fd *new_peer_fd(const tal_t *ctx UNNEEDED, int peer_fd UNNEEDED)
+{ fprintf(stderr, "new_peer_fd called!\n"); abort(); }
+/* Generated stub for new_uncommitted_channel */
+struct uncommitted_channel *new_uncommitted_channel(struct peer *peer UNNEEDED)
+{ fprintf(stderr, "new_uncommitted_channel called!\n"); abort(); }
+/* Generated stub for notify_chain_mvt */
+void notify_chain_mvt(struct lightningd *ld UNNEEDED, const struct chain_coin_mvt *mvt UNNEEDED)
+{ fprintf(stderr, "notify_chain_mvt called!\n"); abort(); }
+/* Generated stub for notify_channel_mvt */
+void notify_channel_mvt(struct lightningd *ld UNNEEDED, const struct channel_coin_mvt *mvt UNNEEDED)
+{ fprintf(stderr, "notify_channel_mvt called!\n"); abort(); }
+/* Generated stub for notify_channel_open_failed */
+void notify_channel_open_failed(struct lightningd *ld UNNEEDED,
+                                const struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "notify_channel_open_failed called!\n"); abort(); }
+/* Generated stub for notify_channel_state_changed */
+void notify_channel_state_changed(struct lightningd *ld UNNEEDED,
+				  struct node_id *peer_id UNNEEDED,
+				  struct channel_id *cid UNNEEDED,
+				  struct short_channel_id *scid UNNEEDED,
+				  struct timeabs *timestamp UNNEEDED,
+				  enum channel_state old_state UNNEEDED,
+				  enum channel_state new_state UNNEEDED,
+				  enum state_change cause UNNEEDED,
+				  char *message UNNEEDED)
+{ fprintf(stderr, "notify_channel_state_changed called!\n"); abort(); }
+/* Generated stub for notify_connect */
+void notify_connect(struct lightningd *ld UNNEEDED,
+		    const struct node_id *nodeid UNNEEDED,
+		    bool incoming UNNEEDED,
+		    const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "notify_connect called!\n"); abort(); }
+/* Generated stub for notify_disconnect */
+void notify_disconnect(struct lightningd *ld UNNEEDED, struct node_id *nodeid UNNEEDED)
+{ fprintf(stderr, "notify_disconnect called!\n"); abort(); }
+/* Generated stub for notify_forward_event */
+void notify_forward_event(struct lightningd *ld UNNEEDED,
+			  const struct htlc_in *in UNNEEDED,
+			  /* May be NULL if we don't know. */
+			  const struct short_channel_id *scid_out UNNEEDED,
+			  /* May be NULL. */
+			  const struct amount_msat *amount_out UNNEEDED,
+			  enum forward_status state UNNEEDED,
+			  enum onion_wire failcode UNNEEDED,
+			  struct timeabs *resolved_time UNNEEDED,
+			  enum forward_style forward_style UNNEEDED)
+{ fprintf(stderr, "notify_forward_event called!\n"); abort(); }
+/* Generated stub for onchaind_funding_spent */
+enum watch_result onchaind_funding_spent(struct channel *channel UNNEEDED,
+					 const struct bitcoin_tx *tx UNNEEDED,
+					 u32 blockheight UNNEEDED)
+{ fprintf(stderr, "onchaind_funding_spent called!\n"); abort(); }
+/* Generated stub for onion_decode */
+struct onion_payload *onion_decode(const tal_t *ctx UNNEEDED,
+				   const struct route_step *rs UNNEEDED,
+				   const struct pubkey *blinding UNNEEDED,
+				   const struct secret *blinding_ss UNNEEDED,
+				   const u64 *accepted_extra_tlvs UNNEEDED,
+				   u64 *failtlvtype UNNEEDED,
+				   size_t *failtlvpos UNNEEDED)
+{ fprintf(stderr, "onion_decode called!\n"); abort(); }
+/* Generated stub for onion_wire_name */
+const char *onion_wire_name(int e UNNEEDED)
+{ fprintf(stderr, "onion_wire_name called!\n"); abort(); }
+/* Generated stub for outpointfilter_add */
+void outpointfilter_add(struct outpointfilter *of UNNEEDED,
+			const struct bitcoin_outpoint *outpoint UNNEEDED)
+{ fprintf(stderr, "outpointfilter_add called!\n"); abort(); }
+/* Generated stub for outpointfilter_matches */
+bool outpointfilter_matches(struct outpointfilter *of UNNEEDED,
+			    const struct bitcoin_outpoint *outpoint UNNEEDED)
+{ fprintf(stderr, "outpointfilter_matches called!\n"); abort(); }
+/* Generated stub for outpointfilter_new */
+struct outpointfilter *outpointfilter_new(tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "outpointfilter_new called!\n"); abort(); }
+/* Generated stub for outpointfilter_remove */
+void outpointfilter_remove(struct outpointfilter *of UNNEEDED,
+			   const struct bitcoin_outpoint *outpoint UNNEEDED)
+{ fprintf(stderr, "outpointfilter_remove called!\n"); abort(); }
+/* Generated stub for param */
+bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
+	   const jsmntok_t params[] UNNEEDED, ...)
+{ fprintf(stderr, "param called!\n"); abort(); }
+/* Generated stub for param_bool */
+struct command_result *param_bool(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				  const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				  bool **b UNNEEDED)
+{ fprintf(stderr, "param_bool called!\n"); abort(); }
+/* Generated stub for param_channel_id */
+struct command_result *param_channel_id(struct command *cmd UNNEEDED,
+					const char *name UNNEEDED,
+					const char *buffer UNNEEDED,
+					const jsmntok_t *tok UNNEEDED,
+					struct channel_id **cid UNNEEDED)
+{ fprintf(stderr, "param_channel_id called!\n"); abort(); }
+/* Generated stub for param_loglevel */
+struct command_result *param_loglevel(struct command *cmd UNNEEDED,
+				      const char *name UNNEEDED,
+				      const char *buffer UNNEEDED,
+				      const jsmntok_t *tok UNNEEDED,
+				      enum log_level **level UNNEEDED)
+{ fprintf(stderr, "param_loglevel called!\n"); abort(); }
+/* Generated stub for param_msat */
+struct command_result *param_msat(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				  const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				  struct amount_msat **msat UNNEEDED)
+{ fprintf(stderr, "param_msat called!\n"); abort(); }
+/* Generated stub for param_node_id */
+struct command_result *param_node_id(struct command *cmd UNNEEDED,
+				     const char *name UNNEEDED,
+				     const char *buffer UNNEEDED,
+				     const jsmntok_t *tok UNNEEDED,
+				     struct node_id **id UNNEEDED)
+{ fprintf(stderr, "param_node_id called!\n"); abort(); }
+/* Generated stub for param_number */
+struct command_result *param_number(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				    const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				    unsigned int **num UNNEEDED)
+{ fprintf(stderr, "param_number called!\n"); abort(); }
+/* Generated stub for param_short_channel_id */
+struct command_result *param_short_channel_id(struct command *cmd UNNEEDED,
+					      const char *name UNNEEDED,
+					      const char *buffer UNNEEDED,
+					      const jsmntok_t *tok UNNEEDED,
+					      struct short_channel_id **scid UNNEEDED)
+{ fprintf(stderr, "param_short_channel_id called!\n"); abort(); }
+/* Generated stub for param_string */
+struct command_result *param_string(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				    const char * buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				    const char **str UNNEEDED)
+{ fprintf(stderr, "param_string called!\n"); abort(); }
+/* Generated stub for parse_onionpacket */
+struct onionpacket *parse_onionpacket(const tal_t *ctx UNNEEDED,
+				      const u8 *src UNNEEDED,
+				      const size_t srclen UNNEEDED,
+				      enum onion_wire *failcode UNNEEDED)
+{ fprintf(stderr, "parse_onionpacket called!\n"); abort(); }
+/* Generated stub for payment_failed */
+void payment_failed(struct lightningd *ld UNNEEDED, const struct htlc_out *hout UNNEEDED,
+		    const char *localfail UNNEEDED)
+{ fprintf(stderr, "payment_failed called!\n"); abort(); }
+/* Generated stub for payment_store */
+void payment_store(struct lightningd *ld UNNEEDED, struct wallet_payment *payment UNNEEDED)
+{ fprintf(stderr, "payment_store called!\n"); abort(); }
+/* Generated stub for payment_succeeded */
+void payment_succeeded(struct lightningd *ld UNNEEDED, struct htlc_out *hout UNNEEDED,
+		       const struct preimage *rval UNNEEDED)
+{ fprintf(stderr, "payment_succeeded called!\n"); abort(); }
+/* Generated stub for peer_restart_dualopend */
+bool peer_restart_dualopend(struct peer *peer UNNEEDED,
+			    struct peer_fd *peer_fd UNNEEDED,
+			    struct channel *channel UNNEEDED)
+{ fprintf(stderr, "peer_restart_dualopend called!\n"); abort(); }
+/* Generated stub for peer_start_channeld */
+bool peer_start_channeld(struct channel *channel UNNEEDED,
+			 struct peer_fd *peer_fd UNNEEDED,
+			 const u8 *fwd_msg UNNEEDED,
+			 bool reconnected UNNEEDED,
+			 bool reestablish_only UNNEEDED)
+{ fprintf(stderr, "peer_start_channeld called!\n"); abort(); }
+/* Generated stub for peer_start_dualopend */
+bool peer_start_dualopend(struct peer *peer UNNEEDED, struct peer_fd *peer_fd UNNEEDED,
+			  struct channel *channel UNNEEDED)
+{ fprintf(stderr, "peer_start_dualopend called!\n"); abort(); }
+/* Generated stub for peer_start_openingd */
+bool peer_start_openingd(struct peer *peer UNNEEDED,
+			 struct peer_fd *peer_fd UNNEEDED)
+{ fprintf(stderr, "peer_start_openingd called!\n"); abort(); }
+/* Generated stub for plugin_hook_call_ */
+bool plugin_hook_call_(struct lightningd *ld UNNEEDED, const struct plugin_hook *hook UNNEEDED,
+		       tal_t *cb_arg STEALS UNNEEDED)
+{ fprintf(stderr, "plugin_hook_call_ called!\n"); abort(); }
+/* Generated stub for process_onionpacket */
+struct route_step *process_onionpacket(
+	const tal_t * ctx UNNEEDED,
+	const struct onionpacket *packet UNNEEDED,
+	const struct secret *shared_secret UNNEEDED,
+	const u8 *assocdata UNNEEDED,
+	const size_t assocdatalen UNNEEDED,
+	bool has_realm
+	)
+{ fprintf(stderr, "process_onionpacket called!\n"); abort(); }
+/* Generated stub for report_subd_memleak */
+void report_subd_memleak(struct leak_detect *leak_detect UNNEEDED, struct subd *leaker UNNEEDED)
+{ fprintf(stderr, "report_subd_memleak called!\n"); abort(); }
+/* Generated stub for resolve_close_command */
+void resolve_close_command(struct lightningd *ld UNNEEDED, struct channel *channel UNNEEDED,
+			   bool cooperative UNNEEDED)
+{ fprintf(stderr, "resolve_close_command called!\n"); abort(); }
+/* Generated stub for serialize_onionpacket */
+u8 *serialize_onionpacket(
+	const tal_t *ctx UNNEEDED,
+	const struct onionpacket *packet UNNEEDED)
+{ fprintf(stderr, "serialize_onionpacket called!\n"); abort(); }
+/* Generated stub for start_leak_request */
+void start_leak_request(const struct subd_req *req UNNEEDED,
+			struct leak_detect *leak_detect UNNEEDED)
+{ fprintf(stderr, "start_leak_request called!\n"); abort(); }
+/* Generated stub for subd_release_channel */
+void subd_release_channel(struct subd *owner UNNEEDED, const void *channel UNNEEDED)
+{ fprintf(stderr, "subd_release_channel called!\n"); abort(); }
+/* Generated stub for subd_req_ */
+struct subd_req *subd_req_(const tal_t *ctx UNNEEDED,
+	       struct subd *sd UNNEEDED,
+	       const u8 *msg_out UNNEEDED,
+	       int fd_out UNNEEDED, size_t num_fds_in UNNEEDED,
+	       void (*replycb)(struct subd * UNNEEDED, const u8 * UNNEEDED, const int * UNNEEDED, void *) UNNEEDED,
+	       void *replycb_data UNNEEDED)
+{ fprintf(stderr, "subd_req_ called!\n"); abort(); }
+/* Generated stub for subd_send_fd */
+void subd_send_fd(struct subd *sd UNNEEDED, int fd UNNEEDED)
+{ fprintf(stderr, "subd_send_fd called!\n"); abort(); }
+/* Generated stub for subd_send_msg */
+void subd_send_msg(struct subd *sd UNNEEDED, const u8 *msg_out UNNEEDED)
+{ fprintf(stderr, "subd_send_msg called!\n"); abort(); }
+/* Generated stub for subkey_from_hmac */
+void subkey_from_hmac(const char *prefix UNNEEDED,
+		      const struct secret *base UNNEEDED,
+		      struct secret *key UNNEEDED)
+{ fprintf(stderr, "subkey_from_hmac called!\n"); abort(); }
+/* Generated stub for topology_add_sync_waiter_ */
+void topology_add_sync_waiter_(const tal_t *ctx UNNEEDED,
+			       struct chain_topology *topo UNNEEDED,
+			       void (*cb)(struct chain_topology *topo UNNEEDED,
+					  void *arg) UNNEEDED,
+			       void *arg UNNEEDED)
+{ fprintf(stderr, "topology_add_sync_waiter_ called!\n"); abort(); }
+/* Generated stub for towire_channeld_config_channel */
+u8 *towire_channeld_config_channel(const tal_t *ctx UNNEEDED, u32 *feerate_base UNNEEDED, u32 *feerate_ppm UNNEEDED, struct amount_msat *htlc_minimum UNNEEDED, struct amount_msat *htlc_maximum UNNEEDED)
+{ fprintf(stderr, "towire_channeld_config_channel called!\n"); abort(); }
+/* Generated stub for towire_channeld_dev_memleak */
+u8 *towire_channeld_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channeld_dev_memleak called!\n"); abort(); }
+/* Generated stub for towire_channeld_dev_reenable_commit */
+u8 *towire_channeld_dev_reenable_commit(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channeld_dev_reenable_commit called!\n"); abort(); }
+/* Generated stub for towire_channeld_fail_htlc */
+u8 *towire_channeld_fail_htlc(const tal_t *ctx UNNEEDED, const struct failed_htlc *failed_htlc UNNEEDED)
+{ fprintf(stderr, "towire_channeld_fail_htlc called!\n"); abort(); }
+/* Generated stub for towire_channeld_fulfill_htlc */
+u8 *towire_channeld_fulfill_htlc(const tal_t *ctx UNNEEDED, const struct fulfilled_htlc *fulfilled_htlc UNNEEDED)
+{ fprintf(stderr, "towire_channeld_fulfill_htlc called!\n"); abort(); }
+/* Generated stub for towire_channeld_got_commitsig_reply */
+u8 *towire_channeld_got_commitsig_reply(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channeld_got_commitsig_reply called!\n"); abort(); }
+/* Generated stub for towire_channeld_got_revoke_reply */
+u8 *towire_channeld_got_revoke_reply(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channeld_got_revoke_reply called!\n"); abort(); }
+/* Generated stub for towire_channeld_offer_htlc */
+u8 *towire_channeld_offer_htlc(const tal_t *ctx UNNEEDED, struct amount_msat amount_msat UNNEEDED, u32 cltv_expiry UNNEEDED, const struct sha256 *payment_hash UNNEEDED, const u8 onion_routing_packet[1366] UNNEEDED, const struct pubkey *blinding UNNEEDED)
+{ fprintf(stderr, "towire_channeld_offer_htlc called!\n"); abort(); }
+/* Generated stub for towire_channeld_sending_commitsig_reply */
+u8 *towire_channeld_sending_commitsig_reply(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channeld_sending_commitsig_reply called!\n"); abort(); }
+/* Generated stub for towire_connectd_discard_peer */
+u8 *towire_connectd_discard_peer(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u64 counter UNNEEDED)
+{ fprintf(stderr, "towire_connectd_discard_peer called!\n"); abort(); }
+/* Generated stub for towire_connectd_peer_connect_subd */
+u8 *towire_connectd_peer_connect_subd(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u64 counter UNNEEDED, const struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "towire_connectd_peer_connect_subd called!\n"); abort(); }
+/* Generated stub for towire_connectd_peer_final_msg */
+u8 *towire_connectd_peer_final_msg(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u64 counter UNNEEDED, const u8 *msg UNNEEDED)
+{ fprintf(stderr, "towire_connectd_peer_final_msg called!\n"); abort(); }
+/* Generated stub for towire_dualopend_dev_memleak */
+u8 *towire_dualopend_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_dualopend_dev_memleak called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* Generated stub for towire_expiry_too_far */
+u8 *towire_expiry_too_far(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_expiry_too_far called!\n"); abort(); }
+/* Generated stub for towire_expiry_too_soon */
+u8 *towire_expiry_too_soon(const tal_t *ctx UNNEEDED, const u8 *channel_update UNNEEDED)
+{ fprintf(stderr, "towire_expiry_too_soon called!\n"); abort(); }
+/* Generated stub for towire_fee_insufficient */
+u8 *towire_fee_insufficient(const tal_t *ctx UNNEEDED, struct amount_msat htlc_msat UNNEEDED, const u8 *channel_update UNNEEDED)
+{ fprintf(stderr, "towire_fee_insufficient called!\n"); abort(); }
+/* Generated stub for towire_final_incorrect_cltv_expiry */
+u8 *towire_final_incorrect_cltv_expiry(const tal_t *ctx UNNEEDED, u32 cltv_expiry UNNEEDED)
+{ fprintf(stderr, "towire_final_incorrect_cltv_expiry called!\n"); abort(); }
+/* Generated stub for towire_final_incorrect_htlc_amount */
+u8 *towire_final_incorrect_htlc_amount(const tal_t *ctx UNNEEDED, struct amount_msat incoming_htlc_amt UNNEEDED)
+{ fprintf(stderr, "towire_final_incorrect_htlc_amount called!\n"); abort(); }
+/* Generated stub for towire_gossipd_remote_addr */
+u8 *towire_gossipd_remote_addr(const tal_t *ctx UNNEEDED, const struct wireaddr *remote_addr UNNEEDED)
+{ fprintf(stderr, "towire_gossipd_remote_addr called!\n"); abort(); }
+/* Generated stub for towire_hsmd_get_output_scriptpubkey */
+u8 *towire_hsmd_get_output_scriptpubkey(const tal_t *ctx UNNEEDED, u64 channel_id UNNEEDED, const struct node_id *peer_id UNNEEDED, const struct pubkey *commitment_point UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_get_output_scriptpubkey called!\n"); abort(); }
+/* Generated stub for towire_hsmd_new_channel */
+u8 *towire_hsmd_new_channel(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u64 dbid UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_new_channel called!\n"); abort(); }
+/* Generated stub for towire_hsmd_sign_commitment_tx */
+u8 *towire_hsmd_sign_commitment_tx(const tal_t *ctx UNNEEDED, const struct node_id *peer_id UNNEEDED, u64 channel_dbid UNNEEDED, const struct bitcoin_tx *tx UNNEEDED, const struct pubkey *remote_funding_key UNNEEDED, u64 commit_num UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_sign_commitment_tx called!\n"); abort(); }
+/* Generated stub for towire_incorrect_cltv_expiry */
+u8 *towire_incorrect_cltv_expiry(const tal_t *ctx UNNEEDED, u32 cltv_expiry UNNEEDED, const u8 *channel_update UNNEEDED)
+{ fprintf(stderr, "towire_incorrect_cltv_expiry called!\n"); abort(); }
+/* Generated stub for towire_incorrect_or_unknown_payment_details */
+u8 *towire_incorrect_or_unknown_payment_details(const tal_t *ctx UNNEEDED, struct amount_msat htlc_msat UNNEEDED, u32 height UNNEEDED)
+{ fprintf(stderr, "towire_incorrect_or_unknown_payment_details called!\n"); abort(); }
+/* Generated stub for towire_invalid_onion_payload */
+u8 *towire_invalid_onion_payload(const tal_t *ctx UNNEEDED, bigsize type UNNEEDED, u16 offset UNNEEDED)
+{ fprintf(stderr, "towire_invalid_onion_payload called!\n"); abort(); }
+/* Generated stub for towire_invalid_realm */
+u8 *towire_invalid_realm(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_invalid_realm called!\n"); abort(); }
+/* Generated stub for towire_onchaind_dev_memleak */
+u8 *towire_onchaind_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_onchaind_dev_memleak called!\n"); abort(); }
+/* Generated stub for towire_onchaind_known_preimage */
+u8 *towire_onchaind_known_preimage(const tal_t *ctx UNNEEDED, const struct preimage *preimage UNNEEDED)
+{ fprintf(stderr, "towire_onchaind_known_preimage called!\n"); abort(); }
+/* Generated stub for towire_openingd_dev_memleak */
+u8 *towire_openingd_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_openingd_dev_memleak called!\n"); abort(); }
+/* Generated stub for towire_permanent_channel_failure */
+u8 *towire_permanent_channel_failure(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_permanent_channel_failure called!\n"); abort(); }
+/* Generated stub for towire_permanent_node_failure */
+u8 *towire_permanent_node_failure(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_permanent_node_failure called!\n"); abort(); }
+/* Generated stub for towire_required_channel_feature_missing */
+u8 *towire_required_channel_feature_missing(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_required_channel_feature_missing called!\n"); abort(); }
+/* Generated stub for towire_required_node_feature_missing */
+u8 *towire_required_node_feature_missing(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_required_node_feature_missing called!\n"); abort(); }
+/* Generated stub for towire_scb_chan */
+void towire_scb_chan(u8 **p UNNEEDED, const struct scb_chan *scb_chan UNNEEDED)
+{ fprintf(stderr, "towire_scb_chan called!\n"); abort(); }
+/* Generated stub for towire_temporary_channel_failure */
+u8 *towire_temporary_channel_failure(const tal_t *ctx UNNEEDED, const u8 *channel_update UNNEEDED)
+{ fprintf(stderr, "towire_temporary_channel_failure called!\n"); abort(); }
+/* Generated stub for towire_temporary_node_failure */
+u8 *towire_temporary_node_failure(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_temporary_node_failure called!\n"); abort(); }
+/* Generated stub for towire_unknown_next_peer */
+u8 *towire_unknown_next_peer(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_unknown_next_peer called!\n"); abort(); }
+/* Generated stub for towire_warningfmt */
+u8 *towire_warningfmt(const tal_t *ctx UNNEEDED,
+		      const struct channel_id *channel UNNEEDED,
+		      const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_warningfmt called!\n"); abort(); }
+/* Generated stub for try_reconnect */
+void try_reconnect(const tal_t *ctx UNNEEDED,
+		   struct peer *peer UNNEEDED,
+		   const struct wireaddr_internal *addrhint UNNEEDED)
+{ fprintf(stderr, "try_reconnect called!\n"); abort(); }
+/* Generated stub for watch_txid */
+struct txwatch *watch_txid(const tal_t *ctx UNNEEDED,
+			   struct chain_topology *topo UNNEEDED,
+			   struct channel *channel UNNEEDED,
+			   const struct bitcoin_txid *txid UNNEEDED,
+			   enum watch_result (*cb)(struct lightningd *ld UNNEEDED,
+						   struct channel *channel UNNEEDED,
+						   const struct bitcoin_txid * UNNEEDED,
+						   const struct bitcoin_tx * UNNEEDED,
+						   unsigned int depth))
+{ fprintf(stderr, "watch_txid called!\n"); abort(); }
+/* Generated stub for watch_txo */
+struct txowatch *watch_txo(const tal_t *ctx UNNEEDED,
+			   struct chain_topology *topo UNNEEDED,
+			   struct channel *channel UNNEEDED,
+			   const struct bitcoin_outpoint *outpoint UNNEEDED,
+			   enum watch_result (*cb)(struct channel *channel UNNEEDED,
+						   const struct bitcoin_tx *tx UNNEEDED,
+						   size_t input_num UNNEEDED,
+						   const struct block *block))
+{ fprintf(stderr, "watch_txo called!\n"); abort(); }
+/* Generated stub for wrap_onionreply */
+struct onionreply *wrap_onionreply(const tal_t *ctx UNNEEDED,
+				   const struct secret *shared_secret UNNEEDED,
+				   const struct onionreply *reply UNNEEDED)
+{ fprintf(stderr, "wrap_onionreply called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#if DEVELOPER
+bool dev_disconnect_permanent(struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "dev_disconnect_permanent called!\n"); abort(); }
+#endif
+
+/* Fake stubs to talk to hsm */
+u8 *towire_hsmd_get_channel_basepoints(const tal_t *ctx UNNEEDED, const struct node_id *peerid UNNEEDED, u64 dbid UNNEEDED)
+{
+	return NULL;
+}
+bool wire_sync_write(int fd UNNEEDED, const void *msg TAKES UNNEEDED)
+{
+	return true;
+}
+u8 *wire_sync_read(const tal_t *ctx UNNEEDED, int fd UNNEEDED)
+{
+	return NULL;
+}
+void plugin_hook_db_sync(struct db *db UNNEEDED)
+{
+}
+bool fromwire_hsmd_get_channel_basepoints_reply(const void *p UNNEEDED,
+					       struct basepoints *basepoints,
+					       struct pubkey *funding_pubkey)
+{
+	struct pubkey pk;
+	pubkey_from_der(tal_hexdata(tmpctx,
+				    "02a1633cafcc01ebfb6d78e39f687a1f0995c62fc9"
+				    "5f51ead10a02ee0be551b5dc",
+				    66),
+			33, &pk);
+	*funding_pubkey = pk;
+	basepoints->revocation = pk;
+	basepoints->payment = pk;
+	basepoints->htlc = pk;
+	basepoints->delayed_payment = pk;
+	return true;
+}
+
+struct log *new_log(const tal_t *ctx UNNEEDED, struct log_book *record UNNEEDED, const struct node_id *default_node_id UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+	return NULL;
+}
+
+struct log_book *new_log_book(struct lightningd *ld UNNEEDED, size_t max_mem UNNEEDED)
+{
+	return NULL;
+}
+
+void txfilter_add_scriptpubkey(struct txfilter *filter UNNEEDED, const u8 *script TAKES)
+{
+	if (taken(script))
+		tal_free(script);
+}
+
+/* How many HTLCs are already in the db, as on a node which has been
+ * forwarding for a while: we never delete them until the channel closes. */
+#define NUM_OLD_HTLCS 10000
+
+struct wallet_bench {
+	struct wallet *w;
+	struct channel *in_chan, *out_chan;
+	struct preimage preimage;
+	u64 next_id;
+	u64 commit_num;
+};
+
+static void cleanup_bench_wallet(struct wallet *w, char *filename)
+{
+	unlink(filename);
+	tal_free(filename);
+}
+
+static struct wallet *create_bench_wallet(struct lightningd *ld,
+					  const tal_t *ctx)
+{
+	char *dsn, *filename;
+	int fd = tmpdir_mkstemp(ctx, "ldb-XXXXXX", &filename);
+	struct wallet *w = tal(ctx, struct wallet);
+	static unsigned char badseed[BIP32_ENTROPY_LEN_128];
+
+	if (fd == -1)
+		err(1, "Unable to generate temp filename");
+	close(fd);
+
+	dsn = tal_fmt(NULL, "sqlite3://%s", filename);
+	w->db = db_open(w, dsn);
+	w->db->report_changes_fn = NULL;
+	tal_free(dsn);
+	tal_add_destructor2(w, cleanup_bench_wallet, filename);
+
+	list_head_init(&w->unstored_payments);
+	w->ld = ld;
+	w->unspent = NULL;
+	ld->wallet = w;
+
+	w->bip32_base = tal(w, struct ext_key);
+	if (bip32_key_from_seed(badseed, sizeof(badseed),
+				BIP32_VER_TEST_PRIVATE, 0,
+				w->bip32_base) != WALLY_OK)
+		errx(1, "bip32_key_from_seed failed");
+
+	db_begin_transaction(w->db);
+	db_migrate(ld, w->db, NULL);
+	w->db->data_version = 0;
+	db_commit_transaction(w->db);
+	w->max_channel_dbid = 0;
+
+	return w;
+}
+
+static struct channel *bench_channel(struct wallet *w, u64 dbid)
+{
+	struct channel *chan = talz(w, struct channel);
+	struct db_stmt *stmt;
+
+	db_begin_transaction(w->db);
+	stmt = db_prepare_v2(w->db, SQL("INSERT INTO channels (id) VALUES (?);"));
+	db_bind_u64(stmt, 0, dbid);
+	db_exec_prepared_v2(take(stmt));
+	db_commit_transaction(w->db);
+
+	chan->dbid = dbid;
+	chan->next_index[LOCAL] = chan->next_index[REMOTE] = 1;
+	return chan;
+}
+
+/* Each state change is its own transaction, as it would be in lightningd,
+ * where each comes from a separate message from channeld. */
+static void update_htlc(struct wallet_bench *wb, u64 dbid,
+			enum htlc_state state, const struct preimage *preimage)
+{
+	db_begin_transaction(wb->w->db);
+	wallet_htlc_update(wb->w, dbid, state, preimage, wb->commit_num++,
+			   0, NULL, NULL, NULL);
+	db_commit_transaction(wb->w->db);
+}
+
+static void new_htlcs(struct wallet_bench *wb,
+		      struct htlc_in *in, struct htlc_out *out)
+{
+	memset(in, 0, sizeof(*in));
+	in->key.id = wb->next_id;
+	in->key.channel = wb->in_chan;
+	in->msat = AMOUNT_MSAT(100001000);
+	in->cltv_expiry = 700000;
+	in->hstate = RCVD_ADD_HTLC;
+	sha256(&in->payment_hash, &wb->preimage, sizeof(wb->preimage));
+
+	memset(out, 0, sizeof(*out));
+	out->in = in;
+	out->key.id = wb->next_id;
+	out->key.channel = wb->out_chan;
+	out->msat = AMOUNT_MSAT(100000000);
+	out->fees = AMOUNT_MSAT(1000);
+	out->cltv_expiry = 699960;
+	out->hstate = SENT_ADD_HTLC;
+	out->payment_hash = in->payment_hash;
+	wb->next_id++;
+}
+
+/* A successful forward: the incoming HTLC, the outgoing one, then both
+ * fulfilled, every step through the commitment dance. */
+static void htlc_cycle(struct wallet_bench *wb)
+{
+	struct htlc_in in;
+	struct htlc_out out;
+
+	new_htlcs(wb, &in, &out);
+
+	db_begin_transaction(wb->w->db);
+	wallet_htlc_save_in(wb->w, wb->in_chan, &in);
+	db_commit_transaction(wb->w->db);
+	for (enum htlc_state s = RCVD_ADD_COMMIT;
+	     s <= RCVD_ADD_ACK_REVOCATION;
+	     s++)
+		update_htlc(wb, in.dbid, s, NULL);
+
+	db_begin_transaction(wb->w->db);
+	wallet_htlc_save_out(wb->w, wb->out_chan, &out);
+	db_commit_transaction(wb->w->db);
+	for (enum htlc_state s = SENT_ADD_COMMIT;
+	     s <= SENT_ADD_ACK_REVOCATION;
+	     s++)
+		update_htlc(wb, out.dbid, s, NULL);
+
+	for (enum htlc_state s = RCVD_REMOVE_HTLC;
+	     s <= RCVD_REMOVE_ACK_REVOCATION;
+	     s++)
+		update_htlc(wb, out.dbid, s, &wb->preimage);
+
+	for (enum htlc_state s = SENT_REMOVE_HTLC;
+	     s <= SENT_REMOVE_ACK_REVOCATION;
+	     s++)
+		update_htlc(wb, in.dbid, s, &wb->preimage);
+}
+
+/* Finished forwards, all at once: we're not timing these. */
+static void add_old_htlcs(struct wallet_bench *wb, size_t num)
+{
+	struct htlc_in in;
+	struct htlc_out out;
+
+	db_begin_transaction(wb->w->db);
+	for (size_t i = 0; i < num; i++) {
+		new_htlcs(wb, &in, &out);
+		in.hstate = SENT_REMOVE_ACK_REVOCATION;
+		in.preimage = &wb->preimage;
+		out.hstate = RCVD_REMOVE_ACK_REVOCATION;
+		out.preimage = &wb->preimage;
+		wallet_htlc_save_in(wb->w, wb->in_chan, &in);
+		wallet_htlc_save_out(wb->w, wb->out_chan, &out);
+	}
+	db_commit_transaction(wb->w->db);
+}
+
+int main(int argc, char *argv[])
+{
+	struct lightningd *ld;
+	struct wallet_bench wb;
+
+	bench_init(&argc, &argv);
+
+	ld = talz(NULL, struct lightningd);
+	list_head_init(&ld->peers);
+	htlc_in_map_init(&ld->htlcs_in);
+	htlc_out_map_init(&ld->htlcs_out);
+
+	wb.w = create_bench_wallet(ld, ld);
+	wb.in_chan = bench_channel(wb.w, 1);
+	wb.out_chan = bench_channel(wb.w, 2);
+	memset(&wb.preimage, 'P', sizeof(wb.preimage));
+	wb.next_id = 0;
+	wb.commit_num = 0;
+
+	add_old_htlcs(&wb, NUM_OLD_HTLCS);
+
+	bench_run("wallet_htlc_cycle", htlc_cycle, &wb);
+
+	tal_free(ld);
+	bench_shutdown();
+}
@@ -0,0 +1,231 @@
+#include "config.h"
+#include <assert.h>
+#include <bitcoin/chainparams.h>
+#include <bitcoin/privkey.h>
+#include <bitcoin/pubkey.h>
+#include <bitcoin/short_channel_id.h>
+#include <ccan/crc32c/crc32c.h>
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/time/time.h>
+#include <common/gossip_store.h>
+#include <common/node_id.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <gossipd/gossip_store_wiregen.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <tests/bench/libbench.h>
+#include <unistd.h>
+#include <wire/peer_wire.h>
+
+static unsigned int bench_msec = 500;
+static char *bench_filter;
+static u64 rand_state = 0x2545F4914F6CDD1DULL;
+
+void bench_init(int *argc, char ***argv)
+{
+	common_setup((*argv)[0]);
+	chainparams = chainparams_for_network("regtest");
+
+	opt_register_arg("--time", opt_set_uintval, opt_show_uintval,
+			 &bench_msec, "Minimum milliseconds to run each benchmark");
+	opt_register_arg("--filter", opt_set_charp, NULL, &bench_filter,
+			 "Only run benchmarks whose name contains this");
+	opt_register_noarg("-h|--help", opt_usage_and_exit,
+			   "\nRun benchmarks, printing one JSON line each",
+			   "Get usage information");
+	opt_parse(argc, *argv, opt_log_stderr_exit);
+	if (*argc != 1)
+		opt_usage_exit_fail("No arguments expected");
+}
+
+void bench_run_(const char *name, void (*fn)(void *arg), void *arg,
+		size_t bytes)
+{
+	struct timemono start;
+	struct timerel elapsed;
+	u64 iterations = 0, batch = 1;
+
+	if (bench_filter && !strstr(name, bench_filter))
+		return;
+
+	/* Warm up caches, and anything lazily initialized. */
+	fn(arg);
+	clean_tmpctx();
+
+	start = time_mono();
+	do {
+		for (u64 i = 0; i < batch; i++) {
+			fn(arg);
+			clean_tmpctx();
+		}
+		iterations += batch;
+		batch *= 2;
+		elapsed = timemono_since(start);
+	} while (time_to_msec(elapsed) < bench_msec);
+
+	printf("{\"benchmark\":\"%s\",\"iterations\":%"PRIu64
+	       ",\"nsec_per_op\":%"PRIu64,
+	       name, iterations, time_to_nsec(elapsed) / iterations);
+	if (bytes)
+		printf(",\"mb_per_sec\":%.1f",
+		       (double)bytes * iterations
+		       / (time_to_nsec(elapsed) / 1000.0));
+	printf("}\n");
+	fflush(stdout);
+}
+
+void bench_report(const char *name, const char *key, u64 value)
+{
+	if (bench_filter && !strstr(name, bench_filter))
+		return;
+
+	printf("{\"benchmark\":\"%s\",\"%s\":%"PRIu64"}\n",
+	       name, key, value);
+	fflush(stdout);
+}
+
+void bench_shutdown(void)
+{
+	common_shutdown();
+}
+
+/* xorshift64*: we don't want pseudorand, which is seeded randomly. */
+u64 bench_rand(void)
+{
+	rand_state ^= rand_state >> 12;
+	rand_state ^= rand_state << 25;
+	rand_state ^= rand_state >> 27;
+	return rand_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void write_to_store(int fd, const u8 *msg, u32 timestamp)
+{
+	struct gossip_hdr hdr;
+
+	hdr.len = cpu_to_be32(tal_count(msg));
+	hdr.crc = cpu_to_be32(crc32c(timestamp, msg, tal_count(msg)));
+	hdr.timestamp = cpu_to_be32(timestamp);
+	if (!write_all(fd, &hdr, sizeof(hdr))
+	    || !write_all(fd, msg, tal_count(msg)))
+		err(1, "Writing gossip_store");
+}
+
+static void write_update(int fd, const struct short_channel_id *scid,
+			 int dir, struct amount_sat capacity, u32 timestamp)
+{
+	secp256k1_ecdsa_signature dummy_sig;
+	struct amount_msat htlc_max;
+	u8 *msg;
+
+	memset(&dummy_sig, 0, sizeof(dummy_sig));
+	if (!amount_sat_to_msat(&htlc_max, capacity))
+		abort();
+	msg = towire_channel_update_option_channel_htlc_max(tmpctx,
+							    &dummy_sig,
+							    &chainparams->genesis_blockhash,
+							    scid, timestamp,
+							    ROUTING_OPT_HTLC_MAX_MSAT,
+							    dir,
+							    6 + bench_rand() % 138,
+							    AMOUNT_MSAT(1000),
+							    bench_rand() % 1001,
+							    bench_rand() % 1001,
+							    htlc_max);
+	write_to_store(fd, msg, timestamp);
+}
+
+char *bench_gossip_store(const tal_t *ctx, size_t num_nodes, size_t num_chans)
+{
+	struct node_id *ids = tal_arr(tmpctx, struct node_id, num_nodes);
+	secp256k1_ecdsa_signature dummy_sig;
+	struct pubkey dummy_key;
+	struct privkey priv;
+	const u32 timestamp = 1650000000;
+	u8 version = GOSSIP_STORE_VERSION;
+	char *fname;
+	int fd;
+
+	assert(num_nodes > 1);
+	memset(&dummy_sig, 0, sizeof(dummy_sig));
+	memset(&priv, 1, sizeof(priv));
+	if (!pubkey_from_privkey(&priv, &dummy_key))
+		abort();
+
+	for (size_t i = 0; i < num_nodes; i++) {
+		struct pubkey k;
+		memset(&priv, 0, sizeof(priv));
+		priv.secret.data[28] = (i + 1) >> 24;
+		priv.secret.data[29] = (i + 1) >> 16;
+		priv.secret.data[30] = (i + 1) >> 8;
+		priv.secret.data[31] = (i + 1);
+		if (!pubkey_from_privkey(&priv, &k))
+			abort();
+		node_id_from_pubkey(&ids[i], &k);
+	}
+
+	fd = tmpdir_mkstemp(ctx, "bench-gossip_store.XXXXXX", &fname);
+	if (fd < 0 || !write_all(fd, &version, sizeof(version)))
+		err(1, "Creating gossip_store");
+
+	for (size_t i = 0; i < num_chans; i++) {
+		struct short_channel_id scid;
+		struct amount_sat capacity;
+		size_t a, b;
+		u8 *msg;
+
+		/* A spanning tree first, so it's all connected, then random
+		 * channels, biased towards low-numbered nodes (like hubs). */
+		if (i < num_nodes - 1) {
+			a = i + 1;
+			b = bench_rand() % a;
+		} else {
+			do {
+				a = bench_rand() % num_nodes;
+				b = bench_rand() % (1 + bench_rand() % num_nodes);
+			} while (a == b);
+		}
+		if (node_id_cmp(&ids[a], &ids[b]) > 0) {
+			size_t tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		if (!mk_short_channel_id(&scid, 500000 + i / 1000, i % 1000, 0))
+			abort();
+		capacity = amount_sat(100000 + bench_rand() % 10000000);
+
+		msg = towire_channel_announcement(tmpctx, &dummy_sig, &dummy_sig,
+						  &dummy_sig, &dummy_sig,
+						  NULL,
+						  &chainparams->genesis_blockhash,
+						  &scid, &ids[a], &ids[b],
+						  &dummy_key, &dummy_key);
+		write_to_store(fd, msg, 0);
+		write_to_store(fd,
+			       towire_gossip_store_channel_amount(tmpctx,
+								  capacity),
+			       0);
+		write_update(fd, &scid, 0, capacity, timestamp);
+		write_update(fd, &scid, 1, capacity, timestamp);
+	}
+
+	for (size_t i = 0; i < num_nodes; i++) {
+		u8 rgb[3] = { i, i >> 8, i >> 16 };
+		u8 alias[32];
+		u8 *msg;
+
+		memset(alias, 0, sizeof(alias));
+		snprintf((char *)alias, sizeof(alias), "bench-node-%zu", i);
+		msg = towire_node_announcement(tmpctx, &dummy_sig, NULL,
+					       timestamp, &ids[i], rgb, alias,
+					       NULL, NULL);
+		write_to_store(fd, msg, timestamp);
+	}
+
+	close(fd);
+	clean_tmpctx();
+	return fname;
+}
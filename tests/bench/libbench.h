@@ -0,0 +1,47 @@
+#ifndef LIGHTNING_TESTS_BENCH_LIBBENCH_H
+#define LIGHTNING_TESTS_BENCH_LIBBENCH_H
+
+#include "config.h"
+#include <ccan/short_types/short_types.h>
+#include <ccan/tal/tal.h>
+#include <ccan/typesafe_cb/typesafe_cb.h>
+
+/* Called once at the start of main: parses the common options. */
+void bench_init(int *argc, char ***argv);
+
+/* Runs @fn(@arg) repeatedly for (at least) the benchmark time, then prints
+ * a single JSON line with the results:
+ *
+ *   {"benchmark":"<name>","iterations":N,"nsec_per_op":N}
+ *
+ * tmpctx is cleaned after every call, so allocate temporaries off it. */
+#define bench_run(name, fn, arg)					\
+	bench_run_((name), typesafe_cb(void, void *, (fn), (arg)), (arg), 0)
+
+/* Same, but each call processes @bytes bytes, so also adds "mb_per_sec". */
+#define bench_run_bytes(name, fn, arg, bytes)				\
+	bench_run_((name), typesafe_cb(void, void *, (fn), (arg)), (arg), \
+		   (bytes))
+
+void bench_run_(const char *name, void (*fn)(void *arg), void *arg,
+		size_t bytes);
+
+/* For things which aren't timings (e.g. how many attempts a simulated
+ * payment took), prints a single JSON line:
+ *
+ *   {"benchmark":"<name>","<key>":N} */
+void bench_report(const char *name, const char *key, u64 value);
+
+/* Called once at the end of main. */
+void bench_shutdown(void);
+
+/* Writes a deterministic (same every time) gossip_store with @num_nodes
+ * nodes and @num_chans channels between them, each with node_announcements
+ * and channel_updates in both directions.  Signatures are dummies, which
+ * gossmap doesn't care about. */
+char *bench_gossip_store(const tal_t *ctx, size_t num_nodes, size_t num_chans);
+
+/* Deterministic pseudo-random numbers, so runs are comparable. */
+u64 bench_rand(void);
+
+#endif /* LIGHTNING_TESTS_BENCH_LIBBENCH_H */
@@ -1,11 +1,15 @@
 from concurrent import futures
 from fixtures import *  # noqa: F401,F403
+from fixtures import TEST_NETWORK
 from time import time
 from tqdm import tqdm
+from utils import only_one, wait_for
 
 
+import os
 import pytest
 import random
+import sqlite3
 
 
 num_workers = 480
@@ -91,6 +95,106 @@ def test_invoice(node_factory, benchmark):
     benchmark(bench_invoice)
 
 
+def test_invoice_parallel(node_factory, executor):
+    l1 = node_factory.get_node()
+    num_invoices = 2000
+
+    start_time = time()
+    fs = []
+    for i in range(num_invoices):
+        fs.append(executor.submit(l1.rpc.invoice, 1000, 'invoice-{}'.format(i), 'desc'))
+
+    for f in tqdm(futures.as_completed(fs), total=len(fs)):
+        f.result()
+
+    diff = time() - start_time
+    print("Done. %d invoices created in %f seconds (%f invoices per second)" % (num_invoices, diff, num_invoices / diff))
+
+
+def test_invoice_routehints(node_factory, bitcoind, executor):
+    """Invoices per second when there are incoming channels to hint"""
+    l1 = node_factory.get_node()
+    peers = node_factory.get_nodes(4)
+    num_invoices = 2000
+
+    for p in peers:
+        p.rpc.connect(l1.info['id'], 'localhost', l1.port)
+        p.fundchannel(l1, 10**6)
+    bitcoind.generate_block(5)
+    wait_for(lambda: len(l1.rpc.listincoming()['incoming']) == len(peers))
+
+    start_time = time()
+    fs = []
+    for i in range(num_invoices):
+        fs.append(executor.submit(l1.rpc.invoice, 1000, 'invoice-{}'.format(i), 'desc'))
+
+    for f in tqdm(futures.as_completed(fs), total=len(fs)):
+        assert 'warning_capacity' not in f.result()
+
+    diff = time() - start_time
+    print("Done. %d invoices created in %f seconds (%f invoices per second)" % (num_invoices, diff, num_invoices / diff))
+
+
+def test_createinvoices(node_factory):
+    """Same as test_invoice_parallel, but in batches"""
+    l1 = node_factory.get_node()
+    num_invoices = 2000
+    batch_size = 500
+
+    start_time = time()
+    for b in tqdm(range(0, num_invoices, batch_size)):
+        invs = [{'amount_msat': 1000, 'label': 'invoice-{}'.format(i), 'description': 'desc'}
+                for i in range(b, b + batch_size)]
+        for r in l1.rpc.createinvoices(invs)['invoices']:
+            assert 'error' not in r
+
+    diff = time() - start_time
+    print("Done. %d invoices created in %f seconds (%f invoices per second)" % (num_invoices, diff, num_invoices / diff))
+
+
+def test_commando(node_factory, executor):
+    """Commands per second through commando, with a restricted rune"""
+    l1 = node_factory.get_node()
+    peers = node_factory.get_nodes(4)
+    num_commands = 2000
+
+    rune = l1.rpc.commando_rune(restrictions=[["method^list", "method^get", "method=summary"],
+                                              ["method/listdatastore"],
+                                              ["pnamelabel/secret", "pnum=0"]])['rune']
+    for p in peers:
+        p.connect(l1)
+
+    # Each peer can only have one command outstanding at a time.
+    def run(p, n):
+        for i in range(n):
+            p.rpc.commando(peer_id=l1.info['id'], method='getinfo', rune=rune)
+
+    start_time = time()
+    fs = [executor.submit(run, p, num_commands // len(peers)) for p in peers]
+    for f in tqdm(futures.as_completed(fs), total=len(fs)):
+        f.result()
+
+    diff = time() - start_time
+    print("Done. %d commands in %f seconds (%f commands per second)" % (num_commands, diff, num_commands / diff))
+
+
+def test_htlc_accept(node_factory, benchmark):
+    l1, l2 = node_factory.line_graph(2)
+
+    invoices = []
+    for i in range(1, 100):
+        inv = l2.rpc.invoice(1000, 'invoice-{}'.format(i), 'desc')
+        invoices.append((inv['payment_hash'], inv['payment_secret']))
+    route = l1.rpc.getroute(l2.info['id'], 1000, 1)['route']
+
+    def do_pay(l1):
+        payment_hash, payment_secret = invoices.pop()
+        l1.rpc.sendpay(route, payment_hash, payment_secret=payment_secret)
+        l1.rpc.waitsendpay(payment_hash)
+
+    benchmark.pedantic(do_pay, args=(l1,), rounds=len(invoices))
+
+
 def test_pay(node_factory, benchmark):
     l1, l2 = node_factory.line_graph(2)
 
@@ -107,3 +211,81 @@ def test_pay(node_factory, benchmark):
 
 def test_start(node_factory, benchmark):
     benchmark(node_factory.get_node)
+
+
+def test_start_many_channels(node_factory, benchmark):
+    """Restart a node whose wallet holds a couple of thousand channels,
+    over several peers, with HTLCs in flight"""
+    num_channels = 2000
+    num_peers = 4
+    num_htlcs = 3
+    l1 = node_factory.get_node(may_reconnect=True)
+    peers = node_factory.get_nodes(num_peers,
+                                   opts={'may_reconnect': True,
+                                         'plugin': os.path.join(os.getcwd(), 'tests/plugins/hold_htlcs.py'),
+                                         'hold-time': 10000})
+    for p in peers:
+        node_factory.join_nodes([l1, p])
+
+    # Leave some HTLCs stuck in each channel.
+    for p in peers:
+        scid = only_one(only_one(l1.rpc.listpeers(p.info['id'])['peers'])['channels'])['short_channel_id']
+        for i in range(num_htlcs):
+            l1.rpc.sendpay([{'amount_msat': 1000 + i, 'id': p.info['id'],
+                             'delay': 5, 'channel': scid}],
+                           '{:064x}'.format(i + 1), payment_secret='00' * 32)
+    for p in peers:
+        p.daemon.wait_for_logs(['Holding onto an incoming htlc'] * num_htlcs)
+
+    l1.stop()
+    for p in peers:
+        p.stop()
+
+    # Clone the real channels and their HTLCs round-robin over the peers:
+    # loading is what we're measuring, and CLOSINGD_COMPLETE ones don't
+    # need subdaemons or a live peer.
+    db = sqlite3.connect(os.path.join(l1.daemon.lightning_dir, TEST_NETWORK,
+                                      "lightningd.sqlite3"))
+    db.executescript("CREATE TEMP TABLE clone AS SELECT * FROM channels"
+                     " WHERE id = (SELECT MIN(id) FROM channels);"
+                     "UPDATE clone SET state = 6,"
+                     " alias_local = NULL, alias_remote = NULL;"
+                     "CREATE TEMP TABLE htlc_clone AS SELECT * FROM channel_htlcs"
+                     " WHERE channel_id = (SELECT MIN(id) FROM channels);")
+    peer_dbids = [r[0] for r in db.execute("SELECT DISTINCT peer_id FROM channels;")]
+    for i in range(num_channels):
+        db.execute("UPDATE clone SET id = (SELECT MAX(id) FROM channels) + 1,"
+                   " peer_id = ?;", (peer_dbids[i % len(peer_dbids)],))
+        db.executescript("INSERT INTO channels SELECT * FROM clone;"
+                         "UPDATE htlc_clone SET"
+                         " id = id + (SELECT MAX(id) FROM channel_htlcs),"
+                         " channel_id = (SELECT id FROM clone);"
+                         "INSERT INTO channel_htlcs SELECT * FROM htlc_clone;"
+                         "INSERT INTO channel_feerates"
+                         " SELECT clone.id, hstate, feerate_per_kw"
+                         " FROM channel_feerates, clone"
+                         " WHERE channel_id = (SELECT MIN(id) FROM channels);"
+                         "INSERT INTO channel_blockheights"
+                         " SELECT clone.id, hstate, blockheight"
+                         " FROM channel_blockheights, clone"
+                         " WHERE channel_id = (SELECT MIN(id) FROM channels);")
+    db.commit()
+    db.close()
+
+    l1.start()
+    l1.daemon.wait_for_log('Loaded {} channels from DB'.format(num_channels + num_peers))
+    l1.daemon.wait_for_log('Restored {} outgoing HTLCS'.format((num_channels + num_peers) * num_htlcs))
+    benchmark(l1.restart)
+
+
+def test_start_many_addresses(node_factory, benchmark):
+    """Restart a node which has handed out lots of addresses"""
+    l1 = node_factory.get_node()
+    l1.rpc.newaddr()
+    l1.stop()
+    l1.db_manip("UPDATE vars SET intval = 100000"
+                " WHERE name = 'bip32_max_index';")
+
+    # First start derives them all, after that they come from the db.
+    l1.start()
+    benchmark(l1.restart)
@@ -0,0 +1,21 @@
+#!/usr/bin/env python3
+"""Plugin which observes peer_connected, slowly.
+
+Since it's an observer, lightningd shouldn't wait for it, nor take any
+notice of its (invalid!) result.
+"""
+
+from pyln.client import Plugin
+import time
+
+plugin = Plugin()
+
+
+@plugin.hook('peer_connected', observer=True)
+def on_connected(peer, plugin, **kwargs):
+    plugin.log(f"Observing {peer['id']}")
+    time.sleep(5)
+    return {'result': 'disconnect', 'error_message': 'too slow'}
+
+
+plugin.run()
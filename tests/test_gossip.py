@@ -1675,6 +1675,38 @@ def test_gossip_store_compact_restart(node_factory, bitcoind):
     l2.rpc.call('dev-compact-gossip-store')
 
 
+@pytest.mark.developer("needs --dev-fast-gossip for quick index writes")
+def test_gossmap_index(node_factory, bitcoind):
+    """gossipd writes an index which plugins load instead of the store"""
+    l1, l2, l3 = node_factory.line_graph(3, wait_for_announce=True)
+    index = os.path.join(l1.daemon.lightning_dir, TEST_NETWORK,
+                         'gossip_store.gossmap')
+    wait_for(lambda: os.path.exists(index))
+
+    def graph(node):
+        return (sorted((c['short_channel_id'], c['direction'])
+                       for c in node.rpc.listchannels()['channels']),
+                sorted(n['nodeid'] for n in node.rpc.listnodes()['nodes']))
+
+    expected = graph(l1)
+    assert len(expected[0]) == 4
+
+    # topology plugin loads it on restart.
+    l1.restart()
+    assert graph(l1) == expected
+
+    # And pay can route with it.
+    inv = l3.rpc.invoice(1000, 'test_gossmap_index', 'desc')['bolt11']
+    l1.rpc.pay(inv)
+
+    # Compaction renames a new store into place: index gets rewritten.
+    before = time.time()
+    l1.rpc.call('dev-compact-gossip-store')
+    wait_for(lambda: os.stat(index).st_mtime > before)
+    l1.restart()
+    assert graph(l1) == expected
+
+
 @pytest.mark.developer("need dev-compact-gossip-store")
 def test_gossip_store_load_no_channel_update(node_factory):
     """Make sure we can read truncated gossip store with a channel_announcement and no channel_update"""
@@ -144,6 +144,56 @@ def test_invoice_preimage(node_factory):
         l2.rpc.invoice(123456, 'inv2', '?', preimage=invoice_preimage)
 
 
+@pytest.mark.developer("gossip without DEVELOPER=1 is slow")
+@unittest.skipIf(TEST_NETWORK != 'regtest', "Amounts too low, dominated by fees in elements")
+def test_createinvoices(node_factory):
+    """Test creating a batch of invoices at once."""
+    l0, l1, l2 = node_factory.line_graph(3, fundamount=2 * (10**5), wait_for_announce=True)
+    preimage = "17b08f669513b7379728fc1abcea5eaf3448bc1eba55a68ca2cd1843409cdc04"
+
+    l2.rpc.invoice(1000, 'exists', 'desc')
+    invs = [{'amount_msat': 1000 + i, 'label': 'batch-{}'.format(i), 'description': 'desc {}'.format(i)}
+            for i in range(10)]
+    invs[3]['expiry'] = 60
+    invs[4]['preimage'] = preimage
+    invs[5]['label'] = 'exists'
+    invs[6]['amount_msat'] = 'any'
+    ret = l2.rpc.createinvoices(invs, expiry=3600)['invoices']
+
+    assert [r['label'] for r in ret] == [i['label'] for i in invs]
+    assert ret[5]['error']['code'] == 900
+    assert 'bolt11' not in ret[5]
+    for i, r in enumerate(ret):
+        if i == 5:
+            continue
+        b11 = l1.rpc.decodepay(r['bolt11'])
+        assert b11['description'] == invs[i]['description']
+        assert b11['payment_hash'] == r['payment_hash']
+        assert b11['expiry'] == (60 if i == 3 else 3600)
+        assert b11['routes'][0][0]['pubkey'] == l1.info['id']
+        if i == 6:
+            assert 'amount_msat' not in b11
+        else:
+            assert b11['amount_msat'] == 1000 + i
+        assert only_one(l2.rpc.listinvoices(invs[i]['label'])['invoices'])['status'] == 'unpaid'
+
+    # They really work.
+    l1.rpc.pay(ret[4]['bolt11'])
+    assert only_one(l2.rpc.listinvoices('batch-4')['invoices'])['payment_preimage'] == preimage
+
+    # Same preimage fails just that one.
+    ret = l2.rpc.createinvoices([{'amount_msat': 1, 'label': 'again', 'description': 'd', 'preimage': preimage},
+                                 {'amount_msat': 2, 'label': 'again2', 'description': 'd'}])['invoices']
+    assert ret[0]['error']['code'] == 901
+    assert 'bolt11' in ret[1]
+
+    # A bad one means none get created.
+    with pytest.raises(RpcError, match=r'amount_msat'):
+        l2.rpc.createinvoices([{'amount_msat': 1, 'label': 'ok', 'description': 'd'},
+                               {'amount_msat': 0, 'label': 'bad', 'description': 'd'}])
+    assert l2.rpc.listinvoices('ok')['invoices'] == []
+
+
 @pytest.mark.developer("gossip without DEVELOPER=1 is slow")
 @unittest.skipIf(TEST_NETWORK != 'regtest', "Amounts too low, dominated by fees in elements")
 def test_invoice_routeboost(node_factory, bitcoind):
@@ -607,6 +657,55 @@ def test_autocleaninvoice(node_factory):
     l1.rpc.autocleaninvoice(cycle_seconds=1, expired_by=1)
 
 
+def test_autoclean(node_factory):
+    l1, l2, l3 = node_factory.line_graph(3, wait_for_announce=True,
+                                         opts=[{'autoclean-cycle': 1,
+                                                'autoclean-batch': 2,
+                                                'autoclean-succeededpays-age': 2,
+                                                'autoclean-failedpays-age': 2},
+                                               {'autoclean-cycle': 1,
+                                                'autoclean-succeededforwards-age': 2,
+                                                'autoclean-failedforwards-age': 2},
+                                               {'autoclean-cycle': 1,
+                                                'autoclean-batch': 2,
+                                                'autoclean-expiredinvoices-age': 2}])
+
+    # Nothing cleaned on an unconfigured node.
+    assert l1.rpc.call('autoclean-status', {'subsystem': 'expiredinvoices'}) == {'autoclean': {'expiredinvoices': {'enabled': False, 'cleaned': 0}}}
+
+    for i in range(3):
+        l1.rpc.pay(l3.rpc.invoice(1000, 'paid{}'.format(i), 'desc')['bolt11'])
+
+    # One which fails at the destination.
+    inv = l3.rpc.invoice(1000, 'deleted', 'desc')
+    l3.rpc.delinvoice('deleted', 'unpaid')
+    with pytest.raises(RpcError):
+        l1.rpc.pay(inv['bolt11'])
+
+    for i in range(5):
+        l3.rpc.invoice(1000, 'expiring{}'.format(i), 'desc', expiry=1)
+
+    # More than a batch each, so they take several calls.
+    wait_for(lambda: l1.rpc.listsendpays()['payments'] == [])
+    wait_for(lambda: l2.rpc.listforwards()['forwards'] == [])
+    wait_for(lambda: [i['label'] for i in l3.rpc.listinvoices()['invoices']] == ['paid0', 'paid1', 'paid2'])
+
+    status = l1.rpc.call('autoclean-status')['autoclean']
+    assert status['succeededpays'] == {'enabled': True, 'age': 2, 'cleaned': 3}
+    assert status['failedpays']['cleaned'] >= 1
+    assert status['expiredinvoices'] == {'enabled': False, 'cleaned': 0}
+    status = l2.rpc.call('autoclean-status')['autoclean']
+    assert status['succeededforwards'] == {'enabled': True, 'age': 2, 'cleaned': 3}
+    assert status['failedforwards']['cleaned'] == 1
+    assert l3.rpc.call('autoclean-status', {'subsystem': 'expiredinvoices'})['autoclean']['expiredinvoices']['cleaned'] == 5
+    l3.daemon.wait_for_log(r'Cleaned [1-9][0-9]* expiredinvoices in [0-9]* msec')
+
+    # delrecords directly: nothing left.
+    assert l2.rpc.call('delrecords', {'subsystem': 'failedforwards',
+                                      'before': int(time.time()),
+                                      'limit': 1}) == {'subsystem': 'failedforwards', 'deleted': 0}
+
+
 def test_decode_unknown(node_factory):
     l1 = node_factory.get_node()
 
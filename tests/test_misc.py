@@ -2325,6 +2325,51 @@ def test_emergencyrecover(node_factory, bitcoind):
     assert listfunds["short_channel_id"] == "1x1x1"
 
 
+@unittest.skipIf(os.getenv('TEST_DB_PROVIDER', 'sqlite3') != 'sqlite3', "deletes database, which is assumed sqlite3")
+@pytest.mark.developer("needs dev-scb-debounce")
+def test_emergencyrecover_coalesce(node_factory, bitcoind):
+    """
+    A burst of channel state changes is coalesced into one write.
+    """
+    # Long enough that the whole burst lands inside it.
+    l1, l2, l3, l4 = node_factory.get_nodes(4, opts=[{'dev-scb-debounce': 10}, {}, {}, {}])
+    l1.fundwallet(2000000)
+
+    destinations = [{"id": '{}@localhost:{}'.format(l.info['id'], l.port),
+                     "amount": 50000} for l in (l2, l3, l4)]
+    l1.rpc.multifundchannel(destinations)
+    bitcoind.generate_block(6, wait_for_mempool=1)
+    l1.daemon.wait_for_logs([r'to CHANNELD_NORMAL'] * 3)
+
+    l1.daemon.wait_for_log(r'Updated the SCB with 3 channels \(3 state changes, 1 writes\)')
+    assert not l1.daemon.is_in_log(r'Updated the SCB with [0-2] channels')
+
+    l1.stop()
+    os.unlink(os.path.join(l1.daemon.lightning_dir, TEST_NETWORK, "lightningd.sqlite3"))
+    l1.start()
+    assert len(l1.rpc.emergencyrecover()["stubs"]) == 3
+
+
+@unittest.skipIf(os.getenv('TEST_DB_PROVIDER', 'sqlite3') != 'sqlite3', "deletes database, which is assumed sqlite3")
+@pytest.mark.developer("needs dev-scb-debounce")
+def test_emergencyrecover_shutdown(node_factory, bitcoind):
+    """
+    A change still waiting out the debounce is written on shutdown.
+    """
+    # Far longer than the test, so only shutdown can write it.
+    l1, l2 = node_factory.get_nodes(2, opts=[{'dev-scb-debounce': 3600}, {}])
+    l1.rpc.connect(l2.info['id'], 'localhost', l2.port)
+    _, res = l1.fundchannel(l2, 10**5)
+
+    assert not l1.daemon.is_in_log(r'Updated the SCB with')
+    l1.stop()
+
+    os.unlink(os.path.join(l1.daemon.lightning_dir, TEST_NETWORK, "lightningd.sqlite3"))
+    l1.start()
+    stubs = l1.rpc.emergencyrecover()["stubs"]
+    assert stubs == [res["channel_id"]]
+
+
 def test_commitfee_option(node_factory):
     """Sanity check for the --commit-fee startup option."""
     l1, l2 = node_factory.get_nodes(2, opts=[{"commit-fee": "200"}, {}])
@@ -2488,6 +2533,102 @@ def test_getlog(node_factory):
     logs = l1.rpc.getlog(level='io')['log']
     assert [l for l in logs if l['type'] == 'SKIPPED'] == []
 
+    # In pieces, we get the same thing.
+    full = l1.rpc.getlog(level='io')
+    pieces = []
+    since = 0
+    while since < full['next_seq']:
+        part = l1.rpc.getlog(level='io', since=since, limit=100)
+        assert len(part['log']) <= 100
+        pieces += part['log']
+        since = part['next_seq']
+    assert pieces[:len(full['log'])] == full['log']
+
+    # Nothing unusual since then (getlog itself logs, at io level!)
+    since = l1.rpc.getlog()['next_seq']
+    assert since >= full['next_seq']
+    assert l1.rpc.getlog(level='unusual', since=since)['log'] == []
+
+
+def test_getlog_streaming(node_factory):
+    """getlog keeps adding entries as a slow client reads them"""
+    l1 = node_factory.get_node()
+
+    # Each command logs its request and response at io level: that's
+    # a couple of batches' worth.
+    for i in range(1000):
+        l1.rpc.getinfo()
+    full = l1.rpc.getlog(level='io')
+    assert len(full['log']) > 2000
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    sock.connect(l1.rpc.socket_path)
+    req = {'id': 1, 'jsonrpc': '2.0', 'method': 'getlog',
+           'params': {'level': 'io', 'limit': len(full['log'])}}
+    sock.sendall(json.dumps(req).encode())
+
+    # Dribble out the first part, so lightningd has to wait for us.
+    buff = b''
+    for i in range(100):
+        buff += sock.recv(1024)
+        time.sleep(0.01)
+    obj, _ = l1.rpc._readobj(sock, buff)
+    sock.close()
+
+    assert obj['result']['log'] == full['log']
+    assert obj['result']['next_seq'] == full['next_seq']
+
+
+def test_getlog_close(node_factory):
+    """getlog stops cleanly if the client goes away part-way through"""
+    l1 = node_factory.get_node()
+
+    for i in range(1000):
+        l1.rpc.getinfo()
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    sock.connect(l1.rpc.socket_path)
+    sock.sendall(b'{"id":1,"jsonrpc":"2.0","method":"getlog","params":{"level":"io"}}')
+
+    # Read a little, then hang up while it's waiting for us.
+    assert sock.recv(1024).startswith(b'{')
+    time.sleep(1)
+    sock.close()
+
+    # Closing the connection completes the command.
+    l1.daemon.wait_for_log('Command returned result after jcon close')
+    assert l1.rpc.getinfo()['id'] == l1.info['id']
+
+
+def test_getmetrics(node_factory):
+    """Test the getmetrics command and rpc-metrics-interval"""
+    l1 = node_factory.get_node(options={'rpc-metrics-interval': 1})
+
+    before = {m['method']: m for m in l1.rpc.getmetrics()['rpc']}
+    for _ in range(3):
+        l1.rpc.getinfo()
+    with pytest.raises(RpcError):
+        l1.rpc.getinfo('unexpected')
+    metrics = l1.rpc.getmetrics()
+
+    getinfo = [m for m in metrics['rpc'] if m['method'] == 'getinfo'][0]
+    calls = getinfo['calls'] - before.get('getinfo', {'calls': 0})['calls']
+    assert calls == 4
+    assert getinfo['failures'] == before.get('getinfo', {'failures': 0})['failures'] + 1
+    assert sum(b['count'] for b in getinfo['latency_histogram']) == getinfo['calls']
+    assert getinfo['max_usec'] <= getinfo['total_usec']
+    assert getinfo['bytes_in'] > 0
+    assert getinfo['bytes_out'] > 0
+    assert getinfo['allocations'] > 0
+    assert metrics['allocations'] >= getinfo['allocations']
+
+    # We don't count a command until it's complete.
+    assert 'getmetrics' in [m['method'] for m in l1.rpc.getmetrics()['rpc']]
+
+    l1.daemon.wait_for_log(r'JSON-RPC getinfo: [0-9]* calls \([0-9]* failed\), average [0-9]*usec, max [0-9]*usec')
+
 
 def test_log_filter(node_factory):
     """Test the log-level option with subsystem filters"""
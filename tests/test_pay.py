@@ -3881,6 +3881,82 @@ def test_mpp_adaptive(node_factory, bitcoind):
     assert 'bolt11' in only_one(l1.rpc.listpays()['pays'])
 
 
+def test_pay_mcf(node_factory, bitcoind):
+    """Like test_mpp_adaptive, but planning the parts with pay-mcf.
+
+    Neither path can carry it alone, and the gossip capacity of 109x1x1
+    says it could, so the first plan fails there and gets replanned.
+    ```dot
+    digraph {
+      l1 -> l2 [label="scid=103x1x1, cap=amt-1"];
+      l2 -> l4 [label="scid=105x1x1, cap=max"];
+      l1 -> l3 [label="scid=107x1x1, cap=max"];
+      l3 -> l4 [label="scid=109x1x1, cap=amt-1"];
+    }
+    """
+    amt = 10**7 - 1
+    l1, l2, l3, l4 = node_factory.get_nodes(4, opts=[{'pay-mcf': None},
+                                                     {}, {}, {}])
+
+    l1.connect(l2)
+    l2.connect(l4)
+    l1.connect(l3)
+    l3.connect(l4)
+
+    l2.fundchannel(l1, amt)
+    l2.fundchannel(l4, amt, wait_for_active=True)
+    l2.rpc.pay(l1.rpc.invoice(
+        amt + 99999000 - 1,  # Slightly less than amt + reserve
+        label="reb l1->l2",
+        description="Rebalance l1 -> l2"
+    )['bolt11'])
+
+    l1.fundchannel(l3, amt)
+    l4.fundchannel(l3, amt, wait_for_active=True)
+    l4.rpc.pay(l3.rpc.invoice(
+        amt + 99999000 - 1,  # Slightly less than amt + reserve
+        label="reb l3->l4",
+        description="Rebalance l3 -> l4"
+    )['bolt11'])
+
+    c12 = l1.rpc.listpeers(l2.info['id'])['peers'][0]['channels'][0]
+    c34 = l3.rpc.listpeers(l4.info['id'])['peers'][0]['channels'][0]
+    assert(c12['spendable_msat'].millisatoshis < amt)
+    assert(c34['spendable_msat'].millisatoshis < amt)
+
+    def all_htlcs(n):
+        htlcs = []
+        for p in n.rpc.listpeers()['peers']:
+            for c in p['channels']:
+                htlcs += c['htlcs']
+        return htlcs
+
+    wait_for(lambda: all([all_htlcs(n) == [] for n in [l1, l2, l3, l4]]))
+
+    mine_funding_to_announce(bitcoind, [l1, l2, l3, l4])
+    wait_for(lambda: len(l1.rpc.listchannels()['channels']) == 8)
+
+    inv = l4.rpc.invoice(amt, label="mcf", description="mcf")['bolt11']
+    l1.rpc.pay(inv)
+
+    # It planned, rather than falling back to the heuristics...
+    assert not l1.daemon.is_in_log('Could not plan parts')
+    plans = [l for l in l1.daemon.logs
+             if re.search(r'Planned [0-9]+ sub-payments for', l)]
+    # ... once at the start, and again for what failed at l3.
+    assert len(plans) >= 2
+    assert l1.daemon.is_in_log(r'partid 0: Planned [0-9]+ sub-payments for {}msat'.format(amt))
+
+    # It had to go through both l2 and l3.
+    complete = [p for p in l1.rpc.listsendpays(inv)['payments']
+                if p['status'] == 'complete']
+    assert len(complete) >= 2
+    total = sum([p['amount_msat'] for p in complete], Millisatoshi(0))
+    assert total == Millisatoshi(amt)
+    for n in (l2, l3):
+        assert n.rpc.listforwards(status='settled')['forwards'] != []
+
+
 def test_pay_fail_unconfirmed_channel(node_factory, bitcoind):
     '''
     Replicate #3855.
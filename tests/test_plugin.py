@@ -1742,6 +1742,35 @@ def test_bcli(node_factory, bitcoind, chainparams):
     assert not resp["success"] and "decode failed" in resp["errmsg"]
 
 
+def test_hook_observer(node_factory):
+    """Observers are called alongside the chain, and we don't wait for them"""
+    opts = [{'plugin': [os.path.join(os.getcwd(), 'tests/plugins/hook-observer.py'),
+                        os.path.join(os.getcwd(), 'tests/plugins/peer_connected_logger_a.py')]},
+            {}]
+    l1, l2 = node_factory.get_nodes(2, opts=opts)
+
+    l2.connect(l1)
+    l1.daemon.wait_for_logs([f"Observing {l2.info['id']}",
+                             f"peer_connected_logger_a {l2.info['id']}"])
+
+    # It's connected before the observer has answered...
+    wait_for(lambda: only_one(l1.rpc.listpeers(l2.info['id'])['peers'])['connected'])
+    assert not l1.daemon.is_in_log('Observer hook-observer.py returned')
+
+    # ... and it still is after it tells us to disconnect.
+    l1.daemon.wait_for_log(r'Observer of peer_connected hook returned .*disconnect.*: ignoring')
+    assert only_one(l1.rpc.listpeers(l2.info['id'])['peers'])['connected']
+
+    hook = only_one([h for h in l1.rpc.getmetrics()['hooks'] if h['hook'] == 'peer_connected'])
+    observer = only_one([p for p in hook['plugins'] if p['observer']])
+    assert observer['plugin'] == 'hook-observer.py'
+    assert observer['calls'] == 1
+    assert observer['max_usec'] >= 5000000
+    # We only waited for peer_connected_logger_a.
+    assert hook['calls'] == 1
+    assert hook['max_usec'] < observer['max_usec']
+
+
 def test_hook_crash(node_factory, executor, bitcoind):
     """Verify that we fail over if a plugin crashes while handling a hook.
 
@@ -2639,6 +2668,100 @@ def test_commando(node_factory, executor):
     assert exc_info.value.error['data']['erring_index'] == 0
 
 
+def test_commando_bigreply(node_factory):
+    """Replies much larger than the ack window get sent back intact"""
+    l1, l2 = node_factory.line_graph(2, fundchannel=False)
+    rune = l1.rpc.commando_rune()['rune']
+
+    # Several MB of invoices, so we have to wait for acks many times.
+    for i in range(20):
+        l1.rpc.createinvoices([{'amount_msat': 'any',
+                                'label': 'big{}-{}'.format(i, j),
+                                'description': 'D' * 600}
+                               for j in range(100)])
+
+    ret = l2.rpc.call(method='commando',
+                      payload={'peer_id': l1.info['id'],
+                               'rune': rune,
+                               'method': 'listinvoices'})
+    assert len(json.dumps(ret)) > 2 * 1000 * 1000
+    assert ret == l1.rpc.listinvoices()
+
+    # Errors still work the same way.
+    with pytest.raises(RpcError, match='Unknown command'):
+        l2.rpc.call(method='commando',
+                    payload={'peer_id': l1.info['id'],
+                             'rune': rune,
+                             'method': 'notacommand'})
+
+
+@pytest.mark.developer("needs dev-commando-ack-timeout")
+def test_commando_reply_noack(node_factory):
+    """A responder stops sending when the window is full, and gives up if
+    the requester never acks"""
+    l1, l2 = node_factory.line_graph(2, fundchannel=False,
+                                     opts=[{'dev-commando-ack-timeout': 5},
+                                           {}])
+    rune = l1.rpc.commando_rune()['rune']
+
+    # A few hundred kb of invoices: more than one message.
+    for i in range(3):
+        l1.rpc.createinvoices([{'amount_msat': 'any',
+                                'label': 'noack{}-{}'.format(i, j),
+                                'description': 'D' * 600}
+                               for j in range(100)])
+
+    # Send the command by hand, so l2's commando doesn't know the id and
+    # never acks.
+    cmd = json.dumps({'method': 'listinvoices',
+                      'params': {},
+                      'rune': rune,
+                      'window': 1})
+    l2.rpc.sendcustommsg(l1.info['id'],
+                         '4c4f' + '0000000000003039' + cmd.encode().hex())
+
+    l1.daemon.wait_for_log(r'no ack for reply to 12345 for 5 seconds, giving up')
+
+    # They only got the first message.
+    assert len([l for l in l2.daemon.logs
+                if 'Ignoring unexpected partial result' in l
+                and '(id 12345)' in l]) == 1
+
+    # And it still works for a requester which acks.
+    assert l2.rpc.call(method='commando',
+                       payload={'peer_id': l1.info['id'],
+                                'rune': rune,
+                                'method': 'listinvoices'}) == l1.rpc.listinvoices()
+
+
+@pytest.mark.developer("needs dev-commando-max-replies-held")
+def test_commando_replies_held(node_factory):
+    """A responder refuses large replies once it holds too many"""
+    l1, l2 = node_factory.line_graph(2, fundchannel=False,
+                                     opts=[{'dev-commando-max-replies-held': 100000},
+                                           {}])
+    rune = l1.rpc.commando_rune()['rune']
+
+    for i in range(3):
+        l1.rpc.createinvoices([{'amount_msat': 'any',
+                                'label': 'held{}-{}'.format(i, j),
+                                'description': 'D' * 600}
+                               for j in range(100)])
+
+    with pytest.raises(RpcError, match='Too many large replies in flight'):
+        l2.rpc.call(method='commando',
+                    payload={'peer_id': l1.info['id'],
+                             'rune': rune,
+                             'method': 'listinvoices'})
+    l1.daemon.wait_for_log(r'already holding 0 bytes of replies, refusing')
+
+    # Small replies don't need holding.
+    assert l2.rpc.call(method='commando',
+                       payload={'peer_id': l1.info['id'],
+                                'rune': rune,
+                                'method': 'getinfo'})['id'] == l1.info['id']
+
+
 def test_commando_rune(node_factory):
     l1, l2 = node_factory.line_graph(2, fundchannel=False)
 
@@ -5,7 +5,7 @@ set -e
 
 DIR=""
 TARGETS=""
-DEFAULT_TARGETS=" store_load_msec vsz_kb store_rewrite_sec listnodes_sec listchannels_sec routing_sec peer_write_all_sec peer_read_all_sec "
+DEFAULT_TARGETS=" store_compact_offline_msec store_load_msec vsz_kb store_rewrite_sec store_rewrite_step_msec store_rewrite_read_kb listnodes_sec listchannels_sec routing_sec peer_write_all_sec query_range_sec peer_read_all_sec "
 MCP_DIR=../million-channels-project/data/1M/gossip/
 CSV=false
 
@@ -109,6 +109,9 @@ ID=$(wait_for_start)
 while ! grep -q 'gossipd.*: total store load time' "$DIR"/log 2>/dev/null; do
     sleep 1
 done
+if [ -z "${TARGETS##* store_compact_offline_msec *}" ]; then
+    grep 'gossipd.*: gossip_store_compact_offline: .* copied in' "$DIR"/log | sed 's/.* copied in \([0-9]*\) msec.*/\1/' | print_stat store_compact_offline_msec
+fi
 if [ -z "${TARGETS##* store_load_msec *}" ]; then
     grep 'gossipd.*: total store load time' "$DIR"/log | cut -d\  -f7 | print_stat store_load_msec
 fi
@@ -124,6 +127,15 @@ if [ -z "${TARGETS##* store_rewrite_sec *}" ] && [ "$DEVELOPER" = 1 ]; then
     /usr/bin/time --append -f %e $LCLI1 dev-compact-gossip-store 2>&1 > /dev/null | print_stat store_rewrite_sec
 fi
 
+# Compaction normally runs in the background: the longest step is how long
+# it stalls gossipd, and it only reads the store once.
+if [ -z "${TARGETS##* store_rewrite_step_msec *}" ] && [ "$DEVELOPER" = 1 ]; then
+    grep 'gossipd.*: Compaction took' "$DIR"/log | tail -n1 | sed 's/.*(longest \([0-9]*\) msec).*/\1/' | print_stat store_rewrite_step_msec
+fi
+if [ -z "${TARGETS##* store_rewrite_read_kb *}" ] && [ "$DEVELOPER" = 1 ]; then
+    grep 'gossipd.*: Compaction took' "$DIR"/log | tail -n1 | sed 's/.*read \([0-9]*\) bytes.*/\1/' | awk '{ print int($1 / 1024) }' | print_stat store_rewrite_read_kb
+fi
+
 # Now, how long does listnodes take?
 if [ -z "${TARGETS##* listnodes_sec *}" ]; then
     # shellcheck disable=SC2086
@@ -155,6 +167,13 @@ if [ -z "${TARGETS##* peer_write_all_sec *}" ]; then
     /usr/bin/time --quiet --append -f %e devtools/gossipwith --initial-sync --max-messages=$((ENTRIES - 5)) "$ID"@"$DIR"/peer 2>&1 > /dev/null | print_stat peer_write_all_sec
 fi
 
+# Ask for every channel, with timestamps and checksums (query_option 3).
+if [ -z "${TARGETS##* query_range_sec *}" ]; then
+    QUERY=$(devtools/mkquery query_channel_range 06226e46111a0b59caaf126043eb5bbf28c34f3a5e332a1fc7b2b73cf188910f 0 4294967295 3)
+    # gossipwith exits 1 second after the final reply_channel_range.
+    /usr/bin/time --quiet --append -f %e devtools/gossipwith --max-messages=1000000 --timeout-after=1 "$ID"@"$DIR"/peer "$QUERY" 2>&1 > /dev/null | awk '{ print $1 - 1 }' | print_stat query_range_sec
+fi
+
 # Needs DEVELOPER otherwise timestamps will be more than 2 weeks old and it
 # will ignore gossip.
 if [ -z "${TARGETS##* peer_read_all_sec *}" ] && [ "$DEVELOPER" = 1 ]; then
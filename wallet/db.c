@@ -59,6 +59,10 @@ static void fillin_missing_channel_blockheights(struct lightningd *ld,
 						struct db *db,
 						const struct migration_context *mc);
 
+static void fillin_htlc_sigs_idx(struct lightningd *ld,
+				 struct db *db,
+				 const struct migration_context *mc);
+
 /* Do not reorder or remove elements from this array, it is used to
  * migrate existing databases from a previous state, based on the
  * string indices */
@@ -883,6 +887,72 @@ static struct migration dbmigrations[] = {
      * in routehints in invoices. The peer will remember all the
      * aliases, but we only ever need one. */
     {SQL("ALTER TABLE channels ADD alias_remote BIGINT DEFAULT NULL"), NULL},
+    /* Cache of derived pubkeys: deriving them all at startup is slow
+     * for wallets which have handed out lots of addresses. */
+    {SQL("CREATE TABLE bip32_derkeys ("
+	 "  keyidx BIGINT"
+	 ", derkey BLOB"
+	 ", PRIMARY KEY (keyidx)"
+	 ");"),
+     NULL},
+    /* We load every channel's htlc_sigs at once, so we need an explicit
+     * order: they're in the order of the HTLC outputs. */
+    {SQL("ALTER TABLE htlc_sigs ADD idx INTEGER DEFAULT 0"),
+     fillin_htlc_sigs_idx},
+    /* delrecords deletes old forwards, oldest first, a limited number at
+     * a time: that needs a key (in/out_htlc_id can be NULL), and an index
+     * so it doesn't scan the whole table each time. */
+    {SQL("ALTER TABLE forwarded_payments RENAME TO temp_forwarded_payments;"),
+     NULL},
+    {SQL("CREATE TABLE forwarded_payments ("
+	 "  id BIGSERIAL"
+	 ", in_htlc_id BIGINT REFERENCES channel_htlcs(id) ON DELETE SET NULL"
+	 ", out_htlc_id BIGINT REFERENCES channel_htlcs(id) ON DELETE SET NULL"
+	 ", in_channel_scid BIGINT"
+	 ", out_channel_scid BIGINT"
+	 ", in_msatoshi BIGINT"
+	 ", out_msatoshi BIGINT"
+	 ", state INTEGER"
+	 ", received_time BIGINT"
+	 ", resolved_time BIGINT"
+	 ", failcode INTEGER"
+	 ", forward_style INTEGER"
+	 ", PRIMARY KEY (id)"
+	 ", UNIQUE(in_htlc_id, out_htlc_id)"
+	 ");"),
+     NULL},
+    {SQL("INSERT INTO forwarded_payments ("
+	 "  in_htlc_id"
+	 ", out_htlc_id"
+	 ", in_channel_scid"
+	 ", out_channel_scid"
+	 ", in_msatoshi"
+	 ", out_msatoshi"
+	 ", state"
+	 ", received_time"
+	 ", resolved_time"
+	 ", failcode"
+	 ", forward_style"
+	 ") SELECT"
+	 "  in_htlc_id"
+	 ", out_htlc_id"
+	 ", in_channel_scid"
+	 ", out_channel_scid"
+	 ", in_msatoshi"
+	 ", out_msatoshi"
+	 ", state"
+	 ", received_time"
+	 ", resolved_time"
+	 ", failcode"
+	 ", forward_style"
+	 " FROM temp_forwarded_payments;"),
+     NULL},
+    {SQL("DROP TABLE temp_forwarded_payments;"), NULL},
+    {SQL("CREATE INDEX forwarded_payments_out_htlc_id"
+	 " ON forwarded_payments (out_htlc_id);"), NULL},
+    {SQL("CREATE INDEX forwarded_payments_state_time"
+	 " ON forwarded_payments"
+	 " (state, COALESCE(resolved_time, received_time));"), NULL},
 };
 
 /**
@@ -980,6 +1050,52 @@ static void migrate_pr2342_feerate_per_channel(struct lightningd *ld, struct db
 	tal_free(stmt);
 }
 
+/* We used to rely on each channel's htlc_sigs coming back in the order we
+ * inserted them, so number them in that order. */
+static void fillin_htlc_sigs_idx(struct lightningd *ld,
+				 struct db *db,
+				 const struct migration_context *mc)
+{
+	struct db_stmt *stmt;
+	u64 *channelids = tal_arr(tmpctx, u64, 0);
+
+	stmt = db_prepare_v2(db, SQL("SELECT DISTINCT channelid"
+				     " FROM htlc_sigs;"));
+	db_query_prepared(stmt);
+	while (db_step(stmt))
+		tal_arr_expand(&channelids, db_col_u64(stmt, "channelid"));
+	tal_free(stmt);
+
+	for (size_t i = 0; i < tal_count(channelids); i++) {
+		secp256k1_ecdsa_signature *sigs
+			= tal_arr(tmpctx, secp256k1_ecdsa_signature, 0);
+
+		stmt = db_prepare_v2(db, SQL("SELECT signature FROM htlc_sigs"
+					     " WHERE channelid = ?"));
+		db_bind_u64(stmt, 0, channelids[i]);
+		db_query_prepared(stmt);
+		while (db_step(stmt)) {
+			secp256k1_ecdsa_signature sig;
+			if (!db_col_signature(stmt, "signature", &sig))
+				db_fatal("Bad htlc_sigs signature for channel"
+					 " %"PRIu64, channelids[i]);
+			tal_arr_expand(&sigs, sig);
+		}
+		tal_free(stmt);
+
+		for (size_t j = 0; j < tal_count(sigs); j++) {
+			stmt = db_prepare_v2(db, SQL("UPDATE htlc_sigs"
+						     " SET idx = ?"
+						     " WHERE channelid = ?"
+						     " AND signature = ?"));
+			db_bind_int(stmt, 0, j);
+			db_bind_u64(stmt, 1, channelids[i]);
+			db_bind_signature(stmt, 2, &sigs[j]);
+			db_exec_prepared_v2(take(stmt));
+		}
+	}
+}
+
 /* We've added a column `our_funding_satoshis`, since channels can now
  * have funding for either channel participant. We need to 'backfill' this
  * data, however. We can do this using the fact that our_funding_satoshi
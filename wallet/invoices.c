@@ -451,6 +451,27 @@ void invoices_delete_expired(struct invoices *invoices,
 	db_exec_prepared_v2(take(stmt));
 }
 
+size_t invoices_delete_expired_limit(struct invoices *invoices,
+				     u64 max_expiry_time, u32 limit)
+{
+	struct db_stmt *stmt;
+	size_t deleted;
+
+	stmt = db_prepare_v2(invoices->db, SQL(
+			  "DELETE FROM invoices"
+			  " WHERE id IN (SELECT id FROM invoices"
+			  "  WHERE state = ?"
+			  "    AND expiry_time <= ?"
+			  "  ORDER BY id LIMIT ?);"));
+	db_bind_int(stmt, 0, EXPIRED);
+	db_bind_u64(stmt, 1, max_expiry_time);
+	db_bind_u64(stmt, 2, limit);
+	db_exec_prepared_v2(stmt);
+	deleted = db_count_changes(stmt);
+	tal_free(stmt);
+	return deleted;
+}
+
 bool invoices_iterate(struct invoices *invoices,
 		      struct invoice_iterator *it)
 {
@@ -129,6 +129,19 @@ bool invoices_delete_description(struct invoices *invoices,
 void invoices_delete_expired(struct invoices *invoices,
 			     u64 max_expiry_time);
 
+/**
+ * invoices_delete_expired_limit - Delete some expired invoices
+ * with expiration time less than or equal to the given.
+ *
+ * @invoices - the invoice handler.
+ * @max_expiry_time - the maximum expiry time to delete.
+ * @limit - the maximum number to delete (must be > 0).
+ *
+ * Returns the number deleted: if it's less than @limit, there are no more.
+ */
+size_t invoices_delete_expired_limit(struct invoices *invoices,
+				     u64 max_expiry_time, u32 limit);
+
 /**
  * invoices_iterate - Iterate over all existing invoices
  *
@@ -2,8 +2,8 @@
 #include "config.h"
 #include <bitcoin/psbt.h>
 #include <bitcoin/script.h>
-#include <ccan/cast/cast.h>
 #include <ccan/mem/mem.h>
+#include <common/coinselect.h>
 #include <common/configdir.h>
 #include <common/json_command.h>
 #include <common/json_param.h>
@@ -243,6 +243,18 @@ static bool inputs_sufficient(struct amount_sat input,
 	return false;
 }
 
+/* Fee for @weight, rounded up, so fees for the parts of a tx add up to at
+ * least the fee for the whole. */
+static struct amount_sat fee_roundup(u32 feerate_per_kw, size_t weight)
+{
+	struct amount_sat fee = amount_tx_fee(feerate_per_kw, weight);
+
+	if ((u64)feerate_per_kw * weight % 1000 != 0
+	    && !amount_sat_add(&fee, fee, AMOUNT_SAT(1)))
+		abort();
+	return fee;
+}
+
 static struct wally_psbt *psbt_using_utxos(const tal_t *ctx,
 					   struct wallet *wallet,
 					   struct utxo **utxos,
@@ -463,11 +475,13 @@ static struct command_result *json_fundpsbt(struct command *cmd,
 					      const jsmntok_t *params)
 {
 	struct utxo **utxos;
+	const struct utxo **usable;
 	u32 *feerate_per_kw;
 	u32 *minconf, *weight, *min_witness_weight;
-	struct amount_sat *amount, input, diff;
+	struct amount_sat *amount, *effective, input, diff;
 	bool all, *excess_as_change;
 	u32 *locktime, *reserve, maxheight;
+	size_t *sel;
 
 	if (!param(cmd, buffer, params,
 		   p_req("satoshi", param_sat_or_all, &amount),
@@ -487,47 +501,74 @@ static struct command_result *json_fundpsbt(struct command *cmd,
 	all = amount_sat_eq(*amount, AMOUNT_SAT(-1ULL));
 	maxheight = minconf_to_maxheight(*minconf, cmd->ld);
 
-	/* We keep adding until we meet their output requirements. */
-	utxos = tal_arr(cmd, struct utxo *, 0);
+	usable = wallet_usable_utxos(tmpctx, cmd->ld->wallet,
+				     cmd->ld->topology->tip->height,
+				     maxheight);
 
-	input = AMOUNT_SAT(0);
-	while (!inputs_sufficient(input, *amount, *feerate_per_kw, *weight,
-				  &diff)) {
-		struct utxo *utxo;
+	/* What each one is worth once it's paid for its own weight. */
+	effective = tal_arr(tmpctx, struct amount_sat, tal_count(usable));
+	for (size_t i = 0; i < tal_count(usable); i++) {
 		struct amount_sat fee;
-		u32 utxo_weight;
-
-		utxo = wallet_find_utxo(utxos, cmd->ld->wallet,
-					cmd->ld->topology->tip->height,
-					&diff,
-					*feerate_per_kw,
-					maxheight,
-					cast_const2(const struct utxo **, utxos));
-		if (utxo) {
-			utxo_weight = utxo_spend_weight(utxo,
-							*min_witness_weight);
-			fee = amount_tx_fee(*feerate_per_kw, utxo_weight);
-
-			/* Uneconomic to add this utxo, skip it */
-			if (!all && amount_sat_greater_eq(fee, utxo->amount))
-				continue;
-
-			tal_arr_expand(&utxos, utxo);
-
-			/* It supplies more input. */
-			if (!amount_sat_add(&input, input, utxo->amount))
-				return command_fail(cmd, LIGHTNINGD,
-						    "impossible UTXO value");
-
-			/* But also adds weight */
-			*weight += utxo_weight;
-			continue;
+
+		fee = fee_roundup(*feerate_per_kw,
+				  utxo_spend_weight(usable[i],
+						    *min_witness_weight));
+		/* Uneconomic to add this utxo */
+		if (!amount_sat_sub(&effective[i], usable[i]->amount, fee))
+			effective[i] = AMOUNT_SAT(0);
+	}
+
+	if (all) {
+		/* Everything, even the uneconomic ones. */
+		sel = tal_arr(tmpctx, size_t, tal_count(usable));
+		for (size_t i = 0; i < tal_count(usable); i++)
+			sel[i] = i;
+	} else {
+		struct amount_sat target, cost_of_change;
+
+		/* Making change costs its own output now, and spending it
+		 * later. */
+		cost_of_change = amount_tx_fee(*feerate_per_kw,
+					       bitcoin_tx_output_weight(BITCOIN_SCRIPTPUBKEY_P2WPKH_LEN)
+					       + bitcoin_tx_simple_input_weight(false));
+		if (amount_sat_add(&target, *amount,
+				   amount_tx_fee(*feerate_per_kw, *weight)))
+			sel = coinselect(tmpctx, effective, target,
+					 cost_of_change);
+		else
+			sel = NULL;
+
+		/* Can't do it: use all the economic ones, to say how short
+		 * we are. */
+		if (!sel) {
+			sel = tal_arr(tmpctx, size_t, 0);
+			for (size_t i = 0; i < tal_count(usable); i++) {
+				if (!amount_sat_zero(effective[i]))
+					tal_arr_expand(&sel, i);
+			}
 		}
+	}
 
-		/* If they said "all", we expect to run out of utxos. */
-		if (all && tal_count(utxos))
-			break;
+	utxos = tal_arr(cmd, struct utxo *, tal_count(sel));
+	input = AMOUNT_SAT(0);
+	for (size_t i = 0; i < tal_count(sel); i++) {
+		/* Our own copy: reserving them changes the wallet's ones. */
+		utxos[i] = wallet_utxo_get(utxos, cmd->ld->wallet,
+					   &usable[sel[i]]->outpoint);
+
+		/* It supplies more input. */
+		if (!amount_sat_add(&input, input, utxos[i]->amount))
+			return command_fail(cmd, LIGHTNINGD,
+					    "impossible UTXO value");
+
+		/* But also adds weight */
+		*weight += utxo_spend_weight(utxos[i], *min_witness_weight);
+	}
 
+	/* If they said "all", any utxos will do. */
+	if (all ? tal_count(utxos) == 0
+	    : !inputs_sufficient(input, *amount, *feerate_per_kw, *weight,
+				 &diff)) {
 		/* Since it's possible the lack of utxos is because we haven't
 		 * finished syncing yet, report a sync timing error first */
 		if (!topology_synced(cmd->ld->topology))
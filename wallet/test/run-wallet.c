@@ -225,6 +225,10 @@ bool invoices_delete_description(struct invoices *invoices UNNEEDED,
 void invoices_delete_expired(struct invoices *invoices UNNEEDED,
 			     u64 max_expiry_time UNNEEDED)
 { fprintf(stderr, "invoices_delete_expired called!\n"); abort(); }
+/* Generated stub for invoices_delete_expired_limit */
+size_t invoices_delete_expired_limit(struct invoices *invoices UNNEEDED,
+				     u64 max_expiry_time UNNEEDED, u32 limit UNNEEDED)
+{ fprintf(stderr, "invoices_delete_expired_limit called!\n"); abort(); }
 /* Generated stub for invoices_find_by_label */
 bool invoices_find_by_label(struct invoices *invoices UNNEEDED,
 			    struct invoice *pinvoice UNNEEDED,
@@ -966,6 +970,7 @@ static struct wallet *create_test_wallet(struct lightningd *ld, const tal_t *ctx
 
 	list_head_init(&w->unstored_payments);
 	w->ld = ld;
+	w->unspent = NULL;
 	ld->wallet = w;
 
 	w->bip32_base = tal(w, struct ext_key);
@@ -1157,10 +1162,69 @@ static bool test_wallet_outputs(struct lightningd *ld, const tal_t *ctx)
 	/* Now un-reserve them */
 	tal_free(utxos);
 
+	/* The in-memory index agrees, and is sorted by amount */
+	utxos = wallet_usable_utxos(w, w, 100, 0);
+	CHECK(tal_count(utxos) == 2);
+	utxos = wallet_usable_utxos(w, w, 104, 0);
+	CHECK(tal_count(utxos) == 3);
+	for (size_t i = 1; i < tal_count(utxos); i++)
+		CHECK(amount_sat_less_eq(utxos[i-1]->amount, utxos[i]->amount));
+
+	/* It keeps up with reservations... */
+	one_utxo = wallet_utxo_get(w, w, &utxos[0]->outpoint);
+	CHECK(wallet_reserve_utxo(w, one_utxo, 104, 10));
+	CHECK(tal_count(wallet_usable_utxos(w, w, 104, 0)) == 2);
+	CHECK(tal_count(wallet_usable_utxos(w, w, 114, 0)) == 3);
+
+	/* ... and spends. */
+	CHECK(wallet_update_output_status(w, &one_utxo->outpoint,
+					  OUTPUT_STATE_ANY,
+					  OUTPUT_STATE_SPENT));
+	CHECK(tal_count(wallet_usable_utxos(w, w, 114, 0)) == 2);
+
 	db_commit_transaction(w->db);
 	return true;
 }
 
+static bool wallet_shachain_load(struct wallet *wallet, u64 id,
+				 struct wallet_shachain *chain)
+{
+	struct db_stmt *stmt;
+	chain->id = id;
+	shachain_init(&chain->chain);
+
+	/* Load shachain metadata */
+	stmt = db_prepare_v2(
+	    wallet->db,
+	    SQL("SELECT min_index, num_valid FROM shachains WHERE id=?"));
+	db_bind_u64(stmt, 0, id);
+	db_query_prepared(stmt);
+
+	if (!db_step(stmt)) {
+		tal_free(stmt);
+		return false;
+	}
+
+	chain->chain.min_index = db_col_u64(stmt, "min_index");
+	chain->chain.num_valid = db_col_u64(stmt, "num_valid");
+	tal_free(stmt);
+
+	/* Load shachain known entries */
+	stmt = db_prepare_v2(wallet->db,
+			     SQL("SELECT idx, hash, pos FROM shachain_known "
+				 "WHERE shachain_id=?"));
+	db_bind_u64(stmt, 0, id);
+	db_query_prepared(stmt);
+
+	while (db_step(stmt)) {
+		int pos = db_col_int(stmt, "pos");
+		chain->chain.known[pos].index = db_col_u64(stmt, "idx");
+		db_col_sha256(stmt, "hash", &chain->chain.known[pos].hash);
+	}
+	tal_free(stmt);
+	return true;
+}
+
 static bool test_shachain_crud(struct lightningd *ld, const tal_t *ctx)
 {
 	struct wallet_shachain a, b;
@@ -1699,6 +1763,33 @@ static bool test_channel_inflight_crud(struct lightningd *ld, const tal_t *ctx)
 	return true;
 }
 
+static bool wallet_channel_config_load(struct wallet *w, const u64 id,
+				       struct channel_config *cc)
+{
+	struct db_stmt *stmt;
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT dust_limit_satoshis"
+					", max_htlc_value_in_flight_msat"
+					", channel_reserve_satoshis"
+					", htlc_minimum_msat"
+					", to_self_delay"
+					", max_accepted_htlcs"
+					", max_dust_htlc_exposure_msat"
+					" FROM channel_configs WHERE id = ?;"));
+	db_bind_u64(stmt, 0, id);
+	db_query_prepared(stmt);
+
+	if (!db_step(stmt)) {
+		tal_free(stmt);
+		return false;
+	}
+
+	cc->id = id;
+	wallet_stmt2channel_config(stmt, cc);
+	tal_free(stmt);
+	return true;
+}
+
 static bool test_channel_config_crud(struct lightningd *ld, const tal_t *ctx)
 {
 	struct channel_config *cc1 = talz(ctx, struct channel_config),
@@ -1803,20 +1894,26 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	htlc_in_map_init(htlcs_in);
 	htlc_out_map_init(htlcs_out);
 
+	/* The loaders only find channels which lightningd knows about. */
+	list_head_init(&peer->channels);
+	list_add_tail(&peer->channels, &chan->list);
+	list_add_tail(&ld->peers, &peer->list);
+
 	db_begin_transaction(w->db);
 	CHECK(!wallet_err);
 
-	CHECK_MSG(wallet_htlcs_load_in_for_channel(w, chan, htlcs_in),
+	CHECK_MSG(wallet_htlcs_load_in(w, htlcs_in),
 		  "Failed loading in HTLCs");
 	/* Freed by htlcs_resubmit */
 	rem = tal(NULL, struct htlc_in_map);
 	htlc_in_map_copy(rem, htlcs_in);
-	CHECK_MSG(wallet_htlcs_load_out_for_channel(w, chan, htlcs_out, rem),
+	CHECK_MSG(wallet_htlcs_load_out(w, htlcs_out, rem),
 		  "Failed loading out HTLCs");
 	db_commit_transaction(w->db);
 
 	htlcs_resubmit(w->ld, rem);
 	CHECK(!wallet_err);
+	list_del_from(&ld->peers, &peer->list);
 
 	hin = htlc_in_map_get(htlcs_in, &in.key);
 	hout = htlc_out_map_get(htlcs_out, &out.key);
@@ -1834,6 +1931,153 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	return true;
 }
 
+/* Several channels on several peers, each with several HTLCs, some of
+ * them forwarded between channels: the bulk loaders have to hand every
+ * HTLC to the right channel, and skip closed channels. */
+static bool test_htlc_load_many(struct lightningd *ld, const tal_t *ctx)
+{
+	struct db_stmt *stmt;
+	struct wallet *w = create_test_wallet(ld, ctx);
+	struct htlc_in_map *htlcs_in = tal(ctx, struct htlc_in_map), *rem;
+	struct htlc_out_map *htlcs_out = tal(ctx, struct htlc_out_map);
+	const size_t num_chans = 4, num_htlcs = 3;
+	struct channel **chans = tal_arr(ctx, struct channel *, num_chans);
+	struct peer **peers = tal_arr(ctx, struct peer *, num_chans);
+	struct htlc_in *ins = tal_arrz(ctx, struct htlc_in,
+				       num_chans * num_htlcs);
+	struct htlc_out *outs = tal_arrz(ctx, struct htlc_out,
+					 num_chans * num_htlcs);
+	struct channel *closed = tal(ctx, struct channel);
+	struct htlc_in closed_in;
+
+	/* Other tests leave channels in ld->peers: keep clear of their
+	 * dbids. */
+	for (size_t i = 0; i < num_chans; i++) {
+		peers[i] = talz(peers, struct peer);
+		list_head_init(&peers[i]->channels);
+		chans[i] = talz(chans, struct channel);
+		chans[i]->dbid = 100 + i;
+		chans[i]->peer = peers[i];
+		chans[i]->next_index[LOCAL] = chans[i]->next_index[REMOTE] = 1;
+		list_add_tail(&peers[i]->channels, &chans[i]->list);
+	}
+	closed->dbid = 200;
+	closed->peer = talz(closed, struct peer);
+	closed->next_index[LOCAL] = closed->next_index[REMOTE] = 1;
+
+	db_begin_transaction(w->db);
+	stmt = db_prepare_v2(w->db, SQL("INSERT INTO channels (id, state)"
+					" VALUES (?, ?);"));
+	db_bind_u64(stmt, 0, closed->dbid);
+	db_bind_int(stmt, 1, CLOSED);
+	db_exec_prepared_v2(stmt);
+	tal_free(stmt);
+	for (size_t i = 0; i < num_chans; i++) {
+		stmt = db_prepare_v2(w->db, SQL("INSERT INTO channels (id, state)"
+						" VALUES (?, ?);"));
+		db_bind_u64(stmt, 0, chans[i]->dbid);
+		db_bind_int(stmt, 1, CHANNELD_NORMAL);
+		db_exec_prepared_v2(stmt);
+		tal_free(stmt);
+	}
+
+	/* An HTLC on a closed channel, which must not be loaded. */
+	memset(&closed_in, 0, sizeof(closed_in));
+	memset(&closed_in.payment_hash, 'C', sizeof(closed_in.payment_hash));
+	closed_in.key.id = 1;
+	closed_in.key.channel = closed;
+	closed_in.msat = AMOUNT_MSAT(1000);
+	closed_in.hstate = RCVD_ADD_COMMIT;
+	wallet_htlc_save_in(w, closed, &closed_in);
+
+	for (size_t i = 0; i < num_chans; i++) {
+		for (size_t j = 0; j < num_htlcs; j++) {
+			struct htlc_in *hin = &ins[i * num_htlcs + j];
+
+			memset(&hin->payment_hash, i * num_htlcs + j,
+			       sizeof(hin->payment_hash));
+			hin->key.id = j;
+			hin->key.channel = chans[i];
+			hin->msat = amount_msat(1000 + i * num_htlcs + j);
+			hin->hstate = RCVD_ADD_COMMIT;
+			wallet_htlc_save_in(w, chans[i], hin);
+		}
+	}
+
+	/* Forward each incoming HTLC out over the next channel. */
+	for (size_t i = 0; i < num_chans; i++) {
+		for (size_t j = 0; j < num_htlcs; j++) {
+			struct channel *next = chans[(i + 1) % num_chans];
+			struct htlc_out *hout = &outs[i * num_htlcs + j];
+
+			hout->in = &ins[i * num_htlcs + j];
+			hout->payment_hash = hout->in->payment_hash;
+			hout->key.id = i * num_htlcs + j;
+			hout->key.channel = next;
+			hout->msat = amount_msat(999 + i * num_htlcs + j);
+			hout->hstate = SENT_ADD_HTLC;
+			wallet_htlc_save_out(w, next, hout);
+		}
+	}
+	db_commit_transaction(w->db);
+	CHECK_MSG(!wallet_err, wallet_err);
+
+	for (size_t i = 0; i < num_chans; i++)
+		list_add_tail(&ld->peers, &peers[i]->list);
+
+	htlc_in_map_init(htlcs_in);
+	htlc_out_map_init(htlcs_out);
+
+	db_begin_transaction(w->db);
+	CHECK_MSG(wallet_htlcs_load_in(w, htlcs_in),
+		  "Failed loading in HTLCs");
+	/* Freed by htlcs_resubmit */
+	rem = tal(NULL, struct htlc_in_map);
+	htlc_in_map_copy(rem, htlcs_in);
+	CHECK_MSG(wallet_htlcs_load_out(w, htlcs_out, rem),
+		  "Failed loading out HTLCs");
+	db_commit_transaction(w->db);
+	CHECK(!wallet_err);
+
+	/* Every incoming HTLC was claimed by its outgoing one. */
+	CHECK(htlc_in_map_count(rem) == 0);
+	htlcs_resubmit(w->ld, rem);
+
+	for (size_t i = 0; i < num_chans; i++)
+		list_del_from(&ld->peers, &peers[i]->list);
+
+	CHECK(htlc_in_map_count(htlcs_in) == num_chans * num_htlcs);
+	CHECK(htlc_out_map_count(htlcs_out) == num_chans * num_htlcs);
+	CHECK(!htlc_in_map_get(htlcs_in, &closed_in.key));
+
+	for (size_t i = 0; i < num_chans * num_htlcs; i++) {
+		struct htlc_in *hin = htlc_in_map_get(htlcs_in, &ins[i].key);
+		struct htlc_out *hout = htlc_out_map_get(htlcs_out,
+							 &outs[i].key);
+
+		CHECK(hin != NULL);
+		CHECK(hin->key.channel == ins[i].key.channel);
+		CHECK(hin->dbid == ins[i].dbid);
+		CHECK(amount_msat_eq(hin->msat, ins[i].msat));
+		CHECK(sha256_eq(&hin->payment_hash, &ins[i].payment_hash));
+
+		CHECK(hout != NULL);
+		CHECK(hout->key.channel == outs[i].key.channel);
+		CHECK(hout->dbid == outs[i].dbid);
+		CHECK(amount_msat_eq(hout->msat, outs[i].msat));
+		CHECK(hout->in == hin);
+
+		/* Have to free manually, otherwise we get our dependencies
+		 * twisted */
+		tal_free(hin);
+		tal_free(hout);
+	}
+	htlc_in_map_clear(htlcs_in);
+	htlc_out_map_clear(htlcs_out);
+
+	return true;
+}
+
 static bool test_payment_crud(struct lightningd *ld, const tal_t *ctx)
 {
 	struct wallet_payment *t = tal(ctx, struct wallet_payment), *t2;
@@ -1852,6 +2096,7 @@ static bool test_payment_crud(struct lightningd *ld, const tal_t *ctx)
 	memset(&t->payment_hash, 1, sizeof(t->payment_hash));
 	t->partid = 0;
 	t->groupid = 12345;
+	t->timestamp = 1000;
 
 	db_begin_transaction(w->db);
 	t2 = tal_dup(NULL, struct wallet_payment, t);
@@ -1883,10 +2128,151 @@ static bool test_payment_crud(struct lightningd *ld, const tal_t *ctx)
 	CHECK(amount_msat_eq(t2->msatoshi_sent, t->msatoshi_sent));
 	CHECK(preimage_eq(t->payment_preimage, t2->payment_preimage));
 
+	/* Old ones get deleted in batches, newer ones are kept. */
+	for (size_t i = 1; i < 4; i++) {
+		t2 = tal_dup(NULL, struct wallet_payment, t);
+		t2->partid = i;
+		t2->timestamp = 100;
+		wallet_payment_setup(w, t2);
+		wallet_payment_store(w, take(t2));
+	}
+	CHECK(wallet_payments_delete_old(w, PAYMENT_FAILED, 100, 2) == 0);
+	CHECK(wallet_payments_delete_old(w, PAYMENT_COMPLETE, 100, 2) == 2);
+	CHECK(wallet_payments_delete_old(w, PAYMENT_COMPLETE, 100, 2) == 1);
+	CHECK(wallet_payments_delete_old(w, PAYMENT_COMPLETE, 100, 2) == 0);
+	CHECK(wallet_payment_by_hash(ctx, w, &t->payment_hash, t->partid, t->groupid));
+
 	db_commit_transaction(w->db);
 	return true;
 }
 
+static void add_forward(struct wallet *w, enum forward_status state,
+			u64 received, const u64 *resolved)
+{
+	struct db_stmt *stmt;
+
+	stmt = db_prepare_v2(w->db,
+			     SQL("INSERT INTO forwarded_payments ("
+				 "  in_channel_scid"
+				 ", in_msatoshi"
+				 ", state"
+				 ", received_time"
+				 ", resolved_time"
+				 ") VALUES (?, ?, ?, ?, ?);"));
+	db_bind_u64(stmt, 0, 1);
+	db_bind_u64(stmt, 1, 1000);
+	db_bind_int(stmt, 2, wallet_forward_status_in_db(state));
+	db_bind_u64(stmt, 3, received * 1000000000);
+	if (resolved)
+		db_bind_u64(stmt, 4, *resolved * 1000000000);
+	else
+		db_bind_null(stmt, 4);
+	db_exec_prepared_v2(take(stmt));
+}
+
+static size_t count_forwards(struct wallet *w, enum forward_status state,
+			     u64 resolved)
+{
+	struct db_stmt *stmt;
+	size_t count;
+
+	stmt = db_prepare_v2(w->db,
+			     SQL("SELECT COUNT(1) FROM forwarded_payments"
+				 " WHERE state = ?"
+				 " AND COALESCE(resolved_time, received_time) = ?;"));
+	db_bind_int(stmt, 0, wallet_forward_status_in_db(state));
+	db_bind_u64(stmt, 1, resolved * 1000000000);
+	db_query_prepared(stmt);
+	if (!db_step(stmt))
+		abort();
+	count = db_col_int(stmt, "COUNT(1)");
+	tal_free(stmt);
+	return count;
+}
+
+static bool test_forward_delete_old(struct lightningd *ld, const tal_t *ctx)
+{
+	struct wallet *w = create_test_wallet(ld, ctx);
+	u64 t50 = 50, t60 = 60, t200 = 200;
+
+	db_begin_transaction(w->db);
+	/* Five settled at the same time, and one before them */
+	add_forward(w, FORWARD_SETTLED, 10, &t60);
+	for (size_t i = 0; i < 5; i++)
+		add_forward(w, FORWARD_SETTLED, 10, &t50);
+	add_forward(w, FORWARD_SETTLED, 10, &t200);
+	/* Still in flight: never deleted */
+	add_forward(w, FORWARD_OFFERED, 10, NULL);
+	/* Failures, one of them local (which may not be resolved) */
+	add_forward(w, FORWARD_FAILED, 10, &t60);
+	add_forward(w, FORWARD_LOCAL_FAILED, 20, NULL);
+	add_forward(w, FORWARD_FAILED, 10, &t200);
+
+	/* Never more than limit, even if they tie. */
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_SETTLED, 100, 2) == 2);
+	CHECK(count_forwards(w, FORWARD_SETTLED, 50) == 3);
+	CHECK(count_forwards(w, FORWARD_SETTLED, 60) == 1);
+	/* Oldest first */
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_SETTLED, 100, 3) == 3);
+	CHECK(count_forwards(w, FORWARD_SETTLED, 50) == 0);
+	CHECK(count_forwards(w, FORWARD_SETTLED, 60) == 1);
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_SETTLED, 100, 3) == 1);
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_SETTLED, 100, 3) == 0);
+	CHECK(count_forwards(w, FORWARD_SETTLED, 200) == 1);
+	CHECK(count_forwards(w, FORWARD_OFFERED, 10) == 1);
+
+	/* Local failures count as failures, by received time. */
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_FAILED, 100, 1) == 1);
+	CHECK(count_forwards(w, FORWARD_LOCAL_FAILED, 20) == 0);
+	CHECK(wallet_forwarded_payments_delete_old(w, FORWARD_FAILED, 100, 5) == 1);
+	CHECK(count_forwards(w, FORWARD_FAILED, 60) == 0);
+	CHECK(count_forwards(w, FORWARD_FAILED, 200) == 1);
+	db_commit_transaction(w->db);
+	CHECK(!wallet_err);
+
+	return true;
+}
+
+static bool test_wallet_derkeys(struct lightningd *ld, const tal_t *ctx)
+{
+	struct wallet *w = create_test_wallet(ld, ctx);
+	struct db_stmt *stmt;
+	struct ext_key ext;
+	u8 *derkeys;
+
+	db_begin_transaction(w->db);
+	derkeys = wallet_derkeys(ctx, w, 9);
+	CHECK(tal_bytelen(derkeys) == 10 * PUBKEY_CMPR_LEN);
+
+	/* Extending only adds the new ones, and they all match */
+	derkeys = wallet_derkeys(ctx, w, 19);
+	CHECK(tal_bytelen(derkeys) == 20 * PUBKEY_CMPR_LEN);
+	for (size_t i = 0; i < 20; i++) {
+		CHECK(bip32_key_from_parent(w->bip32_base, i,
+					    BIP32_FLAG_KEY_PUBLIC, &ext)
+		      == WALLY_OK);
+		CHECK(memeq(derkeys + i * PUBKEY_CMPR_LEN, PUBKEY_CMPR_LEN,
+			    ext.pub_key, PUBKEY_CMPR_LEN));
+	}
+
+	/* A gap means we rederive from there */
+	stmt = db_prepare_v2(w->db, SQL("DELETE FROM bip32_derkeys"
+					" WHERE keyidx = 5;"));
+	db_exec_prepared_v2(take(stmt));
+	CHECK(memeq(wallet_derkeys(ctx, w, 19), 20 * PUBKEY_CMPR_LEN,
+		    derkeys, 20 * PUBKEY_CMPR_LEN));
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT COUNT(1)"
+					" FROM bip32_derkeys;"));
+	db_query_prepared(stmt);
+	CHECK(db_step(stmt));
+	CHECK(db_col_int(stmt, "COUNT(1)") == 20);
+	tal_free(stmt);
+	db_commit_transaction(w->db);
+	CHECK(!wallet_err);
+	return true;
+}
+
 static bool test_wallet_payment_status_enum(void)
 {
 	CHECK(PAYMENT_PENDING == 0);
@@ -1923,7 +2309,10 @@ int main(int argc, const char *argv[])
 		ok &= test_channel_inflight_crud(ld, tmpctx);
 		ok &= test_wallet_outputs(ld, tmpctx);
 		ok &= test_htlc_crud(ld, tmpctx);
+		ok &= test_htlc_load_many(ld, tmpctx);
 		ok &= test_payment_crud(ld, tmpctx);
+		ok &= test_forward_delete_old(ld, tmpctx);
+		ok &= test_wallet_derkeys(ld, tmpctx);
 		ok &= test_wallet_payment_status_enum();
 	}
 
@@ -1,6 +1,7 @@
 #include "config.h"
 #include <bitcoin/script.h>
 #include <ccan/array_size/array_size.h>
+#include <ccan/asort/asort.h>
 #include <ccan/cast/cast.h>
 #include <ccan/mem/mem.h>
 #include <ccan/tal/str/str.h>
@@ -97,6 +98,7 @@ struct wallet *wallet_new(struct lightningd *ld, struct timers *timers,
 	wallet->log = new_log(wallet, ld->log_book, NULL, "wallet");
 	wallet->bip32_base = tal_steal(wallet, bip32_base);
 	wallet->keyscan_gap = 50;
+	wallet->unspent = NULL;
 	list_head_init(&wallet->unstored_payments);
 	wallet->db = db_setup(wallet, ld, wallet->bip32_base);
 
@@ -107,6 +109,9 @@ struct wallet *wallet_new(struct lightningd *ld, struct timers *timers,
 	return wallet;
 }
 
+static void unspent_refresh(struct wallet *w,
+			    const struct bitcoin_outpoint *outpoint);
+
 /**
  * wallet_add_utxo - Register an UTXO which we (partially) own
  *
@@ -184,6 +189,7 @@ static bool wallet_add_utxo(struct wallet *w, struct utxo *utxo,
 			  tal_bytelen(utxo->scriptPubkey));
 
 	db_exec_prepared_v2(take(stmt));
+	unspent_refresh(w, &utxo->outpoint);
 	return true;
 }
 
@@ -271,6 +277,8 @@ bool wallet_update_output_status(struct wallet *w,
 	db_exec_prepared_v2(stmt);
 	changes = db_count_changes(stmt);
 	tal_free(stmt);
+	if (changes > 0)
+		unspent_refresh(w, outpoint);
 	return changes > 0;
 }
 
@@ -411,6 +419,130 @@ struct utxo *wallet_utxo_get(const tal_t *ctx, struct wallet *w,
 	return utxo;
 }
 
+/* Sorted by amount, then outpoint, so we can find them again. */
+static int cmp_unspent(const struct utxo *a, const struct utxo *b)
+{
+	int ret;
+
+	if (amount_sat_less(a->amount, b->amount))
+		return -1;
+	if (amount_sat_greater(a->amount, b->amount))
+		return 1;
+	ret = memcmp(&a->outpoint.txid, &b->outpoint.txid,
+		     sizeof(a->outpoint.txid));
+	if (ret)
+		return ret;
+	if (a->outpoint.n < b->outpoint.n)
+		return -1;
+	return a->outpoint.n > b->outpoint.n;
+}
+
+static int cmp_unspent_ptr(struct utxo *const *a, struct utxo *const *b,
+			   void *unused)
+{
+	return cmp_unspent(*a, *b);
+}
+
+/* Where this is (or would go) in w->unspent */
+static size_t unspent_pos(const struct wallet *w, const struct utxo *utxo,
+			  bool *found)
+{
+	size_t lo = 0, hi = tal_count(w->unspent);
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		int cmp = cmp_unspent(w->unspent[mid], utxo);
+
+		if (cmp == 0) {
+			*found = true;
+			return mid;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = false;
+	return lo;
+}
+
+static void unspent_load(struct wallet *w)
+{
+	struct db_stmt *stmt;
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT"
+					"  prev_out_tx"
+					", prev_out_index"
+					", value"
+					", type"
+					", status"
+					", keyindex"
+					", channel_id"
+					", peer_id"
+					", commitment_point"
+					", option_anchor_outputs"
+					", confirmation_height"
+					", spend_height"
+					", scriptpubkey"
+					", reserved_til"
+					", csv_lock"
+					" FROM outputs"
+					" WHERE status = ? OR status = ?"));
+	db_bind_int(stmt, 0, output_status_in_db(OUTPUT_STATE_AVAILABLE));
+	db_bind_int(stmt, 1, output_status_in_db(OUTPUT_STATE_RESERVED));
+	db_query_prepared(stmt);
+
+	w->unspent = tal_arr(w, struct utxo *, 0);
+	while (db_step(stmt)) {
+		struct utxo *utxo = wallet_stmt2output(w->unspent, stmt);
+		tal_arr_expand(&w->unspent, utxo);
+	}
+	tal_free(stmt);
+
+	asort(w->unspent, tal_count(w->unspent), cmp_unspent_ptr, NULL);
+}
+
+/* We changed this output in the db: make our copy match. */
+static void unspent_refresh(struct wallet *w,
+			    const struct bitcoin_outpoint *outpoint)
+{
+	struct utxo *utxo;
+	size_t pos, n;
+	bool found;
+
+	/* Not loaded yet?  It'll be right when we do. */
+	if (!w->unspent)
+		return;
+
+	utxo = wallet_utxo_get(w->unspent, w, outpoint);
+	if (!utxo)
+		return;
+
+	pos = unspent_pos(w, utxo, &found);
+	if (utxo->status == OUTPUT_STATE_SPENT) {
+		if (found) {
+			tal_free(w->unspent[pos]);
+			tal_arr_remove(&w->unspent, pos);
+		}
+		tal_free(utxo);
+	} else if (found) {
+		tal_free(w->unspent[pos]);
+		w->unspent[pos] = utxo;
+	} else {
+		n = tal_count(w->unspent);
+		tal_resize(&w->unspent, n + 1);
+		memmove(w->unspent + pos + 1, w->unspent + pos,
+			(n - pos) * sizeof(*w->unspent));
+		w->unspent[pos] = utxo;
+	}
+}
+
+/* A reorg changes confirmation heights all over: reload next time. */
+static void unspent_invalidate(struct wallet *w)
+{
+	w->unspent = tal_free(w->unspent);
+}
+
 static void db_set_utxo(struct db *db, const struct utxo *utxo)
 {
 	struct db_stmt *stmt;
@@ -453,6 +585,7 @@ bool wallet_reserve_utxo(struct wallet *w, struct utxo *utxo,
 	utxo->status = OUTPUT_STATE_RESERVED;
 
 	db_set_utxo(w->db, utxo);
+	unspent_refresh(w, &utxo->outpoint);
 
 	return true;
 }
@@ -473,6 +606,7 @@ void wallet_unreserve_utxo(struct wallet *w, struct utxo *utxo,
 		utxo->reserved_til -= unreserve;
 
 	db_set_utxo(w->db, utxo);
+	unspent_refresh(w, &utxo->outpoint);
 }
 
 static bool excluded(const struct utxo **excludes,
@@ -511,8 +645,6 @@ static bool deep_enough(u32 maxheight, const struct utxo *utxo,
 	return *utxo->blockheight <= maxheight;
 }
 
-/* FIXME: Make this wallet_find_utxos, and branch and bound and I've
- * left that to @niftynei to do, who actually read the paper! */
 struct utxo *wallet_find_utxo(const tal_t *ctx, struct wallet *w,
 			      unsigned current_blockheight,
 			      struct amount_sat *amount_hint,
@@ -564,6 +696,27 @@ struct utxo *wallet_find_utxo(const tal_t *ctx, struct wallet *w,
 	return utxo;
 }
 
+const struct utxo **wallet_usable_utxos(const tal_t *ctx, struct wallet *w,
+					u32 current_blockheight,
+					u32 maxheight)
+{
+	const struct utxo **usable = tal_arr(ctx, const struct utxo *, 0);
+
+	if (!w->unspent)
+		unspent_load(w);
+
+	for (size_t i = 0; i < tal_count(w->unspent); i++) {
+		const struct utxo *utxo = w->unspent[i];
+
+		if (utxo_is_reserved(utxo, current_blockheight))
+			continue;
+		if (!deep_enough(maxheight, utxo, current_blockheight))
+			continue;
+		tal_arr_expand(&usable, utxo);
+	}
+	return usable;
+}
+
 bool wallet_add_onchaind_utxo(struct wallet *w,
 			      const struct bitcoin_outpoint *outpoint,
 			      const u8 *scriptpubkey,
@@ -630,6 +783,7 @@ bool wallet_add_onchaind_utxo(struct wallet *w,
 	db_bind_int(stmt, 13, csv_lock);
 
 	db_exec_prepared_v2(take(stmt));
+	unspent_refresh(w, outpoint);
 	return true;
 }
 
@@ -687,6 +841,85 @@ s64 wallet_get_newindex(struct lightningd *ld)
 	return newidx;
 }
 
+static void derive_derkey(const struct wallet *w, u64 keyidx,
+			  u8 derkey[PUBKEY_CMPR_LEN])
+{
+	struct ext_key ext;
+
+	if (bip32_key_from_parent(w->bip32_base, keyidx,
+				  BIP32_FLAG_KEY_PUBLIC | BIP32_FLAG_SKIP_HASH,
+				  &ext) != WALLY_OK)
+		abort();
+	memcpy(derkey, ext.pub_key, PUBKEY_CMPR_LEN);
+}
+
+u8 *wallet_derkeys(const tal_t *ctx, struct wallet *w, u64 max_index)
+{
+	u8 *derkeys = tal_arr(ctx, u8, (max_index + 1) * PUBKEY_CMPR_LEN);
+	u8 check[PUBKEY_CMPR_LEN];
+	struct db_stmt *stmt;
+	u64 known = 0;
+	bool consistent = true;
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT keyidx, derkey"
+					" FROM bip32_derkeys"
+					" WHERE keyidx <= ?"
+					" ORDER BY keyidx;"));
+	db_bind_u64(stmt, 0, max_index);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		u64 keyidx = db_col_u64(stmt, "keyidx");
+		size_t len = db_col_bytes(stmt, "derkey");
+
+		/* We only ever append, so there should be no gaps */
+		if (keyidx != known || len != PUBKEY_CMPR_LEN) {
+			consistent = false;
+			break;
+		}
+		memcpy(derkeys + known * PUBKEY_CMPR_LEN,
+		       db_col_blob(stmt, "derkey"), PUBKEY_CMPR_LEN);
+		known++;
+	}
+	tal_free(stmt);
+
+	/* One derivation is cheap insurance that these are really ours */
+	if (known) {
+		derive_derkey(w, 0, check);
+		if (!memeq(check, sizeof(check), derkeys, PUBKEY_CMPR_LEN)) {
+			log_broken(w->log, "bip32_derkeys do not match our key:"
+				   " rederiving");
+			known = 0;
+			consistent = false;
+		}
+	}
+
+	if (!consistent) {
+		log_unusual(w->log, "Discarding bip32_derkeys from index %"PRIu64,
+			    known);
+		stmt = db_prepare_v2(w->db, SQL("DELETE FROM bip32_derkeys"
+						" WHERE keyidx >= ?;"));
+		db_bind_u64(stmt, 0, known);
+		db_exec_prepared_v2(take(stmt));
+	}
+
+	if (known <= max_index)
+		log_debug(w->log, "Deriving bip32 keys %"PRIu64"-%"PRIu64,
+			  known, max_index);
+
+	for (u64 i = known; i <= max_index; i++) {
+		u8 *derkey = derkeys + i * PUBKEY_CMPR_LEN;
+
+		derive_derkey(w, i, derkey);
+		stmt = db_prepare_v2(w->db, SQL("INSERT INTO bip32_derkeys"
+						" (keyidx, derkey)"
+						" VALUES (?, ?);"));
+		db_bind_u64(stmt, 0, i);
+		db_bind_blob(stmt, 1, derkey, PUBKEY_CMPR_LEN);
+		db_exec_prepared_v2(take(stmt));
+	}
+	return derkeys;
+}
+
 static void wallet_shachain_init(struct wallet *wallet,
 				 struct wallet_shachain *chain)
 {
@@ -773,102 +1006,54 @@ bool wallet_shachain_add_hash(struct wallet *wallet,
 	return true;
 }
 
-static bool wallet_shachain_load(struct wallet *wallet, u64 id,
-				 struct wallet_shachain *chain)
-{
-	struct db_stmt *stmt;
-	chain->id = id;
-	shachain_init(&chain->chain);
-
-	/* Load shachain metadata */
-	stmt = db_prepare_v2(
-	    wallet->db,
-	    SQL("SELECT min_index, num_valid FROM shachains WHERE id=?"));
-	db_bind_u64(stmt, 0, id);
-	db_query_prepared(stmt);
-
-	if (!db_step(stmt)) {
-		tal_free(stmt);
-		return false;
-	}
-
-	chain->chain.min_index = db_col_u64(stmt, "min_index");
-	chain->chain.num_valid = db_col_u64(stmt, "num_valid");
-	tal_free(stmt);
-
-	/* Load shachain known entries */
-	stmt = db_prepare_v2(wallet->db,
-			     SQL("SELECT idx, hash, pos FROM shachain_known "
-				 "WHERE shachain_id=?"));
-	db_bind_u64(stmt, 0, id);
-	db_query_prepared(stmt);
-
-	while (db_step(stmt)) {
-		int pos = db_col_int(stmt, "pos");
-		chain->chain.known[pos].index = db_col_u64(stmt, "idx");
-		db_col_sha256(stmt, "hash", &chain->chain.known[pos].hash);
-	}
-	tal_free(stmt);
-	return true;
-}
-
-static struct peer *wallet_peer_load(struct wallet *w, const u64 dbid)
-{
-	const char *addrstr;
-	struct peer *peer = NULL;
+/* A peer row, loaded ahead of the channels which refer to it. */
+struct peer_row {
 	struct node_id id;
 	struct wireaddr_internal addr;
-	struct db_stmt *stmt;
-
-	stmt = db_prepare_v2(
-	    w->db, SQL("SELECT id, node_id, address FROM peers WHERE id=?;"));
-	db_bind_u64(stmt, 0, dbid);
-	db_query_prepared(stmt);
+	/* Created when we load its first channel. */
+	struct peer *peer;
+};
 
-	if (!db_step(stmt))
-		goto done;
+static struct peer_row *wallet_stmt2peer_row(const tal_t *ctx,
+					     struct wallet *w,
+					     struct db_stmt *stmt)
+{
+	const char *addrstr;
+	struct peer_row *row;
 
 	if (db_col_is_null(stmt, "node_id")) {
 		db_col_ignore(stmt, "address");
-		db_col_ignore(stmt, "id");
-		goto done;
+		return NULL;
 	}
 
-	db_col_node_id(stmt, "node_id", &id);
+	row = tal(ctx, struct peer_row);
+	row->peer = NULL;
+	db_col_node_id(stmt, "node_id", &row->id);
 
 	/* This can happen for peers last seen on Torv2! */
 	addrstr = db_col_strdup(tmpctx, stmt, "address");
-	if (!parse_wireaddr_internal(addrstr, &addr, chainparams_get_ln_port(chainparams),
+	if (!parse_wireaddr_internal(addrstr, &row->addr,
+				     chainparams_get_ln_port(chainparams),
 				     false, false, true, true, NULL)) {
 		log_unusual(w->log, "Unparsable peer address %s: replacing",
 			    addrstr);
-		parse_wireaddr_internal("127.0.0.1:1", &addr, chainparams_get_ln_port(chainparams),
+		parse_wireaddr_internal("127.0.0.1:1", &row->addr,
+					chainparams_get_ln_port(chainparams),
 					false, false, true, true, NULL);
 	}
-
-	/* FIXME: save incoming in db! */
-	peer = new_peer(w->ld, db_col_u64(stmt, "id"), &id, &addr, false);
-
-done:
-	tal_free(stmt);
-	return peer;
+	return row;
 }
 
 static struct bitcoin_signature *
-wallet_htlc_sigs_load(const tal_t *ctx, struct wallet *w, u64 channelid,
-		      bool option_anchor_outputs)
+htlc_sigs_from_rows(const tal_t *ctx, struct wallet *w,
+		    const secp256k1_ecdsa_signature *sigs,
+		    bool option_anchor_outputs)
 {
-	struct db_stmt *stmt;
-	struct bitcoin_signature *htlc_sigs = tal_arr(ctx, struct bitcoin_signature, 0);
+	struct bitcoin_signature *htlc_sigs;
 
-	stmt = db_prepare_v2(
-	    w->db, SQL("SELECT signature FROM htlc_sigs WHERE channelid = ?"));
-	db_bind_u64(stmt, 0, channelid);
-	db_query_prepared(stmt);
-
-	while (db_step(stmt)) {
-		struct bitcoin_signature sig;
-		db_col_signature(stmt, "signature", &sig.s);
+	htlc_sigs = tal_arr(ctx, struct bitcoin_signature, tal_count(sigs));
+	for (size_t i = 0; i < tal_count(sigs); i++) {
+		htlc_sigs[i].s = sigs[i];
 		/* BOLT #3:
 		 * ## HTLC-Timeout and HTLC-Success Transactions
 		 *...
@@ -877,12 +1062,10 @@ wallet_htlc_sigs_load(const tal_t *ctx, struct wallet *w, u64 channelid,
 		 *   used as described in [BOLT #5]
 		 */
 		if (option_anchor_outputs)
-			sig.sighash_type = SIGHASH_SINGLE|SIGHASH_ANYONECANPAY;
+			htlc_sigs[i].sighash_type = SIGHASH_SINGLE|SIGHASH_ANYONECANPAY;
 		else
-			sig.sighash_type = SIGHASH_ALL;
-		tal_arr_expand(&htlc_sigs, sig);
+			htlc_sigs[i].sighash_type = SIGHASH_ALL;
 	}
-	tal_free(stmt);
 
 	log_debug(w->log, "Loaded %zu HTLC signatures from DB",
 		  tal_count(htlc_sigs));
@@ -935,35 +1118,33 @@ fail:
 	return false;
 }
 
-static struct fee_states *wallet_channel_fee_states_load(struct wallet *w,
-							 const u64 id,
-							 enum side opener)
+/* A channel_feerates or channel_blockheights row */
+struct hstate_val {
+	enum htlc_state hstate;
+	u32 val;
+};
+
+static struct fee_states *fee_states_from_rows(struct wallet *w,
+						const u64 id,
+						enum side opener,
+						const struct hstate_val *rows)
 {
 	struct fee_states *fee_states;
-	struct db_stmt *stmt;
-
-	stmt = db_prepare_v2(w->db, SQL("SELECT hstate, feerate_per_kw FROM channel_feerates WHERE channel_id = ?"));
-	db_bind_u64(stmt, 0, id);
-	db_query_prepared(stmt);
 
 	/* Start with blank slate. */
 	fee_states = new_fee_states(w, opener, NULL);
-	while (db_step(stmt)) {
-		enum htlc_state hstate = htlc_state_in_db(db_col_int(stmt, "hstate"));
-		u32 feerate = db_col_int(stmt, "feerate_per_kw");
-
-		if (fee_states->feerate[hstate] != NULL) {
+	for (size_t i = 0; i < tal_count(rows); i++) {
+		if (fee_states->feerate[rows[i].hstate] != NULL) {
 			log_broken(w->log,
 				   "duplicate channel_feerates for %s id %"PRIu64,
-				   htlc_state_name(hstate), id);
-			fee_states = tal_free(fee_states);
-			break;
+				   htlc_state_name(rows[i].hstate), id);
+			return tal_free(fee_states);
 		}
-		fee_states->feerate[hstate] = tal_dup(fee_states, u32, &feerate);
+		fee_states->feerate[rows[i].hstate]
+			= tal_dup(fee_states, u32, &rows[i].val);
 	}
-	tal_free(stmt);
 
-	if (fee_states && !fee_states_valid(fee_states, opener)) {
+	if (!fee_states_valid(fee_states, opener)) {
 		log_broken(w->log,
 			   "invalid channel_feerates for id %"PRIu64, id);
 		fee_states = tal_free(fee_states);
@@ -971,35 +1152,27 @@ static struct fee_states *wallet_channel_fee_states_load(struct wallet *w,
 	return fee_states;
 }
 
-static struct height_states *wallet_channel_height_states_load(struct wallet *w,
-							       const u64 id,
-							       enum side opener)
+static struct height_states *height_states_from_rows(struct wallet *w,
+						     const u64 id,
+						     enum side opener,
+						     const struct hstate_val *rows)
 {
 	struct height_states *states;
-	struct db_stmt *stmt;
-
-	stmt = db_prepare_v2(w->db, SQL("SELECT hstate, blockheight FROM channel_blockheights WHERE channel_id = ?"));
-	db_bind_u64(stmt, 0, id);
-	db_query_prepared(stmt);
 
 	/* Start with blank slate. */
 	states = new_height_states(w, opener, NULL);
-	while (db_step(stmt)) {
-		enum htlc_state hstate = htlc_state_in_db(db_col_int(stmt, "hstate"));
-		u32 blockheight = db_col_int(stmt, "blockheight");
-
-		if (states->height[hstate] != NULL) {
+	for (size_t i = 0; i < tal_count(rows); i++) {
+		if (states->height[rows[i].hstate] != NULL) {
 			log_broken(w->log,
 				   "duplicate channel_blockheights for %s id %"PRIu64,
-				   htlc_state_name(hstate), id);
-			states = tal_free(states);
-			break;
+				   htlc_state_name(rows[i].hstate), id);
+			return tal_free(states);
 		}
-		states->height[hstate] = tal_dup(states, u32, &blockheight);
+		states->height[rows[i].hstate]
+			= tal_dup(states, u32, &rows[i].val);
 	}
-	tal_free(stmt);
 
-	if (states && !height_states_valid(states, opener)) {
+	if (!height_states_valid(states, opener)) {
 		log_broken(w->log,
 			   "invalid channel_blockheight for id %"PRIu64, id);
 		states = tal_free(states);
@@ -1106,6 +1279,43 @@ void wallet_channel_clear_inflights(struct wallet *w,
 		tal_free(inflight);
 }
 
+/* Index of loaded channels by dbid, so rows fetched for every channel
+ * at once can find their owner. */
+struct channel_index {
+	UINTMAP(struct channel *) map;
+};
+
+static void destroy_channel_index(struct channel_index *cidx)
+{
+	uintmap_clear(&cidx->map);
+}
+
+static struct channel_index *new_channel_index(const tal_t *ctx)
+{
+	struct channel_index *cidx = tal(ctx, struct channel_index);
+
+	uintmap_init(&cidx->map);
+	tal_add_destructor(cidx, destroy_channel_index);
+	return cidx;
+}
+
+static struct channel_index *index_channels(const tal_t *ctx,
+					    struct lightningd *ld)
+{
+	struct channel_index *cidx = new_channel_index(ctx);
+	struct peer *peer;
+	struct channel *chan;
+
+	list_for_each(&ld->peers, peer, list) {
+		list_for_each(&peer->channels, chan, list) {
+			/* Unsaved channels have dbid 0 */
+			if (chan->dbid)
+				uintmap_add(&cidx->map, chan->dbid, chan);
+		}
+	}
+	return cidx;
+}
+
 static struct channel_inflight *
 wallet_stmt2inflight(struct wallet *w, struct db_stmt *stmt,
 		     struct channel *chan)
@@ -1176,14 +1386,15 @@ wallet_stmt2inflight(struct wallet *w, struct db_stmt *stmt,
 	return inflight;
 }
 
-static bool wallet_channel_load_inflights(struct wallet *w,
-					  struct channel *chan)
+static bool wallet_channels_load_inflights(struct wallet *w,
+					   struct channel_index *cidx)
 {
 	bool ok = true;
 	struct db_stmt *stmt;
 
 	stmt = db_prepare_v2(w->db, SQL("SELECT"
-					"  funding_tx_id"
+					"  channel_id"
+					", funding_tx_id"
 					", funding_tx_outnum"
 					", funding_feerate"
 					", funding_satoshi"
@@ -1199,15 +1410,19 @@ static bool wallet_channel_load_inflights(struct wallet *w,
 					", lease_blockheight_start"
 					", lease_fee"
 					" FROM channel_funding_inflights"
-					" WHERE channel_id = ?"
-					" ORDER BY funding_feerate"));
+					" WHERE channel_id IN"
+					"  (SELECT id FROM channels WHERE state != ?)"
+					" ORDER BY channel_id, funding_feerate"));
 
-	db_bind_u64(stmt, 0, chan->dbid);
+	db_bind_int(stmt, 0, CLOSED);
 	db_query_prepared(stmt);
 
 	while (db_step(stmt)) {
 		struct channel_inflight *inflight;
-		inflight = wallet_stmt2inflight(w, stmt, chan);
+		struct channel *chan;
+
+		chan = uintmap_get(&cidx->map, db_col_u64(stmt, "channel_id"));
+		inflight = chan ? wallet_stmt2inflight(w, stmt, chan) : NULL;
 		if (!inflight) {
 			ok = false;
 			break;
@@ -1218,23 +1433,10 @@ static bool wallet_channel_load_inflights(struct wallet *w,
 	return ok;
 }
 
-static bool wallet_channel_config_load(struct wallet *w, const u64 id,
+/* Everything channel_configs has apart from the id */
+static void wallet_stmt2channel_config(struct db_stmt *stmt,
 				       struct channel_config *cc)
 {
-	bool ok = true;
-	const char *query = SQL(
-	    "SELECT dust_limit_satoshis, max_htlc_value_in_flight_msat, "
-	    "channel_reserve_satoshis, htlc_minimum_msat, to_self_delay, "
-	    "max_accepted_htlcs, max_dust_htlc_exposure_msat"
-	    " FROM channel_configs WHERE id= ? ;");
-	struct db_stmt *stmt = db_prepare_v2(w->db, query);
-	db_bind_u64(stmt, 0, id);
-	db_query_prepared(stmt);
-
-	if (!db_step(stmt))
-		return false;
-
-	cc->id = id;
 	db_col_amount_sat(stmt, "dust_limit_satoshis", &cc->dust_limit);
 	db_col_amount_msat(stmt, "max_htlc_value_in_flight_msat",
 			   &cc->max_htlc_value_in_flight);
@@ -1245,14 +1447,206 @@ static bool wallet_channel_config_load(struct wallet *w, const u64 id,
 	cc->max_accepted_htlcs = db_col_int(stmt, "max_accepted_htlcs");
 	db_col_amount_msat(stmt, "max_dust_htlc_exposure_msat",
 			   &cc->max_dust_htlc_exposure_msat);
+}
+
+/* Rows from the per-channel side tables which are small enough to
+ * keep together. */
+struct channel_extras {
+	struct hstate_val *feerates;
+	struct hstate_val *blockheights;
+	secp256k1_ecdsa_signature *htlc_sigs;
+};
+
+/* Everything wallet_stmt2channel needs beyond the channels row itself.
+ * We fetch each table once for all active channels rather than running
+ * a handful of queries per channel, which adds up to tens of thousands
+ * of round trips on large nodes (painfully slow on postgres). */
+struct channel_rows {
+	UINTMAP(struct peer_row *) peers;
+	UINTMAP(struct channel_config *) configs;
+	UINTMAP(struct wallet_shachain *) shachains;
+	UINTMAP(struct channel_extras *) extras;
+};
+
+static void destroy_channel_rows(struct channel_rows *rows)
+{
+	uintmap_clear(&rows->peers);
+	uintmap_clear(&rows->configs);
+	uintmap_clear(&rows->shachains);
+	uintmap_clear(&rows->extras);
+}
+
+static struct channel_extras *channel_extras(struct channel_rows *rows,
+					     u64 channel_id)
+{
+	struct channel_extras *extras = uintmap_get(&rows->extras, channel_id);
+
+	if (!extras) {
+		extras = tal(rows, struct channel_extras);
+		extras->feerates = tal_arr(extras, struct hstate_val, 0);
+		extras->blockheights = tal_arr(extras, struct hstate_val, 0);
+		extras->htlc_sigs = tal_arr(extras, secp256k1_ecdsa_signature, 0);
+		uintmap_add(&rows->extras, channel_id, extras);
+	}
+	return extras;
+}
+
+static struct channel_rows *wallet_channel_rows_load(const tal_t *ctx,
+						     struct wallet *w)
+{
+	struct channel_rows *rows = tal(ctx, struct channel_rows);
+	struct db_stmt *stmt;
+
+	uintmap_init(&rows->peers);
+	uintmap_init(&rows->configs);
+	uintmap_init(&rows->shachains);
+	uintmap_init(&rows->extras);
+	tal_add_destructor(rows, destroy_channel_rows);
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT id, node_id, address"
+					" FROM peers"
+					" WHERE id IN"
+					"  (SELECT peer_id FROM channels"
+					"   WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		u64 id = db_col_u64(stmt, "id");
+		struct peer_row *prow = wallet_stmt2peer_row(rows, w, stmt);
+		if (prow)
+			uintmap_add(&rows->peers, id, prow);
+	}
 	tal_free(stmt);
-	return ok;
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT id, dust_limit_satoshis"
+					", max_htlc_value_in_flight_msat"
+					", channel_reserve_satoshis"
+					", htlc_minimum_msat"
+					", to_self_delay"
+					", max_accepted_htlcs"
+					", max_dust_htlc_exposure_msat"
+					" FROM channel_configs"
+					" WHERE id IN"
+					"  (SELECT channel_config_local FROM channels"
+					"   WHERE state != ?)"
+					" OR id IN"
+					"  (SELECT channel_config_remote FROM channels"
+					"   WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_bind_int(stmt, 1, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct channel_config *cc = tal(rows, struct channel_config);
+		cc->id = db_col_u64(stmt, "id");
+		wallet_stmt2channel_config(stmt, cc);
+		uintmap_add(&rows->configs, cc->id, cc);
+	}
+	tal_free(stmt);
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT id, min_index, num_valid"
+					" FROM shachains"
+					" WHERE id IN"
+					"  (SELECT shachain_remote_id FROM channels"
+					"   WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct wallet_shachain *chain = tal(rows, struct wallet_shachain);
+		chain->id = db_col_u64(stmt, "id");
+		shachain_init(&chain->chain);
+		chain->chain.min_index = db_col_u64(stmt, "min_index");
+		chain->chain.num_valid = db_col_u64(stmt, "num_valid");
+		uintmap_add(&rows->shachains, chain->id, chain);
+	}
+	tal_free(stmt);
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT shachain_id, idx, hash, pos"
+					" FROM shachain_known"
+					" WHERE shachain_id IN"
+					"  (SELECT shachain_remote_id FROM channels"
+					"   WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct wallet_shachain *chain;
+		int pos;
+
+		chain = uintmap_get(&rows->shachains,
+				    db_col_u64(stmt, "shachain_id"));
+		if (!chain) {
+			db_col_ignore(stmt, "idx");
+			db_col_ignore(stmt, "hash");
+			db_col_ignore(stmt, "pos");
+			continue;
+		}
+		pos = db_col_int(stmt, "pos");
+		chain->chain.known[pos].index = db_col_u64(stmt, "idx");
+		db_col_sha256(stmt, "hash", &chain->chain.known[pos].hash);
+	}
+	tal_free(stmt);
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT channel_id, hstate, feerate_per_kw"
+					" FROM channel_feerates"
+					" WHERE channel_id IN"
+					"  (SELECT id FROM channels WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct channel_extras *extras;
+		struct hstate_val row;
+
+		extras = channel_extras(rows, db_col_u64(stmt, "channel_id"));
+		row.hstate = htlc_state_in_db(db_col_int(stmt, "hstate"));
+		row.val = db_col_int(stmt, "feerate_per_kw");
+		tal_arr_expand(&extras->feerates, row);
+	}
+	tal_free(stmt);
+
+	stmt = db_prepare_v2(w->db, SQL("SELECT channel_id, hstate, blockheight"
+					" FROM channel_blockheights"
+					" WHERE channel_id IN"
+					"  (SELECT id FROM channels WHERE state != ?);"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct channel_extras *extras;
+		struct hstate_val row;
+
+		extras = channel_extras(rows, db_col_u64(stmt, "channel_id"));
+		row.hstate = htlc_state_in_db(db_col_int(stmt, "hstate"));
+		row.val = db_col_int(stmt, "blockheight");
+		tal_arr_expand(&extras->blockheights, row);
+	}
+	tal_free(stmt);
+
+	/* Order within a channel matters: it's the order of the HTLC
+	 * outputs on the commitment tx. */
+	stmt = db_prepare_v2(w->db, SQL("SELECT channelid, signature"
+					" FROM htlc_sigs"
+					" WHERE channelid IN"
+					"  (SELECT id FROM channels WHERE state != ?)"
+					" ORDER BY channelid, idx;"));
+	db_bind_int(stmt, 0, CLOSED);
+	db_query_prepared(stmt);
+	while (db_step(stmt)) {
+		struct channel_extras *extras;
+		secp256k1_ecdsa_signature sig;
+
+		extras = channel_extras(rows, db_col_u64(stmt, "channelid"));
+		db_col_signature(stmt, "signature", &sig);
+		tal_arr_expand(&extras->htlc_sigs, sig);
+	}
+	tal_free(stmt);
+
+	return rows;
 }
 
 /**
  * wallet_stmt2channel - Helper to populate a wallet_channel from a `db_stmt`
  */
-static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stmt)
+static struct channel *wallet_stmt2channel(struct wallet *w,
+					   struct db_stmt *stmt,
+					   struct channel_rows *rows)
 {
 	bool ok = true;
 	struct channel_info channel_info;
@@ -1263,8 +1657,10 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 	struct channel *chan;
 	u64 peer_dbid;
 	struct peer *peer;
-	struct wallet_shachain wshachain;
-	struct channel_config our_config;
+	struct peer_row *prow;
+	struct wallet_shachain *wshachain;
+	const struct channel_config *our_config, *their_config;
+	const struct channel_extras *extras;
 	struct bitcoin_outpoint funding;
 	struct bitcoin_outpoint *shutdown_wrong_funding;
 	struct bitcoin_signature last_sig;
@@ -1284,13 +1680,17 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 	u16 lease_chan_max_ppt;
 
 	peer_dbid = db_col_u64(stmt, "peer_id");
-	peer = find_peer_by_dbid(w->ld, peer_dbid);
-	if (!peer) {
-		peer = wallet_peer_load(w, peer_dbid);
-		if (!peer) {
-			return NULL;
-		}
+	prow = uintmap_get(&rows->peers, peer_dbid);
+	if (!prow)
+		return NULL;
+	if (!prow->peer)
+		prow->peer = find_peer_by_dbid(w->ld, peer_dbid);
+	if (!prow->peer) {
+		/* FIXME: save incoming in db! */
+		prow->peer = new_peer(w->ld, peer_dbid, &prow->id, &prow->addr,
+				      false);
 	}
+	peer = prow->peer;
 
 	if (!db_col_is_null(stmt, "short_channel_id")) {
 		scid = tal(tmpctx, struct short_channel_id);
@@ -1314,8 +1714,10 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 		alias[REMOTE] = NULL;
 	}
 
-	ok &= wallet_shachain_load(w, db_col_u64(stmt, "shachain_remote_id"),
-				   &wshachain);
+	wshachain = uintmap_get(&rows->shachains,
+				db_col_u64(stmt, "shachain_remote_id"));
+	if (!wshachain)
+		ok = false;
 
 	remote_shutdown_scriptpubkey = db_col_arr(tmpctx, stmt,
 						  "shutdown_scriptpubkey_remote", u8);
@@ -1355,7 +1757,9 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 
 	db_col_channel_id(stmt, "full_channel_id", &cid);
 	channel_config_id = db_col_u64(stmt, "channel_config_local");
-	ok &= wallet_channel_config_load(w, channel_config_id, &our_config);
+	our_config = uintmap_get(&rows->configs, channel_config_id);
+	if (!our_config)
+		ok = false;
 	db_col_sha256d(stmt, "funding_tx_id", &funding.txid.shad);
 	funding.n = db_col_int(stmt, "funding_tx_outnum"),
 	ok &= db_col_signature(stmt, "last_sig", &last_sig.s);
@@ -1370,13 +1774,18 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 	db_col_pubkey(stmt, "per_commit_remote", &channel_info.remote_per_commit);
 	db_col_pubkey(stmt, "old_per_commit_remote", &channel_info.old_remote_per_commit);
 
-	wallet_channel_config_load(w, db_col_u64(stmt, "channel_config_remote"),
-				   &channel_info.their_config);
+	their_config = uintmap_get(&rows->configs,
+				   db_col_u64(stmt, "channel_config_remote"));
+	if (their_config)
+		channel_info.their_config = *their_config;
+	else
+		ok = false;
 
-	fee_states
-		= wallet_channel_fee_states_load(w,
-						 db_col_u64(stmt, "id"),
-						 db_col_int(stmt, "funder"));
+	/* Channels without any of these rows get an empty set */
+	extras = channel_extras(rows, db_col_u64(stmt, "id"));
+	fee_states = fee_states_from_rows(w, db_col_u64(stmt, "id"),
+					  db_col_int(stmt, "funder"),
+					  extras->feerates);
 	if (!fee_states)
 		ok = false;
 
@@ -1386,10 +1795,9 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 	}
 
 	/* Blockheight states for the channel! */
-	height_states
-		= wallet_channel_height_states_load(w,
-						    db_col_u64(stmt, "id"),
-						    db_col_int(stmt, "funder"));
+	height_states = height_states_from_rows(w, db_col_u64(stmt, "id"),
+						db_col_int(stmt, "funder"),
+						extras->blockheights);
 	if (!height_states)
 		ok = false;
 
@@ -1462,13 +1870,13 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 		last_tx = NULL;
 
 	chan = new_channel(peer, db_col_u64(stmt, "id"),
-			   &wshachain,
+			   wshachain,
 			   db_col_int(stmt, "state"),
 			   db_col_int(stmt, "funder"),
 			   NULL, /* Set up fresh log */
 			   "Loaded from database",
 			   db_col_int(stmt, "channel_flags"),
-			   &our_config,
+			   our_config,
 			   db_col_int(stmt, "minimum_depth"),
 			   db_col_u64(stmt, "next_index_local"),
 			   db_col_u64(stmt, "next_index_remote"),
@@ -1487,9 +1895,8 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 			   msat_to_us_max, /* msatoshi_to_us_max */
 			   last_tx,
 			   &last_sig,
-			   wallet_htlc_sigs_load(tmpctx, w,
-						 db_col_u64(stmt, "id"),
-						 db_col_int(stmt, "option_anchor_outputs")),
+			   htlc_sigs_from_rows(tmpctx, w, extras->htlc_sigs,
+					       db_col_int(stmt, "option_anchor_outputs")),
 			   &channel_info,
 			   take(fee_states),
 			   remote_shutdown_scriptpubkey,
@@ -1519,11 +1926,6 @@ static struct channel *wallet_stmt2channel(struct wallet *w, struct db_stmt *stm
 			   htlc_minimum_msat,
 			   htlc_maximum_msat);
 
-	if (!wallet_channel_load_inflights(w, chan)) {
-		tal_free(chan);
-		return NULL;
-	}
-
 	return chan;
 }
 
@@ -1546,6 +1948,8 @@ static bool wallet_channels_load_active(struct wallet *w)
 	bool ok = true;
 	struct db_stmt *stmt;
 	int count = 0;
+	struct channel_rows *rows = wallet_channel_rows_load(tmpctx, w);
+	struct channel_index *cidx = new_channel_index(tmpctx);
 
 	/* We load all channels */
 	stmt = db_prepare_v2(w->db, SQL("SELECT"
@@ -1621,15 +2025,19 @@ static bool wallet_channels_load_active(struct wallet *w)
 	db_query_prepared(stmt);
 
 	while (db_step(stmt)) {
-		struct channel *c = wallet_stmt2channel(w, stmt);
+		struct channel *c = wallet_stmt2channel(w, stmt, rows);
 		if (!c) {
 			ok = false;
 			break;
 		}
+		uintmap_add(&cidx->map, c->dbid, c);
 		count++;
 	}
 	log_debug(w->log, "Loaded %d channels from DB", count);
 	tal_free(stmt);
+
+	if (ok)
+		ok = wallet_channels_load_inflights(w, cidx);
 	return ok;
 }
 
@@ -2293,6 +2701,18 @@ void wallet_confirm_tx(struct wallet *w,
 	db_bind_sha256d(stmt, 1, &txid->shad);
 
 	db_exec_prepared_v2(take(stmt));
+
+	for (size_t i = 0; i < tal_count(w->unspent); i++) {
+		struct utxo *utxo = w->unspent[i];
+		u32 *blockheight;
+
+		if (!bitcoin_txid_eq(&utxo->outpoint.txid, txid))
+			continue;
+		blockheight = tal(utxo, u32);
+		*blockheight = confirmation_height;
+		tal_free(utxo->blockheight);
+		utxo->blockheight = blockheight;
+	}
 }
 
 int wallet_extract_owned_outputs(struct wallet *w, const struct wally_tx *wtx,
@@ -2750,17 +3170,17 @@ static void fixup_hin(struct wallet *wallet, struct htlc_in *hin)
 #endif
 }
 
-bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
-				      struct channel *chan,
-				      struct htlc_in_map *htlcs_in)
+bool wallet_htlcs_load_in(struct wallet *wallet,
+			  struct htlc_in_map *htlcs_in)
 {
 	struct db_stmt *stmt;
 	bool ok = true;
 	int incount = 0;
+	struct channel_index *cidx = index_channels(tmpctx, wallet->ld);
 
-	log_debug(wallet->log, "Loading in HTLCs for channel %"PRIu64, chan->dbid);
 	stmt = db_prepare_v2(wallet->db, SQL("SELECT"
 					     "  id"
+					     ", channel_id"
 					     ", channel_htlc_id"
 					     ", msatoshi"
 					     ", cltv_expiry"
@@ -2776,10 +3196,11 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 					     ", fail_immediate"
 					     " FROM channel_htlcs"
 					     " WHERE direction= ?"
-					     " AND channel_id= ?"
+					     " AND channel_id IN"
+					     "  (SELECT id FROM channels WHERE state != ?)"
 					     " AND hstate NOT IN (?, ?)"));
 	db_bind_int(stmt, 0, DIRECTION_INCOMING);
-	db_bind_u64(stmt, 1, chan->dbid);
+	db_bind_int(stmt, 1, CLOSED);
 	/* We need to generate `hstate NOT IN (9, 19)` in order to match
 	 * the `WHERE` clause of the database index; incoming HTLCs will
 	 * never actually get the state `RCVD_REMOVE_ACK_REVOCATION`.
@@ -2790,7 +3211,15 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 	db_query_prepared(stmt);
 
 	while (db_step(stmt)) {
-		struct htlc_in *in = tal(chan, struct htlc_in);
+		struct htlc_in *in;
+		struct channel *chan;
+
+		chan = uintmap_get(&cidx->map, db_col_u64(stmt, "channel_id"));
+		if (!chan) {
+			ok = false;
+			break;
+		}
+		in = tal(chan, struct htlc_in);
 		ok &= wallet_stmt2htlc_in(chan, stmt, in);
 		connect_htlc_in(htlcs_in, in);
 		fixup_hin(wallet, in);
@@ -2803,17 +3232,18 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 	return ok;
 }
 
-bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
-				       struct channel *chan,
-				       struct htlc_out_map *htlcs_out,
-				       struct htlc_in_map *unconnected_htlcs_in)
+bool wallet_htlcs_load_out(struct wallet *wallet,
+			   struct htlc_out_map *htlcs_out,
+			   struct htlc_in_map *unconnected_htlcs_in)
 {
 	struct db_stmt *stmt;
 	bool ok = true;
 	int outcount = 0;
+	struct channel_index *cidx = index_channels(tmpctx, wallet->ld);
 
 	stmt = db_prepare_v2(wallet->db, SQL("SELECT"
 					     "  id"
+					     ", channel_id"
 					     ", channel_htlc_id"
 					     ", msatoshi"
 					     ", cltv_expiry"
@@ -2829,10 +3259,11 @@ bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 					     ", fees_msat"
 					     " FROM channel_htlcs"
 					     " WHERE direction = ?"
-					     " AND channel_id = ?"
+					     " AND channel_id IN"
+					     "  (SELECT id FROM channels WHERE state != ?)"
 					     " AND hstate NOT IN (?, ?)"));
 	db_bind_int(stmt, 0, DIRECTION_OUTGOING);
-	db_bind_u64(stmt, 1, chan->dbid);
+	db_bind_int(stmt, 1, CLOSED);
 	/* We need to generate `hstate NOT IN (9, 19)` in order to match
 	 * the `WHERE` clause of the database index; outgoing HTLCs will
 	 * never actually get the state `SENT_REMOVE_ACK_REVOCATION`.
@@ -2843,7 +3274,15 @@ bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 	db_query_prepared(stmt);
 
 	while (db_step(stmt)) {
-		struct htlc_out *out = tal(chan, struct htlc_out);
+		struct htlc_out *out;
+		struct channel *chan;
+
+		chan = uintmap_get(&cidx->map, db_col_u64(stmt, "channel_id"));
+		if (!chan) {
+			ok = false;
+			break;
+		}
+		out = tal(chan, struct htlc_out);
 		ok &= wallet_stmt2htlc_out(wallet, chan, stmt, out,
 					   unconnected_htlcs_in);
 		connect_htlc_out(htlcs_out, out);
@@ -2854,7 +3293,6 @@ bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 	tal_free(stmt);
 
 	log_debug(wallet->log, "Restored %d outgoing HTLCS", outcount);
-
 	return ok;
 }
 
@@ -2904,6 +3342,12 @@ void wallet_invoice_delete_expired(struct wallet *wallet, u64 e)
 {
 	invoices_delete_expired(wallet->invoices, e);
 }
+size_t wallet_invoice_delete_expired_limit(struct wallet *wallet,
+					  u64 max_expiry_time, u32 limit)
+{
+	return invoices_delete_expired_limit(wallet->invoices,
+					     max_expiry_time, limit);
+}
 bool wallet_invoice_iterate(struct wallet *wallet,
 			    struct invoice_iterator *it)
 {
@@ -3174,6 +3618,28 @@ void wallet_payment_delete_by_hash(struct wallet *wallet,
 	db_exec_prepared_v2(take(stmt));
 }
 
+size_t wallet_payments_delete_old(struct wallet *wallet,
+				  enum wallet_payment_status status,
+				  u64 before,
+				  u32 limit)
+{
+	struct db_stmt *stmt;
+	size_t deleted;
+
+	stmt = db_prepare_v2(wallet->db,
+			     SQL("DELETE FROM payments"
+				 " WHERE id IN (SELECT id FROM payments"
+				 "  WHERE status = ? AND timestamp <= ?"
+				 "  ORDER BY id LIMIT ?);"));
+	db_bind_int(stmt, 0, wallet_payment_status_in_db(status));
+	db_bind_u64(stmt, 1, before);
+	db_bind_u64(stmt, 2, limit);
+	db_exec_prepared_v2(stmt);
+	deleted = db_count_changes(stmt);
+	tal_free(stmt);
+	return deleted;
+}
+
 static struct wallet_payment *wallet_stmt2payment(const tal_t *ctx,
 						  struct db_stmt *stmt)
 {
@@ -3636,9 +4102,10 @@ void wallet_htlc_sigs_save(struct wallet *w, u64 channel_id,
 	for (size_t i=0; i<tal_count(htlc_sigs); i++) {
 		stmt = db_prepare_v2(w->db,
 				     SQL("INSERT INTO htlc_sigs (channelid, "
-					 "signature) VALUES (?, ?)"));
+					 "signature, idx) VALUES (?, ?, ?)"));
 		db_bind_u64(stmt, 0, channel_id);
 		db_bind_signature(stmt, 1, &htlc_sigs[i].s);
+		db_bind_int(stmt, 2, i);
 		db_exec_prepared_v2(take(stmt));
 	}
 }
@@ -3767,6 +4234,8 @@ void wallet_block_remove(struct wallet *w, struct block *b)
 	db_query_prepared(stmt);
 	assert(!db_step(stmt));
 	tal_free(stmt);
+
+	unspent_invalidate(w);
 }
 
 void wallet_blocks_rollback(struct wallet *w, u32 height)
@@ -3775,6 +4244,8 @@ void wallet_blocks_rollback(struct wallet *w, u32 height)
 							"WHERE height > ?"));
 	db_bind_int(stmt, 0, height);
 	db_exec_prepared_v2(take(stmt));
+
+	unspent_invalidate(w);
 }
 
 bool wallet_outpoint_spend(struct wallet *w, const tal_t *ctx, const u32 blockheight,
@@ -3795,6 +4266,7 @@ bool wallet_outpoint_spend(struct wallet *w, const tal_t *ctx, const u32 blockhe
 		db_bind_int(stmt, 3, outpoint->n);
 
 		db_exec_prepared_v2(take(stmt));
+		unspent_refresh(w, outpoint);
 
 		our_spend = true;
 	} else
@@ -4636,6 +5108,44 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 	return results;
 }
 
+size_t wallet_forwarded_payments_delete_old(struct wallet *w,
+					    enum forward_status state,
+					    u64 before,
+					    u32 limit)
+{
+	struct db_stmt *stmt;
+	struct timeabs cutoff;
+	enum forward_status also = state;
+	size_t deleted;
+
+	/* Locally-failed ones are failures too. */
+	if (state == FORWARD_FAILED)
+		also = FORWARD_LOCAL_FAILED;
+
+	/* Times are stored in nsec, and postgres' BIGINT is signed. */
+	if (before > INT64_MAX / 1000000000)
+		before = INT64_MAX / 1000000000;
+	cutoff.ts.tv_sec = before;
+	cutoff.ts.tv_nsec = 0;
+
+	/* This matches the forwarded_payments_state_time index. */
+	stmt = db_prepare_v2(w->db,
+			     SQL("DELETE FROM forwarded_payments"
+				 " WHERE id IN (SELECT id FROM forwarded_payments"
+				 "  WHERE state IN (?, ?)"
+				 "  AND COALESCE(resolved_time, received_time) <= ?"
+				 "  ORDER BY COALESCE(resolved_time, received_time)"
+				 "  LIMIT ?);"));
+	db_bind_int(stmt, 0, wallet_forward_status_in_db(state));
+	db_bind_int(stmt, 1, wallet_forward_status_in_db(also));
+	db_bind_timeabs(stmt, 2, cutoff);
+	db_bind_u64(stmt, 3, limit);
+	db_exec_prepared_v2(stmt);
+	deleted = db_count_changes(stmt);
+	tal_free(stmt);
+	return deleted;
+}
+
 struct wallet_transaction *wallet_transactions_get(struct wallet *w, const tal_t *ctx)
 {
 	struct db_stmt *stmt;
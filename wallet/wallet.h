@@ -42,6 +42,10 @@ struct wallet {
 
 	/* How many keys should we look ahead at most? */
 	u64 keyscan_gap;
+
+	/* Our available and reserved outputs, sorted by amount (NULL until
+	 * we first need them). */
+	struct utxo **unspent;
 };
 
 static inline enum output_status output_status_in_db(enum output_status s)
@@ -486,6 +490,22 @@ struct utxo *wallet_find_utxo(const tal_t *ctx, struct wallet *w,
 			      u32 maxheight,
 			      const struct utxo **excludes);
 
+/**
+ * wallet_usable_utxos - All UTXOs we could spend now (does not reserve them!).
+ * @ctx: tal context for the returned array
+ * @w: wallet
+ * @current_blockheight: current chain length.
+ * @maxheight: zero (if caller doesn't care) or maximum blockheight to accept.
+ *
+ * These come from an in-memory index, so this is cheap even for large
+ * wallets.  Returns a `tal_arr` sorted by amount (smallest first): the
+ * utxos themselves belong to the wallet, and are only valid until the
+ * next change to it (such as reserving one of them).
+ */
+const struct utxo **wallet_usable_utxos(const tal_t *ctx, struct wallet *w,
+					u32 current_blockheight,
+					u32 maxheight);
+
 /**
  * wallet_add_onchaind_utxo - Add a UTXO with spending info from onchaind.
  *
@@ -555,6 +575,19 @@ bool wallet_can_spend(struct wallet *w, const u8 *script,
  */
 s64 wallet_get_newindex(struct lightningd *ld);
 
+/**
+ * wallet_derkeys - get the compressed pubkeys for bip32 indices 0 to @max_index.
+ * @ctx: (in) tal context for the result
+ * @w: (in) wallet holding the bip32 base key
+ * @max_index: (in) highest index to return
+ *
+ * Deriving millions of keys is slow, so once derived they are kept in the
+ * database: only keys beyond the highest index we've seen before need
+ * deriving.  Returns an array of (@max_index + 1) * PUBKEY_CMPR_LEN bytes,
+ * the key for index i starting at offset i * PUBKEY_CMPR_LEN.
+ */
+u8 *wallet_derkeys(const tal_t *ctx, struct wallet *w, u64 max_index);
+
 /**
  * wallet_shachain_add_hash -- wallet wrapper around shachain_add_hash
  */
@@ -739,35 +772,35 @@ void wallet_htlc_update(struct wallet *wallet, const u64 htlc_dbid,
 			bool *we_filled);
 
 /**
- * wallet_htlcs_load_in_for_channel - Load incoming HTLCs associated with chan from DB.
+ * wallet_htlcs_load_in - Load incoming HTLCs for all loaded channels.
  *
  * @wallet: wallet to load from
- * @chan: load HTLCs associated with this channel
  * @htlcs_in: htlc_in_map to store loaded htlc_in in
  *
- * This function looks for incoming HTLCs that are associated with the given
- * channel and loads them into the provided map.
+ * This function looks for incoming HTLCs on every channel
+ * wallet_init_channels() loaded, with a single query, and loads them
+ * into the provided map.
  */
-bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
-				      struct channel *chan,
-				      struct htlc_in_map *htlcs_in);
+bool wallet_htlcs_load_in(struct wallet *wallet,
+			  struct htlc_in_map *htlcs_in);
 
 /**
- * wallet_htlcs_load_out_for_channel - Load outgoing HTLCs associated with chan from DB.
+ * wallet_htlcs_load_out - Load outgoing HTLCs for all loaded channels.
  *
  * @wallet: wallet to load from
- * @chan: load HTLCs associated with this channel
  * @htlcs_out: htlc_out_map to store loaded htlc_out in.
  * @remaining_htlcs_in: htlc_in_map with unconnected htlcs (removed as we progress)
  *
+ * Loads outgoing HTLCs on every channel wallet_init_channels() loaded,
+ * with a single query.
+ *
  * We populate htlc_out->in by looking up in remaining_htlcs_in.  It's
  * possible that it's still NULL, since we can have outgoing HTLCs
  * outlive their corresponding incoming.
  */
-bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
-				       struct channel *chan,
-				       struct htlc_out_map *htlcs_out,
-				       struct htlc_in_map *remaining_htlcs_in);
+bool wallet_htlcs_load_out(struct wallet *wallet,
+			   struct htlc_out_map *htlcs_out,
+			   struct htlc_in_map *remaining_htlcs_in);
 
 /**
  * wallet_announcement_save - Save remote announcement information with channel.
@@ -950,6 +983,19 @@ bool wallet_invoice_delete_description(struct wallet *wallet,
 void wallet_invoice_delete_expired(struct wallet *wallet,
 				   u64 max_expiry_time);
 
+/**
+ * wallet_invoice_delete_expired_limit - Delete some expired invoices
+ * with expiration time less than or equal to the given.
+ *
+ * @wallet - the wallet to delete invoices from.
+ * @max_expiry_time - the maximum expiry time to delete.
+ * @limit - the maximum number to delete (must be > 0).
+ *
+ * Returns the number deleted: if it's less than @limit, there are no more.
+ */
+size_t wallet_invoice_delete_expired_limit(struct wallet *wallet,
+					  u64 max_expiry_time, u32 limit);
+
 
 /**
  * wallet_invoice_iterate - Iterate over all existing invoices
@@ -1092,6 +1138,18 @@ void wallet_payment_store(struct wallet *wallet,
  */
 void wallet_payment_delete_by_hash(struct wallet *wallet, const struct sha256 *payment_hash);
 
+/**
+ * wallet_payments_delete_old - Remove some old payments
+ *
+ * Removes up to @limit (> 0) payment parts with @status created at or
+ * before @before (seconds since epoch), oldest first.  Returns the number
+ * deleted: if it's less than @limit, there are no more.
+ */
+size_t wallet_payments_delete_old(struct wallet *wallet,
+				  enum wallet_payment_status status,
+				  u64 before,
+				  u32 limit);
+
 /**
  * wallet_local_htlc_out_delete - Remove a local outgoing failed HTLC
  *
@@ -1374,6 +1432,20 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 						       const struct short_channel_id *chan_in,
 						       const struct short_channel_id *chan_out);
 
+/**
+ * Delete some old forwarded_payments
+ *
+ * Deletes the oldest (by resolved time) forwards in @state (FORWARD_FAILED
+ * includes FORWARD_LOCAL_FAILED) which resolved at or before @before
+ * (seconds since epoch).
+ * Deletes at most @limit (> 0).  Returns the number deleted: if it's less
+ * than @limit, there are no more.
+ */
+size_t wallet_forwarded_payments_delete_old(struct wallet *w,
+					    enum forward_status state,
+					    u64 before,
+					    u32 limit);
+
 /**
  * Load remote_ann_node_sig and remote_ann_bitcoin_sig
  *
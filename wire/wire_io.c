@@ -1,10 +1,12 @@
 #include "config.h"
 /* FIXME: io_plan needs size_t */
  #include <unistd.h>
+#include <ccan/array_size/array_size.h>
 #include <ccan/io/io_plan.h>
 #include <ccan/mem/mem.h>
 #include <common/utils.h>
 #include <errno.h>
+#include <sys/uio.h>
 #include <wire/wire_io.h>
 
 /*
@@ -143,3 +145,90 @@ struct io_plan *io_write_wire_(struct io_conn *conn,
 	arg->u2.s = INSIDE_HEADER_BIT;
 	return io_set_plan(conn, IO_OUT, do_write_wire, next, next_arg);
 }
+
+/* Most messages are small, so this is plenty per writev() */
+#define WRITE_WIRES_IOVS 64
+
+struct write_wires {
+	const u8 **msgs;
+	wire_len_t *hdrs;
+	/* Which msg we're up to, and how much of its header+body is done */
+	size_t idx, off;
+};
+
+/* arg->u1.vp contains struct write_wires */
+static int do_write_wires(int fd, struct io_plan_arg *arg)
+{
+	struct write_wires *w = arg->u1.vp;
+	struct iovec iov[WRITE_WIRES_IOVS];
+	size_t n = 0, skip = w->off;
+	ssize_t ret;
+
+	for (size_t i = w->idx;
+	     i < tal_count(w->msgs) && n + 2 <= ARRAY_SIZE(iov);
+	     i++) {
+		if (skip < HEADER_LEN) {
+			iov[n].iov_base = (char *)&w->hdrs[i] + skip;
+			iov[n].iov_len = HEADER_LEN - skip;
+			n++;
+			skip = 0;
+		} else
+			skip -= HEADER_LEN;
+		iov[n].iov_base = (u8 *)w->msgs[i] + skip;
+		iov[n].iov_len = tal_bytelen(w->msgs[i]) - skip;
+		n++;
+		skip = 0;
+	}
+
+	ret = writev(fd, iov, n);
+	if (ret < 0)
+		return -1;
+
+	while (w->idx < tal_count(w->msgs)) {
+		size_t left = HEADER_LEN + tal_bytelen(w->msgs[w->idx]) - w->off;
+		if ((size_t)ret < left) {
+			w->off += ret;
+			return 0;
+		}
+		ret -= left;
+		w->idx++;
+		w->off = 0;
+	}
+
+	tal_free(w);
+	return 1;
+}
+
+struct io_plan *io_write_wires_(struct io_conn *conn,
+				const u8 **msgs,
+				struct io_plan *(*next)(struct io_conn *, void *),
+				void *next_arg)
+{
+	struct io_plan_arg *arg = io_plan_arg(conn, IO_OUT);
+	struct write_wires *w = tal(conn, struct write_wires);
+	size_t num = tal_count(msgs);
+
+	if (taken(msgs))
+		w->msgs = tal_steal(w, msgs);
+	else {
+		w->msgs = tal_arr(w, const u8 *, num);
+		for (size_t i = 0; i < num; i++)
+			w->msgs[i] = tal_dup_talarr(w->msgs, u8, msgs[i]);
+	}
+
+	w->hdrs = tal_arr(w, wire_len_t, num);
+	for (size_t i = 0; i < num; i++) {
+		size_t len = tal_bytelen(memcheck(w->msgs[i],
+						  tal_bytelen(w->msgs[i])));
+		if (len >= INSIDE_HEADER_BIT) {
+			tal_free(w);
+			errno = E2BIG;
+			return io_close(conn);
+		}
+		w->hdrs[i] = cpu_to_wirelen(len);
+	}
+	w->idx = w->off = 0;
+
+	arg->u1.vp = w;
+	return io_set_plan(conn, IO_OUT, do_write_wires, next, next_arg);
+}
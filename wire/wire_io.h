@@ -36,4 +36,17 @@ struct io_plan *io_write_wire_(struct io_conn *conn,
 		       typesafe_cb_preargs(struct io_plan *, void *,	\
 					   (next), (arg), struct io_conn *), \
 		       (arg))
+
+/* Write several messages, with as few syscalls as possible.  msgs can be
+ * take(), in which case the messages are freed with it. */
+struct io_plan *io_write_wires_(struct io_conn *conn,
+				const u8 **msgs TAKES,
+				struct io_plan *(*next)(struct io_conn *, void *),
+				void *next_arg);
+
+#define io_write_wires(conn, msgs, next, arg)				\
+	io_write_wires_((conn), (msgs),					\
+			typesafe_cb_preargs(struct io_plan *, void *,	\
+					    (next), (arg), struct io_conn *), \
+			(arg))
 #endif /* LIGHTNING_WIRE_WIRE_IO_H */